@@ -21,7 +21,6 @@
 #include <command.h>
 #include <keyparser.h>
 
-#include <QRegExp>
 
 using namespace KateVi;
 
@@ -36,6 +35,13 @@ Command::Command(NormalViMode *parent, QString pattern, bool (NormalViMode::*com
   m_pattern = KeyParser::self()->encodeKeySequence(pattern);
   m_flags = flags;
   m_ptr2commandMethod = commandMethod;
+
+  if (m_flags & REGEX_PATTERN) {
+    // '.' stands for any key, including an encoded Enter.
+    m_regex.setPattern(QRegularExpression::anchoredPattern(m_pattern));
+    m_regex.setPatternOptions(QRegularExpression::DotMatchesEverythingOption);
+    m_regex.optimize();
+  }
 }
 
 Command::~Command() {}
@@ -46,9 +52,13 @@ bool Command::matches(const QString &pattern) const {
   if (!(m_flags & REGEX_PATTERN)) {
     return m_pattern.startsWith(pattern);
   } else {
-    QRegExp re(m_pattern);
-    re.exactMatch(pattern);
-    return (re.matchedLength() == pattern.length());
+    // The keys typed so far either match or may still become a match.
+    if (pattern.isEmpty()) {
+      return true;
+    }
+
+    const auto match = m_regex.match(pattern, 0, QRegularExpression::PartialPreferCompleteMatch);
+    return match.hasMatch() || match.hasPartialMatch();
   }
 }
 
@@ -56,7 +66,6 @@ bool Command::matchesExact(const QString &pattern) const {
   if (!(m_flags & REGEX_PATTERN)) {
     return (m_pattern == pattern);
   } else {
-    QRegExp re(m_pattern);
-    return re.exactMatch(pattern);
+    return m_regex.match(pattern).hasMatch();
   }
 }
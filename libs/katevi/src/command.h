@@ -22,6 +22,7 @@
 #ifndef KATEVI_COMMAND_H
 #define KATEVI_COMMAND_H
 
+#include <QRegularExpression>
 #include <QString>
 
 #include <modes/normalvimode.h>
@@ -61,6 +62,10 @@ public:
 protected:
   NormalViMode *m_parent;
   QString m_pattern;
+
+  // Compiled once for a REGEX_PATTERN command, since every key press tests it.
+  QRegularExpression m_regex;
+
   unsigned int m_flags;
   bool (NormalViMode::*m_ptr2commandMethod)();
   KeyParser *m_keyParser;
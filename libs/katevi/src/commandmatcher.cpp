@@ -0,0 +1,102 @@
+#include "commandmatcher.h"
+
+#include <algorithm>
+
+#include <command.h>
+
+using namespace KateVi;
+
+void CommandMatcher::clear() {
+  m_nodes.clear();
+  m_commands.clear();
+  // The root.
+  m_nodes.append(Node());
+}
+
+QVector<int> CommandMatcher::matching(const QString &p_keys) const {
+  QVector<int> result;
+  if (m_nodes.isEmpty()) {
+    return result;
+  }
+
+  int node = 0;
+  for (int i = 0; i < p_keys.size(); ++i) {
+    // A regex ending above the last key checks the rest of the keys itself.
+    for (int idx : m_nodes.at(node).m_regexLeaves) {
+      if (m_commands.at(idx)->matches(p_keys)) {
+        result.append(idx);
+      }
+    }
+
+    auto it = m_nodes.at(node).m_children.constFind(p_keys.at(i));
+    if (it == m_nodes.at(node).m_children.constEnd()) {
+      std::sort(result.begin(), result.end());
+      return result;
+    }
+
+    node = it.value();
+  }
+
+  // The keys are a prefix of the literal part of everything below.
+  result += m_nodes.at(node).m_below;
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+void CommandMatcher::add(const Command *p_command, int p_index) {
+  Q_ASSERT(m_commands.size() == p_index);
+  m_commands.append(p_command);
+
+  const QString pattern = p_command->pattern();
+  const int literalLength = literalPrefixLength(p_command);
+  int node = 0;
+  m_nodes[node].m_below.append(p_index);
+  for (int i = 0; i < literalLength; ++i) {
+    const QChar key = pattern.at(i);
+    auto it = m_nodes.at(node).m_children.constFind(key);
+    if (it != m_nodes.at(node).m_children.constEnd()) {
+      node = it.value();
+    } else {
+      m_nodes.append(Node());
+      const int child = m_nodes.size() - 1;
+      m_nodes[node].m_children.insert(key, child);
+      node = child;
+    }
+
+    m_nodes[node].m_below.append(p_index);
+  }
+
+  if (p_command->isRegexPattern()) {
+    m_nodes[node].m_regexLeaves.append(p_index);
+  }
+}
+
+int CommandMatcher::literalPrefixLength(const Command *p_command) {
+  const QString pattern = p_command->pattern();
+  if (!p_command->isRegexPattern()) {
+    return pattern.size();
+  }
+
+  // An alternative may start with anything.
+  for (int i = 0; i < pattern.size(); ++i) {
+    if (pattern.at(i) == QLatin1Char('\\')) {
+      ++i;
+    } else if (pattern.at(i) == QLatin1Char('|')) {
+      return 0;
+    }
+  }
+
+  static const QString metaCharacters = QStringLiteral("\\.[](){}*+?^$|");
+  static const QString optionalQuantifiers = QStringLiteral("*?{");
+  for (int i = 0; i < pattern.size(); ++i) {
+    if (metaCharacters.contains(pattern.at(i))) {
+      // The character before a quantifier allowing zero of it is optional.
+      if (i > 0 && optionalQuantifiers.contains(pattern.at(i))) {
+        return i - 1;
+      }
+      return i;
+    }
+  }
+
+  return pattern.size();
+}
@@ -0,0 +1,56 @@
+#ifndef KATEVI_COMMANDMATCHER_H
+#define KATEVI_COMMANDMATCHER_H
+
+#include <QChar>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace KateVi {
+class Command;
+
+// A key sequence trie over the patterns of a command or motion table, so that
+// a key press only visits the commands its keys can still lead to.
+// A literal pattern is stored key by key. A regex pattern is stored under its
+// literal prefix, the keys before its first metacharacter, and the rest is
+// left to the regex the command compiled once.
+class CommandMatcher {
+public:
+  // Index @p_commands. The indices returned below are positions in it.
+  template <typename T> void build(const QVector<T *> &p_commands) {
+    clear();
+    for (int i = 0; i < p_commands.size(); ++i) {
+      add(p_commands.at(i), i);
+    }
+  }
+
+  void clear();
+
+  // Ascending indices of the commands whose Command::matches() accepts
+  // @p_keys.
+  QVector<int> matching(const QString &p_keys) const;
+
+private:
+  struct Node {
+    QHash<QChar, int> m_children;
+
+    // Ascending indices of the commands whose literal part runs through this
+    // node, including the ones ending here.
+    QVector<int> m_below;
+
+    // Regex commands whose literal prefix ends here.
+    QVector<int> m_regexLeaves;
+  };
+
+  void add(const Command *p_command, int p_index);
+
+  // Length of the keys every match of @p_command starts with.
+  static int literalPrefixLength(const Command *p_command);
+
+  QVector<Node> m_nodes;
+
+  QVector<const Command *> m_commands;
+};
+} // namespace KateVi
+
+#endif // KATEVI_COMMANDMATCHER_H
@@ -46,6 +46,17 @@ void ActiveMode::setViInputModeManager(InputModeManager *viInputModeManager) {
   m_viInputModeManager = viInputModeManager;
 }
 
+void ActiveMode::close(bool wasAborted) {
+  m_emulatedCommandBar->m_wasAborted = wasAborted;
+  emit m_emulatedCommandBar->hideMe();
+}
+
+void ActiveMode::closeWithStatusMessage(const QString &exitStatusMessage) {
+  // Only a command which ran shows its message.
+  m_emulatedCommandBar->m_wasAborted = false;
+  m_emulatedCommandBar->closeWithStatusMessage(exitStatusMessage);
+}
+
 #if 0
 void ActiveMode::hideAllWidgetsExcept(QWidget* widgetToKeepVisible)
 {
@@ -57,17 +68,6 @@ void ActiveMode::updateMatchHighlight(const KTextEditor::Range& matchRange)
     m_matchHighligher->updateMatchHighlight(matchRange);
 }
 
-void ActiveMode::close( bool wasAborted )
-{
-    m_emulatedCommandBar->m_wasAborted = wasAborted;
-    m_emulatedCommandBar->hideMe();
-}
-
-void ActiveMode::closeWithStatusMessage(const QString& exitStatusMessage)
-{
-    m_emulatedCommandBar->closeWithStatusMessage(exitStatusMessage);
-}
-
 void ActiveMode::startCompletion ( const CompletionStartParams& completionStartParams )
 {
     m_emulatedCommandBar->m_completer->startCompletion(completionStartParams);
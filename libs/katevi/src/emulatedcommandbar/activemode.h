@@ -60,12 +60,14 @@ public:
   void setViInputModeManager(InputModeManager *viInputModeManager);
 
 protected:
+  void close(bool wasAborted);
+
+  void closeWithStatusMessage(const QString &exitStatusMessage);
+
 #if 0
     // Helper methods.
     void hideAllWidgetsExcept(QWidget* widgetToKeepVisible);
     void updateMatchHighlight(const KTextEditor::Range &matchRange);
-    void close(bool wasAborted);
-    void closeWithStatusMessage(const QString& exitStatusMessage);
     void startCompletion(const CompletionStartParams& completionStartParams);
     void moveCursorTo(const KTextEditor::Cursor &cursorPos);
 #endif
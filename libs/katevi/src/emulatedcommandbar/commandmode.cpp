@@ -31,6 +31,9 @@
 #include <katevi/global.h>
 #include <katevi/globalstate.h>
 #include <katevi/inputmodemanager.h>
+#include <katevi/interface/katevieditorinterface.h>
+#include <linecommand.h>
+#include <marks.h>
 
 #include <QLineEdit>
 #include <QRegularExpression>
@@ -154,7 +157,13 @@ CommandMode::completionInvoked(Completer::CompletionInvocation invocationType) {
 }
 
 void CommandMode::completionChosen() {
-  KATEVI_NIY;
+  const QString commandResponseMessage = executeCommand(m_edit->text());
+  if (commandResponseMessage.isEmpty()) {
+    close(false);
+  } else {
+    closeWithStatusMessage(commandResponseMessage);
+  }
+  viInputModeManager()->globalState()->commandHistory()->append(m_edit->text());
 #if 0
     QString commandToExecute = m_edit->text();
     CommandMode::ParsedSedExpression parsedSedExpression = parseAsSedExpression();
@@ -182,7 +191,39 @@ void CommandMode::completionChosen() {
 }
 
 QString CommandMode::executeCommand(const QString &commandToExecute) {
-  KATEVI_NIY;
+  // Silently ignore leading space characters and colon characters (for vi-heads).
+  int n = 0;
+  while (n < commandToExecute.length() &&
+         (commandToExecute[n].isSpace() || commandToExecute[n] == QLatin1Char(':'))) {
+    n++;
+  }
+
+  QString cmd = commandToExecute.mid(n).trimmed();
+  if (cmd.isEmpty()) {
+    return QString();
+  }
+
+  // Only the commands of LineCommand are supported for now. :substitute works
+  // on the current line by default and :global on the whole document.
+  auto editor = editorInterface();
+  int firstLine = editor->cursorPosition().line();
+  int lastLine = firstLine;
+  if (LineCommand::kind(cmd) == LineCommand::Kind::Global) {
+    firstLine = 0;
+    lastLine = editor->lines() - 1;
+  }
+
+  QString commandResponseMessage;
+  if (!parseRange(cmd, firstLine, lastLine)) {
+    commandResponseMessage = QStringLiteral("Invalid range");
+  } else if (LineCommand::kind(cmd) != LineCommand::Kind::None) {
+    LineCommand::exec(editor, cmd, firstLine, lastLine, commandResponseMessage);
+  } else {
+    commandResponseMessage = QStringLiteral("No such command: \"%1\"").arg(cmd);
+  }
+
+  viInputModeManager()->reset();
+  return commandResponseMessage;
 #if 0
     // Silently ignore leading space characters and colon characters (for vi-heads).
     uint n = 0;
@@ -245,7 +286,88 @@ QString CommandMode::executeCommand(const QString &commandToExecute) {
     viInputModeManager()->reset();
     return commandResponseMessage;
 #endif
-  return "";
+}
+
+bool CommandMode::parseRange(QString &cmd, int &firstLine, int &lastLine) {
+  const int lineCount = editorInterface()->lines();
+  if (cmd.startsWith(QLatin1Char('%'))) {
+    firstLine = 0;
+    lastLine = lineCount - 1;
+    cmd.remove(0, 1);
+    return true;
+  }
+
+  const int currentLine = editorInterface()->cursorPosition().line();
+  int pos = 0;
+  int first = currentLine;
+  if (!parseLineAddress(cmd, pos, first)) {
+    return false;
+  }
+
+  int last = first;
+  if (pos < cmd.length() && (cmd[pos] == QLatin1Char(',') || cmd[pos] == QLatin1Char(';'))) {
+    // After ; the second address is relative to the first one.
+    last = cmd[pos] == QLatin1Char(';') ? first : currentLine;
+    ++pos;
+    if (!parseLineAddress(cmd, pos, last)) {
+      return false;
+    }
+  }
+
+  if (pos == 0) {
+    return true;
+  }
+
+  if (first < 0 || last < 0 || first >= lineCount || last >= lineCount) {
+    return false;
+  }
+
+  if (first > last) {
+    qSwap(first, last);
+  }
+
+  firstLine = first;
+  lastLine = last;
+  cmd = cmd.mid(pos).trimmed();
+  return true;
+}
+
+bool CommandMode::parseLineAddress(const QString &cmd, int &pos, int &line) {
+  if (pos < cmd.length()) {
+    const QChar c = cmd[pos];
+    if (c.isDigit()) {
+      int end = pos;
+      while (end < cmd.length() && cmd[end].isDigit()) {
+        end++;
+      }
+      line = cmd.mid(pos, end - pos).toInt() - 1;
+      pos = end;
+    } else if (c == QLatin1Char('.')) {
+      pos++;
+    } else if (c == QLatin1Char('$')) {
+      line = editorInterface()->lines() - 1;
+      pos++;
+    } else if (c == QLatin1Char('\'') && pos + 1 < cmd.length()) {
+      const KateViI::Cursor mark = viInputModeManager()->marks()->getMarkPosition(cmd[pos + 1]);
+      if (!mark.isValid()) {
+        return false;
+      }
+      line = mark.line();
+      pos += 2;
+    }
+  }
+
+  while (pos < cmd.length() && (cmd[pos] == QLatin1Char('+') || cmd[pos] == QLatin1Char('-'))) {
+    const int sign = cmd[pos] == QLatin1Char('+') ? 1 : -1;
+    int end = ++pos;
+    while (end < cmd.length() && cmd[end].isDigit()) {
+      end++;
+    }
+    line += sign * (end == pos ? 1 : cmd.mid(pos, end - pos).toInt());
+    pos = end;
+  }
+
+  return true;
 }
 
 #if 0
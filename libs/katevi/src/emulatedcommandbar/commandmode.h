@@ -65,6 +65,17 @@ private:
     QChar delimiter;
   };
 
+  // Parse the range at the start of @cmd, such as %, 3,$ or '<,'>, and strip
+  // it. @firstLine and @lastLine are left alone if there is no range. Returns
+  // false if the range is invalid.
+  bool parseRange(QString &cmd, int &firstLine, int &lastLine);
+
+  // Read the line address at @pos of @cmd, a number, ., $ or a mark followed by
+  // +N and -N offsets, into @line. @line is left alone if there is none.
+  // Only the '< and '> marks of the last visual selection are kept so far.
+  // Returns false if the mark is not set.
+  bool parseLineAddress(const QString &cmd, int &pos, int &line);
+
 #if 0
         CompletionStartParams activateCommandCompletion();
         CompletionStartParams activateCommandHistoryCompletion();
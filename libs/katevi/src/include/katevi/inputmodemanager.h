@@ -23,6 +23,7 @@
 #ifndef KATEVI_INPUT_MODE_MANAGER_H
 #define KATEVI_INPUT_MODE_MANAGER_H
 
+#include <QElapsedTimer>
 #include <QKeyEvent>
 #include <QScopedPointer>
 #include <QStack>
@@ -81,6 +82,15 @@ public:
    */
   bool isHandlingKeyPress() const;
 
+  /**
+   * Start replaying recorded keys, such as a macro or the last change. The
+   * outermost replay runs as one edit session, in which the editor may hold
+   * its updates, and reports the replayed keys to the editor at its end.
+   */
+  void beginReplay();
+
+  void endReplay();
+
   /**
    * @return The current vi mode
    */
@@ -254,6 +264,14 @@ private:
 
   int m_insideHandlingKeyPressCount = 0;
 
+  // Nesting depth of beginReplay().
+  int m_replayCount = 0;
+
+  // Keys handled since the outermost beginReplay().
+  int m_replayedKeyCount = 0;
+
+  QElapsedTimer m_replayTimer;
+
   /**
    * a list of the (encoded) key events that was part of the last change.
    */
@@ -69,6 +69,13 @@ public:
   // End an edit session.
   virtual void editEnd() = 0;
 
+  // Recorded keys, such as a macro or the last change, are about to be
+  // replayed. The editor may hold its updates until replayEnd(). Not nested.
+  virtual void replayStart() = 0;
+
+  // @p_keys keys were replayed in @p_nsecs nanoseconds since replayStart().
+  virtual void replayEnd(int p_keys, qint64 p_nsecs) = 0;
+
   // Remove text specified in @p_range. If @p_blockWise is true, will remove a
   // text block on the basis of columns.
   virtual bool removeText(const KateViI::Range &p_range, bool p_blockWise = false) = 0;
@@ -105,6 +105,9 @@ InputModeManager::~InputModeManager() {
 
 bool InputModeManager::handleKeyPress(const QKeyEvent *e) {
   m_insideHandlingKeyPressCount++;
+  if (m_replayCount > 0) {
+    m_replayedKeyCount++;
+  }
   bool res = false;
   bool keyIsPartOfMapping = false;
 
@@ -247,6 +250,27 @@ void InputModeManager::feedKeyPresses(const QString &keyPresses) const {
 
 bool InputModeManager::isHandlingKeyPress() const { return m_insideHandlingKeyPressCount > 0; }
 
+void InputModeManager::beginReplay() {
+  if (m_replayCount++ > 0) {
+    return;
+  }
+
+  m_replayedKeyCount = 0;
+  m_replayTimer.start();
+  m_interface->replayStart();
+  m_interface->editStart();
+}
+
+void InputModeManager::endReplay() {
+  Q_ASSERT(m_replayCount > 0);
+  if (--m_replayCount > 0) {
+    return;
+  }
+
+  m_interface->editEnd();
+  m_interface->replayEnd(m_replayedKeyCount, m_replayTimer.nsecsElapsed());
+}
+
 void InputModeManager::storeLastChangeCommand() {
   m_lastChange = m_lastChangeRecorder->encodedChanges();
   m_lastChangeCompletionsLog = m_completionRecorder->currentChangeCompletionsLog();
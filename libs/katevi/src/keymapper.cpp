@@ -84,23 +84,16 @@ bool KeyMapper::handleKeyPress(QChar key) {
   if (!m_doNotExpandFurtherMappings && !m_doNotMapNextKeyPress && !m_isPlayingBackRejectedKeys) {
     m_mappingKeys.append(key);
 
-    // Try to match through all the defined mappings.
+    // Try to match through the mappings starting with the keys.
     bool isPartialMapping = false;
     bool isFullMapping = false;
     m_fullMappingMatch.clear();
     const auto mappings = m_viInputModeManager->globalState()->mappings();
     const auto mappingMode =
         Mappings::mappingModeForCurrentViMode(m_viInputModeManager->inputAdapter());
-    const auto allMappings = mappings->getAll(mappingMode, false, true);
-    for (const QString &mapping : allMappings) {
-      if (mapping.startsWith(m_mappingKeys)) {
-        if (mapping == m_mappingKeys) {
-          isFullMapping = true;
-          m_fullMappingMatch = mapping;
-        } else {
-          isPartialMapping = true;
-        }
-      }
+    mappings->match(mappingMode, m_mappingKeys, true, &isFullMapping, &isPartialMapping);
+    if (isFullMapping) {
+      m_fullMappingMatch = m_mappingKeys;
     }
 
     if (isFullMapping && !isPartialMapping) {
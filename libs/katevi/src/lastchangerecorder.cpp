@@ -105,8 +105,10 @@ bool LastChangeRecorder::isReplaying() const { return m_isReplaying; }
 
 void LastChangeRecorder::replay(const QString &commands, const CompletionList &completions) {
   m_isReplaying = true;
+  m_viInputModeManager->beginReplay();
   m_viInputModeManager->completionReplayer()->start(completions);
   m_viInputModeManager->feedKeyPresses(commands);
   m_viInputModeManager->completionReplayer()->stop();
+  m_viInputModeManager->endReplay();
   m_isReplaying = false;
 }
@@ -0,0 +1,616 @@
+#include "linecommand.h"
+
+#include <functional>
+
+#include <QAtomicInt>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <katevi/interface/katevieditorinterface.h>
+
+using namespace KateVi;
+
+const int LineCommand::c_parallelPlanSize = 256 * 1024;
+
+const int LineCommand::c_planChunkSize = 64 * 1024;
+
+namespace {
+class FunctionRunnable : public QRunnable {
+public:
+  explicit FunctionRunnable(const std::function<void()> &p_func) : m_func(p_func) {}
+
+  void run() Q_DECL_OVERRIDE { m_func(); }
+
+private:
+  std::function<void()> m_func;
+};
+
+// Literal text, or the text of capture group m_group if it is not -1.
+struct ReplacePart {
+  QString m_text;
+
+  int m_group = -1;
+};
+
+struct Substitute {
+  QRegularExpression m_regExp;
+
+  QVector<ReplacePart> m_replacement;
+
+  // Flag g: every match of a line instead of the first one.
+  bool m_all = false;
+
+  // Flag e: no error if nothing matches.
+  bool m_quiet = false;
+};
+
+struct ParsedCommand {
+  LineCommand::Kind m_kind = LineCommand::Kind::None;
+
+  QString m_error;
+
+  // :global and :vglobal only. The lines matching m_filter, or the ones not
+  // matching it if m_invert, are deleted or substituted.
+  QRegularExpression m_filter;
+
+  bool m_invert = false;
+
+  bool m_delete = false;
+
+  Substitute m_substitute;
+};
+
+enum class LineState { Same, Replaced, Removed };
+
+struct LineResult {
+  LineState m_state = LineState::Same;
+
+  int m_substitutions = 0;
+
+  // Replaced only. May hold line breaks.
+  QString m_text;
+};
+
+QString readName(const QString &p_cmd, int &p_pos) {
+  const int start = p_pos;
+  while (p_pos < p_cmd.size() && p_cmd[p_pos].isLetter()) {
+    ++p_pos;
+  }
+  return p_cmd.mid(start, p_pos - start);
+}
+
+bool isAbbreviationOf(const QString &p_name, const QString &p_full) {
+  return !p_name.isEmpty() && p_full.startsWith(p_name);
+}
+
+// Read up to the next @p_delimiter not escaped, which is dropped. An escaped
+// delimiter loses its backslash; other escapes are kept for the next parser.
+QString readTerm(const QString &p_cmd, int &p_pos, QChar p_delimiter) {
+  QString term;
+  while (p_pos < p_cmd.size()) {
+    const QChar ch = p_cmd[p_pos];
+    if (ch == QLatin1Char('\\') && p_pos + 1 < p_cmd.size()) {
+      const QChar next = p_cmd[p_pos + 1];
+      if (next != p_delimiter) {
+        term += ch;
+      }
+      term += next;
+      p_pos += 2;
+      continue;
+    }
+
+    ++p_pos;
+    if (ch == p_delimiter) {
+      break;
+    }
+    term += ch;
+  }
+  return term;
+}
+
+bool isDelimiter(QChar p_ch) {
+  return !p_ch.isLetterOrNumber() && !p_ch.isSpace() && p_ch != QLatin1Char('\\') &&
+         p_ch != QLatin1Char('"') && p_ch != QLatin1Char('|');
+}
+
+bool compile(const QString &p_pattern, bool p_caseInsensitive, QRegularExpression &p_regExp,
+             QString &p_error) {
+  bool caseInsensitive = p_caseInsensitive;
+  const auto pattern = LineCommand::toQtPattern(p_pattern, &caseInsensitive);
+  p_regExp = QRegularExpression(pattern, caseInsensitive
+                                             ? QRegularExpression::CaseInsensitiveOption
+                                             : QRegularExpression::NoPatternOption);
+  if (!p_regExp.isValid()) {
+    p_error = QStringLiteral("Invalid pattern: %1 (%2)").arg(p_pattern, p_regExp.errorString());
+    return false;
+  }
+
+  // Compile once here instead of in the first match of each thread.
+  p_regExp.optimize();
+  return true;
+}
+
+QVector<ReplacePart> parseReplacement(const QString &p_text) {
+  QVector<ReplacePart> parts;
+  QString literal;
+  auto flush = [&parts, &literal]() {
+    if (!literal.isEmpty()) {
+      ReplacePart part;
+      part.m_text = literal;
+      parts.append(part);
+      literal.clear();
+    }
+  };
+  auto appendGroup = [&parts, &flush](int p_group) {
+    flush();
+    ReplacePart part;
+    part.m_group = p_group;
+    parts.append(part);
+  };
+
+  for (int i = 0; i < p_text.size(); ++i) {
+    const QChar ch = p_text[i];
+    if (ch == QLatin1Char('\\') && i + 1 < p_text.size()) {
+      const QChar next = p_text[++i];
+      if (next.isDigit()) {
+        appendGroup(next.digitValue());
+      } else if (next == QLatin1Char('n') || next == QLatin1Char('r')) {
+        literal += QLatin1Char('\n');
+      } else if (next == QLatin1Char('t')) {
+        literal += QLatin1Char('\t');
+      } else {
+        literal += next;
+      }
+    } else if (ch == QLatin1Char('&')) {
+      appendGroup(0);
+    } else {
+      literal += ch;
+    }
+  }
+  flush();
+  return parts;
+}
+
+// Parse the part of a :substitute after its name, from @p_pos of @p_cmd.
+// An empty pattern takes @p_lastPattern if there is one.
+bool parseSubstitute(const QString &p_cmd, int p_pos, const QRegularExpression *p_lastPattern,
+                     Substitute &p_substitute, QString &p_error) {
+  if (p_pos >= p_cmd.size() || !isDelimiter(p_cmd[p_pos])) {
+    p_error = QStringLiteral("Expected a delimiter: %1").arg(p_cmd);
+    return false;
+  }
+
+  const QChar delimiter = p_cmd[p_pos++];
+  const auto pattern = readTerm(p_cmd, p_pos, delimiter);
+  const auto replacement = readTerm(p_cmd, p_pos, delimiter);
+
+  bool caseInsensitive = false;
+  for (; p_pos < p_cmd.size(); ++p_pos) {
+    const QChar flag = p_cmd[p_pos];
+    if (flag == QLatin1Char('g')) {
+      p_substitute.m_all = true;
+    } else if (flag == QLatin1Char('i')) {
+      caseInsensitive = true;
+    } else if (flag == QLatin1Char('I')) {
+      caseInsensitive = false;
+    } else if (flag == QLatin1Char('e')) {
+      p_substitute.m_quiet = true;
+    } else if (!flag.isSpace()) {
+      p_error = QStringLiteral("Unsupported flag: %1").arg(flag);
+      return false;
+    }
+  }
+
+  if (pattern.isEmpty()) {
+    if (!p_lastPattern) {
+      p_error = QStringLiteral("No previous regular expression");
+      return false;
+    }
+    p_substitute.m_regExp = *p_lastPattern;
+  } else if (!compile(pattern, caseInsensitive, p_substitute.m_regExp, p_error)) {
+    return false;
+  }
+
+  p_substitute.m_replacement = parseReplacement(replacement);
+  return true;
+}
+
+// Parse the part of a :global or :vglobal after its name.
+bool parseGlobal(const QString &p_name, const QString &p_cmd, int p_pos,
+                 ParsedCommand &p_parsed) {
+  p_parsed.m_invert = p_name.startsWith(QLatin1Char('v'));
+  if (p_pos < p_cmd.size() && p_cmd[p_pos] == QLatin1Char('!')) {
+    p_parsed.m_invert = !p_parsed.m_invert;
+    ++p_pos;
+  }
+
+  if (p_pos >= p_cmd.size() || !isDelimiter(p_cmd[p_pos])) {
+    p_parsed.m_error = QStringLiteral("Expected a delimiter: %1").arg(p_cmd);
+    return false;
+  }
+
+  const QChar delimiter = p_cmd[p_pos++];
+  const auto pattern = readTerm(p_cmd, p_pos, delimiter);
+  if (pattern.isEmpty()) {
+    p_parsed.m_error = QStringLiteral("No previous regular expression");
+    return false;
+  }
+
+  if (!compile(pattern, false, p_parsed.m_filter, p_parsed.m_error)) {
+    return false;
+  }
+
+  const auto command = p_cmd.mid(p_pos).trimmed();
+  int pos = 0;
+  const auto name = readName(command, pos);
+  if (isAbbreviationOf(name, QStringLiteral("delete")) && pos == command.size()) {
+    p_parsed.m_delete = true;
+    return true;
+  }
+
+  if (LineCommand::kind(command) == LineCommand::Kind::Substitute) {
+    return parseSubstitute(command, pos, &p_parsed.m_filter, p_parsed.m_substitute,
+                           p_parsed.m_error);
+  }
+
+  p_parsed.m_error = command.isEmpty()
+                         ? QStringLiteral("Missing command for :global")
+                         : QStringLiteral("Unsupported command for :global: %1").arg(command);
+  return false;
+}
+
+ParsedCommand parse(const QString &p_cmd) {
+  ParsedCommand parsed;
+  parsed.m_kind = LineCommand::kind(p_cmd);
+  int pos = 0;
+  const auto name = readName(p_cmd, pos);
+  switch (parsed.m_kind) {
+  case LineCommand::Kind::Substitute:
+    parseSubstitute(p_cmd, pos, nullptr, parsed.m_substitute, parsed.m_error);
+    break;
+
+  case LineCommand::Kind::Global:
+    parseGlobal(name, p_cmd, pos, parsed);
+    break;
+
+  case LineCommand::Kind::None:
+    parsed.m_error = QStringLiteral("No such command: \"%1\"").arg(p_cmd);
+    break;
+  }
+  return parsed;
+}
+
+void substituteLine(const Substitute &p_substitute, const QString &p_line,
+                    LineResult &p_result) {
+  auto it = p_substitute.m_regExp.globalMatch(p_line);
+  if (!it.hasNext()) {
+    return;
+  }
+
+  QString text;
+  text.reserve(p_line.size());
+  int last = 0;
+  int count = 0;
+  while (it.hasNext()) {
+    const auto match = it.next();
+    text.append(p_line.constData() + last, match.capturedStart() - last);
+    for (const auto &part : p_substitute.m_replacement) {
+      if (part.m_group < 0) {
+        text += part.m_text;
+      } else if (part.m_group <= match.lastCapturedIndex() &&
+                 match.capturedStart(part.m_group) >= 0) {
+        text.append(p_line.constData() + match.capturedStart(part.m_group),
+                    match.capturedLength(part.m_group));
+      }
+    }
+
+    last = match.capturedEnd();
+    ++count;
+    if (!p_substitute.m_all) {
+      break;
+    }
+  }
+  text.append(p_line.constData() + last, p_line.size() - last);
+
+  p_result.m_state = LineState::Replaced;
+  p_result.m_substitutions = count;
+  p_result.m_text = text;
+}
+
+void planLine(const ParsedCommand &p_parsed, const QString &p_line, LineResult &p_result) {
+  if (p_parsed.m_kind == LineCommand::Kind::Global) {
+    if (p_parsed.m_filter.match(p_line).hasMatch() == p_parsed.m_invert) {
+      return;
+    }
+
+    if (p_parsed.m_delete) {
+      p_result.m_state = LineState::Removed;
+      return;
+    }
+  }
+
+  substituteLine(p_parsed.m_substitute, p_line, p_result);
+}
+
+// Plan every line of @p_lines into @p_results, using the thread pool if the
+// lines are many enough to be worth it.
+void planLines(const ParsedCommand &p_parsed, const QStringList &p_lines,
+               QVector<LineResult> &p_results, int p_parallelSize, int p_chunkSize) {
+  // Cut the lines into chunks of about p_chunkSize characters.
+  QVector<int> chunkEnds;
+  int chunkSize = 0;
+  int totalSize = 0;
+  for (int i = 0; i < p_lines.size(); ++i) {
+    chunkSize += p_lines[i].size() + 1;
+    if (chunkSize >= p_chunkSize) {
+      chunkEnds.append(i + 1);
+      totalSize += chunkSize;
+      chunkSize = 0;
+    }
+  }
+  if (chunkEnds.isEmpty() || chunkEnds.last() != p_lines.size()) {
+    chunkEnds.append(p_lines.size());
+    totalSize += chunkSize;
+  }
+
+  QAtomicInt nextChunk(0);
+  auto planChunks = [&p_parsed, &p_lines, &p_results, &chunkEnds, &nextChunk]() {
+    int chunk = 0;
+    while ((chunk = nextChunk.fetchAndAddRelaxed(1)) < chunkEnds.size()) {
+      const int first = chunk == 0 ? 0 : chunkEnds[chunk - 1];
+      for (int i = first; i < chunkEnds[chunk]; ++i) {
+        planLine(p_parsed, p_lines[i], p_results[i]);
+      }
+    }
+  };
+
+  if (totalSize < p_parallelSize) {
+    planChunks();
+    return;
+  }
+
+  // The calling thread plans too, so a busy pool only means fewer helpers.
+  auto pool = QThreadPool::globalInstance();
+  QSemaphore finished;
+  const int maxHelpers = qMin(pool->maxThreadCount(), chunkEnds.size()) - 1;
+  int helpers = 0;
+  for (; helpers < maxHelpers; ++helpers) {
+    auto runnable = new FunctionRunnable([&planChunks, &finished]() {
+      planChunks();
+      finished.release();
+    });
+    if (!pool->tryStart(runnable)) {
+      delete runnable;
+      break;
+    }
+  }
+
+  planChunks();
+  finished.acquire(helpers);
+}
+
+void applyChange(KateViI::KateViEditorInterface *p_interface,
+                 const LineCommand::Change &p_change) {
+  const KateViI::Cursor start(p_change.m_first, 0);
+  const KateViI::Cursor end(p_change.m_last, p_interface->lineLength(p_change.m_last));
+  if (p_change.m_lineCount > 0) {
+    if (start == end) {
+      // An empty line, which QTextCursor cannot select.
+      if (!p_change.m_text.isEmpty()) {
+        p_interface->insertText(start, p_change.m_text);
+      }
+    } else {
+      p_interface->replaceText(KateViI::Range(start, end), p_change.m_text);
+    }
+    return;
+  }
+
+  // Removed with one of the line breaks around.
+  if (p_change.m_last + 1 < p_interface->lines()) {
+    p_interface->replaceText(KateViI::Range(start, KateViI::Cursor(p_change.m_last + 1, 0)),
+                             QString());
+  } else if (p_change.m_first > 0) {
+    const int previous = p_change.m_first - 1;
+    p_interface->replaceText(
+        KateViI::Range(KateViI::Cursor(previous, p_interface->lineLength(previous)), end),
+        QString());
+  } else if (start != end) {
+    p_interface->replaceText(KateViI::Range(start, end), QString());
+  }
+}
+} // namespace
+
+LineCommand::Kind LineCommand::kind(const QString &p_cmd) {
+  int pos = 0;
+  const auto name = readName(p_cmd, pos);
+  if (isAbbreviationOf(name, QStringLiteral("substitute"))) {
+    return Kind::Substitute;
+  }
+
+  if (isAbbreviationOf(name, QStringLiteral("global")) ||
+      isAbbreviationOf(name, QStringLiteral("vglobal"))) {
+    return Kind::Global;
+  }
+
+  return Kind::None;
+}
+
+LineCommand::Plan LineCommand::plan(const QString &p_cmd, const QStringList &p_lines,
+                                    int p_firstLine) {
+  Plan result;
+  const auto parsed = parse(p_cmd);
+  if (!parsed.m_error.isEmpty()) {
+    result.m_error = parsed.m_error;
+    return result;
+  }
+
+  QVector<LineResult> lines(p_lines.size());
+  planLines(parsed, p_lines, lines, c_parallelPlanSize, c_planChunkSize);
+
+  // Merge the runs of changed lines.
+  for (int i = 0; i < lines.size(); ++i) {
+    if (lines[i].m_state == LineState::Same) {
+      continue;
+    }
+
+    Change change;
+    change.m_first = p_firstLine + i;
+    for (; i < lines.size() && lines[i].m_state != LineState::Same; ++i) {
+      const auto &line = lines[i];
+      if (line.m_state == LineState::Removed) {
+        ++result.m_removedLines;
+        continue;
+      }
+
+      if (change.m_lineCount > 0) {
+        change.m_text += QLatin1Char('\n');
+      }
+      change.m_text += line.m_text;
+      change.m_lineCount += line.m_text.count(QLatin1Char('\n')) + 1;
+      result.m_substitutions += line.m_substitutions;
+      ++result.m_substitutedLines;
+    }
+    change.m_last = p_firstLine + i - 1;
+    result.m_changes.append(change);
+  }
+
+  if (result.m_changes.isEmpty() && !parsed.m_substitute.m_quiet) {
+    const auto &regExp =
+        parsed.m_kind == Kind::Global ? parsed.m_filter : parsed.m_substitute.m_regExp;
+    result.m_error = QStringLiteral("Pattern not found: %1").arg(regExp.pattern());
+  }
+  return result;
+}
+
+void LineCommand::apply(KateViI::KateViEditorInterface *p_interface, const Plan &p_plan) {
+  const auto &changes = p_plan.m_changes;
+  if (changes.isEmpty()) {
+    return;
+  }
+
+  // From the last run so that the line numbers of the ones before hold.
+  p_interface->editStart();
+  for (int i = changes.size() - 1; i >= 0; --i) {
+    applyChange(p_interface, changes[i]);
+  }
+  p_interface->editEnd();
+
+  int delta = 0;
+  for (int i = 0; i < changes.size() - 1; ++i) {
+    delta += changes[i].m_lineCount - (changes[i].m_last - changes[i].m_first + 1);
+  }
+  const auto &last = changes.last();
+  int line = last.m_first + delta + qMax(last.m_lineCount - 1, 0);
+  line = qBound(0, line, p_interface->lines() - 1);
+  p_interface->setCursorPosition(KateViI::Cursor(line, qMax(p_interface->firstChar(line), 0)));
+}
+
+bool LineCommand::exec(KateViI::KateViEditorInterface *p_interface, const QString &p_cmd,
+                       int p_firstLine, int p_lastLine, QString &p_msg) {
+  QStringList lines;
+  lines.reserve(p_lastLine - p_firstLine + 1);
+  for (int i = p_firstLine; i <= p_lastLine; ++i) {
+    lines.append(p_interface->line(i));
+  }
+
+  const auto result = plan(p_cmd, lines, p_firstLine);
+  if (!result.m_error.isEmpty()) {
+    p_msg = result.m_error;
+    return false;
+  }
+
+  if (!result.m_changes.isEmpty() && p_interface->isReadOnly()) {
+    p_msg = QStringLiteral("The document is read-only");
+    return false;
+  }
+
+  apply(p_interface, result);
+
+  if (result.m_removedLines > 0) {
+    p_msg = QStringLiteral("%1 fewer lines").arg(result.m_removedLines);
+  } else if (result.m_substitutions > 0) {
+    p_msg = QStringLiteral("%1 substitutions on %2 lines")
+                .arg(result.m_substitutions)
+                .arg(result.m_substitutedLines);
+  } else {
+    p_msg.clear();
+  }
+  return true;
+}
+
+QString LineCommand::toQtPattern(const QString &p_pattern, bool *p_caseInsensitive) {
+  QString pattern;
+  pattern.reserve(p_pattern.size());
+  for (int i = 0; i < p_pattern.size(); ++i) {
+    const QChar ch = p_pattern[i];
+    if (ch != QLatin1Char('\\') || i + 1 == p_pattern.size()) {
+      // These are literal unless escaped in vim, and the other way around in
+      // QRegularExpression.
+      if (QStringLiteral("(){}|+?").contains(ch)) {
+        pattern += QLatin1Char('\\');
+      }
+      pattern += ch;
+      continue;
+    }
+
+    const QChar next = p_pattern[++i];
+    switch (next.unicode()) {
+    case '(':
+    case ')':
+    case '|':
+    case '+':
+    case '?':
+      pattern += next;
+      break;
+
+    case '=':
+      pattern += QLatin1Char('?');
+      break;
+
+    case '<':
+    case '>':
+      pattern += QStringLiteral("\\b");
+      break;
+
+    case 'c':
+      *p_caseInsensitive = true;
+      break;
+
+    case 'C':
+      *p_caseInsensitive = false;
+      break;
+
+    case '{': {
+      // \{n,m} or \{n,m\}, and \{-n,m} for the lazy form.
+      const int close = p_pattern.indexOf(QLatin1Char('}'), i + 1);
+      if (close == -1) {
+        pattern += QStringLiteral("\\{");
+        break;
+      }
+
+      auto bounds = p_pattern.mid(i + 1, close - i - 1);
+      if (bounds.endsWith(QLatin1Char('\\'))) {
+        bounds.chop(1);
+      }
+      const bool lazy = bounds.startsWith(QLatin1Char('-'));
+      if (lazy) {
+        bounds.remove(0, 1);
+      }
+      pattern += bounds.isEmpty() ? QStringLiteral("*") : QStringLiteral("{%1}").arg(bounds);
+      if (lazy) {
+        pattern += QLatin1Char('?');
+      }
+      i = close;
+      break;
+    }
+
+    default:
+      pattern += ch;
+      pattern += next;
+      break;
+    }
+  }
+  return pattern;
+}
@@ -0,0 +1,81 @@
+#ifndef KATEVI_LINECOMMAND_H
+#define KATEVI_LINECOMMAND_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace KateViI {
+class KateViEditorInterface;
+}
+
+namespace KateVi {
+// :substitute, :global and :vglobal on a range of lines, in two phases.
+// plan() works out the new text of each line from a snapshot of the lines
+// only, so a large range is split into chunks across the global thread pool.
+// apply() then writes back each run of changed lines as one replacement, the
+// last run first, in a single edit session which is undone in one step.
+// Patterns use the vim magic syntax: \( \) \| \{ \} \+ \? \= \< \> and the \c
+// and \C case markers.
+class LineCommand {
+public:
+  enum class Kind { None, Substitute, Global };
+
+  // A run of old lines [m_first, m_last] replaced by the lines of m_text.
+  struct Change {
+    int m_first = 0;
+
+    int m_last = 0;
+
+    // Lines of m_text, 0 if the run is removed.
+    int m_lineCount = 0;
+
+    QString m_text;
+  };
+
+  struct Plan {
+    // Set if the command is malformed or matched nothing.
+    QString m_error;
+
+    // Sorted by m_first, apart from each other.
+    QVector<Change> m_changes;
+
+    int m_substitutions = 0;
+
+    int m_substitutedLines = 0;
+
+    int m_removedLines = 0;
+  };
+
+  LineCommand() = delete;
+
+  // Which command @p_cmd, without its range, is.
+  static Kind kind(const QString &p_cmd);
+
+  // Phase one: the changes of @p_cmd on @p_lines, the snapshot of the lines
+  // from @p_firstLine on.
+  static Plan plan(const QString &p_cmd, const QStringList &p_lines, int p_firstLine);
+
+  // Phase two: write @p_plan to @p_interface and put the cursor on the last
+  // line changed.
+  static void apply(KateViI::KateViEditorInterface *p_interface, const Plan &p_plan);
+
+  // Run @p_cmd on [@p_firstLine, @p_lastLine]. @p_msg gets the error or the
+  // summary to show.
+  static bool exec(KateViI::KateViEditorInterface *p_interface, const QString &p_cmd,
+                   int p_firstLine, int p_lastLine, QString &p_msg);
+
+  // @p_pattern from the vim magic syntax to QRegularExpression's. Sets
+  // @p_caseInsensitive if it has \c and clears it if it has \C.
+  static QString toQtPattern(const QString &p_pattern, bool *p_caseInsensitive);
+
+private:
+  // Size in characters of a snapshot from which plan() runs in parallel.
+  static const int c_parallelPlanSize;
+
+  // Size in characters of the chunks of lines a thread plans at a time.
+  static const int c_planChunkSize;
+};
+} // namespace KateVi
+
+#endif // KATEVI_LINECOMMAND_H
@@ -84,11 +84,13 @@ void MacroRecorder::replay(const QChar &macroRegister) {
   CompletionList completions = m_viInputModeManager->globalState()->macros()->getCompletions(reg);
 
   m_macrosBeingReplayedCount++;
+  m_viInputModeManager->beginReplay();
   m_viInputModeManager->completionReplayer()->start(completions);
   m_viInputModeManager->pushKeyMapper(mapper);
   m_viInputModeManager->feedKeyPresses(macroAsFeedableKeypresses);
   m_viInputModeManager->popKeyMapper();
   m_viInputModeManager->completionReplayer()->stop();
+  m_viInputModeManager->endReplay();
   m_macrosBeingReplayedCount--;
 }
 
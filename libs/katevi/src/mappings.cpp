@@ -152,7 +152,7 @@ QString Mappings::get(MappingMode mode, const QString &from, bool decode,
 
 QStringList Mappings::getAll(MappingMode mode, bool decode, bool includeTemporary) const {
   QStringList mappings;
-  const QHash<QString, Mapping> mappingsForMode = m_mappings[mode];
+  const MappingList &mappingsForMode = m_mappings[mode];
 
   for (auto i = mappingsForMode.begin(); i != mappingsForMode.end(); i++) {
     if (!includeTemporary && i.value().temporary) {
@@ -168,6 +168,28 @@ QStringList Mappings::getAll(MappingMode mode, bool decode, bool includeTemporar
   return mappings;
 }
 
+void Mappings::match(MappingMode mode, const QString &keys, bool includeTemporary, bool *isFull,
+                     bool *isPartial) const {
+  *isFull = false;
+  *isPartial = false;
+
+  const MappingList &mappingsForMode = m_mappings[mode];
+  for (auto i = mappingsForMode.lowerBound(keys);
+       i != mappingsForMode.end() && i.key().startsWith(keys); ++i) {
+    if (!includeTemporary && i.value().temporary) {
+      continue;
+    }
+
+    if (i.key() == keys) {
+      *isFull = true;
+    } else {
+      // Anything after it is longer too.
+      *isPartial = true;
+      return;
+    }
+  }
+}
+
 bool Mappings::isRecursive(MappingMode mode, const QString &from) const {
   if (!m_mappings[mode].contains(from)) {
     return false;
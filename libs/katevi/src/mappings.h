@@ -19,7 +19,7 @@
 #ifndef KATEVI_MAPPINGS_H
 #define KATEVI_MAPPINGS_H
 
-#include <QHash>
+#include <QMap>
 #include <katevi/katevi_export.h>
 
 namespace KateViI {
@@ -50,6 +50,11 @@ public:
   QString get(MappingMode mode, const QString &from, bool decode = false,
               bool includeTemporary = false) const;
   QStringList getAll(MappingMode mode, bool decode = false, bool includeTemporary = false) const;
+
+  // Whether the encoded @keys is a mapping of @mode, and whether a longer one
+  // starts with it. Only visits the mappings starting with @keys.
+  void match(MappingMode mode, const QString &keys, bool includeTemporary, bool *isFull,
+             bool *isPartial) const;
   bool isRecursive(MappingMode mode, const QString &from) const;
 
   void setLeader(const QChar &leader);
@@ -80,7 +85,8 @@ private:
     // Used for temporary mapping (e.g. mappings with <leader>).
     bool temporary;
   } Mapping;
-  typedef QHash<QString, Mapping> MappingList;
+  // Sorted, so the mappings starting with some keys are adjacent.
+  typedef QMap<QString, Mapping> MappingList;
 
   MappingList m_mappings[4];
   QChar m_leader;
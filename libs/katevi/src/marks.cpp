@@ -136,6 +136,12 @@ void Marks::setMark(const QChar &_mark, const KateViI::Cursor &pos) {
 }
 
 KateViI::Cursor Marks::getMarkPosition(const QChar &mark) const {
+  if (mark == SelectionBegin) {
+    return m_selectionStart;
+  } else if (mark == SelectionEnd) {
+    return m_selectionFinish;
+  }
+
 #if 0
     if (m_marks.contains(mark)) {
         KTextEditor::MovingCursor *c = m_marks.value(mark);
@@ -262,9 +268,9 @@ void Marks::setLastChange(const KateViI::Cursor &pos) { setMark(LastChange, pos)
 
 void Marks::setInsertStopped(const KateViI::Cursor &pos) { setMark(InsertStopped, pos); }
 
-void Marks::setSelectionStart(const KateViI::Cursor &pos) { setMark(SelectionBegin, pos); }
+void Marks::setSelectionStart(const KateViI::Cursor &pos) { m_selectionStart = pos; }
 
-void Marks::setSelectionFinish(const KateViI::Cursor &pos) { setMark(SelectionEnd, pos); }
+void Marks::setSelectionFinish(const KateViI::Cursor &pos) { m_selectionFinish = pos; }
 
 void Marks::setUserMark(const QChar &mark, const KateViI::Cursor &pos) {
   Q_ASSERT(FirstUserMark <= mark && mark <= LastUserMark);
@@ -275,9 +281,9 @@ KateViI::Cursor Marks::getStartEditYanked() const { return getMarkPosition(Begin
 
 KateViI::Cursor Marks::getFinishEditYanked() const { return getMarkPosition(EndEditYanked); }
 
-KateViI::Cursor Marks::getSelectionStart() const { return getMarkPosition(SelectionBegin); }
+KateViI::Cursor Marks::getSelectionStart() const { return m_selectionStart; }
 
-KateViI::Cursor Marks::getSelectionFinish() const { return getMarkPosition(SelectionEnd); }
+KateViI::Cursor Marks::getSelectionFinish() const { return m_selectionFinish; }
 
 KateViI::Cursor Marks::getLastChange() const { return getMarkPosition(LastChange); }
 
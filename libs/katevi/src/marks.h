@@ -19,6 +19,7 @@
 #ifndef KATE_VIMODE_MARKS_H
 #define KATE_VIMODE_MARKS_H
 
+#include <katevi/interface/cursor.h>
 #include <katevi/interface/markinterface.h>
 
 #include <QMap>
@@ -79,6 +80,12 @@ private:
 
   QMap<QChar, KateViI::MovingCursor *> m_marks;
   bool m_settingMark = false;
+
+  // The < and > marks of the last visual selection, the only marks kept
+  // until the others are implemented. Plain positions, which do not follow
+  // later edits.
+  KateViI::Cursor m_selectionStart = KateViI::Cursor::invalid();
+  KateViI::Cursor m_selectionFinish = KateViI::Cursor::invalid();
 };
 } // namespace KateVi
 
@@ -1652,11 +1652,12 @@ bool NormalViMode::commandReplayMacro() {
   const QChar reg = m_keys[m_keys.size() - 1];
   const unsigned int count = getCount();
   resetParser();
-  m_interface->editBegin();
+  // One replay for all the repetitions, so the editor refreshes once.
+  m_viInputModeManager->beginReplay();
   for (unsigned int i = 0; i < count; i++) {
     m_viInputModeManager->macroRecorder()->replay(reg);
   }
-  m_interface->editEnd();
+  m_viInputModeManager->endReplay();
   return true;
 }
 
@@ -2506,21 +2507,27 @@ Range NormalViMode::motionToPreviousBraceBlockEnd() {
   return r;
 }
 
-#if 0
-Range NormalViMode::motionToNextOccurrence()
-{
-    const QString word = getWordUnderCursor();
-    const Range match = m_viInputModeManager->searcher()->findWordForMotion(word, false, getWordRangeUnderCursor().start(), getCount());
-    return Range(match.startLine, match.startColumn, ExclusiveMotion);
+Range NormalViMode::motionToNextOccurrence() {
+  const QString word = getWordUnderCursor();
+  if (word.isEmpty()) {
+    return Range::invalid();
+  }
+
+  const Range match = m_viInputModeManager->searcher()->findWordForMotion(
+      word, false, getWordRangeUnderCursor().start(), getCount());
+  return Range(match.startLine, match.startColumn, ExclusiveMotion);
 }
 
-Range NormalViMode::motionToPrevOccurrence()
-{
-    const QString word = getWordUnderCursor();
-    const Range match = m_viInputModeManager->searcher()->findWordForMotion(word, true, getWordRangeUnderCursor().start(), getCount());
-    return Range(match.startLine, match.startColumn, ExclusiveMotion);
+Range NormalViMode::motionToPrevOccurrence() {
+  const QString word = getWordUnderCursor();
+  if (word.isEmpty()) {
+    return Range::invalid();
+  }
+
+  const Range match = m_viInputModeManager->searcher()->findWordForMotion(
+      word, true, getWordRangeUnderCursor().start(), getCount());
+  return Range(match.startLine, match.startColumn, ExclusiveMotion);
 }
-#endif
 
 Range NormalViMode::motionToFirstLineOfWindow() {
   int lines_to_go = 0;
@@ -3343,10 +3350,8 @@ void NormalViMode::initializeCommands() {
   ADDMOTION("T.", motionToCharBackward, REGEX_PATTERN);
   ADDMOTION(";", motionRepeatlastTF, 0);
   ADDMOTION(",", motionRepeatlastTFBackward, 0);
-  /*
   ADDMOTION("n", motionFindNext, 0);
   ADDMOTION("N", motionFindPrev, 0);
-  */
   ADDMOTION("gg", motionToLineFirst, 0);
   ADDMOTION("G", motionToLineLast, 0);
   ADDMOTION("w", motionWordForward, IS_NOT_LINEWISE);
@@ -3369,10 +3374,8 @@ void NormalViMode::initializeCommands() {
   ADDMOTION("]]", motionToNextBraceBlockStart, IS_NOT_LINEWISE);
   ADDMOTION("[]", motionToPreviousBraceBlockEnd, IS_NOT_LINEWISE);
   ADDMOTION("][", motionToNextBraceBlockEnd, IS_NOT_LINEWISE);
-  /*
   ADDMOTION("*", motionToNextOccurrence, 0);
   ADDMOTION("#", motionToPrevOccurrence, 0);
-  */
   ADDMOTION("H", motionToFirstLineOfWindow, 0);
   ADDMOTION("M", motionToMiddleLineOfWindow, 0);
   ADDMOTION("L", motionToLastLineOfWindow, 0);
@@ -3418,6 +3421,13 @@ void NormalViMode::initializeCommands() {
   ADDMOTION("/<enter>", motionToIncrementalSearchMatch, IS_NOT_LINEWISE);
   ADDMOTION("?<enter>", motionToIncrementalSearchMatch, IS_NOT_LINEWISE);
   */
+
+  compileCommands();
+}
+
+void NormalViMode::compileCommands() {
+  m_commandMatcher.build(m_commands);
+  m_motionMatcher.build(m_motions);
 }
 
 QRegularExpression NormalViMode::generateMatchingItemRegex() const {
@@ -3916,39 +3926,34 @@ void NormalViMode::updateMatchingCommands() {
       }
     }
   } else {
-    // Go through all registered commands and get possible matches.
-    for (int i = 0; i < m_commands.size(); i++) {
-      if (m_commands.at(i)->matches(m_keys)) {
-        m_matchingCommands.push_back(i);
-        if (m_commands.at(i)->needsMotion() &&
-            m_commands.at(i)->pattern().length() == m_keys.size()) {
-          m_awaitingMotionOrTextObject.push(m_keys.size());
-        }
+    // Get the possible matches from the commands the keys can lead to.
+    m_matchingCommands = m_commandMatcher.matching(m_keys);
+    for (int i : m_matchingCommands) {
+      if (m_commands.at(i)->needsMotion() &&
+          m_commands.at(i)->pattern().length() == m_keys.size()) {
+        m_awaitingMotionOrTextObject.push(m_keys.size());
       }
     }
   }
 }
 
 bool NormalViMode::updateMatchingMotions(int p_checkFrom) {
-  // FIXME: if p_checkFrom hasn't changed, only motions whose index is in
-  // m_matchingMotions should be checked.
   if (p_checkFrom < m_keys.size()) {
     const auto subKeys = m_keys.mid(p_checkFrom);
-    for (int i = 0; i < m_motions.size(); i++) {
-      if (m_motions.at(i)->matches(subKeys)) {
-        m_lastMotionWasLinewiseInnerBlock = false;
-        m_matchingMotions.push_back(i);
-
-        // If it matches exactly, we have found the motion command to execute.
-        if (m_motions.at(i)->matchesExact(subKeys)) {
-          m_currentMotionWasVisualLineUpOrDown = false;
-          if (p_checkFrom == 0) {
-            executeMotionWithoutCommand(m_motions.at(i));
-          } else {
-            executeMotionWithCommand(m_motions.at(i));
-          }
-          return true;
+    const auto candidates = m_motionMatcher.matching(subKeys);
+    for (int i : candidates) {
+      m_lastMotionWasLinewiseInnerBlock = false;
+      m_matchingMotions.push_back(i);
+
+      // If it matches exactly, we have found the motion command to execute.
+      if (m_motions.at(i)->matchesExact(subKeys)) {
+        m_currentMotionWasVisualLineUpOrDown = false;
+        if (p_checkFrom == 0) {
+          executeMotionWithoutCommand(m_motions.at(i));
+        } else {
+          executeMotionWithCommand(m_motions.at(i));
         }
+        return true;
       }
     }
   }
@@ -24,6 +24,7 @@
 #ifndef KATEVI_NORMAL_VI_MODE_H
 #define KATEVI_NORMAL_VI_MODE_H
 
+#include <commandmatcher.h>
 #include <modes/modebase.h>
 #include <range.h>
 
@@ -63,6 +64,11 @@ public:
 
   bool handleKeyPress(const QKeyEvent *e) override;
 
+  // The tables the typed keys are matched against.
+  const QVector<Command *> &commands() const { return m_commands; }
+
+  const QVector<Motion *> &motions() const { return m_motions; }
+
   bool commandEnterVisualMode();
 
   bool commandEnterInsertMode();
@@ -252,6 +258,9 @@ public:
   Range motionToPreviousBraceBlockEnd();
   Range motionToNextBraceBlockEnd();
 
+  Range motionToNextOccurrence();
+  Range motionToPrevOccurrence();
+
   Range motionToFirstLineOfWindow();
   Range motionToMiddleLineOfWindow();
   Range motionToLastLineOfWindow();
@@ -269,9 +278,6 @@ public:
     Range motionToMark();
     Range motionToMarkLine();
 
-    Range motionToNextOccurrence();
-    Range motionToPrevOccurrence();
-
     Range motionToIncrementalSearchMatch();
 #endif
 
@@ -320,6 +326,10 @@ protected:
 
   void initializeCommands();
 
+  // Index m_commands and m_motions for matching. Called whenever they are
+  // rebuilt.
+  void compileCommands();
+
   QRegularExpression generateMatchingItemRegex() const;
 
   void executeCommand(const Command *cmd);
@@ -388,6 +398,11 @@ protected:
   // All registered motions.
   QVector<Motion *> m_motions;
 
+  // Tries over the patterns of m_commands and m_motions.
+  CommandMatcher m_commandMatcher;
+
+  CommandMatcher m_motionMatcher;
+
   // Index in m_commands of possible matched commands (matching m_keys) so far.
   QVector<int> m_matchingCommands;
 
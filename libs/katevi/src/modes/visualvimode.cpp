@@ -342,10 +342,8 @@ void VisualViMode::initializeCommands() {
   ADDMOTION("T.", motionToCharBackward, REGEX_PATTERN);
   ADDMOTION(";", motionRepeatlastTF, 0);
   ADDMOTION(",", motionRepeatlastTFBackward, 0);
-  /*
   ADDMOTION("n", motionFindNext, 0);
   ADDMOTION("N", motionFindPrev, 0);
-  */
   ADDMOTION("gg", motionToLineFirst, 0);
   ADDMOTION("G", motionToLineLast, 0);
   ADDMOTION("w", motionWordForward, 0);
@@ -368,10 +366,8 @@ void VisualViMode::initializeCommands() {
   ADDMOTION("]]", motionToNextBraceBlockStart, 0);
   ADDMOTION("[]", motionToPreviousBraceBlockEnd, 0);
   ADDMOTION("][", motionToNextBraceBlockEnd, 0);
-  /*
   ADDMOTION("*", motionToNextOccurrence, 0);
   ADDMOTION("#", motionToPrevOccurrence, 0);
-  */
   ADDMOTION("<c-f>", motionPageDown, 0);
   ADDMOTION("<pagedown>", motionPageDown, 0);
   ADDMOTION("<c-b>", motionPageUp, 0);
@@ -415,4 +411,6 @@ void VisualViMode::initializeCommands() {
   ADDMOTION("/<enter>", motionToIncrementalSearchMatch, 0);
   ADDMOTION("?<enter>", motionToIncrementalSearchMatch, 0);
   */
+
+  compileCommands();
 }
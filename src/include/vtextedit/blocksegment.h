@@ -7,6 +7,12 @@ struct BlockSegment {
 
   BlockSegment(int p_offset, int p_length) : m_offset(p_offset), m_length(p_length) {}
 
+  bool operator==(const BlockSegment &p_other) const {
+    return m_offset == p_other.m_offset && m_length == p_other.m_length;
+  }
+
+  bool operator!=(const BlockSegment &p_other) const { return !(*this == p_other); }
+
   int m_offset = 0;
 
   int m_length = 0;
@@ -8,6 +8,29 @@
 #include <vtextedit/markdownhighlighterdata.h>
 
 namespace vte {
+// One fenced code block sent to an external highlighter.
+struct ExternalCodeBlockHighlightRequest {
+  // Identifies the source text, not its position: it stays the same across
+  // re-parses for as long as the text is still waiting for its highlight.
+  int m_id = 0;
+
+  // Unindented source including the fences.
+  QString m_text;
+};
+
+// Highlighted HTML returned by an external highlighter for one request.
+struct ExternalCodeBlockHighlightData {
+  int m_id = 0;
+
+  // Prism-like nested <span> HTML. Empty means no highlight.
+  QString m_html;
+};
+
+// Register the metatypes carried by the batch highlight signal and slot, so a
+// host may connect to them with queued connections. Idempotent and safe to
+// call from any thread after QCoreApplication exists.
+VTEXTEDIT_EXPORT void registerCodeBlockHighlightMetaTypes();
+
 // Class to help highlighting code block.
 class CodeBlockHighlighter : public QObject {
   Q_OBJECT
@@ -56,11 +79,21 @@ public:
   void highlight(TimeStamp p_timeStamp, const QVector<md::FencedCodeBlock> &p_codeBlocks);
 
 protected:
+  // Called before the first highlightInternal() of a highlight() round.
+  virtual void prepareHighlight() {}
+
   // @p_idx Index in m_codeBlocks.
   virtual void highlightInternal(int p_idx) = 0;
 
+  // Called once every block of a highlight() round is either served from the
+  // cache or passed to highlightInternal().
+  virtual void finishHighlightRequests() {}
+
   void finishHighlightOne(const HighlightResult &p_result);
 
+  void addToCache(const QString &p_text, TimeStamp p_timeStamp,
+                  const HighlightStyles &p_highlights);
+
   TimeStamp m_timeStamp = 0;
 
   QVector<md::FencedCodeBlock> m_codeBlocks;
@@ -69,10 +102,13 @@ signals:
   void codeBlockHighlightCompleted(const CodeBlockHighlighter::HighlightResult &p_result);
 
 private:
-  void addToCache(const HighlightResult &p_result);
-
   LruCache<QString, CacheEntry> m_cache;
 };
 } // namespace vte
 
+Q_DECLARE_METATYPE(vte::ExternalCodeBlockHighlightRequest)
+Q_DECLARE_METATYPE(vte::ExternalCodeBlockHighlightData)
+Q_DECLARE_METATYPE(QVector<vte::ExternalCodeBlockHighlightRequest>)
+Q_DECLARE_METATYPE(QVector<vte::ExternalCodeBlockHighlightData>)
+
 #endif // CODEBLOCKHIGHLIGHTER_H
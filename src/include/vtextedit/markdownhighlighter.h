@@ -119,6 +119,9 @@ signals:
 protected:
   void highlightBlock(const QString &p_text) Q_DECL_OVERRIDE;
 
+  // Code blocks are not spell checked.
+  bool isSpellCheckNeeded(const QTextBlock &p_block) const Q_DECL_OVERRIDE;
+
 private slots:
   void handleParseResult(const QSharedPointer<md::MarkdownParseResult> &p_result);
 
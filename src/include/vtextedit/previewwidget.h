@@ -28,7 +28,9 @@ class VTEXTEDIT_EXPORT PreviewWidgetContext : public QObject {
 public:
   ~PreviewWidgetContext() Q_DECL_OVERRIDE;
 
-  // Stable identity of the preview this context belongs to.
+  // Stable identity of the preview this context belongs to. The host may
+  // recycle a widget for another preview far from the viewport, in which case
+  // the identity changes right before PreviewWidget::setPreview() is called.
   quint64 identity() const;
 
   // The snapshot currently bound to this context. Never null while the widget
@@ -47,7 +49,8 @@ public:
   // not currently laid out (folded away, disabled, etc.).
   QRectF assignedPreviewRect() const;
 
-  // Ask the editor to replace the whole source of this preview.
+  // Ask the editor to replace the whole source of this preview. Only the span
+  // which differs from the current source is rewritten in the document.
   // The outcome is reported asynchronously through replacementFinished().
   void requestSourceReplacement(const QString &p_replacementMarkdown);
 
@@ -69,6 +72,9 @@ private:
 
   explicit PreviewWidgetContext(quint64 p_identity, QObject *p_parent = nullptr);
 
+  // A pooled widget keeps its context, which is moved to the next element.
+  void setIdentity(quint64 p_identity);
+
   void setPreview(const QSharedPointer<const Preview> &p_preview);
 
   void notifyReplacementFinished(const PreviewReplacementResult &p_result);
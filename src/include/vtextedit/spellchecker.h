@@ -3,7 +3,9 @@
 
 #include <vtextedit/vtextedit_export.h>
 
+#include <QHash>
 #include <QMap>
+#include <QMutex>
 #include <QScopedPointer>
 #include <QStringList>
 
@@ -15,6 +17,9 @@ class WordTokenizer;
 
 namespace vte {
 // Wrapper of Sonnet spell check.
+// Sonnet shares one dictionary object per language between all its Speller
+// instances and is not thread safe. Every call into Sonnet, here or from a
+// spell check worker, is made under mutex().
 class VTEXTEDIT_EXPORT SpellChecker {
 public:
   static SpellChecker &getInst();
@@ -28,20 +33,32 @@ public:
   // Return false when there is no dictionary available.
   bool isValid() const;
 
-  Sonnet::LanguageFilter *languageFilter();
-
-  Sonnet::WordTokenizer *wordTokenizer();
-
   void setCurrentLanguage(const QString &p_lang);
   QString currentLanguage() const;
 
   bool isMisspelled(const QString &p_word) const;
 
+  // Thread safe. The verdict is cached for the whole process, per language.
+  bool isMisspelled(const QString &p_language, const QString &p_word) const;
+
+  // Times a verdict was not found in the cache and asked of Sonnet.
+  int verdictCacheMisses() const;
+
   // Ignore @p_word in this session.
   void ignoreWord(const QString &p_word);
 
   void addToDictionary(const QString &p_word);
 
+  // Bumped whenever a cached verdict may have changed, that is on
+  // ignoreWord() and addToDictionary(). Thread safe.
+  int dictionaryGeneration() const;
+
+  QMutex *mutex();
+
+  // Max number of verdicts cached per language before the cache of that
+  // language is dropped.
+  static const int c_maxCachedVerdicts;
+
   QStringList suggest(const QString &p_word, bool p_autoDetectEnabled);
 
   static void addDictionaryCustomSearchPaths(const QStringList &p_dirs);
@@ -51,13 +68,28 @@ private:
 
   QString detectLanguage(const QString &p_word);
 
+  // Word removed from the verdict cache of every language. Called with
+  // m_mutex held.
+  void invalidateVerdicts(const QString &p_word);
+
+  mutable QMutex m_mutex;
+
   QScopedPointer<Sonnet::Speller> m_speller;
 
-  QScopedPointer<Sonnet::LanguageFilter> m_languageFilter;
+  // Answers the cache misses, so a check in another language does not switch
+  // the language of m_speller.
+  QScopedPointer<Sonnet::Speller> m_verdictSpeller;
 
-  QScopedPointer<Sonnet::WordTokenizer> m_wordTokenizer;
+  QScopedPointer<Sonnet::LanguageFilter> m_languageFilter;
 
   QMap<QString, QString> m_dictionaries;
+
+  // Language -> word -> misspelled.
+  mutable QHash<QString, QHash<QString, bool>> m_verdicts;
+
+  mutable int m_verdictCacheMisses = 0;
+
+  int m_dictionaryGeneration = 0;
 };
 } // namespace vte
 
@@ -66,6 +66,18 @@ public:
     Q_ASSERT(m_validLastBlockNumber >= m_validFirstBlockNumber);
   }
 
+  // Block numbers as of construction or the last update().
+  int validFirstBlockNumber() const { return m_validFirstBlockNumber; }
+
+  int validLastBlockNumber() const { return m_validLastBlockNumber; }
+
+  // Same as update() for a range lying after an edit which added @p_delta
+  // blocks (or removed, if negative), without looking the blocks up.
+  void shift(int p_delta) {
+    m_validFirstBlockNumber += p_delta;
+    m_validLastBlockNumber += p_delta;
+  }
+
   const QTextBlock &first() const { return m_first; }
 
   const QTextBlock &last() const { return m_last; }
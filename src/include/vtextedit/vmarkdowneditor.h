@@ -1,6 +1,7 @@
 #ifndef VTEXTEDIT_VMARKDOWNEDITOR_H
 #define VTEXTEDIT_VMARKDOWNEDITOR_H
 
+#include <vtextedit/codeblockhighlighter.h>
 #include <vtextedit/markdownhighlighterdata.h>
 #include <vtextedit/preview.h>
 #include <vtextedit/vtexteditor.h>
@@ -75,16 +76,40 @@ public:
 
 public slots:
   // Used when using WebCodeBlockHighlighter.
+  // @p_idx: the request ID received from externalCodeBlockHighlightRequested(),
+  // echoed back as is. It used to be the index of the code block in the
+  // document; it now names the source text and stays valid across re-parses
+  // until answered, so a host must not compute or reuse it as a block index.
+  // @p_timeStamp is no longer checked: the answer to a pending request is
+  // applied whatever its time stamp, and an unknown or answered ID is ignored.
   void handleExternalCodeBlockHighlightData(int p_idx, TimeStamp p_timeStamp,
                                             const QString &p_html);
 
+  // Used when using WebCodeBlockHighlighter.
+  // Answer any subset of the requests of externalCodeBlockHighlightBatchRequested(),
+  // in any order and in as many calls as convenient: each result is applied as
+  // soon as its HTML has been parsed.
+  void handleExternalCodeBlockHighlightBatchData(
+      const QVector<vte::ExternalCodeBlockHighlightData> &p_data);
+
   // Used for display math ($$...$$) source highlight.
   void handleExternalMathHighlightData(int p_idx, TimeStamp p_timeStamp, const QString &p_html);
 
 signals:
   // Used when using WebCodeBlockHighlighter.
+  // Emitted once per block only if externalCodeBlockHighlightBatchRequested()
+  // has no receiver. @p_idx is a request ID, not a block index: pass it back
+  // unchanged to handleExternalCodeBlockHighlightData().
+  // The batch signal and slot carry registered metatypes (see
+  // registerCodeBlockHighlightMetaTypes()), so both may be queued.
   void externalCodeBlockHighlightRequested(int p_idx, TimeStamp p_timeStamp, const QString &p_text);
 
+  // Used when using WebCodeBlockHighlighter.
+  // Many blocks per request. Each request ID stays valid until it is answered
+  // or its text leaves the document, across any number of re-parses.
+  void externalCodeBlockHighlightBatchRequested(
+      TimeStamp p_timeStamp, const QVector<vte::ExternalCodeBlockHighlightRequest> &p_requests);
+
   // Used for display math ($$...$$) source highlight.
   void externalMathHighlightRequested(int p_idx, TimeStamp p_timeStamp, const QString &p_text);
 
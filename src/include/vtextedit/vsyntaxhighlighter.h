@@ -1,18 +1,26 @@
 #ifndef VSYNTAXHIGHLIGHTER_H
 #define VSYNTAXHIGHLIGHTER_H
 
+#include <QPair>
 #include <QSharedPointer>
 #include <QSyntaxHighlighter>
+#include <QVector>
+
+class QTimer;
 
 namespace vte {
 struct BlockSpellCheckData;
+struct MisspellingTally;
+class SpellCheckWorker;
+struct SpellCheckJob;
+struct SpellCheckResult;
 
 class VSyntaxHighlighter : public QSyntaxHighlighter {
   Q_OBJECT
 public:
   explicit VSyntaxHighlighter(QTextDocument *p_doc);
 
-  virtual ~VSyntaxHighlighter() = default;
+  virtual ~VSyntaxHighlighter();
 
   void setSpellCheckEnabled(bool p_enabled);
 
@@ -20,16 +28,123 @@ public:
 
   virtual bool isSyntaxFoldingEnabled() const;
 
+  // Check every block again, in the background, visible blocks first. Only
+  // the blocks whose misspellings change are rehighlighted.
   void refreshSpellCheck();
 
   void refreshBlockSpellCheck(const QTextBlock &p_block);
 
+  // Blocks [@p_first, @p_last] are shown. Spell check is limited to them and
+  // c_spellCheckViewportMargin blocks around, while the rest of the document
+  // is backfilled in small batches once the editor is idle.
+  void setVisibleBlockRange(int p_first, int p_last);
+
+  // Number of misspellings underlined so far in the whole document, kept as
+  // they change. Blocks the backfill has not reached yet are not counted and
+  // @p_complete is set to false.
+  int misspellingCount(bool *p_complete = nullptr) const;
+
+  // Blocks spell checked on each side of the visible ones.
+  static const int c_spellCheckViewportMargin;
+
+  // Max number of blocks one backfill batch checks.
+  static const int c_spellCheckBackfillBatchSize;
+
+  // Max number of blocks one backfill batch looks at.
+  static const int c_spellCheckBackfillScanSize;
+
+  // Idle time in ms before the backfill goes on.
+  static const int c_spellCheckBackfillInterval;
+
 protected:
+  // Apply the misspellings of the current block if they are known for its
+  // revision. Otherwise ask the spell check worker for them if the block is
+  // around the viewport, or leave it to the backfill. The block is
+  // rehighlighted once they arrive.
+  void spellCheckCurrentBlock(const QString &p_text);
+
+  // Whether @p_block is ever spell checked, given its highlight state.
+  virtual bool isSpellCheckNeeded(const QTextBlock &p_block) const;
+
   void highlightMisspell(const QSharedPointer<BlockSpellCheckData> &p_data);
 
   bool m_spellCheckEnabled = false;
 
   bool m_autoDetectLanguageEnabled = false;
+
+private:
+  friend class SpellCheckWorker;
+
+  // Return false if there is nothing to check in @p_block.
+  bool prepareSpellCheck(const QTextBlock &p_block, bool p_backfill, SpellCheckJob &p_job);
+
+  void requestSpellCheck(const QTextBlock &p_block, const QString &p_text,
+                         const QSharedPointer<BlockSpellCheckData> &p_data, bool p_urgent);
+
+  // Called on the GUI thread with the results posted by the worker.
+  void handleSpellCheckResults(const QVector<SpellCheckResult> &p_results);
+
+  SpellCheckWorker *spellCheckWorker();
+
+  // The spell check data of @p_block, counting in m_misspellingTally. Created
+  // if there is none and @p_create.
+  QSharedPointer<BlockSpellCheckData> blockSpellCheckData(const QTextBlock &p_block,
+                                                          bool p_create);
+
+  // Read the validity and the language of the speller into
+  // m_spellCheckerValid and m_spellCheckLanguage. Called once per batch of
+  // jobs, as each read takes the lock the worker holds while it checks.
+  void readSpellCheckerState();
+
+  bool isInSpellCheckViewport(int p_blockNumber) const;
+
+  // Queue the viewport blocks not checked yet.
+  void spellCheckViewport();
+
+  // Make the backfill go over blocks from @p_blockNumber on again.
+  void scheduleSpellCheckBackfill(int p_blockNumber);
+
+  void backfillSpellCheck();
+
+  void handleSpellCheckContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+  // Created on first use.
+  SpellCheckWorker *m_spellCheckWorker = nullptr;
+
+  // Bumped by refreshSpellCheck() to drop the results still in flight.
+  int m_spellCheckGeneration = 0;
+
+  // Jobs of the current generation queued and not answered yet.
+  int m_spellCheckJobsInFlight = 0;
+
+  // Shared with the spell check data of every block.
+  QSharedPointer<MisspellingTally> m_misspellingTally;
+
+  bool m_spellCheckerStateRead = false;
+
+  bool m_spellCheckerValid = false;
+
+  QString m_spellCheckLanguage;
+
+  // [-1, -1] until the editor tells.
+  QPair<int, int> m_visibleBlockRange;
+
+  QTimer *m_spellCheckBackfillTimer = nullptr;
+
+  // The backfill goes on from this block.
+  int m_backfillNextBlock = 0;
+
+  // The backfill reached the end of the document.
+  bool m_backfillDone = true;
+
+  // Backfill jobs queued and not answered yet. The next batch waits for them.
+  int m_backfillJobsInFlight = 0;
+
+  // Revision and block count of the document at the last edit seen, to tell
+  // the edits from the format changes.
+  int m_contentsRevision = -1;
+
+  int m_contentsBlockCount = -1;
 };
 } // namespace vte
 
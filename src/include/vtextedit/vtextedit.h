@@ -160,9 +160,22 @@ public:
 
   static void forceInputMethodDisabled(bool p_force);
 
+  // Hold the cursor updates, such as the cursor line and the centering, until
+  // the outermost endUpdateBatch(), which does them once for the cursor
+  // reached and emits updateBatchEnded(). Listeners costly to run on each
+  // cursor move check isUpdateBatched() and refresh on updateBatchEnded().
+  void beginUpdateBatch();
+
+  void endUpdateBatch();
+
+  bool isUpdateBatched() const;
+
 signals:
   void cursorLineChanged();
 
+  // Emitted by the outermost endUpdateBatch().
+  void updateBatchEnded();
+
   void cursorWidthChanged();
 
   void resized();
@@ -326,6 +339,9 @@ private:
   // Maximum content width in pixels. 0 = disabled.
   int m_maxContentWidth = 0;
 
+  // Nesting depth of beginUpdateBatch().
+  int m_updateBatchCount = 0;
+
   static bool s_forceInputMethodDisabled;
 };
 
@@ -33,6 +33,7 @@ class AbstractInputMode;
 class EditorCompleter;
 class Completer;
 class StatusIndicator;
+class SearchIndex;
 
 class VTEXTEDIT_EXPORT VTextEditor : public QWidget {
   Q_OBJECT
@@ -104,6 +105,10 @@ public:
   QString currentSpellCheckLanguage() const;
   QMap<QString, QString> availableSpellCheckDictionaries() const;
 
+  // Number of misspellings in the whole document found so far by the background
+  // spell check. @p_complete tells whether every block has been checked.
+  int misspellingCount(bool *p_complete = nullptr) const;
+
   void setSpellCheckEnabled(bool p_enabled);
   void setAutoDetectLanguageEnabled(bool p_enabled);
   void setSpellCheckLanguage(const QString &p_language);
@@ -218,6 +223,9 @@ protected:
 
   void updateSpellCheck();
 
+  // Tell the highlighter which blocks are shown, so spell check could start there.
+  void updateSpellCheckViewport();
+
   // Apply the extra selections the manager has already built, without waiting for
   // its coalescing timer. For derived editors which mutate folding synchronously
   // inside an edit turn and must not let a stale applied selection reach a repaint.
@@ -232,7 +240,8 @@ private slots:
 
   void updateInputModeStatusWidget();
 
-  void clearFindResultCache();
+  // Bring the cursor listeners held by an update batch of m_textEdit up to date.
+  void handleUpdateBatchEnded();
 
 private:
   void setupUI();
@@ -265,10 +274,14 @@ private:
 
   void setFontAndPaletteByStyleSheet(const QFont &p_font, const QPalette &p_palette);
 
-  const QList<QTextCursor> &findAllText(const QStringList &p_texts, FindFlags p_flags, int p_start,
-                                        int p_end);
+  // Highlight @p_current as the current match and the matches of
+  // m_searchHighlight around the viewport.
+  void highlightSearch(const QTextCursor &p_current);
+
+  // Materialize the matches of m_searchHighlight near the viewport only.
+  void updateSearchHighlight();
 
-  void highlightSearch(const QList<QTextCursor> &p_results, int p_currentIdx);
+  void handleViewportChanged();
 
   // @p_skipCurrent: if current cursor locates right at a match, whether skip
   // it.
@@ -287,14 +300,6 @@ private:
   static QString resolveBackReferenceInReplaceText(const QString &p_replaceText, QString p_text,
                                                    const QRegularExpression &p_regExp);
 
-  // @p_cursors is in ascending order.
-  // If @p_forward is true, find the smallest cursor whose selection start is
-  // greater than @p_pos or the first cursor if wrapped. Otherwise, find the
-  // largest cursor whose selection start is smaller than @p_pos or the last
-  // cursor if wrapped.
-  static int selectCursor(const QList<QTextCursor> &p_cursors, int p_pos, bool p_skipCurrent,
-                          bool p_forward, bool &p_isWrapped);
-
 protected:
   // Managed by QObject.
   VTextEdit *m_textEdit = nullptr;
@@ -303,23 +308,17 @@ protected:
   VSyntaxHighlighter *m_highlighter = nullptr;
 
 private:
-  struct FindResultCache {
-    void clear();
-
-    bool matched(const QStringList &p_texts, FindFlags p_flags, int p_start, int p_end) const;
-
-    void update(const QStringList &p_texts, FindFlags p_flags, int p_start, int p_end,
-                const QList<QTextCursor> &p_result);
+  // The search highlighted, followed across scrolls and edits.
+  struct SearchHighlight {
+    bool m_enabled = false;
 
     // Find range [m_start, m_end).
-    int m_start = -1;
+    int m_start = 0;
     int m_end = -1;
 
     QStringList m_texts;
 
     FindFlags m_flags = FindFlag::None;
-
-    QList<QTextCursor> m_result;
   };
 
   QSharedPointer<TextEditorConfig> m_config;
@@ -370,7 +369,10 @@ private:
   // Used to indicate current font point size of editor.
   int m_editorFontPointSize = 0;
 
-  FindResultCache m_findResultCache;
+  // Managed by QObject.
+  SearchIndex *m_searchIndex = nullptr;
+
+  SearchHighlight m_searchHighlight;
 
   // When using style sheet, m_textEdit->font() and palette() won't return the
   // actual ones. We store them on our own.
@@ -381,6 +383,9 @@ private:
 
   QTimer *m_topLineChangedTimer = nullptr;
 
+  // Coalesce scrolls, resizes and edits before handleViewportChanged().
+  QTimer *m_viewportChangedTimer = nullptr;
+
   static int s_instanceCount;
 
   // Completer shared among all instances.
@@ -5,6 +5,7 @@
 #include <QDebug>
 #include <QEvent>
 #include <QScrollBar>
+#include <QVariantMap>
 #include <QTextBlock>
 #include <QTextCursor>
 
@@ -21,6 +22,8 @@
 
 using namespace vte;
 
+const char *TextEditInputMode::c_replayStatsProperty = "vte_vi_replay_stats";
+
 TextEditInputMode::TextEditInputMode(VTextEdit *p_textEdit) : m_textEdit(p_textEdit) {
   Q_ASSERT(m_textEdit);
   // Observe-only filter, used to publish focus signals.
@@ -101,6 +104,23 @@ void TextEditInputMode::editEnd() {
   }
 }
 
+void TextEditInputMode::replayStart() {
+  // The replay runs in one edit session, which already holds the highlighter,
+  // the layout and the document listeners until its end.
+  m_textEdit->beginUpdateBatch();
+}
+
+void TextEditInputMode::replayEnd(int p_keys, qint64 p_nsecs) {
+  m_textEdit->endUpdateBatch();
+
+  QVariantMap stats;
+  stats.insert(QStringLiteral("keys"), p_keys);
+  stats.insert(QStringLiteral("nsecs"), p_nsecs);
+  stats.insert(QStringLiteral("keysPerSecond"),
+               p_nsecs > 0 ? static_cast<qint64>(p_keys * 1e9 / p_nsecs) : 0);
+  m_textEdit->setProperty(c_replayStatsProperty, stats);
+}
+
 bool TextEditInputMode::removeLine(int p_line) {
   auto block = document()->findBlockByNumber(p_line);
   if (block.isValid()) {
@@ -223,8 +243,24 @@ KateViI::Range TextEditInputMode::selectionRange() const {
 QVector<KateViI::Range>
 TextEditInputMode::searchText(const KateViI::Range &p_range, const QString &p_pattern,
                               const KateViI::SearchOptions p_options) const {
-  EDITOR_NIY;
-  return QVector<KateViI::Range>();
+  // The range is ordered already, so only the options tell the direction.
+  const bool backward = p_options.testFlag(KateViI::Backwards);
+  const bool valid = m_searcher.setPattern(
+      p_pattern, p_options.testFlag(KateViI::Regex),
+      !p_options.testFlag(KateViI::CaseInsensitive), p_options.testFlag(KateViI::WholeWords));
+  if (!valid || !p_range.isValid()) {
+    return {KateViI::Range::invalid()};
+  }
+
+  const auto start = p_range.start();
+  const auto end = p_range.end();
+  const auto match = m_searcher.find(document(), start.line(), start.column(), end.line(),
+                                     end.column(), backward);
+  if (!match.isValid()) {
+    return {KateViI::Range::invalid()};
+  }
+
+  return {KateViI::Range(match.m_block, match.m_start, match.m_block, match.m_end)};
 }
 
 KateViI::Cursor TextEditInputMode::documentEnd() const {
@@ -4,6 +4,7 @@
 #include <QObject>
 
 #include <inputmode/inputmodeeditorinterface.h>
+#include <texteditor/documentsearcher.h>
 
 class QTextDocument;
 
@@ -18,6 +19,10 @@ class TextEditInputMode : public QObject, public InputModeEditorInterface {
 public:
   explicit TextEditInputMode(VTextEdit *p_textEdit);
 
+  // Dynamic property of the VTextEdit holding the last replay as a QVariantMap
+  // of keys, nsecs and keysPerSecond.
+  static const char *c_replayStatsProperty;
+
 signals:
   // Emitted from notifyEditorModeChanged() when the mode really changes.
   void editorModeChanged();
@@ -60,6 +65,10 @@ public:
 
   void editEnd() Q_DECL_OVERRIDE;
 
+  void replayStart() Q_DECL_OVERRIDE;
+
+  void replayEnd(int p_keys, qint64 p_nsecs) Q_DECL_OVERRIDE;
+
   bool removeText(const KateViI::Range &p_range, bool p_blockWise) Q_DECL_OVERRIDE;
 
   bool removeLine(int p_line) Q_DECL_OVERRIDE;
@@ -240,6 +249,10 @@ protected:
   // Work around of the Qt bug.
   // See editStart() and editEnd().
   int m_verticalScrollBarValue = 0;
+
+  // Keeps the last pattern compiled across searchText() calls, such as the
+  // ones of repeated n presses.
+  mutable DocumentSearcher m_searcher;
 };
 } // namespace vte
 
@@ -12,6 +12,7 @@ void CodeBlockHighlighter::highlight(TimeStamp p_timeStamp,
   m_codeBlocks = p_codeBlocks;
 
   m_cache.setCapacityHint(m_codeBlocks.size());
+  prepareHighlight();
   for (int idx = 0; idx < m_codeBlocks.size(); ++idx) {
     auto &entry = m_cache.get(m_codeBlocks[idx].m_text);
     if (!entry.isNull()) {
@@ -24,15 +25,32 @@ void CodeBlockHighlighter::highlight(TimeStamp p_timeStamp,
       highlightInternal(idx);
     }
   }
+  finishHighlightRequests();
 }
 
 void CodeBlockHighlighter::finishHighlightOne(const HighlightResult &p_result) {
-  addToCache(p_result);
+  addToCache(m_codeBlocks[p_result.m_index].m_text, p_result.m_timeStamp, p_result.m_highlights);
 
   emit codeBlockHighlightCompleted(p_result);
 }
 
-void CodeBlockHighlighter::addToCache(const HighlightResult &p_result) {
-  m_cache.set(m_codeBlocks[p_result.m_index].m_text,
-              CacheEntry(p_result.m_timeStamp, p_result.m_highlights));
+void CodeBlockHighlighter::addToCache(const QString &p_text, TimeStamp p_timeStamp,
+                                      const HighlightStyles &p_highlights) {
+  m_cache.set(p_text, CacheEntry(p_timeStamp, p_highlights));
+}
+
+void vte::registerCodeBlockHighlightMetaTypes() {
+  // Function-local static initialization is thread safe and runs exactly once.
+  static const bool registered = []() {
+    qRegisterMetaType<TimeStamp>("TimeStamp");
+    qRegisterMetaType<vte::ExternalCodeBlockHighlightRequest>(
+        "vte::ExternalCodeBlockHighlightRequest");
+    qRegisterMetaType<vte::ExternalCodeBlockHighlightData>("vte::ExternalCodeBlockHighlightData");
+    qRegisterMetaType<QVector<vte::ExternalCodeBlockHighlightRequest>>(
+        "QVector<vte::ExternalCodeBlockHighlightRequest>");
+    qRegisterMetaType<QVector<vte::ExternalCodeBlockHighlightData>>(
+        "QVector<vte::ExternalCodeBlockHighlightData>");
+    return true;
+  }();
+  Q_UNUSED(registered);
 }
@@ -40,26 +40,38 @@ inline void computeHeadingSections(QVector<FoldingRegion> &p_regions, int p_numO
               return a.m_startBlock < b.m_startBlock;
             });
 
-  // Compute heading section ranges.
-  for (int i = 0; i < headings.size(); ++i) {
-    int endBlock = p_numOfBlocks - 1;
-    // Find next heading with same or higher level (lower or equal m_level value).
-    for (int j = i + 1; j < headings.size(); ++j) {
-      if (headings[j].m_level <= headings[i].m_level) {
-        endBlock = headings[j].m_startBlock - 1;
-        break;
-      }
+  // Compute heading section ranges in one backward pass. The stack holds the
+  // candidates for the next heading of the same or higher level, nearest on
+  // top.
+  QVector<int> stack;
+  for (int i = headings.size() - 1; i >= 0; --i) {
+    while (!stack.isEmpty() && headings[stack.last()].m_level > headings[i].m_level) {
+      stack.removeLast();
     }
-    headings[i].m_endBlock = endBlock;
+    // Next heading with same or higher level (lower or equal m_level value).
+    headings[i].m_endBlock =
+        stack.isEmpty() ? p_numOfBlocks - 1 : headings[stack.last()].m_startBlock - 1;
+    stack.append(i);
   }
 
-  // Collect blockquote regions for filtering.
+  // Collect blockquote regions for filtering, sorted by start, with the largest
+  // end block so far, so containment is one binary search.
   QVector<FoldingRegion> blockquotes;
   for (const auto &r : others) {
     if (r.m_type == Blockquote) {
       blockquotes.append(r);
     }
   }
+  std::sort(blockquotes.begin(), blockquotes.end(),
+            [](const FoldingRegion &a, const FoldingRegion &b) {
+              return a.m_startBlock < b.m_startBlock;
+            });
+  QVector<int> maxEndBlocks;
+  maxEndBlocks.reserve(blockquotes.size());
+  for (const auto &bq : blockquotes) {
+    maxEndBlocks.append(maxEndBlocks.isEmpty() ? bq.m_endBlock
+                                               : qMax(maxEndBlocks.last(), bq.m_endBlock));
+  }
 
   // Filter out headings that are too small or inside a blockquote.
   QVector<FoldingRegion> validHeadings;
@@ -68,14 +80,13 @@ inline void computeHeadingSections(QVector<FoldingRegion> &p_regions, int p_numO
       continue;
     }
 
-    bool insideBlockquote = false;
-    for (const auto &bq : blockquotes) {
-      if (h.m_startBlock >= bq.m_startBlock && h.m_endBlock <= bq.m_endBlock) {
-        insideBlockquote = true;
-        break;
-      }
-    }
-    if (insideBlockquote) {
+    // Some blockquote starting at or before the heading ends at or after it.
+    auto it = std::upper_bound(blockquotes.begin(), blockquotes.end(), h.m_startBlock,
+                               [](int p_val, const FoldingRegion &p_bq) {
+                                 return p_val < p_bq.m_startBlock;
+                               });
+    const int numBefore = static_cast<int>(it - blockquotes.begin());
+    if (numBefore > 0 && maxEndBlocks[numBefore - 1] >= h.m_endBlock) {
       continue;
     }
 
@@ -1,9 +1,11 @@
 #include "interactivepreviewhost.h"
 
 #include <algorithm>
+#include <limits>
 #include <climits>
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QEvent>
 #include <QScopedValueRollback>
 #include <QScrollBar>
@@ -21,6 +23,7 @@
 #include "previewbuilder.h"
 #include "previewfromast.h"
 #include "previewlogging.h"
+#include "previewmeasurecache.h"
 #include "tablepreviewwidget.h"
 
 using namespace vte;
@@ -65,8 +68,24 @@ const char *InteractivePreviewHost::c_foldRefreshCountProperty = "vte_preview_fo
 
 const char *InteractivePreviewHost::c_owedWorkDrainCountProperty = "vte_preview_owed_work_drains";
 
+const char *InteractivePreviewHost::c_owedWorkFrameCountProperty = "vte_preview_owed_work_frames";
+
+const char *InteractivePreviewHost::c_owedWorkStepStatsProperty = "vte_preview_owed_work_steps";
+
+const char *InteractivePreviewHost::c_measureStatsProperty = "vte_preview_measure_stats";
+
 const int InteractivePreviewHost::c_replacementRetryBudget = 8;
 
+const int InteractivePreviewHost::c_virtualizationThreshold = 32;
+
+const int InteractivePreviewHost::c_keepAliveScreens = 2;
+
+const int InteractivePreviewHost::c_maxPooledWidgets = 8;
+
+const int InteractivePreviewHost::c_measureBatchSize = 8;
+
+const int InteractivePreviewHost::c_owedWorkFrameMs = 16;
+
 InteractivePreviewHost::BlockGuard::BlockGuard(InteractivePreviewHost *p_host, Reason p_reason)
     : m_host(p_host), m_reason(p_reason) {
   ++m_host->m_blockDepth;
@@ -107,6 +126,39 @@ static int trimmedEndOffset(const QString &p_text) {
 }
 
 
+// The one span where @p_before and @p_after differ: it starts at @p_offset in
+// both and ends at @p_beforeEnd in @p_before and at @p_afterEnd in @p_after.
+// An empty span in both when they are equal. Never splits a surrogate pair.
+//
+// A sheet writes back its whole table, but an edit of one cell only differs
+// inside that cell, and applying just this span leaves every other block of
+// the table - and its user data, its layout and its highlighting - in place.
+static void changedSpan(const QString &p_before, const QString &p_after, int *p_offset,
+                        int *p_beforeEnd, int *p_afterEnd) {
+  const int shorter = qMin(p_before.size(), p_after.size());
+  int prefix = 0;
+  while (prefix < shorter && p_before.at(prefix) == p_after.at(prefix)) {
+    ++prefix;
+  }
+  if (prefix > 0 && prefix < shorter && p_before.at(prefix - 1).isHighSurrogate()) {
+    --prefix;
+  }
+
+  int suffix = 0;
+  while (suffix < shorter - prefix &&
+         p_before.at(p_before.size() - 1 - suffix) == p_after.at(p_after.size() - 1 - suffix)) {
+    ++suffix;
+  }
+  if (suffix > 0 && suffix < shorter - prefix &&
+      p_before.at(p_before.size() - suffix).isLowSurrogate()) {
+    --suffix;
+  }
+
+  *p_offset = prefix;
+  *p_beforeEnd = p_before.size() - suffix;
+  *p_afterEnd = p_after.size() - suffix;
+}
+
 static int typeOrder(PreviewElementType p_type) { return static_cast<int>(p_type); }
 
 static int typeIndex(PreviewElementType p_type) {
@@ -119,6 +171,16 @@ InteractivePreviewHost::InteractivePreviewHost(VMarkdownEditor *p_editor)
     : QObject(p_editor), m_editor(p_editor) {
   setObjectName(QLatin1String(c_objectName));
 
+  m_measureCache = new PreviewMeasureCache(this);
+
+  m_owedWorkTimer = new QTimer(this);
+  m_owedWorkTimer->setSingleShot(true);
+  m_owedWorkTimer->setTimerType(Qt::PreciseTimer);
+  connect(m_owedWorkTimer, &QTimer::timeout, this, [this]() {
+    m_owedWorkScheduled = false;
+    drainOwedWork();
+  });
+
   registerPreviewMetaTypes();
 
   m_textEdit = m_editor->getTextEdit();
@@ -177,6 +239,7 @@ InteractivePreviewHost::InteractivePreviewHost(VMarkdownEditor *p_editor)
 
 InteractivePreviewHost::~InteractivePreviewHost() {
   removeAllItems(true);
+  clearWidgetPool(nullptr, true);
   // Nothing may survive the editor, including removals whose deferred deletion
   // has not been delivered yet.
   flushPendingDeletions();
@@ -238,6 +301,8 @@ bool InteractivePreviewHost::unregisterFactory(PreviewWidgetFactory *p_factory)
     // Erase first so a reentrant callback cannot resolve it anymore.
     m_factories.removeAt(i);
 
+    clearWidgetPool(p_factory, false);
+
     p_factory->deleteLater();
 
     qCDebug(previewHostLog) << "unregistered factory" << p_factory->metaObject()->className()
@@ -428,6 +493,9 @@ void InteractivePreviewHost::rebuildAll() {
   // see a collapsed range and drop the element to the painted path.
   flushDirtySheets();
 
+  // The factories which win may configure their widgets differently.
+  m_measureCache->clear();
+
   // Carry the live state across the rebuild: m_lastPreviews holds the
   // positions of parse generation m_revision, which the document may have
   // moved since, whereas the anchors have been tracking every edit. An
@@ -488,7 +556,8 @@ void InteractivePreviewHost::scheduleOwedWork() {
 
   if (!m_replacementRetryPending && !m_hasDeferredGeneration && !m_reconcilePending &&
       !m_publishPending && !m_geometrySyncPending && !m_scrollApplyPending &&
-      !m_foldRefreshPending && !m_cursorLineSyncPending) {
+      !m_virtualizePending && !m_measurePending && !m_foldRefreshPending &&
+      !m_cursorLineSyncPending) {
     return;
   }
 
@@ -505,11 +574,17 @@ void InteractivePreviewHost::scheduleOwedWork() {
     return;
   }
 
+  // Paced to the frame while anything is painted: the next drain waits for
+  // the frame after the last one, so a burst of scrolling or typing next to
+  // the widgets drains once per frame rather than once per event. A hidden
+  // editor has no frame to wait for.
+  int delay = 0;
+  if (m_lastOwedWorkDrain.isValid() && m_textEdit && m_textEdit->isVisible()) {
+    delay = qMax<qint64>(0, c_owedWorkFrameMs - m_lastOwedWorkDrain.elapsed());
+  }
+
   m_owedWorkScheduled = true;
-  QTimer::singleShot(0, this, [this]() {
-    m_owedWorkScheduled = false;
-    drainOwedWork();
-  });
+  m_owedWorkTimer->start(delay);
 }
 
 void InteractivePreviewHost::drainOwedWork() {
@@ -520,7 +595,12 @@ void InteractivePreviewHost::drainOwedWork() {
     return;
   }
 
-  setProperty(c_owedWorkDrainCountProperty, ++m_owedWorkDrainCount);
+  ++m_owedWorkDrainCount;
+  if (!m_lastOwedWorkDrain.isValid() || !m_textEdit || !m_textEdit->isVisible() ||
+      m_lastOwedWorkDrain.elapsed() >= c_owedWorkFrameMs) {
+    ++m_owedWorkFrameCount;
+  }
+  m_lastOwedWorkDrain.start();
 
   {
     QScopedValueRollback<bool> guard(m_drainingOwedWork, true);
@@ -561,6 +641,14 @@ InteractivePreviewHost::OwedWork InteractivePreviewHost::highestOwedWork() const
     return OwedWork::ScrollApply;
   }
 
+  if (m_virtualizePending) {
+    return OwedWork::Virtualize;
+  }
+
+  if (m_measurePending) {
+    return OwedWork::Measure;
+  }
+
   if (m_foldRefreshPending && !m_reconciling) {
     return OwedWork::FoldRefresh;
   }
@@ -588,13 +676,23 @@ bool InteractivePreviewHost::stopOwedWorkBefore(OwedWork p_step) const {
   return highestOwedWork() < p_step;
 }
 
+template <typename T> void InteractivePreviewHost::runOwedWorkStep(OwedWork p_step, T p_body) {
+  QElapsedTimer timer;
+  timer.start();
+  p_body();
+
+  auto &stats = m_owedWorkStats[static_cast<int>(p_step)];
+  ++stats.m_runs;
+  stats.m_nsecs += timer.nsecsElapsed();
+}
+
 // The order is load-bearing: a replacement must settle before the reconcile
 // which would remove its item, and the item set must settle before geometry
 // and folding observe it.
 void InteractivePreviewHost::runOwedWorkSteps() {
   if (m_replacementRetryPending) {
     m_replacementRetryPending = false;
-    retryDeferredReplacements();
+    runOwedWorkStep(OwedWork::ReplacementRetry, [this]() { retryDeferredReplacements(); });
   }
 
   if (stopOwedWorkBefore(OwedWork::DeferredGeneration)) {
@@ -602,7 +700,7 @@ void InteractivePreviewHost::runOwedWorkSteps() {
   }
 
   if (m_hasDeferredGeneration && !m_reconciling) {
-    replayDeferredGeneration();
+    runOwedWorkStep(OwedWork::DeferredGeneration, [this]() { replayDeferredGeneration(); });
   }
 
   if (stopOwedWorkBefore(OwedWork::Reconcile)) {
@@ -613,7 +711,7 @@ void InteractivePreviewHost::runOwedWorkSteps() {
     m_reconcilePending = false;
     setProperty(c_reconcileDeliveryCountProperty, ++m_reconcileDeliveryCount);
     // A factory set change may make a different factory win, so rebuild.
-    rebuildAll();
+    runOwedWorkStep(OwedWork::Reconcile, [this]() { rebuildAll(); });
   }
 
   if (stopOwedWorkBefore(OwedWork::Publish)) {
@@ -621,7 +719,7 @@ void InteractivePreviewHost::runOwedWorkSteps() {
   }
 
   if (m_publishPending) {
-    publish();
+    runOwedWorkStep(OwedWork::Publish, [this]() { publish(); });
   }
 
   if (stopOwedWorkBefore(OwedWork::GeometrySync)) {
@@ -631,7 +729,7 @@ void InteractivePreviewHost::runOwedWorkSteps() {
   if (m_geometrySyncPending) {
     // The wrappers own the flag bookkeeping - a full sync subsuming a pending
     // scroll apply, in particular. Their blocked check is a no-op here.
-    syncWidgetGeometry();
+    runOwedWorkStep(OwedWork::GeometrySync, [this]() { syncWidgetGeometry(); });
   }
 
   if (stopOwedWorkBefore(OwedWork::ScrollApply)) {
@@ -639,7 +737,30 @@ void InteractivePreviewHost::runOwedWorkSteps() {
   }
 
   if (m_scrollApplyPending) {
-    applyScrollOffset();
+    if (isScrollApplied()) {
+      // Owed while blocked and served since, by a full sync or by the bars
+      // moving back to where they were.
+      m_scrollApplyPending = false;
+      ++m_owedWorkStats[static_cast<int>(OwedWork::ScrollApply)].m_skips;
+    } else {
+      runOwedWorkStep(OwedWork::ScrollApply, [this]() { applyScrollOffset(); });
+    }
+  }
+
+  if (stopOwedWorkBefore(OwedWork::Virtualize)) {
+    return;
+  }
+
+  if (m_virtualizePending) {
+    runOwedWorkStep(OwedWork::Virtualize, [this]() { virtualizeItems(); });
+  }
+
+  if (stopOwedWorkBefore(OwedWork::Measure)) {
+    return;
+  }
+
+  if (m_measurePending) {
+    runOwedWorkStep(OwedWork::Measure, [this]() { refineMeasurements(); });
   }
 
   if (stopOwedWorkBefore(OwedWork::FoldRefresh)) {
@@ -650,7 +771,7 @@ void InteractivePreviewHost::runOwedWorkSteps() {
     m_foldRefreshPending = false;
     setProperty(c_foldRefreshCountProperty, ++m_foldRefreshCount);
     if (m_editor) {
-      m_editor->applyPreviewFolding();
+      runOwedWorkStep(OwedWork::FoldRefresh, [this]() { m_editor->applyPreviewFolding(); });
     }
   }
 
@@ -660,8 +781,51 @@ void InteractivePreviewHost::runOwedWorkSteps() {
 
   if (m_cursorLineSyncPending) {
     m_cursorLineSyncPending = false;
-    syncCursorLineToItem(m_cursorLineSyncId);
+    runOwedWorkStep(OwedWork::CursorLineSync,
+                    [this]() { syncCursorLineToItem(m_cursorLineSyncId); });
+  }
+}
+
+QVariantMap InteractivePreviewHost::owedWorkStepStats() const {
+  QVariantMap steps;
+  for (int i = 0; i < static_cast<int>(OwedWork::None); ++i) {
+    const auto &stats = m_owedWorkStats[i];
+    QVariantMap step;
+    step.insert(QStringLiteral("runs"), stats.m_runs);
+    step.insert(QStringLiteral("skips"), stats.m_skips);
+    step.insert(QStringLiteral("nsecs"), stats.m_nsecs);
+    steps.insert(QLatin1String(owedWorkName(static_cast<OwedWork>(i))), step);
+  }
+  return steps;
+}
+
+const char *InteractivePreviewHost::owedWorkName(OwedWork p_step) {
+  switch (p_step) {
+  case OwedWork::ReplacementRetry:
+    return "replacementRetry";
+  case OwedWork::DeferredGeneration:
+    return "deferredGeneration";
+  case OwedWork::Reconcile:
+    return "reconcile";
+  case OwedWork::Publish:
+    return "publish";
+  case OwedWork::GeometrySync:
+    return "geometrySync";
+  case OwedWork::ScrollApply:
+    return "scrollApply";
+  case OwedWork::Virtualize:
+    return "virtualize";
+  case OwedWork::Measure:
+    return "measure";
+  case OwedWork::FoldRefresh:
+    return "foldRefresh";
+  case OwedWork::CursorLineSync:
+    return "cursorLineSync";
+  case OwedWork::None:
+    break;
   }
+
+  return "none";
 }
 
 void InteractivePreviewHost::replayDeferredGeneration() {
@@ -747,7 +911,7 @@ QVector<PreviewedRange> InteractivePreviewHost::previewedRanges() const {
   ranges.reserve(m_items.size());
   for (auto it = m_items.constBegin(); it != m_items.constEnd(); ++it) {
     const auto &item = it.value();
-    if (!item.m_widget || !item.m_preview) {
+    if ((!item.m_widget && !item.m_dormant) || !item.m_preview) {
       continue;
     }
 
@@ -842,12 +1006,19 @@ void InteractivePreviewHost::updatePreviews(
   QSet<quint64> used;
   QVector<QPair<quint64, QSharedPointer<const Preview>>> matched;
   QVector<QSharedPointer<const Preview>> fresh;
+  // Matched items whose snapshot was reused by the highlighter: only their
+  // revision and position changed.
+  int unchanged = 0;
   rebuildAnchorIndex();
   for (const auto &preview : candidates) {
     const quint64 id = findIdentity(preview, used);
     if (id) {
       used.insert(id);
       matched.append(qMakePair(id, preview));
+      const auto item = m_items.constFind(id);
+      if (PreviewBuilder::sharesContent(item.value().m_generationPreview, preview)) {
+        ++unchanged;
+      }
     } else {
       fresh.append(preview);
     }
@@ -867,8 +1038,8 @@ void InteractivePreviewHost::updatePreviews(
 
   qCDebug(previewHostLog) << "reconcile revision" << p_revision << "-" << p_previews.size()
                           << "snapshot(s)," << candidates.size() << "enabled," << matched.size()
-                          << "matched," << fresh.size() << "new," << removed << "removed (enabled"
-                          << m_enabled << ")";
+                          << "matched (" << unchanged << "unchanged)," << fresh.size() << "new,"
+                          << removed << "removed (enabled" << m_enabled << ")";
 
   for (const auto &pair : matched) {
     updateItem(pair.first, pair.second);
@@ -998,12 +1169,26 @@ QTextCursor InteractivePreviewHost::makeAnchor(int p_startPos, int p_endPos) con
   return cursor;
 }
 
+PreviewWidgetContext *
+InteractivePreviewHost::newContext(quint64 p_id, const QSharedPointer<const Preview> &p_preview) {
+  auto context = new PreviewWidgetContext(p_id, this);
+  context->setPreview(p_preview);
+  connect(context, &PreviewWidgetContext::sourceReplacementRequested, this,
+          &InteractivePreviewHost::handleSourceReplacementRequested);
+  return context;
+}
+
 PreviewWidget *
 InteractivePreviewHost::createWidgetFor(const QSharedPointer<const Preview> &p_preview,
-                                        PreviewWidgetContext *p_context,
+                                        quint64 p_id, PreviewWidgetContext **p_context,
                                         PreviewWidgetFactory **p_usedFactory) {
+  *p_context = nullptr;
   *p_usedFactory = nullptr;
 
+  // Created on the first factory which has no pooled widget to offer, and
+  // handed to every factory after it, as a declining factory leaves it unused.
+  QPointer<PreviewWidgetContext> context;
+
   // Iterate over a snapshot: a factory may unregister itself (or a sibling)
   // from inside any of the callbacks below, which mutates m_factories.
   const auto factories = orderedFactories();
@@ -1025,10 +1210,27 @@ InteractivePreviewHost::createWidgetFor(const QSharedPointer<const Preview> &p_p
       continue;
     }
 
+    PreviewWidgetContext *pooledContext = nullptr;
+    auto pooled = takePooledWidget(factory.data(), p_id, p_preview, &pooledContext);
+    if (pooled) {
+      delete context.data();
+      *p_context = pooledContext;
+      *p_usedFactory = factory.data();
+      return pooled;
+    }
+
+    if (factory.isNull() || !isFactoryActive(factory.data())) {
+      continue;
+    }
+
+    if (context.isNull()) {
+      context = newContext(p_id, p_preview);
+    }
+
     QPointer<PreviewWidget> widget;
     {
       BlockGuard guard(this, BlockGuard::Reason::FactoryCallback);
-      widget = factory->createWidget(p_context, p_preview, viewport());
+      widget = factory->createWidget(context.data(), p_preview, viewport());
     }
 
     if (widget.isNull()) {
@@ -1070,13 +1272,79 @@ InteractivePreviewHost::createWidgetFor(const QSharedPointer<const Preview> &p_p
       continue;
     }
 
+    *p_context = context.data();
     *p_usedFactory = factory.data();
     return widget.data();
   }
 
+  delete context.data();
   return nullptr;
 }
 
+PreviewWidget *
+InteractivePreviewHost::takePooledWidget(PreviewWidgetFactory *p_factory, quint64 p_id,
+                                         const QSharedPointer<const Preview> &p_preview,
+                                         PreviewWidgetContext **p_context) {
+  *p_context = nullptr;
+
+  // Re-resolved on every iteration: a refusing widget's callback may mutate
+  // the pool.
+  while (true) {
+    auto it = m_widgetPool.find(p_factory);
+    if (it == m_widgetPool.end() || it.value().isEmpty()) {
+      return nullptr;
+    }
+
+    const auto pooled = it.value().takeLast();
+    if (pooled.m_widget.isNull() || pooled.m_context.isNull()) {
+      disposeWidget(pooled.m_widget, pooled.m_context, false);
+      continue;
+    }
+
+    pooled.m_context->setIdentity(p_id);
+    pooled.m_context->setPreview(p_preview);
+
+    QPointer<PreviewWidget> widget = pooled.m_widget;
+    QPointer<PreviewWidgetFactory> factory = p_factory;
+    bool accepted = false;
+    {
+      BlockGuard guard(this, BlockGuard::Reason::FactoryCallback);
+      accepted = !widget.isNull() && widget->supportedTypes().contains(p_preview->type()) &&
+                 !widget.isNull() && widget->setPreview(p_preview);
+    }
+
+    if (accepted && !widget.isNull() && !pooled.m_context.isNull() && !factory.isNull() &&
+        isFactoryActive(factory.data())) {
+      qCDebug(previewHostLog) << "rebound a pooled" << widget->metaObject()->className()
+                              << "to identity" << p_id;
+      *p_context = pooled.m_context.data();
+      return widget.data();
+    }
+
+    disposeWidget(pooled.m_widget, pooled.m_context, false);
+    if (factory.isNull() || !isFactoryActive(factory.data())) {
+      return nullptr;
+    }
+  }
+}
+
+void InteractivePreviewHost::clearWidgetPool(PreviewWidgetFactory *p_factory,
+                                             bool p_synchronous) {
+  QVector<PooledWidget> pooled;
+  if (p_factory) {
+    pooled = m_widgetPool.take(p_factory);
+  } else {
+    for (const auto &widgets : m_widgetPool) {
+      pooled += widgets;
+    }
+    m_widgetPool.clear();
+  }
+
+  for (const auto &entry : pooled) {
+    disposeWidget(entry.m_widget, entry.m_context, p_synchronous);
+  }
+}
+
 void InteractivePreviewHost::createItem(const QSharedPointer<const Preview> &p_preview,
                                         PreviewFoldState p_carried) {
   auto *vp = viewport();
@@ -1143,19 +1411,14 @@ void InteractivePreviewHost::createItem(const QSharedPointer<const Preview> &p_p
 
   const quint64 id = m_nextIdentity++;
 
-  auto context = new PreviewWidgetContext(id, this);
-  context->setPreview(bound);
-  connect(context, &PreviewWidgetContext::sourceReplacementRequested, this,
-          &InteractivePreviewHost::handleSourceReplacementRequested);
-
+  PreviewWidgetContext *context = nullptr;
   PreviewWidgetFactory *usedFactory = nullptr;
-  PreviewWidget *widget = createWidgetFor(bound, context, &usedFactory);
+  PreviewWidget *widget = createWidgetFor(bound, id, &context, &usedFactory);
   if (!widget) {
     // Nobody claims it: keep the static painted fallback (or source only).
     qCDebug(previewHostLog) << "no factory claimed" << previewTypeName(bound->type()) << "at ["
                             << bound->startPos() << "," << bound->endPos()
                             << ") - keeping the painted fallback";
-    delete context;
     return;
   }
 
@@ -1184,6 +1447,18 @@ void InteractivePreviewHost::createItem(const QSharedPointer<const Preview> &p_p
                           << (carriedBinding
                                   ? "(rebuilt, carried the rebased source)"
                                   : (carriedAnchor ? "(rebuilt, carried the live anchor)" : ""));
+
+  // A far element is only measured, so that its band is reserved, and hands
+  // its widget on to the next element right away. Its position is estimated
+  // from its source block, as no band has been published for it yet.
+  if (isVirtualizing()) {
+    const auto block = m_doc->findBlock(anchor.selectionStart());
+    const auto band = keepAliveBand();
+    const QRectF blockRect = block.isValid() ? m_layout->blockBoundingRect(block) : QRectF();
+    if (blockRect.bottom() < band.first || blockRect.top() > band.second) {
+      parkItem(id);
+    }
+  }
 }
 
 void InteractivePreviewHost::updateItem(quint64 p_id,
@@ -1205,6 +1480,11 @@ void InteractivePreviewHost::updateItem(quint64 p_id,
 
   const auto bound = keepBinding ? item.m_preview : p_preview;
 
+  // The highlighter relocates the snapshot of an element whose source did not
+  // change, so the cached measurement still holds.
+  const bool unchanged =
+      !rebased && PreviewBuilder::sharesContent(item.m_generationPreview, p_preview);
+
   // Resolve the new anchor before rebinding anything: a replayed generation
   // can describe a range the document has outgrown, and rebinding first would
   // leave the item quoting the new source over a collapsed range.
@@ -1228,6 +1508,15 @@ void InteractivePreviewHost::updateItem(quint64 p_id,
   item.m_generationPreview = p_preview;
   item.m_anchor = anchor;
 
+  if (item.m_dormant) {
+    // Bound once woken. The reserved band keeps the last measured size until
+    // then.
+    if (!unchanged) {
+      item.m_measureDirty = true;
+    }
+    return;
+  }
+
   if (item.m_context) {
     item.m_context->setPreview(bound);
   }
@@ -1252,8 +1541,13 @@ void InteractivePreviewHost::updateItem(quint64 p_id,
     }
 
     auto &live = it.value();
-    // The bound snapshot changed, so the cached measurement is stale.
-    live.m_measureDirty = true;
+    // The bound snapshot changed, so the cached measurement is stale. A widget
+    // which resizes itself anyway posts a LayoutRequest.
+    if (!unchanged) {
+      live.m_measureDirty = true;
+    }
+    // Whatever kept it from being parked may have been written back.
+    live.m_parkDeclined = false;
     qCDebug(previewHostLog) << "updated item" << p_id << previewTypeName(bound->type())
                             << "in place at [" << live.m_anchor.selectionStart() << ","
                             << live.m_anchor.selectionEnd() << ")"
@@ -1338,33 +1632,41 @@ void InteractivePreviewHost::removeItem(quint64 p_id, bool p_synchronous) {
         (focus == item.m_widget.data() || item.m_widget->isAncestorOf(focus))) {
       m_textEdit->setFocus();
     }
+  }
 
-    item.m_widget->hide();
+  disposeWidget(item.m_widget, item.m_context, p_synchronous);
+}
+
+void InteractivePreviewHost::disposeWidget(const QPointer<PreviewWidget> &p_widget,
+                                           const QPointer<PreviewWidgetContext> &p_context,
+                                           bool p_synchronous) {
+  if (p_widget) {
+    p_widget->hide();
   }
 
   if (p_synchronous) {
     // Destroy the widget before its context so a widget destructor can still
     // reach the context.
-    delete item.m_widget.data();
-    delete item.m_context.data();
+    delete p_widget.data();
+    delete p_context.data();
     return;
   }
 
-  if (item.m_widget) {
-    item.m_widget->setParent(nullptr);
-    item.m_widget->deleteLater();
+  if (p_widget) {
+    p_widget->setParent(nullptr);
+    p_widget->deleteLater();
   }
 
-  if (item.m_context) {
-    item.m_context->deleteLater();
+  if (p_context) {
+    p_context->deleteLater();
   }
 
   // Remember the pair: if the editor goes away before the deferred deletion is
   // delivered, the destructor must still tear it down.
-  if (!item.m_widget.isNull() || !item.m_context.isNull()) {
+  if (!p_widget.isNull() || !p_context.isNull()) {
     PendingDeletion pending;
-    pending.m_widget = item.m_widget;
-    pending.m_context = item.m_context;
+    pending.m_widget = p_widget;
+    pending.m_context = p_context;
     m_pendingDeletions.append(pending);
   }
 
@@ -1768,6 +2070,138 @@ QSizeF InteractivePreviewHost::preferredSize(PreviewWidget *p_widget, PreviewPla
   return QSizeF(width, qMax<qreal>(0, height));
 }
 
+qreal InteractivePreviewHost::measureWidthBasis(const ActiveItem &p_item, int p_startPos,
+                                                int p_endPos, qreal p_availableWidth) const {
+  qreal widthBasis = p_availableWidth;
+  if (p_item.m_preview->placement() == PreviewPlacement::InlineAboveLine) {
+    const qreal spanWidth = m_layout->inlinePlacementWidth(p_startPos, p_endPos);
+    if (spanWidth > 0) {
+      widthBasis = p_availableWidth > 0 ? qMin(spanWidth, p_availableWidth) : spanWidth;
+    }
+  }
+  return widthBasis;
+}
+
+void InteractivePreviewHost::measureItem(ActiveItem &p_item, int p_startPos, int p_endPos,
+                                         qreal p_widthBasis) {
+  Q_ASSERT(p_item.m_widget);
+  p_item.m_measuredSize =
+      preferredSize(p_item.m_widget.data(), p_item.m_preview->placement(), p_startPos, p_endPos);
+  // Store the input constraint, which is what the guard is keyed on. The
+  // width preferredSize() derives is the widget's own, so caching that
+  // instead would never compare equal and the measurement would re-run on
+  // every publish.
+  p_item.m_measuredWidthBasis = p_widthBasis;
+  p_item.m_measureDirty = false;
+  p_item.m_measureForced = false;
+  p_item.m_measureApproximate = false;
+
+  if (!isMeasuredLocally(p_item)) {
+    m_measureCache->insert(*p_item.m_preview, p_item.m_factory.data(), p_item.m_widget.data(),
+                           p_widthBasis, p_item.m_measuredSize);
+  }
+
+  qCDebug(previewLayoutLog) << "measured item" << p_item.m_id
+                            << previewTypeName(p_item.m_preview->type()) << "->"
+                            << p_item.m_measuredSize << "at width basis" << p_widthBasis;
+}
+
+bool InteractivePreviewHost::reuseMeasurement(ActiveItem &p_item, qreal p_widthBasis) {
+  Q_ASSERT(p_item.m_widget);
+  if (p_item.m_measureForced || isMeasuredLocally(p_item)) {
+    return false;
+  }
+
+  QSizeF size;
+  if (!m_measureCache->find(*p_item.m_preview, p_item.m_factory.data(), p_item.m_widget.data(),
+                            p_widthBasis, &size)) {
+    return false;
+  }
+
+  p_item.m_measuredSize = size;
+  p_item.m_measuredWidthBasis = p_widthBasis;
+  p_item.m_measureDirty = false;
+  p_item.m_measureApproximate = false;
+  return true;
+}
+
+bool InteractivePreviewHost::isMeasuredLocally(const ActiveItem &p_item) const {
+  return p_item.m_id == m_focusedItemId || m_deferredReplacements.contains(p_item.m_id);
+}
+
+void InteractivePreviewHost::refineMeasurements() {
+  m_measurePending = false;
+
+  // Nearest the viewport first, so what is about to scroll in settles first.
+  const auto visible = viewportBand(0);
+  const qreal center = (visible.first + visible.second) / 2;
+  QVector<QPair<qreal, quint64>> queue;
+  for (auto it = m_items.constBegin(); it != m_items.constEnd(); ++it) {
+    const auto &item = it.value();
+    if (!item.m_measureApproximate || item.m_dormant || !item.m_widget) {
+      continue;
+    }
+
+    // Folded or not laid out yet: last in line.
+    const qreal distance = item.m_documentRect.isNull()
+                               ? std::numeric_limits<qreal>::max()
+                               : qAbs(item.m_documentRect.center().y() - center);
+    queue.append(qMakePair(distance, it.key()));
+  }
+
+  std::sort(queue.begin(), queue.end());
+
+  const qreal availableWidth = m_layout->availableContentWidth();
+  bool changed = false;
+  const int count = qMin(queue.size(), c_measureBatchSize);
+  for (int i = 0; i < count; ++i) {
+    auto it = m_items.find(queue[i].second);
+    if (it == m_items.end() || !it.value().m_widget) {
+      continue;
+    }
+
+    auto &item = it.value();
+    const int start = item.m_anchor.selectionStart();
+    const int end = item.m_anchor.selectionEnd();
+    const QSizeF approximate = item.m_measuredSize;
+    const qreal widthBasis = measureWidthBasis(item, start, end, availableWidth);
+    if (!reuseMeasurement(item, widthBasis)) {
+      measureItem(item, start, end, widthBasis);
+    }
+    changed = changed || item.m_measuredSize != approximate;
+  }
+
+  qCDebug(previewLayoutLog) << "refined" << count << "of" << queue.size()
+                            << "approximate size(s)" << (changed ? "- some changed" : "");
+
+  // One batch per drain, and the drain is paced to the frame.
+  if (queue.size() > count) {
+    m_measurePending = true;
+  }
+
+  if (changed) {
+    schedulePublish();
+  }
+
+  publishMeasureStats();
+}
+
+void InteractivePreviewHost::publishMeasureStats() {
+  int approximate = 0;
+  for (const auto &item : m_items) {
+    if (item.m_measureApproximate) {
+      ++approximate;
+    }
+  }
+
+  QVariantMap stats;
+  stats.insert(QStringLiteral("hits"), m_measureCache->hitCount());
+  stats.insert(QStringLiteral("misses"), m_measureCache->missCount());
+  stats.insert(QStringLiteral("entries"), m_measureCache->size());
+  stats.insert(QStringLiteral("approximate"), approximate);
+  setProperty(c_measureStatsProperty, stats);
+}
+
 void InteractivePreviewHost::applyReadOnly() {
   if (!m_tableFactory) {
     return;
@@ -1848,10 +2282,11 @@ void InteractivePreviewHost::publish() {
   claims.reserve(m_items.size());
 
   const qreal availableWidth = m_layout->availableContentWidth();
+  const auto visible = viewportBand(0);
 
   for (auto it = m_items.begin(); it != m_items.end(); ++it) {
     auto &item = it.value();
-    if (!item.m_widget || !item.m_preview) {
+    if ((!item.m_widget && !item.m_dormant) || !item.m_preview) {
       continue;
     }
 
@@ -1869,29 +2304,33 @@ void InteractivePreviewHost::publish() {
     spec.m_typeOrder = typeOrder(item.m_preview->type());
 
     // Re-measuring is expensive, so only do it when the widget asked for a new
-    // layout or the width it will be given changed.
-    qreal widthBasis = availableWidth;
-    if (spec.m_placement == PreviewPlacement::InlineAboveLine) {
-      const qreal spanWidth = m_layout->inlinePlacementWidth(start, end);
-      if (spanWidth > 0) {
-        widthBasis = availableWidth > 0 ? qMin(spanWidth, availableWidth) : spanWidth;
+    // layout or the width it will be given changed, and only when no widget
+    // was measured for the same content and width before. A dormant item has
+    // nothing to measure and keeps its last size until it is woken.
+    //
+    // An off-screen item keeps its last size as an approximation and is
+    // measured in batches afterwards, so a resize with many previews only
+    // measures what is in view before the next frame.
+    if (!item.m_dormant) {
+      const qreal widthBasis = measureWidthBasis(item, start, end, availableWidth);
+      if ((item.m_measureDirty ||
+           !qFuzzyCompare(item.m_measuredWidthBasis + 1, widthBasis + 1)) &&
+          !reuseMeasurement(item, widthBasis)) {
+        const bool measuredBefore = item.m_measuredWidthBasis >= 0;
+        const bool inView = item.m_documentRect.bottom() >= visible.first &&
+                            item.m_documentRect.top() <= visible.second &&
+                            !item.m_documentRect.isNull();
+        if (measuredBefore && !inView && !item.m_measureForced) {
+          item.m_measuredWidthBasis = widthBasis;
+          item.m_measureDirty = false;
+          item.m_measureApproximate = true;
+          m_measurePending = true;
+        } else {
+          measureItem(item, start, end, widthBasis);
+        }
       }
     }
 
-    if (item.m_measureDirty || !qFuzzyCompare(item.m_measuredWidthBasis + 1, widthBasis + 1)) {
-      item.m_measuredSize = preferredSize(item.m_widget.data(), spec.m_placement, start, end);
-      // Store the input constraint, which is what the guard is keyed on. The
-      // width preferredSize() derives is the widget's own, so caching that
-      // instead would never compare equal and the measurement would re-run on
-      // every publish.
-      item.m_measuredWidthBasis = widthBasis;
-      item.m_measureDirty = false;
-
-      qCDebug(previewLayoutLog)
-          << "measured item" << item.m_id << previewTypeName(item.m_preview->type()) << "->"
-          << item.m_measuredSize << "at width basis" << widthBasis;
-    }
-
     spec.m_width = item.m_measuredSize.width();
     spec.m_height = item.m_measuredSize.height();
     specs.append(spec);
@@ -1931,8 +2370,11 @@ void InteractivePreviewHost::publish() {
     syncWidgetGeometry();
   }
 
+  publishMeasureStats();
+
   // The previews the layout now holds are the ones the fold decision is made
-  // from, so this is the point where a re-evaluation is owed.
+  // from, so this is the point where a re-evaluation is owed. It also arms the
+  // drain which refines the approximate sizes.
   scheduleFoldRefresh();
 }
 
@@ -1976,12 +2418,16 @@ void InteractivePreviewHost::syncWidgetGeometryImpl() {
 
   for (auto it = m_items.begin(); it != m_items.end(); ++it) {
     auto &item = it.value();
-    if (!item.m_widget) {
+    if (!item.m_widget && !item.m_dormant) {
       continue;
     }
 
     const QRectF docRect = m_layout->widgetPreviewRect(item.m_id);
     item.m_documentRect = m_enabled ? docRect : QRectF();
+    if (item.m_dormant) {
+      // Only kept to decide when to wake it.
+      continue;
+    }
 
     if (item.m_context) {
       if (item.m_documentRect.isNull()) {
@@ -2040,6 +2486,21 @@ void InteractivePreviewHost::applyScrollOffset() {
   applyScrollOffsetImpl();
 }
 
+bool InteractivePreviewHost::isScrollApplied() const {
+  auto *vp = viewport();
+  return vp && m_scrollApplied && m_appliedScroll == scrollOffset() &&
+         m_appliedViewportSize == vp->size();
+}
+
+QPoint InteractivePreviewHost::scrollOffset() const {
+  return QPoint(m_textEdit && m_textEdit->horizontalScrollBar()
+                    ? m_textEdit->horizontalScrollBar()->value()
+                    : 0,
+                m_textEdit && m_textEdit->verticalScrollBar()
+                    ? m_textEdit->verticalScrollBar()->value()
+                    : 0);
+}
+
 void InteractivePreviewHost::applyScrollOffsetImpl() {
   auto *vp = viewport();
   if (!vp) {
@@ -2053,20 +2514,35 @@ void InteractivePreviewHost::applyScrollOffsetImpl() {
 
   // Everything below is scroll dependent only; the document rectangles were
   // computed by the last syncWidgetGeometry().
-  const int hScroll = m_textEdit && m_textEdit->horizontalScrollBar()
-                          ? m_textEdit->horizontalScrollBar()->value()
-                          : 0;
-  const int vScroll = m_textEdit && m_textEdit->verticalScrollBar()
-                          ? m_textEdit->verticalScrollBar()->value()
-                          : 0;
+  const QPoint scroll = scrollOffset();
+  const int hScroll = scroll.x();
+  const int vScroll = scroll.y();
   const QRect viewportRect(QPoint(0, 0), vp->size());
 
+  m_scrollApplied = true;
+  m_appliedScroll = scroll;
+  m_appliedViewportSize = vp->size();
+
+  // Whether an item has to be parked or woken, which virtualizeItems() does
+  // once the geometry application has unwound.
+  const auto band = keepAliveBand();
+  bool residencyChanged = false;
+
   for (auto it = m_items.begin(); it != m_items.end(); ++it) {
     auto &item = it.value();
+    if (item.m_dormant) {
+      residencyChanged = residencyChanged || isResident(item, band);
+      continue;
+    }
+
     if (!item.m_widget) {
       continue;
     }
 
+    if (!item.m_parkDeclined && !isResident(item, band)) {
+      residencyChanged = true;
+    }
+
     if (item.m_documentRect.isNull()) {
       // Folded, disabled or not laid out: keep the widget allocated but
       // hidden off-screen.
@@ -2087,6 +2563,219 @@ void InteractivePreviewHost::applyScrollOffsetImpl() {
       item.m_widget->hide();
     }
   }
+
+  if (residencyChanged) {
+    // Armed by the outermost guard above, or picked up by a running drain.
+    m_virtualizePending = true;
+    scheduleOwedWork();
+  }
+}
+
+bool InteractivePreviewHost::isVirtualizing() const {
+  return m_items.size() >= c_virtualizationThreshold;
+}
+
+QPair<qreal, qreal> InteractivePreviewHost::viewportBand(int p_screens) const {
+  auto *vp = viewport();
+  if (!vp) {
+    return qMakePair<qreal, qreal>(0, 0);
+  }
+
+  auto vbar = m_textEdit->verticalScrollBar();
+  const int vScroll = vbar ? vbar->value() : 0;
+  const qreal margin = p_screens * vp->height();
+  return qMakePair(vScroll - margin, vScroll + vp->height() + margin);
+}
+
+QPair<qreal, qreal> InteractivePreviewHost::keepAliveBand() const {
+  return viewportBand(c_keepAliveScreens);
+}
+
+bool InteractivePreviewHost::isResident(const ActiveItem &p_item,
+                                        const QPair<qreal, qreal> &p_band) const {
+  if (!isVirtualizing() || p_item.m_id == m_focusedItemId) {
+    return true;
+  }
+
+  // Folded, disabled or not laid out: nothing to show.
+  if (p_item.m_documentRect.isNull()) {
+    return false;
+  }
+
+  return p_item.m_documentRect.bottom() >= p_band.first &&
+         p_item.m_documentRect.top() <= p_band.second;
+}
+
+void InteractivePreviewHost::virtualizeItems() {
+  m_virtualizePending = false;
+
+  const auto band = keepAliveBand();
+  bool needMeasure = false;
+  bool woken = false;
+
+  // Parking flushes a sheet, which is reentrant, so every item is re-resolved
+  // by id.
+  const auto ids = m_items.keys();
+  for (quint64 id : ids) {
+    auto it = m_items.find(id);
+    if (it == m_items.end()) {
+      continue;
+    }
+
+    auto &item = it.value();
+    const bool resident = isResident(item, band);
+    if (resident) {
+      item.m_parkDeclined = false;
+    }
+
+    if (item.m_dormant && resident) {
+      if (wakeItem(id)) {
+        woken = true;
+        const auto live = m_items.constFind(id);
+        needMeasure = needMeasure || (live != m_items.constEnd() && live->m_measureDirty);
+      }
+    } else if (!item.m_dormant && !resident && !item.m_parkDeclined) {
+      parkItem(id);
+    }
+  }
+
+  qCDebug(previewHostLog) << "virtualized" << m_items.size() << "item(s) -" << m_widgetPool.size()
+                          << "factory pool(s)" << (woken ? "- woke some" : "");
+
+  if (needMeasure) {
+    // Measuring republishes, which syncs the geometry of the woken ones.
+    schedulePublish();
+  } else if (woken) {
+    syncWidgetGeometry();
+  }
+}
+
+bool InteractivePreviewHost::parkItem(quint64 p_id) {
+  auto it = m_items.find(p_id);
+  if (it == m_items.end() || it.value().m_dormant || !it.value().m_widget ||
+      !it.value().m_context || !it.value().m_factory) {
+    return false;
+  }
+
+  // A focused widget, or one whose write-back is still owed, stays.
+  QWidget *focus = QApplication::focusWidget();
+  QPointer<PreviewWidget> widget = it.value().m_widget;
+  if (p_id == m_focusedItemId || m_deferredReplacements.contains(p_id) ||
+      (focus && (focus == widget.data() || widget->isAncestorOf(focus)))) {
+    it.value().m_parkDeclined = true;
+    return false;
+  }
+
+  QPointer<TablePreviewWidget> sheet = qobject_cast<TablePreviewWidget *>(widget.data());
+  if (sheet) {
+    // The flush is the last point at which this identity owns the sheet.
+    const auto outcome = sheet->flushNow();
+
+    // The flush applies a document edit and may re-enter this host.
+    it = m_items.find(p_id);
+    if (it == m_items.end()) {
+      return false;
+    }
+
+    if (outcome != TablePreviewWidget::FlushOutcome::Settled || sheet.isNull()) {
+      it.value().m_parkDeclined = true;
+      return false;
+    }
+  }
+
+  auto &item = it.value();
+  if (item.m_measureDirty && item.m_widget) {
+    const int start = item.m_anchor.selectionStart();
+    const int end = item.m_anchor.selectionEnd();
+    const qreal widthBasis = measureWidthBasis(item, start, end, m_layout->availableContentWidth());
+    if (!reuseMeasurement(item, widthBasis)) {
+      measureItem(item, start, end, widthBasis);
+    }
+  }
+
+  PooledWidget pooled;
+  pooled.m_widget = item.m_widget;
+  pooled.m_context = item.m_context;
+  if (pooled.m_widget.isNull() || pooled.m_context.isNull()) {
+    return false;
+  }
+
+  auto factory = item.m_factory.data();
+  item.m_widget.clear();
+  item.m_context.clear();
+  item.m_dormant = true;
+
+  pooled.m_widget->hide();
+  // A request from a parked widget resolves to no item.
+  pooled.m_context->setIdentity(0);
+
+  auto &pool = m_widgetPool[factory];
+  if (pool.size() < c_maxPooledWidgets) {
+    pool.append(pooled);
+  } else {
+    disposeWidget(pooled.m_widget, pooled.m_context, false);
+  }
+
+  qCDebug(previewHostLog) << "parked item" << p_id << "-" << pool.size()
+                          << "widget(s) pooled for its factory";
+  return true;
+}
+
+bool InteractivePreviewHost::wakeItem(quint64 p_id) {
+  auto it = m_items.find(p_id);
+  if (it == m_items.end() || !it.value().m_dormant) {
+    return false;
+  }
+
+  auto *vp = viewport();
+  if (!vp) {
+    return false;
+  }
+
+  const auto bound = it.value().m_preview;
+  QPointer<PreviewWidgetFactory> lastFactory = it.value().m_factory;
+
+  // Rebind a pooled widget of the factory which claimed it before, and only
+  // walk the factory chain if none takes it.
+  PreviewWidgetContext *context = nullptr;
+  PreviewWidgetFactory *usedFactory = nullptr;
+  PreviewWidget *widget = nullptr;
+  if (lastFactory && isFactoryActive(lastFactory.data())) {
+    widget = takePooledWidget(lastFactory.data(), p_id, bound, &context);
+    usedFactory = lastFactory.data();
+  }
+  if (!widget) {
+    widget = createWidgetFor(bound, p_id, &context, &usedFactory);
+  }
+
+  // The callbacks may have torn the item down.
+  it = m_items.find(p_id);
+  if (it == m_items.end()) {
+    disposeWidget(widget, context, false);
+    return false;
+  }
+
+  if (!widget) {
+    qCDebug(previewHostLog) << "no factory claims dormant item" << p_id
+                            << "anymore - leaving it to the painted path";
+    removeItem(p_id);
+    return false;
+  }
+
+  widget->setParent(vp);
+  widget->setFont(editorFont());
+  widget->hide();
+  widget->installEventFilter(this);
+
+  auto &item = it.value();
+  item.m_widget = widget;
+  item.m_context = context;
+  item.m_factory = usedFactory;
+  item.m_dormant = false;
+  item.m_parkDeclined = false;
+
+  qCDebug(previewHostLog) << "woke item" << p_id << previewTypeName(bound->type());
+  return true;
 }
 
 bool InteractivePreviewHost::eventFilter(QObject *p_obj, QEvent *p_event) {
@@ -2120,6 +2809,7 @@ bool InteractivePreviewHost::eventFilter(QObject *p_obj, QEvent *p_event) {
       for (auto it = m_items.begin(); it != m_items.end(); ++it) {
         if (it.value().m_widget.data() == widget) {
           it.value().m_measureDirty = true;
+          it.value().m_measureForced = true;
           schedulePublish();
           break;
         }
@@ -2597,16 +3287,22 @@ void InteractivePreviewHost::handleSourceReplacementRequested(
   // importantly while text folding is disabled, where every range was cleared.
   // The item's remembered state has to survive that untouched.
 
+  // Only the span which differs, so the blocks of the unchanged rows survive.
+  int offset = 0;
+  int liveEnd = 0;
+  int replacementEnd = 0;
+  changedSpan(live, p_replacementMarkdown, &offset, &liveEnd, &replacementEnd);
+
   QTextCursor cursor(m_doc);
   cursor.beginEditBlock();
-  cursor.setPosition(start);
-  cursor.setPosition(end, QTextCursor::KeepAnchor);
-  cursor.insertText(p_replacementMarkdown);
+  cursor.setPosition(start + offset);
+  cursor.setPosition(start + liveEnd, QTextCursor::KeepAnchor);
+  cursor.insertText(p_replacementMarkdown.mid(offset, replacementEnd - offset));
   cursor.endEditBlock();
 
-  // insertText() removes the selection first, which collapses this anchor, and
-  // then advances it past the inserted text. Retarget it explicitly so the
-  // identity survives until the next parse generation.
+  // An edit at either end of the range moves that end of this anchor with it.
+  // Retarget it explicitly so the identity survives until the next parse
+  // generation.
   item.m_anchor = makeAnchor(start, start + p_replacementMarkdown.size());
   item.m_measureDirty = true;
 
@@ -2622,7 +3318,9 @@ void InteractivePreviewHost::handleSourceReplacementRequested(
   }
 
   qCDebug(previewReplaceLog) << "  applied to [" << start << ","
-                             << (start + p_replacementMarkdown.size()) << ")"
+                             << (start + p_replacementMarkdown.size()) << ") - rewrote"
+                             << (liveEnd - offset) << "->" << (replacementEnd - offset)
+                             << "characters at" << (start + offset)
                              << (rebased ? "and rebased the bound snapshot"
                                          : "WITHOUT a rebased snapshot");
 
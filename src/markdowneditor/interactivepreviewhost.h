@@ -1,13 +1,17 @@
 #ifndef INTERACTIVEPREVIEWHOST_H
 #define INTERACTIVEPREVIEWHOST_H
 
+#include <QElapsedTimer>
 #include <QHash>
 #include <QObject>
 #include <QPair>
+#include <QPoint>
 #include <QPointer>
 #include <QRectF>
 #include <QSet>
+#include <QSize>
 #include <QSizeF>
+#include <QVariant>
 #include <QTextCursor>
 #include <QVector>
 
@@ -19,8 +23,10 @@
 
 class QTextDocument;
 class QScrollBar;
+class QTimer;
 
 namespace vte {
+class PreviewMeasureCache;
 class TablePreviewWidget;
 class TablePreviewWidgetFactory;
 class VMarkdownEditor;
@@ -36,8 +42,18 @@ enum class FocusEscapeDirection;
 // It is an internal QObject child of the editor so no exported class needs a
 // new data member. Layout only ever learns identities and rectangles; widget
 // ownership never leaves this host.
+//
+// A document with many previews is virtualized: only the elements within a few
+// screens of the viewport hold a widget. The others keep their identity, their
+// anchor and their measured size, which the layout keeps reserving, and their
+// widget goes back to a per-factory pool to be rebound to another element.
 class InteractivePreviewHost : public QObject {
   Q_OBJECT
+  // Owed-work counters, read as properties but only built when read, so a
+  // drain pays nothing to publish them.
+  Q_PROPERTY(int vte_preview_owed_work_drains READ owedWorkDrainCount)
+  Q_PROPERTY(int vte_preview_owed_work_frames READ owedWorkFrameCount)
+  Q_PROPERTY(QVariantMap vte_preview_owed_work_steps READ owedWorkStepStats)
 public:
   explicit InteractivePreviewHost(VMarkdownEditor *p_editor);
 
@@ -79,6 +95,21 @@ public:
   // from a zero timer spinning against a held block.
   static const char *c_owedWorkDrainCountProperty;
 
+  // Number of drains which had a frame of their own: the first one, one at
+  // least c_owedWorkFrameMs after the one before, or one while the editor is
+  // hidden. It equals the drain count as long as the pacing holds.
+  static const char *c_owedWorkFrameCountProperty;
+
+  // What each owed-work step has cost so far: a QVariantMap from the step name
+  // to a QVariantMap of "runs", "skips" (owed, but its inputs had not changed)
+  // and "nsecs".
+  static const char *c_owedWorkStepStatsProperty;
+
+  // How preferred sizes were obtained so far: a QVariantMap of "hits" and
+  // "misses" of the shared measurement cache, its "entries", and the number of
+  // items currently reserving an "approximate" size.
+  static const char *c_measureStatsProperty;
+
   // Whether the host may not touch the editor's document right now: either a
   // layout pass is running, or an application-defined callback or a geometry
   // application is on the stack. Every mutating entry point tests this, and
@@ -206,6 +237,14 @@ private:
 
     bool m_measureDirty = true;
 
+    // Whether the widget itself asked for a new layout, so its size is
+    // measured rather than looked up in the shared cache.
+    bool m_measureForced = false;
+
+    // Whether m_measuredSize is the last size kept for an off-screen item
+    // while its measurement at the current basis is owed.
+    bool m_measureApproximate = false;
+
     // Last published document rectangle, so scrolling does not have to
     // recompute any scroll invariant geometry.
     QRectF m_documentRect;
@@ -224,6 +263,15 @@ private:
 
     int m_sourceRectEnd = -1;
 
+    // Whether the widget and its context have gone back to the pool because the
+    // element is far from the viewport. A dormant item is still published with
+    // its last measured size.
+    bool m_dormant = false;
+
+    // Whether parking was declined because the widget still owes a write-back.
+    // Retried once the element comes near the viewport again.
+    bool m_parkDeclined = false;
+
     // The initial fold state this element has been settled into, or Undecided
     // while no pass has seen it together with a live folding range. It lives on
     // the item and not on the folding range because a range is destroyed by the
@@ -244,6 +292,14 @@ private:
     PreviewFoldState m_foldState = PreviewFoldState::Undecided;
   };
 
+  // A widget with its context, parked for reuse by the factory which created
+  // it. The context's identity is 0 while parked.
+  struct PooledWidget {
+    QPointer<PreviewWidget> m_widget;
+
+    QPointer<PreviewWidgetContext> m_context;
+  };
+
   // A removed pair whose deferred deletion has not been delivered yet.
   struct PendingDeletion {
     QPointer<PreviewWidget> m_widget;
@@ -253,6 +309,13 @@ private:
 
   QWidget *viewport() const;
 
+  // The editor's horizontal and vertical scroll bar values.
+  QPoint scrollOffset() const;
+
+  // Whether the widgets were last placed for the current scroll offsets and
+  // viewport size.
+  bool isScrollApplied() const;
+
   // A sheet is handing the caret back to the editor. The destination is
   // resolved here rather than in the sheet: only this host holds a live anchor
   // for the source, and the snapshot positions a sheet knows go stale on any
@@ -360,16 +423,82 @@ private:
   // deleted synchronously so nothing survives the editor without an owner.
   void removeAllItems(bool p_synchronous = false);
 
+  // Hide and destroy a widget and its context, deferred unless
+  // @p_synchronous.
+  void disposeWidget(const QPointer<PreviewWidget> &p_widget,
+                     const QPointer<PreviewWidgetContext> &p_context, bool p_synchronous);
+
   void prunePendingDeletions();
 
   // Destroy everything whose deferred deletion is still outstanding.
   void flushPendingDeletions();
 
-  // Try every compatible factory in order. Returns nullptr when none claims.
-  PreviewWidget *createWidgetFor(const QSharedPointer<const Preview> &p_preview,
-                                 PreviewWidgetContext *p_context,
+  // A new context of identity @p_id bound to @p_preview.
+  PreviewWidgetContext *newContext(quint64 p_id, const QSharedPointer<const Preview> &p_preview);
+
+  // Try every compatible factory in order, reusing a pooled widget of the
+  // factory before asking it for a new one. Returns nullptr when none claims.
+  // On success, @p_context is the context of the widget, of identity @p_id.
+  PreviewWidget *createWidgetFor(const QSharedPointer<const Preview> &p_preview, quint64 p_id,
+                                 PreviewWidgetContext **p_context,
                                  PreviewWidgetFactory **p_usedFactory);
 
+  // Rebind a pooled widget of @p_factory to @p_preview under identity @p_id.
+  // Pooled widgets refusing the snapshot are destroyed. Returns nullptr when
+  // none accepts.
+  PreviewWidget *takePooledWidget(PreviewWidgetFactory *p_factory, quint64 p_id,
+                                  const QSharedPointer<const Preview> &p_preview,
+                                  PreviewWidgetContext **p_context);
+
+  // Destroy the pooled widgets of @p_factory, or of every factory if null.
+  void clearWidgetPool(PreviewWidgetFactory *p_factory, bool p_synchronous);
+
+  // Whether there are enough items for the far ones to give up their widgets.
+  bool isVirtualizing() const;
+
+  // Vertical extent in document coordinates of the viewport plus @p_screens
+  // viewport heights above and below it.
+  QPair<qreal, qreal> viewportBand(int p_screens) const;
+
+  // Vertical extent in document coordinates within which an item keeps its
+  // widget.
+  QPair<qreal, qreal> keepAliveBand() const;
+
+  // Whether @p_item should hold a widget given @p_band.
+  bool isResident(const ActiveItem &p_item, const QPair<qreal, qreal> &p_band) const;
+
+  // Park far items and wake near ones. Runs as an owed-work step, since
+  // parking a sheet flushes its write-back.
+  void virtualizeItems();
+
+  // Return the widget of @p_id to the pool. False if it has to stay.
+  bool parkItem(quint64 p_id);
+
+  // Give dormant item @p_id a widget again. False if it is gone, including
+  // when no factory claims it anymore and it is left to the painted path.
+  bool wakeItem(quint64 p_id);
+
+  // The width a measurement of @p_item spanning [@p_startPos, @p_endPos) is
+  // made against.
+  qreal measureWidthBasis(const ActiveItem &p_item, int p_startPos, int p_endPos,
+                          qreal p_availableWidth) const;
+
+  void measureItem(ActiveItem &p_item, int p_startPos, int p_endPos, qreal p_widthBasis);
+
+  // Take the size of @p_item at @p_widthBasis from the shared cache. False if
+  // it has to be measured.
+  bool reuseMeasurement(ActiveItem &p_item, qreal p_widthBasis);
+
+  // Whether the widget of @p_item may show more than its snapshot, such as an
+  // edit not written back yet, so its size is neither looked up nor shared.
+  bool isMeasuredLocally(const ActiveItem &p_item) const;
+
+  // Measure the approximate items nearest the viewport, at most
+  // c_measureBatchSize of them. Runs as an owed-work step.
+  void refineMeasurements();
+
+  void publishMeasureStats();
+
   QSizeF preferredSize(PreviewWidget *p_widget, PreviewPlacement p_placement, int p_startPos,
                        int p_endPos) const;
 
@@ -394,6 +523,14 @@ private:
     Publish,
     GeometrySync,
     ScrollApply,
+
+    // Parking and waking follow the geometry they are decided from.
+    Virtualize,
+
+    // Refining the approximate sizes follows the parking, which leaves fewer
+    // of them to measure.
+    Measure,
+
     FoldRefresh,
 
     // The cursor move must observe a settled item set and geometry, so it
@@ -426,6 +563,17 @@ private:
   // The highest ranking category which is currently owed and runnable.
   OwedWork highestOwedWork() const;
 
+  // Run @p_body as the owed step @p_step, counting it and timing it.
+  template <typename T> void runOwedWorkStep(OwedWork p_step, T p_body);
+
+  int owedWorkDrainCount() const { return m_owedWorkDrainCount; }
+
+  int owedWorkFrameCount() const { return m_owedWorkFrameCount; }
+
+  QVariantMap owedWorkStepStats() const;
+
+  static const char *owedWorkName(OwedWork p_step);
+
   // Whether the drain must stop before the step ranking at @p_step, because it
   // is blocked again or because a step just raised work ranking above it.
   bool stopOwedWorkBefore(OwedWork p_step) const;
@@ -548,11 +696,21 @@ private:
 
   bool m_scrollApplyPending = false;
 
+  bool m_virtualizePending = false;
+
+  bool m_measurePending = false;
+
   bool m_replacementRetryPending = false;
 
   // Whether one drain is already armed, so an unblock edge arms exactly one.
   bool m_owedWorkScheduled = false;
 
+  // Managed by QObject. Delivers the one armed drain.
+  QTimer *m_owedWorkTimer = nullptr;
+
+  // Started by every drain, to pace the next one to the frame.
+  QElapsedTimer m_lastOwedWorkDrain;
+
   // Set while a drain is running its ordered steps, so the work those steps
   // owe is picked up by the drain itself or by its single follow-up delivery,
   // never by one timer per owed item.
@@ -563,9 +721,54 @@ private:
   // budget drops the entry and nothing else.
   QHash<quint64, int> m_deferredReplacements;
 
-  // Published through c_owedWorkDrainCountProperty.
+  // Read through c_owedWorkDrainCountProperty.
   int m_owedWorkDrainCount = 0;
 
+  // Read through c_owedWorkFrameCountProperty.
+  int m_owedWorkFrameCount = 0;
+
+  struct OwedWorkStats {
+    int m_runs = 0;
+
+    int m_skips = 0;
+
+    qint64 m_nsecs = 0;
+  };
+
+  // Indexed by OwedWork. Read through c_owedWorkStepStatsProperty.
+  OwedWorkStats m_owedWorkStats[static_cast<int>(OwedWork::None)];
+
+  // The scroll offsets and viewport size the widgets were last placed for, so
+  // an owed scroll apply which would place them identically is skipped.
+  bool m_scrollApplied = false;
+
+  QPoint m_appliedScroll;
+
+  QSize m_appliedViewportSize;
+
+  // Managed by QObject.
+  PreviewMeasureCache *m_measureCache = nullptr;
+
+  // Widgets parked for reuse, per factory.
+  QHash<PreviewWidgetFactory *, QVector<PooledWidget>> m_widgetPool;
+
+  // Number of items from which the far ones are virtualized.
+  static const int c_virtualizationThreshold;
+
+  // Screens above and below the viewport within which items keep a widget.
+  static const int c_keepAliveScreens;
+
+  // Maximum number of widgets parked per factory.
+  static const int c_maxPooledWidgets;
+
+  // Maximum number of approximate sizes one drain measures.
+  static const int c_measureBatchSize;
+
+  // Shortest interval between two drains while the editor is visible: one
+  // frame at 60 Hz. Work owed within a frame of the last drain waits for the
+  // next frame instead of arming another zero timer.
+  static const int c_owedWorkFrameMs;
+
   // Maximum number of times the host retries one postponed replacement on a
   // built-in sheet's behalf. The sheet's own debounce is the backstop after
   // that.
@@ -3,6 +3,7 @@
 #include <algorithm>
 
 #include <QDebug>
+#include <QHash>
 #include <QTextBlock>
 #include <QTextDocument>
 
@@ -109,16 +110,137 @@ int regionRank(const md::FoldingRegion &p_region) {
   const int group = previewTypeForRegion(p_region.m_type, &type) ? 0 : 1;
   return group * 100 + static_cast<int>(p_region.m_type);
 }
+
+bool sameExtent(const md::FoldingRegion &p_a, const md::FoldingRegion &p_b) {
+  return p_a.m_startBlock == p_b.m_startBlock && p_a.m_endBlock == p_b.m_endBlock;
+}
 } // namespace
 
+bool MarkdownFoldingProvider::EditedSpan::intersects(int p_first, int p_last) const {
+  return m_valid && p_last >= m_first && p_first <= m_lastBeforeEdit;
+}
+
 MarkdownFoldingProvider::MarkdownFoldingProvider(TextFolding *p_textFolding,
                                                  QTextDocument *p_document)
     : m_textFolding(p_textFolding), m_document(p_document)
 {
+  m_blockCount = m_document->blockCount();
+  m_revision = m_document->revision();
+  m_contentsChangeConnection =
+      QObject::connect(m_document, &QTextDocument::contentsChange,
+                       [this](int p_position, int p_charsRemoved, int p_charsAdded) {
+                         if (p_charsRemoved > 0 || p_charsAdded > 0) {
+                           recordEdit(p_position, p_charsAdded);
+                         }
+                       });
+}
+
+MarkdownFoldingProvider::~MarkdownFoldingProvider()
+{
+  QObject::disconnect(m_contentsChangeConnection);
+}
+
+const MarkdownFoldingProvider::Diff &MarkdownFoldingProvider::lastDiff() const
+{
+  return m_lastDiff;
+}
+
+void MarkdownFoldingProvider::recordEdit(int p_position, int p_charsAdded)
+{
+  const int blockCount = m_document->blockCount();
+  const int revision = m_document->revision();
+  const int blockDelta = blockCount - m_blockCount;
+
+  // The highlighter and the layout report every format change through
+  // contentsChange too, and after a parse that is every block. Those change
+  // neither the revision nor the block count, and recording them would have
+  // every entry look its range up again.
+  if (blockDelta == 0 && revision == m_revision && m_document->isUndoRedoEnabled()) {
+    return;
+  }
+  m_blockCount = blockCount;
+  m_revision = revision;
+
+  auto lastBlock = m_document->findBlock(p_position + p_charsAdded);
+  if (!lastBlock.isValid()) {
+    lastBlock = m_document->lastBlock();
+  }
+  auto firstBlock = m_document->findBlock(p_position);
+  if (!firstBlock.isValid()) {
+    firstBlock = lastBlock;
+  }
+
+  const int first = firstBlock.blockNumber();
+  const int lastAfterEdit = lastBlock.blockNumber();
+  const int lastBeforeEdit = lastAfterEdit - blockDelta;
+
+  auto &span = m_editedSpan;
+  if (!span.m_valid) {
+    span.m_valid = true;
+    span.m_first = first;
+    span.m_lastBeforeEdit = lastBeforeEdit;
+    span.m_lastAfterEdit = lastAfterEdit;
+    return;
+  }
+
+  // Merge the two spans, in the numbering between the two edits, then map the
+  // end back to before the first edit and forward to after the second one.
+  const int last = qMax(span.m_lastAfterEdit, lastBeforeEdit);
+  span.m_first = qMin(span.m_first, first);
+  span.m_lastBeforeEdit += last - span.m_lastAfterEdit;
+  span.m_lastAfterEdit = lastAfterEdit + last - lastBeforeEdit;
+}
+
+void MarkdownFoldingProvider::shiftEntriesByEdits()
+{
+  if (!m_editedSpan.m_valid) {
+    return;
+  }
+
+  const auto span = m_editedSpan;
+  m_editedSpan = EditedSpan();
+
+  const int blockDelta = span.m_lastAfterEdit - span.m_lastBeforeEdit;
+  bool needSort = false;
+  int prevFirst = -1;
+  int kept = 0;
+  for (int i = 0; i < m_entries.size(); ++i) {
+    auto entry = m_entries[i];
+    if (span.intersects(entry.m_first, entry.m_last)) {
+      int first = 0;
+      int last = 0;
+      if (!m_textFolding->foldingRangeBlocks(entry.m_id, &first, &last)) {
+        // The range is gone: the entry has nothing left to describe.
+        continue;
+      }
+
+      if (first != entry.m_first || last != entry.m_last) {
+        entry.m_first = first;
+        entry.m_last = last;
+        ++m_lastDiff.m_moved;
+      }
+    } else if (entry.m_first > span.m_lastBeforeEdit && blockDelta != 0) {
+      entry.m_first += blockDelta;
+      entry.m_last += blockDelta;
+      ++m_lastDiff.m_moved;
+    }
+
+    needSort = needSort || entry.m_first <= prevFirst;
+    prevFirst = entry.m_first;
+    m_entries[kept++] = entry;
+  }
+  m_entries.resize(kept);
+
+  if (needSort) {
+    std::sort(m_entries.begin(), m_entries.end(),
+              [](const Entry &p_a, const Entry &p_b) { return p_a.m_first < p_b.m_first; });
+  }
 }
 
 void MarkdownFoldingProvider::updateFoldingRegions(const QVector<md::FoldingRegion> &p_regions)
 {
+  m_lastDiff = Diff();
+
   // 0. Drop the ranges the document has invalidated behind TextFolding's back.
   //
   // Replacing the whole source of an element in one edit - what the preview
@@ -127,8 +249,14 @@ void MarkdownFoldingProvider::updateFoldingRegions(const QVector<md::FoldingRegi
   // survives that edit holding stale endpoints and stops matching the block it
   // is supposed to start on, so the gutter loses its folding marker. A parse
   // result always describes a settled document, which makes this the right
-  // moment to re-validate.
-  m_textFolding->checkAndUpdateFoldings();
+  // moment to re-validate. TextFolding validates the ranges an edit touches as
+  // the edit happens, so this only walks the tree when an edit got past that.
+  m_textFolding->checkAndUpdatePendingFoldings();
+
+  if (m_textFolding->isEmpty()) {
+    // Every range was dropped without an edit, e.g. by disabling folding.
+    m_entries.clear();
+  }
 
   // 1. Filter out regions that span fewer than 2 blocks.
   QVector<md::FoldingRegion> valid;
@@ -139,111 +267,105 @@ void MarkdownFoldingProvider::updateFoldingRegions(const QVector<md::FoldingRegi
     }
   }
 
-  // 1b. De-duplicate exact extents.
+  // 2. Sort outermost-first: ascending startBlock, then descending size. Exact
+  // extents are ordered by regionRank(), for 2b.
+  std::sort(valid.begin(), valid.end(), [](const md::FoldingRegion &a, const md::FoldingRegion &b) {
+    if (a.m_startBlock != b.m_startBlock) {
+      return a.m_startBlock < b.m_startBlock;
+    }
+    if (a.m_endBlock != b.m_endBlock) {
+      return a.m_endBlock > b.m_endBlock;
+    }
+    return regionRank(a) < regionRank(b);
+  });
+
+  // 2b. De-duplicate exact extents.
   //
   // A blockquote wrapping nothing but a table emits two regions covering
   // exactly the same blocks, and TextFolding can only hold one of them: it
-  // rejects a second range starting on the same block. std::sort is not
-  // stable, so without a deterministic rule which of the two survives would be
-  // unspecified, and the fold state would follow whichever one won this parse.
+  // rejects a second range starting on the same block. The sort above makes
+  // the winner deterministic; without it, the fold state would follow
+  // whichever one won this parse.
   //
   // De-duplicating here rather than merely ordering the loser later is also
   // what lets a live wrapper entry be replaced when a table grows into exactly
   // its extent: the wrapper region is gone from the parsed set, so nothing
   // matches the live wrapper entry, it is removed below and the table is
   // created in its place.
-  {
-    QHash<QPair<int, int>, int> extentIndex;
-    QVector<md::FoldingRegion> unique;
-    unique.reserve(valid.size());
-    for (const auto &r : valid) {
-      const auto key = qMakePair(r.m_startBlock, r.m_endBlock);
-      auto it = extentIndex.find(key);
-      if (it == extentIndex.end()) {
-        extentIndex.insert(key, unique.size());
-        unique.append(r);
-        continue;
-      }
+  valid.erase(std::unique(valid.begin(), valid.end(), sameExtent), valid.end());
 
-      if (regionRank(r) < regionRank(unique[it.value()])) {
-        unique[it.value()] = r;
-      }
+  // 3. Bring the entries to their *current* positions.
+  //
+  // The entries describe where each region was at the last reconciliation.
+  // Any edit above a range shifts its block numbers, so matching the parsed
+  // regions against the stale extents would drop and recreate every range
+  // below the edit - and lose its fold state with it. The edits since then
+  // tell where each entry went; only those intersecting an edit ask
+  // TextFolding.
+  shiftEntriesByEdits();
+
+  // 4. Merge the parsed regions with the entries, both sorted by start block,
+  // matching on the extent *and* the type. A hit carries the entry over
+  // unchanged, which is what preserves the fold state and the settled decision
+  // across a re-parse and across any edit that only shifted block numbers. The
+  // type is compared rather than being part of the key so a fenced code block
+  // edited into a table at the same extent is treated as the new element it
+  // is. Two live ranges never share a start block, so at most one entry starts
+  // on any block.
+  QVector<Entry> merged;
+  merged.reserve(valid.size());
+  QVector<int> missing;
+  QVector<qint64> stale;
+  int i = 0;
+  int j = 0;
+  while (j < valid.size()) {
+    const int startBlock = valid[j].m_startBlock;
+    while (i < m_entries.size() && m_entries[i].m_first < startBlock) {
+      stale.append(m_entries[i++].m_id);
     }
 
-    valid = unique;
-  }
-
-  // 2. Sort outermost-first: ascending startBlock, then descending size.
-  std::sort(valid.begin(), valid.end(), [](const md::FoldingRegion &a, const md::FoldingRegion &b) {
-    if (a.m_startBlock != b.m_startBlock) {
-      return a.m_startBlock < b.m_startBlock;
+    int end = j;
+    while (end < valid.size() && valid[end].m_startBlock == startBlock) {
+      ++end;
     }
-    return (a.m_endBlock - a.m_startBlock) > (b.m_endBlock - b.m_startBlock);
-  });
-
-  // 3. Snapshot the live entries at their *current* positions.
-  //
-  // The table's keys describe where each region was at the last
-  // reconciliation. Any edit above a range shifts its block numbers without
-  // telling anyone, so matching the parsed regions against those keys would
-  // drop and recreate every range below the edit - and lose its fold state
-  // with it. TextFolding knows where each range lives now, so ask it.
-  struct LiveEntry {
-    Entry m_entry;
 
-    int m_first = 0;
-
-    int m_last = 0;
-
-    bool m_matched = false;
-  };
+    int match = -1;
+    if (i < m_entries.size() && m_entries[i].m_first == startBlock) {
+      const auto &entry = m_entries[i];
+      for (int k = j; k < end; ++k) {
+        if (valid[k].m_endBlock == entry.m_last && valid[k].m_type == entry.m_type) {
+          match = k;
+          break;
+        }
+      }
 
-  QVector<LiveEntry> live;
-  live.reserve(m_entries.size());
-  QHash<QPair<int, int>, int> liveIndex;
-  for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
-    int first = 0;
-    int last = 0;
-    if (!m_textFolding->foldingRangeBlocks(it.value().m_id, &first, &last)) {
-      // The range is gone: the entry has nothing left to describe.
-      continue;
+      if (match == -1) {
+        stale.append(entry.m_id);
+      }
     }
 
-    const auto key = qMakePair(first, last);
-    if (liveIndex.contains(key)) {
-      // Two live ranges can never share an extent - identical extents imply
-      // identical start blocks, which TextFolding rejects - so this can only
-      // be a stale duplicate entry. Keep the first one.
-      continue;
+    for (int k = j; k < end; ++k) {
+      if (k == match) {
+        merged.append(m_entries[i]);
+        continue;
+      }
+
+      Entry entry;
+      entry.m_type = valid[k].m_type;
+      entry.m_first = valid[k].m_startBlock;
+      entry.m_last = valid[k].m_endBlock;
+      missing.append(merged.size());
+      merged.append(entry);
     }
 
-    LiveEntry entry;
-    entry.m_entry = it.value();
-    entry.m_first = first;
-    entry.m_last = last;
-    liveIndex.insert(key, live.size());
-    live.append(entry);
-  }
-
-  // 4. Match every parsed region against the snapshot, on the extent *and* the
-  // type. A hit carries the entry over unchanged, which is what preserves the
-  // fold state and the settled decision across a re-parse and across any edit
-  // that only shifted block numbers. The type is compared rather than being
-  // part of the key so a fenced code block edited into a table at the same
-  // extent is treated as the new element it is.
-  QHash<QPair<int, int>, Entry> newEntries;
-  newEntries.reserve(valid.size());
-  QVector<md::FoldingRegion> missing;
-  for (const auto &r : valid) {
-    const auto key = qMakePair(r.m_startBlock, r.m_endBlock);
-    const int idx = liveIndex.value(key, -1);
-    if (idx >= 0 && !live[idx].m_matched && live[idx].m_entry.m_type == r.m_type) {
-      live[idx].m_matched = true;
-      newEntries.insert(key, live[idx].m_entry);
-      continue;
+    if (i < m_entries.size() && m_entries[i].m_first == startBlock) {
+      ++i;
     }
+    j = end;
+  }
 
-    missing.append(r);
+  while (i < m_entries.size()) {
+    stale.append(m_entries[i++].m_id);
   }
 
   // 5. Remove every unmatched live range.
@@ -252,9 +374,9 @@ void MarkdownFoldingProvider::updateFoldingRegions(const QVector<md::FoldingRegi
   // the same block as an existing one, so a region which only changed one
   // endpoint would otherwise be refused and left with no range at all until
   // some later parse which may never come.
-  for (const auto &entry : live) {
-    if (!entry.m_matched) {
-      m_textFolding->removeFoldingRange(entry.m_entry.m_id);
+  for (qint64 id : stale) {
+    if (m_textFolding->removeFoldingRange(id)) {
+      ++m_lastDiff.m_removed;
     }
   }
 
@@ -262,27 +384,33 @@ void MarkdownFoldingProvider::updateFoldingRegions(const QVector<md::FoldingRegi
   //
   // Creation can simply fail, e.g. when the range is not well nested with an
   // existing one; retrying it on the next parse costs nothing.
-  for (const auto &r : missing) {
-    TextBlockRange range(m_document->findBlockByNumber(r.m_startBlock),
-                         m_document->findBlockByNumber(r.m_endBlock));
-    qint64 id = m_textFolding->newFoldingRange(range, TextFolding::Persistent);
-    if (id != TextFolding::InvalidRangeId) {
-      Entry entry;
-      entry.m_id = id;
-      entry.m_type = r.m_type;
-      newEntries.insert(qMakePair(r.m_startBlock, r.m_endBlock), entry);
+  for (int idx : missing) {
+    auto &entry = merged[idx];
+    TextBlockRange range(m_document->findBlockByNumber(entry.m_first),
+                         m_document->findBlockByNumber(entry.m_last));
+    entry.m_id = m_textFolding->newFoldingRange(range, TextFolding::Persistent);
+    if (entry.m_id != TextFolding::InvalidRangeId) {
+      ++m_lastDiff.m_added;
     }
   }
 
-  m_entries = newEntries;
+  if (!missing.isEmpty()) {
+    merged.erase(std::remove_if(merged.begin(), merged.end(),
+                                [](const Entry &p_entry) {
+                                  return p_entry.m_id == TextFolding::InvalidRangeId;
+                                }),
+                 merged.end());
+  }
+
+  m_entries = merged;
 }
 
 void MarkdownFoldingProvider::clear()
 {
   QVector<qint64> ids;
   ids.reserve(m_entries.size());
-  for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
-    ids.append(it.value().m_id);
+  for (const auto &entry : m_entries) {
+    ids.append(entry.m_id);
   }
   m_entries.clear();
   for (qint64 id : ids) {
@@ -290,7 +418,11 @@ void MarkdownFoldingProvider::clear()
   }
 }
 
-void MarkdownFoldingProvider::resetState() { m_entries.clear(); }
+void MarkdownFoldingProvider::resetState()
+{
+  m_entries.clear();
+  m_editedSpan = EditedSpan();
+}
 
 void MarkdownFoldingProvider::setAutoFoldPreviewsEnabled(bool p_enabled)
 {
@@ -331,7 +463,8 @@ MarkdownFoldingProvider::applyPreviewAutoFold(const QVector<PreviewedRange> &p_w
   // end up in resetState(), which clears m_entries. So nothing may hold an
   // iterator into it across a fold.
   struct PendingDecision {
-    QPair<int, int> m_key;
+    // m_first of the entry.
+    int m_key = 0;
 
     qint64 m_id = -1;
 
@@ -350,9 +483,7 @@ MarkdownFoldingProvider::applyPreviewAutoFold(const QVector<PreviewedRange> &p_w
 
   QVector<PendingDecision> pending;
 
-  for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
-    const Entry &entry = it.value();
-
+  for (const Entry &entry : m_entries) {
     PreviewElementType type = PreviewElementType::Image;
     if (!previewTypeForRegion(entry.m_type, &type)) {
       continue;
@@ -404,7 +535,7 @@ MarkdownFoldingProvider::applyPreviewAutoFold(const QVector<PreviewedRange> &p_w
     }
 
     PendingDecision decision;
-    decision.m_key = it.key();
+    decision.m_key = entry.m_first;
     decision.m_id = entry.m_id;
     decision.m_hasWidget = widget != nullptr;
     if (widget) {
@@ -442,9 +573,9 @@ MarkdownFoldingProvider::applyPreviewAutoFold(const QVector<PreviewedRange> &p_w
     if (decision.m_settle) {
       // Re-resolved rather than remembered: the fold above may have taken a
       // reentrant path which rebuilt or cleared the table.
-      auto it = m_entries.find(decision.m_key);
-      if (it != m_entries.end() && it.value().m_id == decision.m_id) {
-        it.value().m_autoFoldDecided = true;
+      const int idx = findEntry(decision.m_key, decision.m_id);
+      if (idx > -1) {
+        m_entries[idx].m_autoFoldDecided = true;
       }
     }
 
@@ -490,14 +621,14 @@ bool MarkdownFoldingProvider::tryRegionFolded(PreviewElementType p_type, int p_s
 
   // Walk the entries and resolve each id, so the answer does not depend on the
   // keys still being current.
-  for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
-    if (it.value().m_type != regionType) {
+  for (const auto &entry : m_entries) {
+    if (entry.m_type != regionType) {
       continue;
     }
 
     int first = 0;
     int last = 0;
-    if (!m_textFolding->foldingRangeBlocks(it.value().m_id, &first, &last)) {
+    if (!m_textFolding->foldingRangeBlocks(entry.m_id, &first, &last)) {
       continue;
     }
 
@@ -506,7 +637,7 @@ bool MarkdownFoldingProvider::tryRegionFolded(PreviewElementType p_type, int p_s
     }
 
     if (p_folded) {
-      *p_folded = m_textFolding->isRangeFolded(it.value().m_id);
+      *p_folded = m_textFolding->isRangeFolded(entry.m_id);
     }
     return true;
   }
@@ -516,23 +647,38 @@ bool MarkdownFoldingProvider::tryRegionFolded(PreviewElementType p_type, int p_s
 
 void MarkdownFoldingProvider::rekeyEntriesByLiveExtent()
 {
-  QHash<QPair<int, int>, Entry> rekeyed;
-  rekeyed.reserve(m_entries.size());
-  for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
-    int first = 0;
-    int last = 0;
-    if (!m_textFolding->foldingRangeBlocks(it.value().m_id, &first, &last)) {
+  // The live extents already account for every edit so far.
+  m_editedSpan = EditedSpan();
+
+  int kept = 0;
+  for (int i = 0; i < m_entries.size(); ++i) {
+    auto entry = m_entries[i];
+    if (!m_textFolding->foldingRangeBlocks(entry.m_id, &entry.m_first, &entry.m_last)) {
       // Dead range: the entry describes nothing, and TextFolding has already
       // dropped it, so forgetting it leaks nothing.
       continue;
     }
 
-    // Two live ranges can never share an extent, so this cannot evict a live
-    // entry.
-    rekeyed.insert(qMakePair(first, last), it.value());
+    m_entries[kept++] = entry;
   }
+  m_entries.resize(kept);
 
-  m_entries = rekeyed;
+  // Blocks keep their order across edits, so this is a no-op unless an entry
+  // was stale.
+  std::sort(m_entries.begin(), m_entries.end(),
+            [](const Entry &p_a, const Entry &p_b) { return p_a.m_first < p_b.m_first; });
+}
+
+int MarkdownFoldingProvider::findEntry(int p_first, qint64 p_id) const
+{
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), p_first,
+                             [](const Entry &p_entry, int p_val) {
+                               return p_entry.m_first < p_val;
+                             });
+  if (it != m_entries.end() && it->m_first == p_first && it->m_id == p_id) {
+    return static_cast<int>(it - m_entries.begin());
+  }
+  return -1;
 }
 
 bool MarkdownFoldingProvider::restoreFoldedRange(PreviewElementType p_type, int p_startBlock,
@@ -573,14 +719,20 @@ bool MarkdownFoldingProvider::restoreFoldedRange(PreviewElementType p_type, int
   // Already settled: this is not a new initial decision, it is the state the
   // element carried into the rewrite.
   entry.m_autoFoldDecided = true;
-
-  // The keys still describe where each region sat at the last reconciliation,
-  // and the rewrite has just moved everything below it. Canonicalising them
-  // first is what makes the insert below unable to evict a live entry: after
-  // it, a key collision would mean another live range with exactly this
-  // extent, which newFoldingRange() would have refused.
+  entry.m_first = p_startBlock;
+  entry.m_last = p_endBlock;
+
+  // The entries still describe where each region sat at the last
+  // reconciliation, and the rewrite has just moved everything below it.
+  // Canonicalising them first is what keeps the insert below in order: after
+  // it, another entry starting on this block would mean another live range
+  // starting there, which newFoldingRange() would have refused.
   rekeyEntriesByLiveExtent();
-  m_entries.insert(qMakePair(p_startBlock, p_endBlock), entry);
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), p_startBlock,
+                             [](const Entry &p_entry, int p_val) {
+                               return p_entry.m_first < p_val;
+                             });
+  m_entries.insert(it, entry);
   return true;
 }
 
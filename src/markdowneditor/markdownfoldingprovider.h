@@ -1,7 +1,7 @@
 #ifndef MARKDOWNFOLDINGPROVIDER_H
 #define MARKDOWNFOLDINGPROVIDER_H
 
-#include <QHash>
+#include <QMetaObject>
 #include <QPair>
 #include <QVector>
 
@@ -41,10 +41,28 @@ struct PreviewedRange {
 
 class MarkdownFoldingProvider {
 public:
+  // What one updateFoldingRegions() did to the ranges.
+  struct Diff {
+    int m_added = 0;
+
+    int m_removed = 0;
+
+    // Entries carried over to new block numbers by the edits since the
+    // previous reconciliation. Moving needs no TextFolding call.
+    int m_moved = 0;
+  };
+
   MarkdownFoldingProvider(TextFolding *p_textFolding, QTextDocument *p_document);
 
+  ~MarkdownFoldingProvider();
+
+  // Reconcile the ranges with a parse: a merge of the sorted regions against
+  // the sorted entries, after shifting the entries by the edits made since the
+  // previous parse. Only added and removed regions reach TextFolding.
   void updateFoldingRegions(const QVector<md::FoldingRegion> &p_regions);
 
+  const Diff &lastDiff() const;
+
   void clear();
 
   void resetState();
@@ -85,21 +103,61 @@ private:
 
     // Whether the initial state of *this range* has already been settled.
     bool m_autoFoldDecided = false;
+
+    // Extent of the region as of the last reconciliation.
+    int m_first = 0;
+
+    int m_last = 0;
+  };
+
+  // Blocks touched by the edits since the last reconciliation, merged into one
+  // span. An entry lying before it has not moved and one lying after it has
+  // only moved by m_lastAfterEdit - m_lastBeforeEdit blocks; only the entries
+  // intersecting it have to ask TextFolding where their range went.
+  struct EditedSpan {
+    bool intersects(int p_first, int p_last) const;
+
+    bool m_valid = false;
+
+    int m_first = 0;
+
+    // Last block of the span before and after the edits.
+    int m_lastBeforeEdit = 0;
+
+    int m_lastAfterEdit = 0;
   };
 
+  void recordEdit(int p_position, int p_charsAdded);
+
+  // Bring the extents of the entries up to date with m_editedSpan and drop the
+  // entries whose range is gone.
+  void shiftEntriesByEdits();
+
   // Re-key every entry by the live extent of its range, dropping the entries
   // whose range is gone.
   void rekeyEntriesByLiveExtent();
 
+  // Index in m_entries of the entry keyed on @p_first holding @p_id, or -1.
+  int findEntry(int p_first, qint64 p_id) const;
+
   TextFolding *m_textFolding = nullptr;
 
   QTextDocument *m_document = nullptr;
 
-  // Keyed by the region's (startBlock, endBlock) as of the last
-  // reconciliation. The keys are only a starting point for matching: every
-  // lookup which has to be exact resolves the range's *live* extent through
-  // TextFolding instead.
-  QHash<QPair<int, int>, Entry> m_entries;
+  // Sorted by m_first. The extents are only a starting point for matching:
+  // every lookup which has to be exact resolves the range's *live* extent
+  // through TextFolding instead.
+  QVector<Entry> m_entries;
+
+  EditedSpan m_editedSpan;
+
+  int m_blockCount = 0;
+
+  int m_revision = 0;
+
+  QMetaObject::Connection m_contentsChangeConnection;
+
+  Diff m_lastDiff;
 
   bool m_autoFoldEnabled = true;
 };
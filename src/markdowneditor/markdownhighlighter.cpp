@@ -5,8 +5,6 @@
 #include <QTextDocument>
 #include <QTimer>
 
-#include <spellcheck/spellcheckhighlighthelper.h>
-#include <texteditor/blockspellcheckdata.h>
 #include <vtextedit/previewdata.h>
 #include <vtextedit/textblockdata.h>
 #include <vtextedit/texteditutils.h>
@@ -21,6 +19,7 @@
 #include "markdownparser.h"
 #include "markdownsyntaxstyles.h"
 #include "mathblockhighlighter.h"
+#include "previewsnapshotcache.h"
 
 // Extension flags (replacing pmh_EXT_* constants).
 // These are kept for config compatibility but cmark enables all extensions by default.
@@ -194,22 +193,18 @@ void MarkdownHighlighter::highlightBlock(const QString &p_text) {
   }
 
   // Do spell check.
-  const bool needSpellCheck = cstate != md::HighlightBlockState::CodeBlockStart &&
-                              cstate != md::HighlightBlockState::CodeBlock &&
-                              cstate != md::HighlightBlockState::CodeBlockEnd;
-  if (needSpellCheck && !p_text.isEmpty() && m_spellCheckEnabled) {
-    auto data = TextBlockData::get(block);
-    bool ret = SpellCheckHighlightHelper::checkBlock(block, p_text, m_autoDetectLanguageEnabled);
-    if (ret) {
-      // Further check and highlight.
-      auto spellData = data->getBlockSpellCheckData();
-      if (spellData && spellData->isValid(block.revision()) && !spellData->isEmpty()) {
-        VSyntaxHighlighter::highlightMisspell(spellData);
-      }
-    }
+  if (!p_text.isEmpty() && m_spellCheckEnabled && isSpellCheckNeeded(block)) {
+    spellCheckCurrentBlock(p_text);
   }
 }
 
+bool MarkdownHighlighter::isSpellCheckNeeded(const QTextBlock &p_block) const {
+  const int state = p_block.userState();
+  return state != md::HighlightBlockState::CodeBlockStart &&
+         state != md::HighlightBlockState::CodeBlock &&
+         state != md::HighlightBlockState::CodeBlockEnd;
+}
+
 static bool containSpecialChar(const QString &p_str) {
   Q_ASSERT(!p_str.isEmpty());
   QChar fi = p_str[0];
@@ -792,6 +787,17 @@ bool MarkdownHighlighter::isEmptyCodeBlockHighlights(
   return empty;
 }
 
+// The snapshots of the last generation, as a child object because this class
+// is exported and must not grow a data member.
+static PreviewSnapshotCache *snapshotCache(MarkdownHighlighter *p_highlighter) {
+  auto cache =
+      p_highlighter->findChild<PreviewSnapshotCache *>(QString(), Qt::FindDirectChildrenOnly);
+  if (!cache) {
+    cache = new PreviewSnapshotCache(p_highlighter);
+  }
+  return cache;
+}
+
 void MarkdownHighlighter::completeHighlight(QSharedPointer<MarkdownHighlighterResult> p_result) {
   m_notifyHighlightComplete = true;
 
@@ -817,7 +823,8 @@ void MarkdownHighlighter::completeHighlight(QSharedPointer<MarkdownHighlighterRe
   const QVariant maskValue = property(InteractivePreviewHost::c_enabledTypeMaskProperty);
   const int typeMask = maskValue.isValid() ? maskValue.toInt() : 0;
   emit previewElementsUpdated(static_cast<quint64>(p_result->m_timeStamp),
-                              p_result->buildPreviews(document(), typeMask, m_styles));
+                              p_result->buildPreviews(document(), typeMask, m_styles,
+                                                      snapshotCache(this)));
 }
 
 bool MarkdownHighlighter::isMathEnabled() const { return m_parserExts & EXT_MATH; }
@@ -838,7 +845,8 @@ void MarkdownHighlighter::republishPreviewElements() {
   // Deliberately not completeHighlight(): that republishes unrelated regions
   // and mutates m_notifyHighlightComplete.
   emit previewElementsUpdated(static_cast<quint64>(m_result->m_timeStamp),
-                              m_result->buildPreviews(document(), typeMask, m_styles));
+                              m_result->buildPreviews(document(), typeMask, m_styles,
+                                                      snapshotCache(this)));
 }
 
 void MarkdownHighlighter::rehighlightSensitiveBlocks() {
@@ -2,8 +2,8 @@
 
 #include "foldingregionutils.h"
 #include "previewbuilder.h"
-#include "previewfromast.h"
 #include "previewlogging.h"
+#include "previewsnapshotcache.h"
 
 #include <QDebug>
 #include <QRegularExpression>
@@ -68,13 +68,17 @@ MarkdownHighlighterResult::MarkdownHighlighterResult(
 
 QVector<QSharedPointer<const Preview>>
 MarkdownHighlighterResult::buildPreviews(const QTextDocument *p_doc, int p_typeMask,
-                                         const QVector<QTextCharFormat> &p_styles) const {
+                                         const QVector<QTextCharFormat> &p_styles,
+                                         PreviewSnapshotCache *p_cache) const {
   QVector<QSharedPointer<const Preview>> previews;
   if (!p_doc || p_typeMask == 0) {
     // The host publishes an empty mask when the feature is off or when no
     // registered factory claims any type, and then no snapshot work is done.
     qCDebug(previewSnapshotLog) << "no snapshots requested - document" << (p_doc != nullptr)
                                 << "typeMask" << p_typeMask;
+    if (p_cache) {
+      p_cache->clear();
+    }
     return previews;
   }
 
@@ -88,6 +92,11 @@ MarkdownHighlighterResult::buildPreviews(const QTextDocument *p_doc, int p_typeM
     return previewSourceText(p_doc, p_start, p_end);
   };
 
+  // Without a cache of the previous generation every snapshot is built anew.
+  PreviewSnapshotCache localCache;
+  auto cache = p_cache ? p_cache : &localCache;
+  cache->beginGeneration(p_styles);
+
   if (typeEnabled(PreviewElementType::Image)) {
     for (const auto &image : m_imageElements) {
       const auto source = sourceOf(image.m_startPos, image.m_endPos);
@@ -96,11 +105,7 @@ MarkdownHighlighterResult::buildPreviews(const QTextDocument *p_doc, int p_typeM
                                     << image.m_startPos << "," << image.m_endPos << ")";
         continue;
       }
-      previews.append(
-          PreviewBuilder::createImage(revision, image.m_startPos, image.m_endPos, source,
-                                      image.m_standalone ? PreviewPlacement::BlockAfterSource
-                                                         : PreviewPlacement::InlineAboveLine,
-                                      image.m_destination, image.m_alternateText, image.m_title));
+      previews.append(cache->image(revision, image, source));
     }
   }
 
@@ -112,8 +117,7 @@ MarkdownHighlighterResult::buildPreviews(const QTextDocument *p_doc, int p_typeM
                                     << code.m_startPos << "," << code.m_endPos << ")";
         continue;
       }
-      previews.append(PreviewBuilder::createCode(revision, code.m_startPos, code.m_endPos, source,
-                                                 code.m_language, code.m_code));
+      previews.append(cache->code(revision, code, source));
     }
   }
 
@@ -125,8 +129,7 @@ MarkdownHighlighterResult::buildPreviews(const QTextDocument *p_doc, int p_typeM
                                     << math.m_startPos << "," << math.m_endPos << ")";
         continue;
       }
-      previews.append(PreviewBuilder::createMath(revision, math.m_startPos, math.m_endPos, source,
-                                                 math.m_expression, math.m_display));
+      previews.append(cache->math(revision, math, source));
     }
   }
 
@@ -139,11 +142,12 @@ MarkdownHighlighterResult::buildPreviews(const QTextDocument *p_doc, int p_typeM
         continue;
       }
 
-      previews.append(
-          createTablePreview(revision, table.m_startPos, table.m_endPos, source, table, p_styles));
+      previews.append(cache->table(revision, table, source));
     }
   }
 
+  cache->endGeneration();
+
   std::sort(previews.begin(), previews.end(),
             [](const QSharedPointer<const Preview> &a, const QSharedPointer<const Preview> &b) {
               if (a->startPos() != b->startPos()) {
@@ -164,7 +168,8 @@ MarkdownHighlighterResult::buildPreviews(const QTextDocument *p_doc, int p_typeM
                                 << counts[2] << "table" << counts[3] << "(source elements: image"
                                 << m_imageElements.size() << "code" << m_codeElements.size()
                                 << "math" << m_mathElements.size() << "table"
-                                << m_tableElements.size() << ")";
+                                << m_tableElements.size() << ") -" << cache->hitCount()
+                                << "reused," << cache->missCount() << "built";
 
     for (const auto &preview : previews) {
       qCDebug(previewSnapshotLog) << "  " << previewTypeName(preview->type()) << "at ["
@@ -15,6 +15,7 @@ class QTextDocument;
 
 namespace vte {
 class MarkdownHighlighter;
+class PreviewSnapshotCache;
 struct ContentsChange;
 
 class MarkdownHighlighterFastResult {
@@ -127,9 +128,12 @@ public:
   // @p_typeMask (bit i corresponds to PreviewElementType value i).
   // @p_styles maps HLUnit::styleIndex to a concrete format and is used to
   // resolve the per-cell syntax runs of table snapshots.
+  // @p_cache holds the snapshots of the previous generation, which unchanged
+  // elements reuse. It may be null.
   QVector<QSharedPointer<const Preview>>
   buildPreviews(const QTextDocument *p_doc, int p_typeMask,
-                const QVector<QTextCharFormat> &p_styles) const;
+                const QVector<QTextCharFormat> &p_styles,
+                PreviewSnapshotCache *p_cache) const;
 
   QVector<md::HLUnitStyle> m_dummyHighlight;
 
@@ -304,3 +304,80 @@ PreviewBuilder::createTable(quint64 p_revision, int p_startPos, int p_endPos,
                      p_startPos, p_endPos, p_source);
   return QSharedPointer<const TablePreview>(new TablePreview(d, tableData));
 }
+
+static PreviewPrivate *relocatedCommon(const PreviewPrivate &p_d, quint64 p_revision,
+                                       int p_startPos, int p_endPos) {
+  auto d = new PreviewPrivate(p_d);
+  d->m_revision = p_revision;
+  d->m_startPos = p_startPos;
+  d->m_endPos = p_endPos;
+  return d;
+}
+
+QSharedPointer<const Preview>
+PreviewBuilder::relocate(const QSharedPointer<const Preview> &p_preview, quint64 p_revision,
+                         int p_startPos, int p_endPos) {
+  Q_ASSERT(p_preview);
+  // Every member is implicitly shared, so the copies below are shallow.
+  switch (p_preview->type()) {
+  case PreviewElementType::Image: {
+    auto image = static_cast<const ImagePreview *>(p_preview.data());
+    return QSharedPointer<const ImagePreview>(
+        new ImagePreview(relocatedCommon(*image->m_d, p_revision, p_startPos, p_endPos),
+                         new ImagePreviewPrivate(*image->m_imageData)));
+  }
+
+  case PreviewElementType::Code: {
+    auto code = static_cast<const CodePreview *>(p_preview.data());
+    return QSharedPointer<const CodePreview>(
+        new CodePreview(relocatedCommon(*code->m_d, p_revision, p_startPos, p_endPos),
+                        new CodePreviewPrivate(*code->m_codeData)));
+  }
+
+  case PreviewElementType::Math: {
+    auto math = static_cast<const MathPreview *>(p_preview.data());
+    return QSharedPointer<const MathPreview>(
+        new MathPreview(relocatedCommon(*math->m_d, p_revision, p_startPos, p_endPos),
+                        new MathPreviewPrivate(*math->m_mathData)));
+  }
+
+  case PreviewElementType::Table: {
+    auto table = static_cast<const TablePreview *>(p_preview.data());
+    return QSharedPointer<const TablePreview>(
+        new TablePreview(relocatedCommon(*table->m_d, p_revision, p_startPos, p_endPos),
+                         new TablePreviewPrivate(*table->m_tableData)));
+  }
+  }
+
+  Q_ASSERT(false);
+  return QSharedPointer<const Preview>();
+}
+
+bool PreviewBuilder::sharesContent(const QSharedPointer<const Preview> &p_a,
+                                   const QSharedPointer<const Preview> &p_b) {
+  if (!p_a || !p_b) {
+    return false;
+  }
+
+  if (p_a == p_b) {
+    return true;
+  }
+
+  if (p_a->type() != p_b->type() || p_a->placement() != p_b->placement()) {
+    return false;
+  }
+
+  // A snapshot is never built with an empty source, and an empty string may
+  // share the static null buffer.
+  const auto &source = p_a->sourceMarkdown();
+  if (source.isEmpty() || source.constData() != p_b->sourceMarkdown().constData()) {
+    return false;
+  }
+
+  if (p_a->type() == PreviewElementType::Table) {
+    const auto &cells = static_cast<const TablePreview *>(p_a.data())->cells();
+    return cells.constData() == static_cast<const TablePreview *>(p_b.data())->cells().constData();
+  }
+
+  return true;
+}
@@ -41,6 +41,17 @@ public:
               const QVector<QString> &p_rowPrefixes, const QString &p_delimiterPrefix,
               const QVector<QVector<QVector<PreviewFormatRun>>> &p_cellFormats);
 
+  // A copy of @p_preview for another parse generation and position. The
+  // source and the typed payload are shared with @p_preview, not rebuilt.
+  static QSharedPointer<const Preview> relocate(const QSharedPointer<const Preview> &p_preview,
+                                                quint64 p_revision, int p_startPos, int p_endPos);
+
+  // Whether @p_a and @p_b were relocated from one snapshot, so that they
+  // describe the same content. Snapshots built from separately extracted
+  // sources never share their source buffer, even for an equal source.
+  static bool sharesContent(const QSharedPointer<const Preview> &p_a,
+                            const QSharedPointer<const Preview> &p_b);
+
 private:
   PreviewBuilder() = delete;
 };
@@ -0,0 +1,85 @@
+#include "previewmeasurecache.h"
+
+#include <QWidget>
+
+using namespace vte;
+
+const int PreviewMeasureCache::c_maxEntries = 4096;
+
+PreviewMeasureCache::PreviewMeasureCache(QObject *p_parent) : QObject(p_parent) {}
+
+bool PreviewMeasureCache::find(const Preview &p_preview, const QObject *p_factory,
+                               const QWidget *p_widget, qreal p_widthBasis, QSizeF *p_size) {
+  auto it = m_entries.constFind(p_preview.sourceMarkdown());
+  if (it != m_entries.constEnd()) {
+    const auto key = makeEntry(p_preview, p_factory, p_widget, p_widthBasis);
+    for (const auto &entry : it.value()) {
+      if (matches(entry, key)) {
+        ++m_hitCount;
+        *p_size = entry.m_size;
+        return true;
+      }
+    }
+  }
+
+  ++m_missCount;
+  return false;
+}
+
+void PreviewMeasureCache::insert(const Preview &p_preview, const QObject *p_factory,
+                                 const QWidget *p_widget, qreal p_widthBasis,
+                                 const QSizeF &p_size) {
+  // Resizing the window through every width would otherwise grow it without
+  // bound. Starting over costs one measurement per widget.
+  if (m_size >= c_maxEntries) {
+    clear();
+  }
+
+  auto entry = makeEntry(p_preview, p_factory, p_widget, p_widthBasis);
+  entry.m_size = p_size;
+
+  auto &bucket = m_entries[p_preview.sourceMarkdown()];
+  for (auto &existing : bucket) {
+    if (matches(existing, entry)) {
+      existing.m_size = p_size;
+      return;
+    }
+  }
+
+  bucket.append(entry);
+  ++m_size;
+}
+
+void PreviewMeasureCache::clear() {
+  m_entries.clear();
+  m_size = 0;
+}
+
+int PreviewMeasureCache::size() const { return m_size; }
+
+int PreviewMeasureCache::hitCount() const { return m_hitCount; }
+
+int PreviewMeasureCache::missCount() const { return m_missCount; }
+
+PreviewMeasureCache::Entry PreviewMeasureCache::makeEntry(const Preview &p_preview,
+                                                          const QObject *p_factory,
+                                                          const QWidget *p_widget,
+                                                          qreal p_widthBasis) {
+  Entry entry;
+  entry.m_type = p_preview.type();
+  entry.m_placement = p_preview.placement();
+  entry.m_factory = p_factory;
+  entry.m_widgetClass = p_widget->metaObject();
+  // Widgets are laid out at whole pixels.
+  entry.m_widthBasis = qRound(p_widthBasis);
+  entry.m_font = p_widget->font();
+  entry.m_paletteKey = p_widget->palette().cacheKey();
+  return entry;
+}
+
+bool PreviewMeasureCache::matches(const Entry &p_a, const Entry &p_b) {
+  return p_a.m_type == p_b.m_type && p_a.m_placement == p_b.m_placement &&
+         p_a.m_factory == p_b.m_factory && p_a.m_widgetClass == p_b.m_widgetClass &&
+         p_a.m_widthBasis == p_b.m_widthBasis && p_a.m_paletteKey == p_b.m_paletteKey &&
+         p_a.m_font == p_b.m_font;
+}
@@ -0,0 +1,83 @@
+#ifndef PREVIEWMEASURECACHE_H
+#define PREVIEWMEASURECACHE_H
+
+#include <QFont>
+#include <QHash>
+#include <QObject>
+#include <QSizeF>
+#include <QVector>
+
+#include <vtextedit/preview.h>
+
+class QWidget;
+
+namespace vte {
+// Preferred sizes of preview widgets, keyed by the snapshot content and by
+// everything else a measurement depends on: the factory and class of the
+// widget, the width basis, the font and the palette. Shared by every widget
+// of one host, so two equal tables, a rebuilt widget or a width the window is
+// resized back to are measured once.
+// The interactive preview host owns one as a direct child.
+class PreviewMeasureCache : public QObject {
+  Q_OBJECT
+public:
+  explicit PreviewMeasureCache(QObject *p_parent = nullptr);
+
+  // The size @p_widget, created by @p_factory, measured for @p_preview at
+  // @p_widthBasis.
+  bool find(const Preview &p_preview, const QObject *p_factory, const QWidget *p_widget,
+            qreal p_widthBasis, QSizeF *p_size);
+
+  void insert(const Preview &p_preview, const QObject *p_factory, const QWidget *p_widget,
+              qreal p_widthBasis, const QSizeF &p_size);
+
+  // A factory may configure the widgets it creates, so entries are only valid
+  // for the factory set they were measured under.
+  void clear();
+
+  int size() const;
+
+  int hitCount() const;
+
+  int missCount() const;
+
+  // Entries beyond which the cache starts over.
+  static const int c_maxEntries;
+
+private:
+  struct Entry {
+    PreviewElementType m_type = PreviewElementType::Image;
+
+    PreviewPlacement m_placement = PreviewPlacement::BlockAfterSource;
+
+    const QObject *m_factory = nullptr;
+
+    const QMetaObject *m_widgetClass = nullptr;
+
+    int m_widthBasis = -1;
+
+    QFont m_font;
+
+    qint64 m_paletteKey = 0;
+
+    QSizeF m_size;
+  };
+
+  static Entry makeEntry(const Preview &p_preview, const QObject *p_factory,
+                         const QWidget *p_widget, qreal p_widthBasis);
+
+  static bool matches(const Entry &p_a, const Entry &p_b);
+
+  // Keyed by the source, which decides the content of a snapshot. Equal
+  // sources measured for other widths or fonts share one bucket.
+  QHash<QString, QVector<Entry>> m_entries;
+
+  int m_size = 0;
+
+  int m_hitCount = 0;
+
+  int m_missCount = 0;
+};
+} // namespace vte
+
+#endif // PREVIEWMEASURECACHE_H
@@ -0,0 +1,157 @@
+#include "previewsnapshotcache.h"
+
+#include "previewbuilder.h"
+#include "previewfromast.h"
+
+using namespace vte;
+
+PreviewSnapshotCache::PreviewSnapshotCache(QObject *p_parent) : QObject(p_parent) {}
+
+void PreviewSnapshotCache::beginGeneration(const QVector<QTextCharFormat> &p_styles) {
+  if (m_styles != p_styles) {
+    clear();
+    m_styles = p_styles;
+  }
+
+  m_hitCount = 0;
+  m_missCount = 0;
+}
+
+void PreviewSnapshotCache::endGeneration() {
+  for (int i = 0; i < c_previewElementTypeCount; ++i) {
+    m_entries[i].swap(m_used[i]);
+    m_used[i].clear();
+  }
+}
+
+void PreviewSnapshotCache::clear() {
+  for (int i = 0; i < c_previewElementTypeCount; ++i) {
+    m_entries[i].clear();
+    m_used[i].clear();
+  }
+}
+
+int PreviewSnapshotCache::hitCount() const { return m_hitCount; }
+
+int PreviewSnapshotCache::missCount() const { return m_missCount; }
+
+const PreviewSnapshotCache::Entry *PreviewSnapshotCache::find(PreviewElementType p_type,
+                                                               const QString &p_source) const {
+  const int type = static_cast<int>(p_type);
+  auto it = m_used[type].constFind(p_source);
+  if (it != m_used[type].constEnd()) {
+    return &it.value();
+  }
+
+  it = m_entries[type].constFind(p_source);
+  if (it != m_entries[type].constEnd()) {
+    return &it.value();
+  }
+
+  return nullptr;
+}
+
+QSharedPointer<const Preview> PreviewSnapshotCache::reuse(const Entry &p_entry,
+                                                          quint64 p_revision,
+                                                          const md::TypedPreviewElement &p_element,
+                                                          const QString &p_source) {
+  ++m_hitCount;
+  m_used[static_cast<int>(p_entry.m_preview->type())].insert(p_source, p_entry);
+  return PreviewBuilder::relocate(p_entry.m_preview, p_revision, p_element.m_startPos,
+                                  p_element.m_endPos);
+}
+
+QSharedPointer<const Preview> PreviewSnapshotCache::add(Entry p_entry, const QString &p_source) {
+  ++m_missCount;
+  auto preview = p_entry.m_preview;
+  m_used[static_cast<int>(preview->type())].insert(p_source, std::move(p_entry));
+  return preview;
+}
+
+QSharedPointer<const Preview> PreviewSnapshotCache::image(quint64 p_revision,
+                                                          const md::ImageElement &p_element,
+                                                          const QString &p_source) {
+  const auto placement = p_element.m_standalone ? PreviewPlacement::BlockAfterSource
+                                                : PreviewPlacement::InlineAboveLine;
+  // A reference image resolves its destination from a definition elsewhere.
+  const auto entry = find(PreviewElementType::Image, p_source);
+  if (entry) {
+    auto cached = entry->m_preview.staticCast<const ImagePreview>();
+    if (cached->placement() == placement && cached->destination() == p_element.m_destination &&
+        cached->alternateText() == p_element.m_alternateText &&
+        cached->title() == p_element.m_title) {
+      return reuse(*entry, p_revision, p_element, p_source);
+    }
+  }
+
+  Entry added;
+  added.m_preview =
+      PreviewBuilder::createImage(p_revision, p_element.m_startPos, p_element.m_endPos, p_source,
+                                  placement, p_element.m_destination, p_element.m_alternateText,
+                                  p_element.m_title);
+  return add(added, p_source);
+}
+
+QSharedPointer<const Preview> PreviewSnapshotCache::code(quint64 p_revision,
+                                                         const md::CodeElement &p_element,
+                                                         const QString &p_source) {
+  const auto entry = find(PreviewElementType::Code, p_source);
+  if (entry) {
+    auto cached = entry->m_preview.staticCast<const CodePreview>();
+    if (cached->language() == p_element.m_language && cached->code() == p_element.m_code) {
+      return reuse(*entry, p_revision, p_element, p_source);
+    }
+  }
+
+  Entry added;
+  added.m_preview =
+      PreviewBuilder::createCode(p_revision, p_element.m_startPos, p_element.m_endPos, p_source,
+                                 p_element.m_language, p_element.m_code);
+  return add(added, p_source);
+}
+
+QSharedPointer<const Preview> PreviewSnapshotCache::math(quint64 p_revision,
+                                                         const md::MathElement &p_element,
+                                                         const QString &p_source) {
+  const auto entry = find(PreviewElementType::Math, p_source);
+  if (entry) {
+    auto cached = entry->m_preview.staticCast<const MathPreview>();
+    if (cached->isDisplayMath() == p_element.m_display &&
+        cached->expression() == p_element.m_expression) {
+      return reuse(*entry, p_revision, p_element, p_source);
+    }
+  }
+
+  Entry added;
+  added.m_preview =
+      PreviewBuilder::createMath(p_revision, p_element.m_startPos, p_element.m_endPos, p_source,
+                                 p_element.m_expression, p_element.m_display);
+  return add(added, p_source);
+}
+
+QSharedPointer<const Preview> PreviewSnapshotCache::table(quint64 p_revision,
+                                                          const md::TableElement &p_element,
+                                                          const QString &p_source) {
+  // The cells, the prefixes and the alignments are all taken from the source.
+  auto highlights = cellHighlights(p_element);
+  const auto entry = find(PreviewElementType::Table, p_source);
+  if (entry && entry->m_cellHighlights == highlights) {
+    return reuse(*entry, p_revision, p_element, p_source);
+  }
+
+  Entry added;
+  added.m_preview = createTablePreview(p_revision, p_element.m_startPos, p_element.m_endPos,
+                                       p_source, p_element, m_styles);
+  added.m_cellHighlights = std::move(highlights);
+  return add(added, p_source);
+}
+
+QVector<QVector<QVector<md::HLUnit>>>
+PreviewSnapshotCache::cellHighlights(const md::TableElement &p_element) {
+  QVector<QVector<QVector<md::HLUnit>>> highlights;
+  highlights.reserve(p_element.m_rows.size());
+  for (const auto &row : p_element.m_rows) {
+    highlights.append(row.m_cellHighlights);
+  }
+  return highlights;
+}
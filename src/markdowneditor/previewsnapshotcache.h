@@ -0,0 +1,84 @@
+#ifndef PREVIEWSNAPSHOTCACHE_H
+#define PREVIEWSNAPSHOTCACHE_H
+
+#include <QHash>
+#include <QObject>
+#include <QTextCharFormat>
+#include <QVector>
+
+#include <vtextedit/preview.h>
+
+#include "markdownastwalker.h"
+
+namespace vte {
+// Snapshots of the previous parse generation, keyed by element type and
+// source text. An element whose source and parsed data did not change gets a
+// relocated copy of its previous snapshot instead of being converted again,
+// so PreviewBuilder::sharesContent() tells the host what did not change.
+// The highlighter owns one as a direct child.
+class PreviewSnapshotCache : public QObject {
+  Q_OBJECT
+public:
+  explicit PreviewSnapshotCache(QObject *p_parent = nullptr);
+
+  // Start a generation whose table snapshots resolve their cell runs with
+  // @p_styles. Other styles than the last generation's drop every entry.
+  void beginGeneration(const QVector<QTextCharFormat> &p_styles);
+
+  // Keep only the entries the generation asked for.
+  void endGeneration();
+
+  void clear();
+
+  QSharedPointer<const Preview> image(quint64 p_revision, const md::ImageElement &p_element,
+                                      const QString &p_source);
+
+  QSharedPointer<const Preview> code(quint64 p_revision, const md::CodeElement &p_element,
+                                     const QString &p_source);
+
+  QSharedPointer<const Preview> math(quint64 p_revision, const md::MathElement &p_element,
+                                     const QString &p_source);
+
+  QSharedPointer<const Preview> table(quint64 p_revision, const md::TableElement &p_element,
+                                      const QString &p_source);
+
+  // Snapshots reused and built since beginGeneration().
+  int hitCount() const;
+
+  int missCount() const;
+
+private:
+  struct Entry {
+    QSharedPointer<const Preview> m_preview;
+
+    // Tables only. The cell runs depend on the highlight units, which the
+    // source alone does not decide, such as a link to a reference defined
+    // elsewhere.
+    QVector<QVector<QVector<md::HLUnit>>> m_cellHighlights;
+  };
+
+  // The entry of @p_source, from this generation or the previous one.
+  const Entry *find(PreviewElementType p_type, const QString &p_source) const;
+
+  QSharedPointer<const Preview> reuse(const Entry &p_entry, quint64 p_revision,
+                                      const md::TypedPreviewElement &p_element,
+                                      const QString &p_source);
+
+  QSharedPointer<const Preview> add(Entry p_entry, const QString &p_source);
+
+  static QVector<QVector<QVector<md::HLUnit>>> cellHighlights(const md::TableElement &p_element);
+
+  QVector<QTextCharFormat> m_styles;
+
+  // Indexed by PreviewElementType.
+  QHash<QString, Entry> m_entries[c_previewElementTypeCount];
+
+  QHash<QString, Entry> m_used[c_previewElementTypeCount];
+
+  int m_hitCount = 0;
+
+  int m_missCount = 0;
+};
+} // namespace vte
+
+#endif // PREVIEWSNAPSHOTCACHE_H
@@ -35,6 +35,8 @@ PreviewWidgetContext::~PreviewWidgetContext() {}
 
 quint64 PreviewWidgetContext::identity() const { return m_d->m_identity; }
 
+void PreviewWidgetContext::setIdentity(quint64 p_identity) { m_d->m_identity = p_identity; }
+
 QSharedPointer<const Preview> PreviewWidgetContext::preview() const { return m_d->m_preview; }
 
 QRectF PreviewWidgetContext::sourceTextRect() const { return m_d->m_sourceTextRect; }
@@ -11,11 +11,14 @@
 #include <QGuiApplication>
 #include <QInputMethod>
 #include <QKeyEvent>
+#include <QLineEdit>
 #include <QMenu>
 #include <QMimeData>
 #include <QMouseEvent>
+#include <QPainter>
 #include <QPalette>
 #include <QScopedValueRollback>
+#include <QScrollBar>
 #include <QStringList>
 #include <QTextBlock>
 #include <QTextBlockFormat>
@@ -31,6 +34,7 @@
 #include <QWheelEvent>
 #include <QtMath>
 
+#include <algorithm>
 #include <cstdlib>
 #include <functional>
 #include <memory>
@@ -2030,6 +2034,808 @@ void TablePreviewSheet::insertFromMimeData(const QMimeData *p_source) {
   insertPlainText(sanitizeForCell(text));
 }
 
+// ---------------------------------------------------------------------------
+// TablePreviewGrid
+// ---------------------------------------------------------------------------
+
+// See the header.
+const int TablePreviewGrid::c_maxCells = 200000;
+
+const int TablePreviewGrid::c_sampleRows = 64;
+
+const int TablePreviewGrid::c_maxVisibleLines = 20;
+
+namespace {
+// Bounds of a measured column width, in average character widths.
+const int c_gridMinColumnChars = 3;
+
+const int c_gridMaxColumnChars = 40;
+
+// As the sheet's document: a long token breaks anywhere rather than overflow.
+const int c_gridTextFlags = Qt::TextWordWrap | Qt::TextWrapAnywhere;
+
+Qt::Alignment gridAlignment(PreviewTableAlignment p_alignment) {
+  switch (p_alignment) {
+  case PreviewTableAlignment::Center:
+    return Qt::AlignHCenter;
+  case PreviewTableAlignment::Right:
+    return Qt::AlignRight;
+  default:
+    return Qt::AlignLeft;
+  }
+}
+} // namespace
+
+bool TablePreviewGrid::isWithinLimits(const TablePreview &p_table) {
+  return TablePreviewDocument::normalizedColumnCount(p_table) <=
+             TablePreviewDocument::c_maxColumns &&
+         TablePreviewDocument::normalizedCellCount(p_table) <= c_maxCells;
+}
+
+TablePreviewGrid::TablePreviewGrid(QWidget *p_parent) : QAbstractScrollArea(p_parent) {
+  setFrameShape(QFrame::NoFrame);
+  setFocusPolicy(Qt::StrongFocus);
+  setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+  setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+  // The band behind it is the editor's, as for the sheet.
+  viewport()->setAutoFillBackground(false);
+
+  m_editor = new QLineEdit(viewport());
+  m_editor->setFrame(false);
+  m_editor->hide();
+  m_editor->installEventFilter(this);
+
+  relayout();
+}
+
+int TablePreviewGrid::rowCount() const { return m_cells.size(); }
+
+int TablePreviewGrid::columnCount() const { return m_columnCount; }
+
+const QVector<QVector<QString>> &TablePreviewGrid::cells() const { return m_cells; }
+
+void TablePreviewGrid::setTable(const QSharedPointer<const TablePreview> &p_table) {
+  cancelEdit();
+
+  m_table = p_table;
+  if (p_table) {
+    m_cells = p_table->cells();
+    m_alignments = p_table->alignments();
+    m_rowPrefixes = p_table->rowPrefixes();
+    m_delimiterPrefix = p_table->delimiterPrefix();
+    m_declaredColumnCount = p_table->columnCount();
+  } else {
+    m_cells.clear();
+    m_alignments.clear();
+    m_rowPrefixes.clear();
+    m_delimiterPrefix.clear();
+    m_declaredColumnCount = 0;
+  }
+
+  m_columnCount = m_alignments.size();
+  for (const auto &row : m_cells) {
+    m_columnCount = qMax(m_columnCount, row.size());
+  }
+
+  for (auto &row : m_cells) {
+    while (row.size() < m_columnCount) {
+      row.append(QString());
+    }
+  }
+
+  while (m_alignments.size() < m_columnCount) {
+    m_alignments.append(PreviewTableAlignment::None);
+  }
+
+  m_currentRow = qBound(0, m_currentRow, qMax(0, rowCount() - 1));
+  m_currentColumn = qBound(0, m_currentColumn, qMax(0, m_columnCount - 1));
+
+  relayout();
+}
+
+bool TablePreviewGrid::setCell(int p_row, int p_column, const QString &p_text) {
+  if (p_row < 0 || p_row >= rowCount() || p_column < 0 || p_column >= m_columnCount) {
+    return false;
+  }
+
+  const QString text = sanitizeForCell(p_text);
+  if (m_cells[p_row][p_column] == text) {
+    return false;
+  }
+
+  m_cells[p_row][p_column] = text;
+
+  // Measured again when next painted.
+  if (m_rowHeights[p_row] >= 0) {
+    addRowHeight(p_row, m_lineHeight - m_rowHeights[p_row]);
+    m_rowHeights[p_row] = -1;
+    --m_measuredRowCount;
+  }
+
+  updateScrollBars();
+  viewport()->update();
+  return true;
+}
+
+bool TablePreviewGrid::isRoundTrippable() const {
+  if (m_cells.isEmpty() || m_declaredColumnCount <= 0) {
+    return false;
+  }
+
+  if (m_columnCount != m_declaredColumnCount) {
+    qCDebug(previewTableLog) << "not round-trippable: a row is wider than the header declares -"
+                             << m_columnCount << "vs" << m_declaredColumnCount;
+    return false;
+  }
+
+  return TablePreviewSerializer::arePrefixesSafe(m_rowPrefixes, m_delimiterPrefix);
+}
+
+QString TablePreviewGrid::toMarkdown() const {
+  if (!isRoundTrippable()) {
+    return QString();
+  }
+
+  return TablePreviewSerializer::serialize(m_cells, m_alignments, m_rowPrefixes,
+                                           m_delimiterPrefix);
+}
+
+void TablePreviewGrid::setReadOnly(bool p_readOnly) {
+  m_readOnly = p_readOnly;
+  if (m_readOnly) {
+    // Whatever was typed could no longer be written back.
+    cancelEdit();
+  }
+}
+
+bool TablePreviewGrid::isReadOnly() const { return m_readOnly; }
+
+int TablePreviewGrid::currentRow() const { return m_currentRow; }
+
+int TablePreviewGrid::currentColumn() const { return m_currentColumn; }
+
+void TablePreviewGrid::setCurrentCell(int p_row, int p_column) {
+  if (m_cells.isEmpty()) {
+    return;
+  }
+
+  m_currentRow = qBound(0, p_row, rowCount() - 1);
+  m_currentColumn = qBound(0, p_column, m_columnCount - 1);
+  scrollToCell(m_currentRow, m_currentColumn);
+  viewport()->update();
+}
+
+void TablePreviewGrid::moveCurrentCell(int p_row, int p_column) {
+  const int row = m_currentRow;
+  const int column = m_currentColumn;
+  setCurrentCell(p_row, p_column);
+  if (row != m_currentRow || column != m_currentColumn) {
+    emit cellLeft();
+  }
+}
+
+bool TablePreviewGrid::editCurrentCell() {
+  if (m_readOnly || m_cells.isEmpty()) {
+    return false;
+  }
+
+  if (isEditing()) {
+    return true;
+  }
+
+  scrollToCell(m_currentRow, m_currentColumn);
+
+  m_editRow = m_currentRow;
+  m_editColumn = m_currentColumn;
+  m_editor->setFont(m_editRow == 0 ? headerFont() : font());
+  m_editor->setAlignment(gridAlignment(m_alignments[m_editColumn]) | Qt::AlignVCenter);
+  m_editor->setText(m_cells[m_editRow][m_editColumn]);
+  placeEditor();
+  m_editor->show();
+  m_editor->setFocus();
+  return true;
+}
+
+void TablePreviewGrid::commitEdit() {
+  if (!isEditing()) {
+    return;
+  }
+
+  const int row = m_editRow;
+  const int column = m_editColumn;
+  const QString text = m_editor->text();
+
+  // Before hiding: that moves the focus, whose focus-out lands here again.
+  m_editRow = -1;
+  m_editColumn = -1;
+  const bool hadFocus = m_editor->hasFocus();
+  m_editor->hide();
+  if (hadFocus) {
+    setFocus();
+  }
+
+  if (setCell(row, column, text)) {
+    emit cellEdited(row, column);
+  }
+}
+
+void TablePreviewGrid::cancelEdit() {
+  if (!isEditing()) {
+    return;
+  }
+
+  m_editRow = -1;
+  m_editColumn = -1;
+  const bool hadFocus = m_editor->hasFocus();
+  m_editor->hide();
+  if (hadFocus) {
+    setFocus();
+  }
+}
+
+bool TablePreviewGrid::isEditing() const { return m_editRow >= 0; }
+
+QRect TablePreviewGrid::cellRect(int p_row, int p_column) const {
+  if (p_row < 0 || p_row >= rowCount() || p_column < 0 || p_column >= m_columnCount) {
+    return QRect();
+  }
+
+  return QRect(m_columnOffsets[p_column] - horizontalScrollBar()->value(),
+               rowTop(p_row) - verticalScrollBar()->value(), m_columnWidths[p_column],
+               rowHeight(p_row));
+}
+
+int TablePreviewGrid::measuredRowCount() const { return m_measuredRowCount; }
+
+QFont TablePreviewGrid::headerFont() const {
+  QFont font = this->font();
+  font.setBold(true);
+  return font;
+}
+
+void TablePreviewGrid::relayout() {
+  const int padding = qCeil(c_cellPadding);
+  // One pixel for the grid line below the row.
+  m_lineHeight = QFontMetrics(headerFont()).height() + 2 * padding + 1;
+
+  measureColumns();
+  resetRowHeights();
+
+  // The rows the grid shows without scrolling, so a table inside the cap gets
+  // its exact height now rather than while it is scrolled.
+  const int cap = c_maxVisibleLines * m_lineHeight;
+  for (int r = 0, top = 0; r < rowCount() && top < cap; ++r) {
+    top += measureRow(r);
+  }
+
+  updateScrollBars();
+  placeEditor();
+  viewport()->update();
+  updateGeometry();
+  emit preferredGeometryChanged();
+}
+
+void TablePreviewGrid::measureColumns() {
+  const QFontMetrics metrics(font());
+  const QFontMetrics headerMetrics(headerFont());
+  const int padding = qCeil(c_cellPadding);
+  const int minWidth = c_gridMinColumnChars * metrics.averageCharWidth();
+  const int maxWidth = c_gridMaxColumnChars * metrics.averageCharWidth();
+
+  m_columnWidths.fill(minWidth, m_columnCount);
+  const int sampled = qMin(rowCount(), c_sampleRows);
+  for (int r = 0; r < sampled; ++r) {
+    const QFontMetrics &rowMetrics = r == 0 ? headerMetrics : metrics;
+    for (int c = 0; c < m_columnCount; ++c) {
+      const QString &text = m_cells[r][c];
+      if (text.isEmpty()) {
+        continue;
+      }
+
+      m_columnWidths[c] =
+          qMax(m_columnWidths[c], qMin(rowMetrics.horizontalAdvance(text), maxWidth));
+    }
+  }
+
+  m_columnOffsets.resize(m_columnCount + 1);
+  int offset = 0;
+  for (int c = 0; c < m_columnCount; ++c) {
+    // Padding on both sides, and the grid line on the right.
+    m_columnWidths[c] += 2 * padding + 1;
+    m_columnOffsets[c] = offset;
+    offset += m_columnWidths[c];
+  }
+  m_columnOffsets[m_columnCount] = offset;
+}
+
+void TablePreviewGrid::resetRowHeights() {
+  const int rows = rowCount();
+  m_rowHeights.fill(-1, rows);
+  m_measuredRowCount = 0;
+
+  // Every row is one line to start with. Built in O(rows) by adding each node
+  // into its parent instead of through rows separate updates.
+  m_heightTree.fill(0, rows + 1);
+  for (int i = 1; i <= rows; ++i) {
+    m_heightTree[i] += m_lineHeight;
+    const int parent = i + (i & -i);
+    if (parent <= rows) {
+      m_heightTree[parent] += m_heightTree[i];
+    }
+  }
+}
+
+int TablePreviewGrid::measureRow(int p_row) {
+  if (m_rowHeights[p_row] >= 0) {
+    return m_rowHeights[p_row];
+  }
+
+  const QFontMetrics metrics(p_row == 0 ? headerFont() : font());
+  const int padding = qCeil(c_cellPadding);
+  int textHeight = metrics.height();
+  for (int c = 0; c < m_columnCount; ++c) {
+    const QString &text = m_cells[p_row][c];
+    const int width = m_columnWidths[c] - 2 * padding - 1;
+    // Most cells fit their column, and a single advance is much cheaper than
+    // laying the text out.
+    if (text.isEmpty() || metrics.horizontalAdvance(text) <= width) {
+      continue;
+    }
+
+    const QRect bounds = metrics.boundingRect(QRect(0, 0, width, 1 << 24), c_gridTextFlags, text);
+    textHeight = qMax(textHeight, bounds.height());
+  }
+
+  const int height = textHeight + 2 * padding + 1;
+  m_rowHeights[p_row] = height;
+  ++m_measuredRowCount;
+  addRowHeight(p_row, height - m_lineHeight);
+  return height;
+}
+
+int TablePreviewGrid::rowHeight(int p_row) const {
+  const int height = m_rowHeights[p_row];
+  return height >= 0 ? height : m_lineHeight;
+}
+
+void TablePreviewGrid::addRowHeight(int p_row, int p_delta) {
+  if (p_delta == 0) {
+    return;
+  }
+
+  for (int i = p_row + 1; i < m_heightTree.size(); i += i & -i) {
+    m_heightTree[i] += p_delta;
+  }
+}
+
+int TablePreviewGrid::rowTop(int p_row) const {
+  int top = 0;
+  for (int i = p_row; i > 0; i -= i & -i) {
+    top += m_heightTree[i];
+  }
+  return top;
+}
+
+int TablePreviewGrid::rowAt(int p_y) const {
+  const int rows = rowCount();
+  if (rows == 0) {
+    return -1;
+  }
+
+  // Descend the tree: the largest prefix of rows whose total stays <= p_y.
+  int step = 1;
+  while (step * 2 <= rows) {
+    step *= 2;
+  }
+
+  int row = 0;
+  int remaining = p_y;
+  for (; step > 0; step /= 2) {
+    const int next = row + step;
+    if (next <= rows && m_heightTree[next] <= remaining) {
+      row = next;
+      remaining -= m_heightTree[next];
+    }
+  }
+
+  return qMin(row, rows - 1);
+}
+
+int TablePreviewGrid::columnAt(int p_x) const {
+  if (m_columnCount == 0) {
+    return -1;
+  }
+
+  auto it = std::upper_bound(m_columnOffsets.constBegin(), m_columnOffsets.constEnd(), p_x);
+  const int column = static_cast<int>(it - m_columnOffsets.constBegin()) - 1;
+  return qBound(0, column, m_columnCount - 1);
+}
+
+int TablePreviewGrid::contentHeight() const { return rowTop(rowCount()); }
+
+int TablePreviewGrid::contentWidth() const {
+  return m_columnOffsets.isEmpty() ? 0 : m_columnOffsets.last();
+}
+
+void TablePreviewGrid::updateScrollBars() {
+  const QSize view = viewport()->size();
+
+  auto vbar = verticalScrollBar();
+  vbar->setSingleStep(m_lineHeight);
+  vbar->setPageStep(view.height());
+  vbar->setRange(0, qMax(0, contentHeight() - view.height()));
+
+  auto hbar = horizontalScrollBar();
+  hbar->setSingleStep(4 * fontMetrics().averageCharWidth());
+  hbar->setPageStep(view.width());
+  hbar->setRange(0, qMax(0, contentWidth() - view.width()));
+}
+
+void TablePreviewGrid::scrollToCell(int p_row, int p_column) {
+  const int height = measureRow(p_row);
+  const int top = rowTop(p_row);
+  auto vbar = verticalScrollBar();
+  // Measuring may have grown the content.
+  updateScrollBars();
+  const int viewHeight = viewport()->height();
+  if (top < vbar->value()) {
+    vbar->setValue(top);
+  } else if (top + height > vbar->value() + viewHeight) {
+    vbar->setValue(top + qMin(height, viewHeight) - viewHeight);
+  }
+
+  const int left = m_columnOffsets[p_column];
+  const int width = m_columnWidths[p_column];
+  auto hbar = horizontalScrollBar();
+  const int viewWidth = viewport()->width();
+  if (left < hbar->value()) {
+    hbar->setValue(left);
+  } else if (left + width > hbar->value() + viewWidth) {
+    hbar->setValue(left + qMin(width, viewWidth) - viewWidth);
+  }
+}
+
+void TablePreviewGrid::placeEditor() {
+  if (!isEditing()) {
+    return;
+  }
+
+  // Inside the grid lines.
+  m_editor->setGeometry(cellRect(m_editRow, m_editColumn).adjusted(0, 0, -1, -1));
+}
+
+void TablePreviewGrid::paintEvent(QPaintEvent *p_event) {
+  if (m_cells.isEmpty() || m_columnCount == 0) {
+    return;
+  }
+
+  QPainter painter(viewport());
+  const QRect exposed = p_event->rect();
+  const int xOffset = horizontalScrollBar()->value();
+  const int yOffset = verticalScrollBar()->value();
+  const int padding = qCeil(c_cellPadding);
+  const int firstColumn = columnAt(xOffset + exposed.left());
+  const int lastColumn = columnAt(xOffset + exposed.right());
+  const QColor gridColor = palette().color(QPalette::Mid);
+  const QColor textColor = palette().color(QPalette::Text);
+  const QFont bodyFont = font();
+  const QFont boldFont = headerFont();
+
+  // Measuring a row only moves the rows below it, so walking down from the
+  // first exposed row paints each one at its final place.
+  int row = rowAt(yOffset + exposed.top());
+  int top = rowTop(row) - yOffset;
+  bool heightsChanged = false;
+  for (; row < rowCount() && top <= exposed.bottom(); ++row) {
+    const bool measured = m_rowHeights[row] >= 0;
+    const int height = measureRow(row);
+    heightsChanged = heightsChanged || (!measured && height != m_lineHeight);
+
+    painter.setFont(row == 0 ? boldFont : bodyFont);
+    for (int c = firstColumn; c <= lastColumn; ++c) {
+      const QRect cell(m_columnOffsets[c] - xOffset, top, m_columnWidths[c], height);
+
+      painter.setPen(gridColor);
+      painter.drawLine(cell.topRight(), cell.bottomRight());
+      painter.drawLine(cell.bottomLeft(), cell.bottomRight());
+      if (row == 0) {
+        painter.drawLine(cell.topLeft(), cell.topRight());
+      }
+      if (c == 0) {
+        painter.drawLine(cell.topLeft(), cell.bottomLeft());
+      }
+
+      painter.setPen(textColor);
+      painter.drawText(cell.adjusted(padding, padding, -padding - 1, -padding - 1),
+                       c_gridTextFlags | gridAlignment(m_alignments[c]) | Qt::AlignTop,
+                       m_cells[row][c]);
+
+      if (row == m_currentRow && c == m_currentColumn && hasFocus()) {
+        painter.setPen(QPen(palette().color(QPalette::Highlight), 2));
+        painter.drawRect(cell.adjusted(1, 1, -1, -1));
+      }
+    }
+
+    top += height;
+  }
+
+  if (heightsChanged) {
+    updateScrollBars();
+    placeEditor();
+  }
+}
+
+void TablePreviewGrid::resizeEvent(QResizeEvent *p_event) {
+  QAbstractScrollArea::resizeEvent(p_event);
+  updateScrollBars();
+  placeEditor();
+}
+
+void TablePreviewGrid::scrollContentsBy(int p_dx, int p_dy) {
+  Q_UNUSED(p_dx);
+  Q_UNUSED(p_dy);
+  placeEditor();
+  viewport()->update();
+}
+
+void TablePreviewGrid::keyPressEvent(QKeyEvent *p_event) {
+  // Relayed as the sheet does: a pending edit has to be written back before
+  // the editor's stack is moved.
+  if (p_event->matches(QKeySequence::Undo)) {
+    emit undoRequested();
+    p_event->accept();
+    return;
+  }
+
+  if (p_event->matches(QKeySequence::Redo)) {
+    emit redoRequested();
+    p_event->accept();
+    return;
+  }
+
+  if (p_event->matches(QKeySequence::Copy)) {
+    if (!m_cells.isEmpty()) {
+      QGuiApplication::clipboard()->setText(m_cells[m_currentRow][m_currentColumn]);
+    }
+    p_event->accept();
+    return;
+  }
+
+  if (m_cells.isEmpty()) {
+    QAbstractScrollArea::keyPressEvent(p_event);
+    return;
+  }
+
+  const Qt::KeyboardModifiers modifiers = p_event->modifiers() & ~Qt::KeypadModifier;
+  const int visibleRows = qMax(1, viewport()->height() / qMax(1, m_lineHeight));
+  switch (p_event->key()) {
+  case Qt::Key_Return:
+  case Qt::Key_Enter:
+  case Qt::Key_F2:
+    if (modifiers == Qt::NoModifier) {
+      editCurrentCell();
+    }
+    p_event->accept();
+    return;
+
+  case Qt::Key_Escape:
+    emit focusEscapeRequested(FocusEscapeDirection::Keep);
+    p_event->accept();
+    return;
+
+  case Qt::Key_Up:
+    if (m_currentRow == 0) {
+      emit focusEscapeRequested(FocusEscapeDirection::Up);
+    } else {
+      moveCurrentCell(m_currentRow - 1, m_currentColumn);
+    }
+    p_event->accept();
+    return;
+
+  case Qt::Key_Down:
+    if (m_currentRow == rowCount() - 1) {
+      emit focusEscapeRequested(FocusEscapeDirection::Down);
+    } else {
+      moveCurrentCell(m_currentRow + 1, m_currentColumn);
+    }
+    p_event->accept();
+    return;
+
+  case Qt::Key_Left:
+    moveCurrentCell(m_currentRow, m_currentColumn - 1);
+    p_event->accept();
+    return;
+
+  case Qt::Key_Right:
+    moveCurrentCell(m_currentRow, m_currentColumn + 1);
+    p_event->accept();
+    return;
+
+  case Qt::Key_PageUp:
+    moveCurrentCell(m_currentRow - visibleRows, m_currentColumn);
+    p_event->accept();
+    return;
+
+  case Qt::Key_PageDown:
+    moveCurrentCell(m_currentRow + visibleRows, m_currentColumn);
+    p_event->accept();
+    return;
+
+  case Qt::Key_Home:
+    moveCurrentCell(modifiers.testFlag(Qt::ControlModifier) ? 0 : m_currentRow, 0);
+    p_event->accept();
+    return;
+
+  case Qt::Key_End:
+    moveCurrentCell(modifiers.testFlag(Qt::ControlModifier) ? rowCount() - 1 : m_currentRow,
+                    m_columnCount - 1);
+    p_event->accept();
+    return;
+
+  case Qt::Key_Tab:
+  case Qt::Key_Backtab: {
+    if (modifiers.testFlag(Qt::ControlModifier)) {
+      break;
+    }
+
+    const int step = p_event->key() == Qt::Key_Tab ? 1 : -1;
+    const int index = m_currentRow * m_columnCount + m_currentColumn + step;
+    if (index >= 0 && index < rowCount() * m_columnCount) {
+      moveCurrentCell(index / m_columnCount, index % m_columnCount);
+    }
+    p_event->accept();
+    return;
+  }
+
+  default:
+    break;
+  }
+
+  // Typing over a cell replaces it, as in any spreadsheet.
+  const QString text = p_event->text();
+  if (!text.isEmpty() && text.at(0).isPrint() &&
+      !(modifiers & (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier))) {
+    if (editCurrentCell()) {
+      m_editor->setText(sanitizeForCell(text));
+    }
+    p_event->accept();
+    return;
+  }
+
+  QAbstractScrollArea::keyPressEvent(p_event);
+}
+
+bool TablePreviewGrid::eventFilter(QObject *p_object, QEvent *p_event) {
+  if (p_object != m_editor) {
+    return QAbstractScrollArea::eventFilter(p_object, p_event);
+  }
+
+  switch (p_event->type()) {
+  case QEvent::KeyPress: {
+    auto event = static_cast<QKeyEvent *>(p_event);
+    if (event->matches(QKeySequence::Undo) || event->matches(QKeySequence::Redo)) {
+      // The line edit's own stack, which only spans this edit.
+      return false;
+    }
+
+    switch (event->key()) {
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+      commitEdit();
+      emit cellLeft();
+      return true;
+
+    case Qt::Key_Escape:
+      cancelEdit();
+      return true;
+
+    case Qt::Key_Tab:
+    case Qt::Key_Backtab:
+    case Qt::Key_Up:
+    case Qt::Key_Down:
+      // Committed, then handled as navigation.
+      commitEdit();
+      keyPressEvent(event);
+      return true;
+
+    default:
+      return false;
+    }
+  }
+
+  case QEvent::FocusOut:
+    // Clicking elsewhere keeps what was typed.
+    if (isEditing()) {
+      commitEdit();
+      emit cellLeft();
+    }
+    return false;
+
+  default:
+    return false;
+  }
+}
+
+void TablePreviewGrid::mousePressEvent(QMouseEvent *p_event) {
+  commitEdit();
+  setFocus(Qt::MouseFocusReason);
+
+  if (m_cells.isEmpty() || p_event->pos().x() + horizontalScrollBar()->value() >= contentWidth() ||
+      p_event->pos().y() + verticalScrollBar()->value() >= contentHeight()) {
+    QAbstractScrollArea::mousePressEvent(p_event);
+    return;
+  }
+
+  moveCurrentCell(rowAt(p_event->pos().y() + verticalScrollBar()->value()),
+                  columnAt(p_event->pos().x() + horizontalScrollBar()->value()));
+  p_event->accept();
+}
+
+void TablePreviewGrid::mouseDoubleClickEvent(QMouseEvent *p_event) {
+  mousePressEvent(p_event);
+  editCurrentCell();
+}
+
+void TablePreviewGrid::wheelEvent(QWheelEvent *p_event) {
+  const QPoint delta = p_event->angleDelta();
+  auto canScroll = [](const QScrollBar *p_bar, int p_delta) {
+    return (p_delta > 0 && p_bar->value() > p_bar->minimum()) ||
+           (p_delta < 0 && p_bar->value() < p_bar->maximum());
+  };
+
+  if (canScroll(verticalScrollBar(), delta.y()) || canScroll(horizontalScrollBar(), delta.x())) {
+    QAbstractScrollArea::wheelEvent(p_event);
+    return;
+  }
+
+  // At either end: the movement is the editor's.
+  p_event->ignore();
+}
+
+void TablePreviewGrid::changeEvent(QEvent *p_event) {
+  QAbstractScrollArea::changeEvent(p_event);
+
+  switch (p_event->type()) {
+  case QEvent::FontChange:
+    relayout();
+    break;
+
+  case QEvent::PaletteChange:
+  case QEvent::StyleChange:
+    viewport()->update();
+    break;
+
+  default:
+    break;
+  }
+}
+
+QSize TablePreviewGrid::sizeHint() const {
+  // Width 0: see TablePreviewSheet::sizeHint().
+  return QSize(0, heightForWidth(0));
+}
+
+QSize TablePreviewGrid::minimumSizeHint() const { return QSize(0, 0); }
+
+bool TablePreviewGrid::hasHeightForWidth() const { return true; }
+
+int TablePreviewGrid::heightForWidth(int p_width) const {
+  const int frame = 2 * frameWidth();
+  const int cap = c_maxVisibleLines * m_lineHeight;
+  const int content = contentHeight();
+  int height = qMin(content, cap) + frame;
+
+  int width = p_width - frame;
+  if (content > cap) {
+    width -= verticalScrollBar()->sizeHint().width();
+  }
+  if (p_width > 0 && contentWidth() > width) {
+    height += horizontalScrollBar()->sizeHint().height();
+  }
+
+  return height;
+}
+
 // ---------------------------------------------------------------------------
 // TablePreviewWidget
 // ---------------------------------------------------------------------------
@@ -2115,16 +2921,16 @@ bool TablePreviewWidget::setPreview(const QSharedPointer<const Preview> &p_previ
     return false;
   }
 
-  // A table too large to lay out interactively is left to the static source
+  // A table too large even for the grid is left to the static source
   // rendering. A refused table never becomes an active item, so the factory
   // chain is re-walked on every parse generation: warning here would repeat
   // forever for a static, by-design condition.
-  if (!TablePreviewDocument::isWithinLimits(*table)) {
+  if (!TablePreviewDocument::isWithinLimits(*table) && !TablePreviewGrid::isWithinLimits(*table)) {
     qCDebug(previewTableLog)
         << "refused an oversized table -" << table->cells().size() << "row(s) x"
         << TablePreviewDocument::normalizedColumnCount(*table) << "column(s) ="
         << TablePreviewDocument::normalizedCellCount(*table) << "cells; limits are"
-        << TablePreviewDocument::c_maxCells << "cells and"
+        << TablePreviewGrid::c_maxCells << "cells and"
         << TablePreviewDocument::c_maxColumns << "columns";
     return false;
   }
@@ -2146,7 +2952,7 @@ bool TablePreviewWidget::setPreview(const QSharedPointer<const Preview> &p_previ
     const char *reason = "identical source";
 
     if (!unchanged) {
-      const QString current = m_document->toMarkdown();
+      const QString current = currentMarkdown();
       unchanged = !current.isEmpty() && current == incoming;
       reason = "the sheet's own contents";
     }
@@ -2203,12 +3009,18 @@ void TablePreviewWidget::applyEditability() {
   // the host would reject, or which could not be written back without changing
   // what the table renders to. Read-only still allows the caret, selection and
   // copy, which the retired NoEditTriggers did not.
-  const bool roundTrippable = m_document->isRoundTrippable();
+  const bool roundTrippable =
+      m_gridMode ? m_grid->isRoundTrippable() : m_document->isRoundTrippable();
   const bool editable = !m_readOnly && roundTrippable && m_authoritative && !m_suppressed;
   qCDebug(previewTableLog) << "sheet is" << (editable ? "editable" : "viewer only")
                            << "- read-only" << m_readOnly << "round-trippable" << roundTrippable
                            << "authoritative" << m_authoritative << "suppressed" << m_suppressed;
 
+  if (m_gridMode) {
+    m_grid->setReadOnly(!editable);
+    return;
+  }
+
   const bool wasReadOnly = m_sheet->isReadOnly();
 
   if (!wasReadOnly && !editable) {
@@ -2245,7 +3057,8 @@ void TablePreviewWidget::rebindFromContext() {
 }
 
 void TablePreviewWidget::refreshCellSyntaxFormats(const TablePreview &p_table) {
-  if (!m_document->table()) {
+  // The grid paints plain text.
+  if (m_gridMode || !m_document->table()) {
     return;
   }
 
@@ -2283,13 +3096,22 @@ void TablePreviewWidget::resetFromSource() {
   // user's accepted change.
   rebindFromContext();
 
+  // An external edit can move a table across the sheet's bound either way.
+  setGridMode(m_table && !TablePreviewDocument::isWithinLimits(*m_table));
+
   {
     QScopedValueRollback<bool> guard(m_applyingSource, true);
-    m_document->setTable(m_table);
-    if (m_sheet) {
-      // Only the palette: build() has just written every per-cell format, and
-      // repeating that pass is O(cells) of pure duplicate work.
-      m_sheet->refreshPalette();
+    if (m_gridMode) {
+      m_grid->setTable(m_table);
+      // Nothing left for the hidden sheet to lay out.
+      m_document->setTable(QSharedPointer<const TablePreview>());
+    } else {
+      m_document->setTable(m_table);
+      if (m_sheet) {
+        // Only the palette: build() has just written every per-cell format, and
+        // repeating that pass is O(cells) of pure duplicate work.
+        m_sheet->refreshPalette();
+      }
     }
   }
 
@@ -2308,13 +3130,50 @@ void TablePreviewWidget::resetFromSource() {
   m_inFlightGeneration = 0;
   m_commitInFlight = false;
   m_inFlightMarkdown.clear();
-  m_committedMarkdown = m_document->toMarkdown();
+  m_committedMarkdown = currentMarkdown();
 
   applyEditability();
   updateGeometry();
 
-  qCDebug(previewTableLog) << "sheet reset to" << m_document->rowCount() << "x"
-                           << m_document->columnCount();
+  qCDebug(previewTableLog) << (m_gridMode ? "grid" : "sheet") << "reset to"
+                           << (m_gridMode ? m_grid->rowCount() : m_document->rowCount()) << "x"
+                           << (m_gridMode ? m_grid->columnCount() : m_document->columnCount());
+}
+
+void TablePreviewWidget::setGridMode(bool p_grid) {
+  if (p_grid && !m_grid) {
+    m_grid = new TablePreviewGrid(this);
+    m_grid->setFont(font());
+    layout()->addWidget(m_grid);
+
+    connect(m_grid, &TablePreviewGrid::cellEdited, this,
+            &TablePreviewWidget::handleGridCellEdited);
+    connect(m_grid, &TablePreviewGrid::cellLeft, this, &TablePreviewWidget::handleCellLeft);
+    connect(m_grid, &TablePreviewGrid::focusEscapeRequested, this,
+            &TablePreviewWidget::handleEscapeRequested);
+    connect(m_grid, &TablePreviewGrid::undoRequested, this,
+            &TablePreviewWidget::handleUndoRequested);
+    connect(m_grid, &TablePreviewGrid::redoRequested, this,
+            &TablePreviewWidget::handleRedoRequested);
+    connect(m_grid, &TablePreviewGrid::preferredGeometryChanged, this,
+            &TablePreviewWidget::handlePreferredGeometryChanged);
+  }
+
+  if (m_gridMode == p_grid) {
+    return;
+  }
+
+  m_gridMode = p_grid;
+  if (m_grid) {
+    m_grid->setVisible(p_grid);
+  }
+  if (m_sheet) {
+    m_sheet->setVisible(!p_grid);
+  }
+}
+
+QString TablePreviewWidget::currentMarkdown() const {
+  return m_gridMode ? m_grid->toMarkdown() : m_document->toMarkdown();
 }
 
 void TablePreviewWidget::armCommit() {
@@ -2347,6 +3206,17 @@ void TablePreviewWidget::handleContentsChanged() {
   armCommit();
 }
 
+void TablePreviewWidget::handleGridCellEdited() {
+  if (m_applyingSource || m_suppressed) {
+    return;
+  }
+
+  // A grid edit arrives whole, when its line edit closes. The cellLeft() that
+  // usually follows writes it back; the debounce covers the rest.
+  ++m_editGeneration;
+  armCommit();
+}
+
 void TablePreviewWidget::handleCellLeft() {
   // Leaving a cell commits it immediately: the debounce exists to coalesce
   // keystrokes inside one cell, not to hold an edit the user has visibly
@@ -2377,7 +3247,10 @@ TablePreviewWidget::FlushOutcome TablePreviewWidget::flushPendingCommit() {
     return FlushOutcome::Deferred;
   }
 
-  if (m_sheet) {
+  if (m_gridMode) {
+    // Likewise for the grid's open line edit.
+    m_grid->commitEdit();
+  } else if (m_sheet) {
     // Before the generation check, never after it. A preedit is not in the
     // document yet, so it has not advanced the generation either: testing
     // first would report a composing sheet as clean, and the host's
@@ -2397,7 +3270,7 @@ TablePreviewWidget::FlushOutcome TablePreviewWidget::flushPendingCommit() {
     return FlushOutcome::Settled;
   }
 
-  const QString markdown = m_document->toMarkdown();
+  const QString markdown = currentMarkdown();
   if (markdown.isEmpty()) {
     // Unsafe to rewrite: restore the source view.
     qCWarning(previewTableLog) << "the sheet was edited but cannot be serialized safely -"
@@ -2566,6 +3439,10 @@ void TablePreviewWidget::revokeAuthority() {
 }
 
 QSize TablePreviewWidget::sizeHint() const {
+  if (m_gridMode) {
+    return m_grid->sizeHint();
+  }
+
   // Width 0: see TablePreviewSheet::sizeHint().
   return m_sheet ? m_sheet->sizeHint() : QSize(0, 0);
 }
@@ -2573,6 +3450,10 @@ QSize TablePreviewWidget::sizeHint() const {
 bool TablePreviewWidget::hasHeightForWidth() const { return true; }
 
 int TablePreviewWidget::heightForWidth(int p_width) const {
+  if (m_gridMode) {
+    return m_grid->heightForWidth(p_width);
+  }
+
   // The layout has no margins, so the sheet's outer width is this widget's.
   return m_sheet ? m_sheet->heightForWidth(p_width) : 0;
 }
@@ -2625,6 +3506,11 @@ void TablePreviewWidget::changeEvent(QEvent *p_event) {
 
       updateGeometry();
     }
+
+    if (m_grid && p_event->type() == QEvent::FontChange && m_grid->font() != font()) {
+      // Same reason as for the sheet. The grid relays itself out on the change.
+      m_grid->setFont(font());
+    }
     break;
 
   default:
@@ -1,6 +1,7 @@
 #ifndef TABLEPREVIEWWIDGET_H
 #define TABLEPREVIEWWIDGET_H
 
+#include <QAbstractScrollArea>
 #include <QMetaType>
 #include <QPointer>
 #include <QScopedPointer>
@@ -12,6 +13,7 @@
 #include <vtextedit/preview.h>
 #include <vtextedit/previewwidget.h>
 
+class QLineEdit;
 class QMenu;
 class QTextDocument;
 class QTextTable;
@@ -92,8 +94,8 @@ public:
   // one 16 ms frame rather than a multiple of it. The previous QTableView
   // sheet could afford 200000 because it was virtualized and fitted only the
   // rows it actually showed; this substrate cannot, so the bound is roughly
-  // three orders of magnitude lower. A table over it is left to the static
-  // source rendering, exactly as before.
+  // three orders of magnitude lower. A table over it is shown in a
+  // TablePreviewGrid instead, which is virtualized again.
   static const int c_maxCells;
 
   // Upper bound on the number of columns.
@@ -612,6 +614,214 @@ private:
   int m_lastCellIndex = -1;
 };
 
+// Virtualized sheet for a table too large for TablePreviewSheet.
+//
+// Plain cells on a scrolling viewport: only the rows and columns in view are
+// painted, and a row is measured the first time it comes into view. Column
+// widths are taken from the header and the first rows and never depend on the
+// band's width, so a row's height, once measured, never has to be redone on a
+// reflow. Row tops come from a Fenwick tree of the row heights, in which a row
+// not measured yet counts as one line, so both the top of a row and the row at
+// a scroll offset are O(log rows).
+//
+// Navigating moves a current cell; editing it opens one line edit over that
+// cell only. No syntax runs and no structural edits: those stay the sheet's.
+// Unlike the sheet it does scroll internally, capped at c_maxVisibleLines, and
+// hands the wheel to the editor only at either end.
+class TablePreviewGrid : public QAbstractScrollArea {
+  Q_OBJECT
+public:
+  // Upper bound on the number of cells a grid holds. The layout no longer
+  // grows with the table, but a commit still serializes every cell and
+  // replaces the whole source, so this is the QTableView sheet's bound again.
+  static const int c_maxCells;
+
+  // Rows, header included, whose text decides the column widths. A longer
+  // cell further down wraps instead.
+  static const int c_sampleRows;
+
+  // Height cap, in one-line rows. A taller table scrolls inside the grid.
+  static const int c_maxVisibleLines;
+
+  static bool isWithinLimits(const TablePreview &p_table);
+
+  explicit TablePreviewGrid(QWidget *p_parent = nullptr);
+
+  // Normalized exactly as TablePreviewDocument::setTable() does. Cancels an
+  // open edit.
+  void setTable(const QSharedPointer<const TablePreview> &p_table);
+
+  int rowCount() const;
+
+  int columnCount() const;
+
+  const QVector<QVector<QString>> &cells() const;
+
+  // Line separators are collapsed as for a paste into the sheet. Returns
+  // whether the cell changed.
+  bool setCell(int p_row, int p_column, const QString &p_text);
+
+  // Same rules as TablePreviewDocument::isRoundTrippable().
+  bool isRoundTrippable() const;
+
+  // Empty when the table cannot be written back safely.
+  QString toMarkdown() const;
+
+  void setReadOnly(bool p_readOnly);
+
+  bool isReadOnly() const;
+
+  int currentRow() const;
+
+  int currentColumn() const;
+
+  // Clamped into the table, and scrolled into view.
+  void setCurrentCell(int p_row, int p_column);
+
+  // Open the line edit on the current cell. Fails when read-only.
+  bool editCurrentCell();
+
+  // Close the line edit, writing its text to the cell. Emits cellEdited() when
+  // that changed the cell.
+  void commitEdit();
+
+  void cancelEdit();
+
+  bool isEditing() const;
+
+  // Viewport rectangle of a cell. A row not measured yet has its estimated
+  // height.
+  QRect cellRect(int p_row, int p_column) const;
+
+  // Rows whose height has been measured so far.
+  int measuredRowCount() const;
+
+  QSize sizeHint() const Q_DECL_OVERRIDE;
+
+  QSize minimumSizeHint() const Q_DECL_OVERRIDE;
+
+  bool hasHeightForWidth() const Q_DECL_OVERRIDE;
+
+  int heightForWidth(int p_width) const Q_DECL_OVERRIDE;
+
+  bool eventFilter(QObject *p_object, QEvent *p_event) Q_DECL_OVERRIDE;
+
+signals:
+  void cellEdited(int p_row, int p_column);
+
+  // The user finished with a cell: an edit was committed from the keyboard or
+  // the current cell moved.
+  void cellLeft();
+
+  void preferredGeometryChanged();
+
+  void focusEscapeRequested(vte::FocusEscapeDirection p_direction);
+
+  void undoRequested();
+
+  void redoRequested();
+
+protected:
+  void paintEvent(QPaintEvent *p_event) Q_DECL_OVERRIDE;
+
+  void resizeEvent(QResizeEvent *p_event) Q_DECL_OVERRIDE;
+
+  void scrollContentsBy(int p_dx, int p_dy) Q_DECL_OVERRIDE;
+
+  void keyPressEvent(QKeyEvent *p_event) Q_DECL_OVERRIDE;
+
+  void mousePressEvent(QMouseEvent *p_event) Q_DECL_OVERRIDE;
+
+  void mouseDoubleClickEvent(QMouseEvent *p_event) Q_DECL_OVERRIDE;
+
+  // Scrolls inside while it can, and leaves the rest to the editor.
+  void wheelEvent(QWheelEvent *p_event) Q_DECL_OVERRIDE;
+
+  void changeEvent(QEvent *p_event) Q_DECL_OVERRIDE;
+
+private:
+  // Measure the columns and restart the row heights, after a new table or a
+  // new font.
+  void relayout();
+
+  void measureColumns();
+
+  void resetRowHeights();
+
+  // Height of @p_row, measuring it on first use.
+  int measureRow(int p_row);
+
+  int rowHeight(int p_row) const;
+
+  // Fenwick tree operations over m_heightTree.
+  void addRowHeight(int p_row, int p_delta);
+
+  int rowTop(int p_row) const;
+
+  // The row covering content offset @p_y, clamped into the table.
+  int rowAt(int p_y) const;
+
+  int columnAt(int p_x) const;
+
+  int contentHeight() const;
+
+  int contentWidth() const;
+
+  void updateScrollBars();
+
+  void scrollToCell(int p_row, int p_column);
+
+  void moveCurrentCell(int p_row, int p_column);
+
+  void placeEditor();
+
+  QFont headerFont() const;
+
+  QSharedPointer<const TablePreview> m_table;
+
+  QVector<QVector<QString>> m_cells;
+
+  QVector<PreviewTableAlignment> m_alignments;
+
+  QVector<QString> m_rowPrefixes;
+
+  QString m_delimiterPrefix;
+
+  int m_declaredColumnCount = 0;
+
+  int m_columnCount = 0;
+
+  QVector<int> m_columnWidths;
+
+  // Left edge of every column in content coordinates, plus the right edge of
+  // the last one.
+  QVector<int> m_columnOffsets;
+
+  // -1 for a row not measured yet.
+  QVector<int> m_rowHeights;
+
+  // 1-based Fenwick tree of the row heights.
+  QVector<int> m_heightTree;
+
+  int m_measuredRowCount = 0;
+
+  // Height of a one-line row, which is what an unmeasured row counts as.
+  int m_lineHeight = 0;
+
+  int m_currentRow = 0;
+
+  int m_currentColumn = 0;
+
+  bool m_readOnly = false;
+
+  // Managed by QObject.
+  QLineEdit *m_editor = nullptr;
+
+  int m_editRow = -1;
+
+  int m_editColumn = -1;
+};
+
 class TablePreviewWidget : public PreviewWidget {
   Q_OBJECT
 public:
@@ -692,6 +902,8 @@ private slots:
 
   void handleCellLeft();
 
+  void handleGridCellEdited();
+
   void handleFocusLost();
 
   void handleEscapeRequested(vte::FocusEscapeDirection p_direction);
@@ -710,6 +922,12 @@ private slots:
 private:
   void resetFromSource();
 
+  // Show the grid instead of the sheet, creating it on first use.
+  void setGridMode(bool p_grid);
+
+  // What the sheet or the grid would write back right now.
+  QString currentMarkdown() const;
+
   // Repaint the cells with the syntax runs of @p_table without rebuilding the
   // document, so the caret and the selection survive.
   //
@@ -743,6 +961,12 @@ private:
   // Destroyed after m_sheet, which renders it. See the destructor.
   QScopedPointer<TablePreviewDocument> m_document;
 
+  // Managed by QObject. Created for the first table too large for the sheet.
+  TablePreviewGrid *m_grid = nullptr;
+
+  // Whether m_grid rather than m_sheet shows the bound table.
+  bool m_gridMode = false;
+
   // Managed by QObject.
   QTimer *m_commitTimer = nullptr;
 
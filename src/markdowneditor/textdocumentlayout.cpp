@@ -11,6 +11,7 @@
 #include <QTextFrame>
 #include <QTextLayout>
 
+#include <texteditor/selectionoverlay.h>
 #include <vtextedit/previewdata.h>
 #include <vtextedit/textblockdata.h>
 
@@ -66,7 +67,9 @@ TextDocumentLayout::PassGuard::~PassGuard() {
 
 TextDocumentLayout::TextDocumentLayout(QTextDocument *p_doc, DocumentResourceMgr *p_resourceMgr)
     : QAbstractTextDocumentLayout(p_doc), m_margin(p_doc->documentMargin()),
-      m_resourceMgr(p_resourceMgr) {}
+      m_resourceMgr(p_resourceMgr) {
+  m_selectionOverlay = new SelectionOverlay(this);
+}
 
 static void fillBackground(QPainter *p_painter, const QRectF &p_rect, QBrush p_brush,
                            QRectF p_gradientRect = QRectF()) {
@@ -271,7 +274,9 @@ void TextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_context
       fillBackground(p_painter, rect.adjusted(x, y, x, y), bg);
     }
 
-    auto selections = formatRangeFromSelection(block, p_context.selections);
+    // The overlay goes first, so the cursor selection of the context is on top.
+    auto selections = m_selectionOverlay->formatRanges(block);
+    selections += formatRangeFromSelection(block, p_context.selections);
 
     layout->draw(p_painter, offset, selections,
                  p_context.clip.isValid() ? p_context.clip : QRectF());
@@ -311,41 +316,9 @@ QVector<QTextLayout::FormatRange>
 TextDocumentLayout::formatRangeFromSelection(const QTextBlock &p_block,
                                              const QVector<Selection> &p_selections) const {
   QVector<QTextLayout::FormatRange> ret;
-
-  int blpos = p_block.position();
-  int bllen = p_block.length();
   for (int i = 0; i < p_selections.size(); ++i) {
     const QAbstractTextDocumentLayout::Selection &range = p_selections.at(i);
-    const int selStart = range.cursor.selectionStart() - blpos;
-    const int selEnd = range.cursor.selectionEnd() - blpos;
-    if (selStart < bllen && selEnd > 0 && selEnd > selStart) {
-      QTextLayout::FormatRange o;
-      o.start = selStart;
-      o.length = selEnd - selStart;
-      o.format = range.format;
-      ret.append(o);
-    } else if (!range.cursor.hasSelection() &&
-               range.format.hasProperty(QTextFormat::FullWidthSelection) &&
-               p_block.contains(range.cursor.position())) {
-      // For full width selections we don't require an actual selection, just
-      // a position to specify the line. that's more convenience in usage.
-      QTextLayout::FormatRange o;
-      QTextLine l = p_block.layout()->lineForTextPosition(range.cursor.position() - blpos);
-      if (!l.isValid()) {
-        qWarning() << "invalid layout lineForTextPosition" << p_block.blockNumber()
-                   << range.cursor.position() << blpos;
-        Q_ASSERT(false);
-        continue;
-      }
-      o.start = l.textStart();
-      o.length = l.textLength();
-      if (o.start + o.length == bllen - 1) {
-        ++o.length; // include newline
-      }
-
-      o.format = range.format;
-      ret.append(o);
-    }
+    SelectionOverlay::appendFormatRange(p_block, range.cursor, range.format, ret);
   }
 
   return ret;
@@ -475,6 +448,11 @@ void TextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_c
   // Update the margin.
   m_margin = doc->documentMargin();
 
+  // Only an insertion moves the end of a selection away from its start.
+  if (p_charsAdded > 0) {
+    m_selectionOverlay->invalidateMaxLength();
+  }
+
   int charsChanged = p_charsRemoved + p_charsAdded;
 
   QTextBlock changeStartBlock = doc->findBlock(p_from);
@@ -1174,6 +1152,57 @@ void TextDocumentLayout::relayout() {
   emit update(QRectF(0., 0., 1000000000., 1000000000.));
 }
 
+void TextDocumentLayout::updateBlocksVisibility(int p_firstBlock, int p_lastBlock) {
+  PassGuard pass(this);
+
+  QTextDocument *doc = document();
+  const QTextBlock firstBlock = doc->findBlockByNumber(p_firstBlock);
+  if (!firstBlock.isValid()) {
+    return;
+  }
+
+  QTextBlock lastBlock = doc->findBlockByNumber(p_lastBlock);
+  if (!lastBlock.isValid() || p_lastBlock < p_firstBlock) {
+    lastBlock = doc->lastBlock();
+  }
+
+  m_margin = doc->documentMargin();
+
+  // A hidden block is laid out with no line, a visible one with at least one.
+  // Blocks of a nested folded range stay hidden through the unfold of their
+  // parent and keep their layout.
+  QTextBlock block = firstBlock;
+  while (true) {
+    auto info = BlockLayoutData::get(block);
+    if (info->isNull() || block.isVisible() != (block.layout()->lineCount() > 0)) {
+      clearBlockLayout(block);
+      layoutBlock(block);
+    }
+
+    if (block == lastBlock) {
+      break;
+    }
+    block = block.next();
+  }
+
+  // updateOffsetAfter() stops at the first block whose offset did not move,
+  // which within the span may well be followed by one which did.
+  updateOffsetBefore(firstBlock);
+  qreal offset = BlockLayoutData::get(firstBlock)->bottom();
+  for (block = firstBlock; block != lastBlock;) {
+    block = block.next();
+    auto info = BlockLayoutData::get(block);
+    info->m_offset = offset;
+    offset = info->bottom();
+  }
+  updateOffsetAfter(lastBlock);
+
+  updateDocumentSize();
+
+  qreal top = BlockLayoutData::get(firstBlock)->m_offset;
+  emit update(QRectF(0., top, 1000000000., 1000000000.));
+}
+
 void TextDocumentLayout::relayout(const OrderedIntSet &p_blocks) {
   PassGuard pass(this);
 
@@ -18,6 +18,7 @@ namespace vte {
 class DocumentResourceMgr;
 struct PreviewImageData;
 class PreviewData;
+class SelectionOverlay;
 
 // The painted preview sources map one to one onto the interactive element
 // types; PreviewElementType::Table has no painted counterpart, and therefore
@@ -168,6 +169,13 @@ public:
   // Request update block by block number.
   void updateBlockByNumber(int p_blockNumber);
 
+  // The visibility of blocks within [@p_firstBlock, @p_lastBlock] changed, as
+  // by folding. Only the blocks whose layout no longer matches their
+  // visibility are touched: a hidden block gets its zero height rect without
+  // being shaped, and a block already laid out for its state is skipped. The
+  // offsets and the document size are then updated in one pass.
+  void updateBlocksVisibility(int p_firstBlock, int p_lastBlock);
+
   // Submit the complete set of interactive preview widgets to reserve space
   // for. Layout data only ever stores identities and rectangles, never widget
   // pointers.
@@ -413,6 +421,10 @@ private:
 
   DocumentResourceMgr *m_resourceMgr = nullptr;
 
+  // Extra selections painted by draw() besides the ones of the paint context.
+  // Managed by QObject.
+  SelectionOverlay *m_selectionOverlay = nullptr;
+
   // Whether allow preview of block.
   bool m_previewEnabled = false;
 
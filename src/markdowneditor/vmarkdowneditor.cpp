@@ -25,6 +25,7 @@
 
 #include <QDebug>
 #include <QFontMetricsF>
+#include <QMetaMethod>
 
 using namespace vte;
 
@@ -105,8 +106,21 @@ void VMarkdownEditor::setupSyntaxHighlighter() {
   if (m_config->m_webCodeBlockHighlighterEnabled) {
     m_webCodeBlockHighlighter = new WebCodeBlockHighlighter(this);
     connect(m_webCodeBlockHighlighter,
-            &WebCodeBlockHighlighter::externalCodeBlockHighlightRequested, this,
-            &VMarkdownEditor::externalCodeBlockHighlightRequested);
+            &WebCodeBlockHighlighter::externalCodeBlockHighlightBatchRequested, this,
+            [this](TimeStamp p_timeStamp,
+                   const QVector<ExternalCodeBlockHighlightRequest> &p_requests) {
+              static const auto batchSignal = QMetaMethod::fromSignal(
+                  &VMarkdownEditor::externalCodeBlockHighlightBatchRequested);
+              if (isSignalConnected(batchSignal)) {
+                emit externalCodeBlockHighlightBatchRequested(p_timeStamp, p_requests);
+                return;
+              }
+
+              // A host speaking the single-block protocol.
+              for (const auto &req : p_requests) {
+                emit externalCodeBlockHighlightRequested(req.m_id, p_timeStamp, req.m_text);
+              }
+            });
 
     codeBlockHighlighter = m_webCodeBlockHighlighter;
   } else {
@@ -147,6 +161,11 @@ void VMarkdownEditor::setupDocumentLayout() {
 
   document()->setDocumentLayout(docLayout);
 
+  // Fold and unfold only flip block visibility, which the layout handles
+  // without relayouting or rehighlighting the whole range.
+  connect(m_folding, &TextFolding::blocksVisibilityChanged, docLayout,
+          &TextDocumentLayout::updateBlocksVisibility);
+
   connect(m_textEdit, &VTextEdit::cursorWidthChanged, this,
           [this]() { documentLayout()->setCursorWidth(m_textEdit->cursorWidth()); });
 }
@@ -646,6 +665,12 @@ void VMarkdownEditor::handleExternalCodeBlockHighlightData(int p_idx, TimeStamp
   m_webCodeBlockHighlighter->handleExternalCodeBlockHighlightData(p_idx, p_timeStamp, p_html);
 }
 
+void VMarkdownEditor::handleExternalCodeBlockHighlightBatchData(
+    const QVector<ExternalCodeBlockHighlightData> &p_data) {
+  Q_ASSERT(m_webCodeBlockHighlighter);
+  m_webCodeBlockHighlighter->handleExternalCodeBlockHighlightBatchData(p_data);
+}
+
 void VMarkdownEditor::setExternalCodeBlockHighlihgtStyles(
     const ExternalCodeBlockHighlightStyles &p_styles) {
   WebCodeBlockHighlighter::setExternalCodeBlockHighlihgtStyles(p_styles);
@@ -1,6 +1,7 @@
 #include "webcodeblockhighlighter.h"
 
 #include <QDebug>
+#include <QMutexLocker>
 #include <QXmlStreamReader>
 
 #include <vtextedit/textutils.h>
@@ -9,8 +10,88 @@ using namespace vte;
 
 WebCodeBlockHighlighter::ExternalCodeBlockHighlightStyles WebCodeBlockHighlighter::s_styles;
 
+const int WebCodeBlockHighlighter::c_maxBatchSize = 64;
+
+const int WebCodeBlockHighlighter::c_defaultRequestTimeoutMs = 5000;
+
+WebCodeBlockHtmlParseWorker::WebCodeBlockHtmlParseWorker(WebCodeBlockHighlighter *p_highlighter)
+    : QThread(p_highlighter), m_highlighter(p_highlighter) {}
+
+WebCodeBlockHtmlParseWorker::~WebCodeBlockHtmlParseWorker() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stop = true;
+    m_jobs.clear();
+    m_jobAvailable.wakeAll();
+  }
+
+  wait();
+}
+
+void WebCodeBlockHtmlParseWorker::enqueue(const Job &p_job) {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_jobs.enqueue(p_job);
+    m_jobAvailable.wakeOne();
+  }
+
+  if (!isRunning()) {
+    start();
+  }
+}
+
+void WebCodeBlockHtmlParseWorker::run() {
+  while (true) {
+    Job job;
+    {
+      QMutexLocker locker(&m_mutex);
+      while (m_jobs.isEmpty() && !m_stop) {
+        m_jobAvailable.wait(&m_mutex);
+      }
+
+      if (m_stop) {
+        return;
+      }
+
+      job = m_jobs.dequeue();
+    }
+
+    CodeBlockHighlighter::HighlightStyles styles;
+    styles.resize(job.m_lines.size());
+    WebCodeBlockHighlighter::parseHtmlToStyles(job.m_html, job.m_lines, 1, job.m_styles, styles);
+
+    // The highlighter deletes this worker, and waits for it, before it goes
+    // away, so it outlives the post. A result posted for a request that has
+    // been dropped meanwhile is ignored there.
+    auto highlighter = m_highlighter;
+    const int id = job.m_id;
+    QMetaObject::invokeMethod(
+        m_highlighter, [highlighter, id, styles]() { highlighter->handleParsedStyles(id, styles); },
+        Qt::QueuedConnection);
+  }
+}
+
 WebCodeBlockHighlighter::WebCodeBlockHighlighter(QObject *p_parent)
-    : CodeBlockHighlighter(p_parent) {}
+    : CodeBlockHighlighter(p_parent) {
+  registerCodeBlockHighlightMetaTypes();
+  m_parseWorker = new WebCodeBlockHtmlParseWorker(this);
+}
+
+WebCodeBlockHighlighter::~WebCodeBlockHighlighter() {
+  // Join the worker before the members it posts results to are destroyed.
+  delete m_parseWorker;
+  m_parseWorker = nullptr;
+}
+
+void WebCodeBlockHighlighter::prepareHighlight() {
+  // A request still in flight keeps its ID across rounds; only the blocks it
+  // serves are recomputed.
+  for (auto &req : m_pendingRequests) {
+    req.m_indexes.clear();
+  }
+
+  m_batch.clear();
+}
 
 void WebCodeBlockHighlighter::highlightInternal(int p_idx) {
   const auto &block = m_codeBlocks[p_idx];
@@ -19,51 +100,137 @@ void WebCodeBlockHighlighter::highlightInternal(int p_idx) {
     return;
   }
 
-  const auto &unindentedText = TextUtils::unindentTextMultiLines(block.m_text);
-  emit externalCodeBlockHighlightRequested(p_idx, m_timeStamp, unindentedText);
+  auto it = m_pendingIds.find(block.m_text);
+  if (it != m_pendingIds.end()) {
+    // Already requested, by a previous round or by an identical block of this
+    // one.
+    auto &req = m_pendingRequests[it.value()];
+    if (req.m_indexes.isEmpty() && req.m_sentTimer.hasExpired(m_requestTimeout)) {
+      // First holder in this round of a request whose answer is overdue, maybe
+      // lost by the host. A late answer to the previous send is still taken.
+      sendRequest(it.value(), req);
+    }
+    req.m_indexes.append(p_idx);
+    return;
+  }
+
+  const int id = ++m_nextRequestId;
+  m_pendingIds.insert(block.m_text, id);
+
+  auto &req = m_pendingRequests[id];
+  req.m_text = block.m_text;
+  req.m_indexes.append(p_idx);
+  sendRequest(id, req);
+}
+
+void WebCodeBlockHighlighter::sendRequest(int p_id, PendingRequest &p_req) {
+  p_req.m_sentTimer.start();
+
+  ExternalCodeBlockHighlightRequest extReq;
+  extReq.m_id = p_id;
+  extReq.m_text = TextUtils::unindentTextMultiLines(p_req.m_text);
+  m_batch.append(extReq);
+}
+
+void WebCodeBlockHighlighter::setRequestTimeout(int p_ms) { m_requestTimeout = p_ms; }
+
+void WebCodeBlockHighlighter::finishHighlightRequests() {
+  // Forget the requests whose text is gone from the document; their results
+  // will be ignored.
+  for (auto it = m_pendingRequests.begin(); it != m_pendingRequests.end();) {
+    if (it.value().m_indexes.isEmpty()) {
+      m_pendingIds.remove(it.value().m_text);
+      it = m_pendingRequests.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (int i = 0; i < m_batch.size(); i += c_maxBatchSize) {
+    emit externalCodeBlockHighlightBatchRequested(m_timeStamp, m_batch.mid(i, c_maxBatchSize));
+  }
+
+  m_batch.clear();
 }
 
 void WebCodeBlockHighlighter::handleExternalCodeBlockHighlightData(int p_idx, TimeStamp p_timeStamp,
                                                                    const QString &p_html) {
-  if (m_timeStamp != p_timeStamp) {
-    return;
+  // Request IDs outlive the round which issued them, so the time stamp is not
+  // needed to detect obsolete data.
+  Q_UNUSED(p_timeStamp);
+
+  ExternalCodeBlockHighlightData data;
+  data.m_id = p_idx;
+  data.m_html = p_html;
+  handleExternalCodeBlockHighlightBatchData({data});
+}
+
+void WebCodeBlockHighlighter::handleExternalCodeBlockHighlightBatchData(
+    const QVector<ExternalCodeBlockHighlightData> &p_data) {
+  for (const auto &data : p_data) {
+    auto it = m_pendingRequests.find(data.m_id);
+    if (it == m_pendingRequests.end()) {
+      continue;
+    }
+
+    if (data.m_html.isEmpty()) {
+      finishRequest(data.m_id, HighlightStyles());
+      continue;
+    }
+
+    WebCodeBlockHtmlParseWorker::Job job;
+    job.m_id = data.m_id;
+    job.m_lines = it.value().m_text.split(QLatin1Char('\n'));
+    job.m_html = data.m_html;
+    job.m_styles = s_styles;
+    m_parseWorker->enqueue(job);
   }
+}
 
-  if (p_html.isEmpty()) {
-    finishHighlightOne(HighlightResult(p_timeStamp, p_idx));
+void WebCodeBlockHighlighter::handleParsedStyles(int p_id, const HighlightStyles &p_styles) {
+  if (!m_pendingRequests.contains(p_id)) {
     return;
   }
 
-  auto lines = m_codeBlocks[p_idx].m_text.split(QLatin1Char('\n'));
-  Q_ASSERT(lines.size() > 2);
+  finishRequest(p_id, p_styles);
+}
 
-  HighlightResult hiRes(p_timeStamp, p_idx);
-  hiRes.m_highlights.resize(lines.size());
+void WebCodeBlockHighlighter::finishRequest(int p_id, const HighlightStyles &p_styles) {
+  const auto req = m_pendingRequests.take(p_id);
+  m_pendingIds.remove(req.m_text);
 
-  parseHtmlToStyles(p_html, lines, 1, hiRes.m_highlights);
+  addToCache(req.m_text, m_timeStamp, p_styles);
 
-  if (m_timeStamp != p_timeStamp) {
-    return;
+  for (int idx : req.m_indexes) {
+    HighlightResult hiRes(m_timeStamp, idx);
+    hiRes.m_highlights = p_styles;
+    emit codeBlockHighlightCompleted(hiRes);
   }
-
-  finishHighlightOne(hiRes);
 }
 
 void WebCodeBlockHighlighter::parseHtmlToStyles(const QString &p_html, const QStringList &p_lines,
                                                 int p_startLineIdx, HighlightStyles &p_styles) {
+  parseHtmlToStyles(p_html, p_lines, p_startLineIdx, s_styles, p_styles);
+}
+
+void WebCodeBlockHighlighter::parseHtmlToStyles(
+    const QString &p_html, const QStringList &p_lines, int p_startLineIdx,
+    const ExternalCodeBlockHighlightStyles &p_classStyles, HighlightStyles &p_styles) {
   auto htmlLines = p_html.split(QLatin1Char('\n'));
 
   int lineIdx = p_startLineIdx;
   int lineOffset = 0;
 
   for (int htmlLineIdx = 0; htmlLineIdx < htmlLines.size(); ++htmlLineIdx) {
-    parseXmlAndMatch(htmlLines[htmlLineIdx], p_lines, p_styles, lineIdx, lineOffset);
+    parseXmlAndMatch(htmlLines[htmlLineIdx], p_lines, p_classStyles, p_styles, lineIdx,
+                     lineOffset);
   }
 }
 
-void WebCodeBlockHighlighter::parseXmlAndMatch(const QString &p_html, const QStringList &p_lines,
-                                               HighlightStyles &p_styles, int &p_idx,
-                                               int &p_offset) {
+void WebCodeBlockHighlighter::parseXmlAndMatch(
+    const QString &p_html, const QStringList &p_lines,
+    const ExternalCodeBlockHighlightStyles &p_classStyles, HighlightStyles &p_styles, int &p_idx,
+    int &p_offset) {
   if (p_html.isEmpty()) {
     return;
   }
@@ -92,7 +259,8 @@ void WebCodeBlockHighlighter::parseXmlAndMatch(const QString &p_html, const QStr
       }
 
       QStringList classList;
-      failed = !parseSpanElement(reader, p_lines, p_styles, classList, p_idx, p_offset);
+      failed = !parseSpanElement(reader, p_lines, p_classStyles, p_styles, classList, p_idx,
+                                 p_offset);
       break;
     }
 
@@ -104,10 +272,10 @@ void WebCodeBlockHighlighter::parseXmlAndMatch(const QString &p_html, const QStr
   }
 }
 
-bool WebCodeBlockHighlighter::parseSpanElement(QXmlStreamReader &p_reader,
-                                               const QStringList &p_lines,
-                                               HighlightStyles &p_styles, QStringList &p_classList,
-                                               int &p_idx, int &p_offset) {
+bool WebCodeBlockHighlighter::parseSpanElement(
+    QXmlStreamReader &p_reader, const QStringList &p_lines,
+    const ExternalCodeBlockHighlightStyles &p_classStyles, HighlightStyles &p_styles,
+    QStringList &p_classList, int &p_idx, int &p_offset) {
   if (p_idx >= p_lines.size()) {
     return false;
   }
@@ -147,7 +315,7 @@ bool WebCodeBlockHighlighter::parseSpanElement(QXmlStreamReader &p_reader,
             auto &unit = p_styles[p_idx].back();
             unit.start = pos;
             unit.length = tokenText.size();
-            unit.format = styleOfClasses(p_classList);
+            unit.format = styleOfClasses(p_classList, p_classStyles);
           }
           break;
         }
@@ -170,7 +338,8 @@ bool WebCodeBlockHighlighter::parseSpanElement(QXmlStreamReader &p_reader,
       }
 
       // Embedded <span>.
-      failed = !parseSpanElement(p_reader, p_lines, p_styles, p_classList, p_idx, p_offset);
+      failed = !parseSpanElement(p_reader, p_lines, p_classStyles, p_styles, p_classList, p_idx,
+                                 p_offset);
       break;
     }
 
@@ -197,14 +366,16 @@ bool WebCodeBlockHighlighter::parseSpanElement(QXmlStreamReader &p_reader,
   return !failed;
 }
 
-QTextCharFormat WebCodeBlockHighlighter::styleOfClasses(const QStringList &p_classList) {
+QTextCharFormat
+WebCodeBlockHighlighter::styleOfClasses(const QStringList &p_classList,
+                                        const ExternalCodeBlockHighlightStyles &p_classStyles) {
   QTextCharFormat fmt;
   for (const auto &cla : p_classList) {
     if (cla == QStringLiteral("token")) {
       continue;
     }
-    auto it = s_styles.find(cla);
-    if (it != s_styles.end()) {
+    auto it = p_classStyles.find(cla);
+    if (it != p_classStyles.end()) {
       fmt.merge(it.value());
     }
   }
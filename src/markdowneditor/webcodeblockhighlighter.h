@@ -3,9 +3,58 @@
 
 #include <vtextedit/codeblockhighlighter.h>
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
 class QXmlStreamReader;
 
 namespace vte {
+class WebCodeBlockHighlighter;
+
+// Parse the HTML returned by the external highlighter into styles off the GUI
+// thread. Jobs are handled in arrival order and each result is posted back to
+// the highlighter as soon as it is ready.
+class WebCodeBlockHtmlParseWorker : public QThread {
+  Q_OBJECT
+public:
+  struct Job {
+    int m_id = 0;
+
+    // Source lines of the code block, including the fences.
+    QStringList m_lines;
+
+    QString m_html;
+
+    // Snapshot of the class styles, so a concurrent
+    // setExternalCodeBlockHighlihgtStyles() could not race with the parse.
+    QHash<QString, QTextCharFormat> m_styles;
+  };
+
+  explicit WebCodeBlockHtmlParseWorker(WebCodeBlockHighlighter *p_highlighter);
+
+  ~WebCodeBlockHtmlParseWorker();
+
+  void enqueue(const Job &p_job);
+
+protected:
+  void run() Q_DECL_OVERRIDE;
+
+private:
+  WebCodeBlockHighlighter *m_highlighter = nullptr;
+
+  QMutex m_mutex;
+
+  QWaitCondition m_jobAvailable;
+
+  QQueue<Job> m_jobs;
+
+  bool m_stop = false;
+};
+
 class WebCodeBlockHighlighter : public CodeBlockHighlighter {
   Q_OBJECT
 public:
@@ -13,8 +62,7 @@ public:
 
   explicit WebCodeBlockHighlighter(QObject *p_parent);
 
-  void handleExternalCodeBlockHighlightData(int p_idx, TimeStamp p_timeStamp,
-                                            const QString &p_html);
+  ~WebCodeBlockHighlighter();
 
   static void setExternalCodeBlockHighlihgtStyles(const ExternalCodeBlockHighlightStyles &p_styles);
 
@@ -24,24 +72,95 @@ public:
   static void parseHtmlToStyles(const QString &p_html, const QStringList &p_lines,
                                 int p_startLineIdx, HighlightStyles &p_styles);
 
+  static void parseHtmlToStyles(const QString &p_html, const QStringList &p_lines,
+                                int p_startLineIdx,
+                                const ExternalCodeBlockHighlightStyles &p_classStyles,
+                                HighlightStyles &p_styles);
+
+  // Max number of blocks per externalCodeBlockHighlightBatchRequested().
+  static const int c_maxBatchSize;
+
+  // Default of setRequestTimeout().
+  static const int c_defaultRequestTimeoutMs;
+
+  // A request not answered within @p_ms is sent again, under the same ID, by the
+  // next highlight() round still holding its text.
+  void setRequestTimeout(int p_ms);
+
+public slots:
+  // Single-block form of handleExternalCodeBlockHighlightBatchData().
+  // @p_idx is the ExternalCodeBlockHighlightRequest::m_id being answered.
+  void handleExternalCodeBlockHighlightData(int p_idx, TimeStamp p_timeStamp,
+                                            const QString &p_html);
+
+  // Results may arrive in any order and in any number of calls. Unknown or
+  // obsolete IDs are ignored.
+  void handleExternalCodeBlockHighlightBatchData(
+      const QVector<vte::ExternalCodeBlockHighlightData> &p_data);
+
 signals:
-  void externalCodeBlockHighlightRequested(int p_idx, TimeStamp p_timeStamp, const QString &p_text);
+  // Blocks missing from the cache are sent in batches of at most c_maxBatchSize.
+  // A text already waiting for its result is not sent again until its request
+  // times out.
+  void externalCodeBlockHighlightBatchRequested(
+      TimeStamp p_timeStamp, const QVector<ExternalCodeBlockHighlightRequest> &p_requests);
 
 protected:
+  void prepareHighlight() Q_DECL_OVERRIDE;
+
   // @p_idx Index in m_codeBlocks.
   void highlightInternal(int p_idx) Q_DECL_OVERRIDE;
 
+  void finishHighlightRequests() Q_DECL_OVERRIDE;
+
 private:
-  static QTextCharFormat styleOfClasses(const QStringList &p_classList);
+  friend class WebCodeBlockHtmlParseWorker;
+
+  struct PendingRequest {
+    QString m_text;
+
+    // Indexes in m_codeBlocks of the current round holding m_text.
+    QVector<int> m_indexes;
+
+    // Started when the request is (re-)sent.
+    QElapsedTimer m_sentTimer;
+  };
+
+  void sendRequest(int p_id, PendingRequest &p_req);
+
+  // Called on the GUI thread once the worker parsed the result of @p_id.
+  void handleParsedStyles(int p_id, const HighlightStyles &p_styles);
+
+  void finishRequest(int p_id, const HighlightStyles &p_styles);
+
+  static QTextCharFormat styleOfClasses(const QStringList &p_classList,
+                                        const ExternalCodeBlockHighlightStyles &p_classStyles);
 
   static void parseXmlAndMatch(const QString &p_html, const QStringList &p_lines,
+                               const ExternalCodeBlockHighlightStyles &p_classStyles,
                                HighlightStyles &p_styles, int &p_idx, int &p_offset);
 
   // Return true on success.
   static bool parseSpanElement(QXmlStreamReader &p_reader, const QStringList &p_lines,
+                               const ExternalCodeBlockHighlightStyles &p_classStyles,
                                HighlightStyles &p_styles, QStringList &p_classList, int &p_idx,
                                int &p_offset);
 
+  // Requests sent to the external highlighter and not answered yet.
+  QHash<int, PendingRequest> m_pendingRequests;
+
+  // Source text -> request ID.
+  QHash<QString, int> m_pendingIds;
+
+  // Requests of the current round not yet emitted.
+  QVector<ExternalCodeBlockHighlightRequest> m_batch;
+
+  int m_nextRequestId = 0;
+
+  int m_requestTimeout = c_defaultRequestTimeoutMs;
+
+  WebCodeBlockHtmlParseWorker *m_parseWorker = nullptr;
+
   static ExternalCodeBlockHighlightStyles s_styles;
 };
 } // namespace vte
@@ -2,19 +2,22 @@
 
 #include <QDebug>
 #include <QMap>
+#include <QMutexLocker>
 
 #include <languagefilter_p.h>
 #include <speller.h>
 
 using namespace vte;
 
+const int SpellChecker::c_maxCachedVerdicts = 200000;
+
 SpellChecker::SpellChecker()
-    : m_speller(new Sonnet::Speller()),
-      m_languageFilter(new Sonnet::LanguageFilter(new Sonnet::SentenceTokenizer())),
-      m_wordTokenizer(new Sonnet::WordTokenizer()) {
+    : m_speller(new Sonnet::Speller()), m_verdictSpeller(new Sonnet::Speller()),
+      m_languageFilter(new Sonnet::LanguageFilter(new Sonnet::SentenceTokenizer())) {
   m_dictionaries = m_speller->availableDictionaries();
 
   m_speller->setAttribute(Sonnet::Speller::AutoDetectLanguage, false);
+  m_verdictSpeller->setAttribute(Sonnet::Speller::AutoDetectLanguage, false);
 }
 
 SpellChecker::~SpellChecker() {}
@@ -30,31 +33,84 @@ void SpellChecker::addDictionaryCustomSearchPaths(const QStringList &p_dirs) {
 
 const QMap<QString, QString> &SpellChecker::availableDictionaries() const { return m_dictionaries; }
 
-bool SpellChecker::isValid() const { return m_speller->isValid(); }
-
-Sonnet::LanguageFilter *SpellChecker::languageFilter() { return m_languageFilter.data(); }
-
-Sonnet::WordTokenizer *SpellChecker::wordTokenizer() { return m_wordTokenizer.data(); }
+bool SpellChecker::isValid() const {
+  QMutexLocker locker(&m_mutex);
+  return m_speller->isValid();
+}
 
 void SpellChecker::setCurrentLanguage(const QString &p_lang) {
-  if (p_lang == currentLanguage()) {
+  QMutexLocker locker(&m_mutex);
+  if (p_lang == m_speller->language()) {
     return;
   }
 
   m_speller->setLanguage(p_lang);
 }
 
-QString SpellChecker::currentLanguage() const { return m_speller->language(); }
+QString SpellChecker::currentLanguage() const {
+  QMutexLocker locker(&m_mutex);
+  return m_speller->language();
+}
 
 bool SpellChecker::isMisspelled(const QString &p_word) const {
-  return m_speller->isMisspelled(p_word);
+  return isMisspelled(currentLanguage(), p_word);
+}
+
+bool SpellChecker::isMisspelled(const QString &p_language, const QString &p_word) const {
+  QMutexLocker locker(&m_mutex);
+  auto &verdicts = m_verdicts[p_language];
+  auto it = verdicts.constFind(p_word);
+  if (it != verdicts.constEnd()) {
+    return it.value();
+  }
+
+  ++m_verdictCacheMisses;
+  if (m_verdictSpeller->language() != p_language) {
+    m_verdictSpeller->setLanguage(p_language);
+  }
+
+  const bool misspelled = m_verdictSpeller->isMisspelled(p_word);
+  if (verdicts.size() >= c_maxCachedVerdicts) {
+    verdicts.clear();
+  }
+  verdicts.insert(p_word, misspelled);
+  return misspelled;
 }
 
-void SpellChecker::ignoreWord(const QString &p_word) { m_speller->addToSession(p_word); }
+int SpellChecker::verdictCacheMisses() const {
+  QMutexLocker locker(&m_mutex);
+  return m_verdictCacheMisses;
+}
+
+void SpellChecker::ignoreWord(const QString &p_word) {
+  QMutexLocker locker(&m_mutex);
+  m_speller->addToSession(p_word);
+  invalidateVerdicts(p_word);
+}
+
+void SpellChecker::addToDictionary(const QString &p_word) {
+  QMutexLocker locker(&m_mutex);
+  m_speller->addToPersonal(p_word);
+  invalidateVerdicts(p_word);
+}
+
+void SpellChecker::invalidateVerdicts(const QString &p_word) {
+  for (auto &verdicts : m_verdicts) {
+    verdicts.remove(p_word);
+  }
+
+  ++m_dictionaryGeneration;
+}
+
+int SpellChecker::dictionaryGeneration() const {
+  QMutexLocker locker(&m_mutex);
+  return m_dictionaryGeneration;
+}
 
-void SpellChecker::addToDictionary(const QString &p_word) { m_speller->addToPersonal(p_word); }
+QMutex *SpellChecker::mutex() { return &m_mutex; }
 
 QStringList SpellChecker::suggest(const QString &p_word, bool p_autoDetectEnabled) {
+  QMutexLocker locker(&m_mutex);
   if (p_autoDetectEnabled) {
     auto lang = detectLanguage(p_word);
     if (!lang.isEmpty()) {
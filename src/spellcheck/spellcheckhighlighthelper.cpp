@@ -1,67 +1,68 @@
 #include "spellcheckhighlighthelper.h"
 
 #include <QDebug>
+#include <QMutexLocker>
 
-#include <texteditor/blockspellcheckdata.h>
 #include <vtextedit/spellchecker.h>
-#include <vtextedit/textblockdata.h>
 
 #include <languagefilter_p.h>
 
 using namespace vte;
 
-bool SpellCheckHighlightHelper::checkBlock(const QTextBlock &p_block, const QString &p_text,
-                                           bool p_autoDetectEnabled) {
+QVector<BlockSegment> SpellCheckHighlightHelper::checkText(const QString &p_text,
+                                                           const QString &p_language,
+                                                           bool p_autoDetectEnabled,
+                                                           Sonnet::LanguageFilter *p_filter,
+                                                           Sonnet::WordTokenizer *p_tokenizer) {
+  QVector<BlockSegment> misspellings;
   if (p_text.length() < 2) {
-    return false;
+    return misspellings;
   }
 
-  // Check if cache is valid.
-  auto data = TextBlockData::get(p_block);
-  auto spellData = data->getBlockSpellCheckData();
-  if (spellData && spellData->isValid(p_block.revision())) {
-    return true;
-  }
+  struct Sentence {
+    QString m_text;
+    int m_offset = 0;
+    QString m_language;
+  };
 
   auto &speller = SpellChecker::getInst();
-  if (!speller.isValid()) {
-    return false;
-  }
 
-  if (!spellData) {
-    spellData.reset(new BlockSpellCheckData());
-    data->setBlockSpellCheckData(spellData);
-  } else {
-    spellData->clear();
-  }
-  spellData->m_revision = p_block.revision();
+  // The language filter guesses through Sonnet, so each sentence is collected
+  // under the lock, which is released in between so that the GUI thread waits
+  // for one sentence at most. The words are checked after.
+  QVector<Sentence> sentences;
+  p_filter->setBuffer(p_text);
+  while (true) {
+    QMutexLocker locker(speller.mutex());
+    if (!p_filter->hasNext()) {
+      break;
+    }
 
-  auto filter = speller.languageFilter();
-  filter->setBuffer(p_text);
-  while (filter->hasNext()) {
-    if (!filter->isSpellcheckable()) {
+    if (!p_filter->isSpellcheckable()) {
       continue;
     }
 
-    const auto sentence = filter->next();
+    const auto sentence = p_filter->next();
+    Sentence sen;
     if (p_autoDetectEnabled) {
-      const auto lang = filter->language();
-      if (lang.isEmpty()) {
+      sen.m_language = p_filter->language();
+      if (sen.m_language.isEmpty()) {
         continue;
       }
-
-      if (lang != speller.currentLanguage()) {
-        speller.setCurrentLanguage(lang);
-      }
+    } else {
+      sen.m_language = p_language;
     }
+    sen.m_text = sentence.toString();
+    sen.m_offset = sentence.position();
+    sentences.push_back(sen);
+  }
 
-    auto tokenizer = speller.wordTokenizer();
-    tokenizer->setBuffer(sentence.toString());
-    const int offset = sentence.position();
-    while (tokenizer->hasNext()) {
-      const auto token = tokenizer->next();
+  for (const auto &sen : sentences) {
+    p_tokenizer->setBuffer(sen.m_text);
+    while (p_tokenizer->hasNext()) {
+      const auto token = p_tokenizer->next();
 
-      if (!tokenizer->isSpellcheckable()) {
+      if (!p_tokenizer->isSpellcheckable()) {
         continue;
       }
 
@@ -71,12 +72,12 @@ bool SpellCheckHighlightHelper::checkBlock(const QTextBlock &p_block, const QStr
         word.chop(1);
       }
 
-      if (speller.isMisspelled(word)) {
+      if (speller.isMisspelled(sen.m_language, word)) {
         // Found one.
-        spellData->addMisspell(token.position() + offset, token.length());
+        misspellings.push_back(BlockSegment(token.position() + sen.m_offset, token.length()));
       }
     }
   }
 
-  return true;
+  return misspellings;
 }
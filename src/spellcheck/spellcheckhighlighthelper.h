@@ -1,17 +1,29 @@
 #ifndef SPELLCHECKHIGHLIGHTHELPER_H
 #define SPELLCHECKHIGHLIGHTHELPER_H
 
-#include <QTextBlock>
+#include <QString>
+#include <QVector>
+
+#include <vtextedit/blocksegment.h>
+
+namespace Sonnet {
+class LanguageFilter;
+class WordTokenizer;
+} // namespace Sonnet
 
 namespace vte {
 class SpellCheckHighlightHelper {
 public:
   SpellCheckHighlightHelper() = delete;
 
-  // Fill the BlockSpellCheckData of @p_block.
-  // Return true if spell check succeeded.
-  static bool checkBlock(const QTextBlock &p_block, const QString &p_text,
-                         bool p_autoDetectEnabled);
+  // Misspelled words of @p_text, checked in @p_language unless
+  // @p_autoDetectEnabled detects another one per sentence.
+  // Thread safe as long as @p_filter and @p_tokenizer are owned by the calling
+  // thread.
+  static QVector<BlockSegment> checkText(const QString &p_text, const QString &p_language,
+                                         bool p_autoDetectEnabled,
+                                         Sonnet::LanguageFilter *p_filter,
+                                         Sonnet::WordTokenizer *p_tokenizer);
 };
 } // namespace vte
 
@@ -0,0 +1,129 @@
+#include "spellcheckworker.h"
+
+#include <QMutexLocker>
+#include <QScopedPointer>
+
+#include <vtextedit/spellchecker.h>
+#include <vtextedit/vsyntaxhighlighter.h>
+
+#include <languagefilter_p.h>
+
+#include "spellcheckhighlighthelper.h"
+
+using namespace vte;
+
+const int SpellCheckWorker::c_maxResultBatchSize = 64;
+
+SpellCheckWorker::SpellCheckWorker(VSyntaxHighlighter *p_highlighter)
+    : QThread(p_highlighter), m_highlighter(p_highlighter) {}
+
+SpellCheckWorker::~SpellCheckWorker() {
+  {
+    QMutexLocker locker(&m_mutex);
+    m_stop = true;
+    m_jobs.clear();
+    m_jobAvailable.wakeAll();
+  }
+
+  wait();
+}
+
+void SpellCheckWorker::enqueue(const SpellCheckJob &p_job, bool p_urgent) {
+  {
+    QMutexLocker locker(&m_mutex);
+    if (p_urgent) {
+      m_jobs.prepend(p_job);
+    } else {
+      m_jobs.enqueue(p_job);
+    }
+    m_jobAvailable.wakeOne();
+  }
+
+  startIfNeeded();
+}
+
+void SpellCheckWorker::enqueue(const QVector<SpellCheckJob> &p_jobs, bool p_urgent) {
+  if (p_jobs.isEmpty()) {
+    return;
+  }
+
+  {
+    QMutexLocker locker(&m_mutex);
+    m_jobs.reserve(m_jobs.size() + p_jobs.size());
+    if (p_urgent) {
+      // Keep their own order ahead of the queued ones.
+      for (int i = p_jobs.size() - 1; i >= 0; --i) {
+        m_jobs.prepend(p_jobs[i]);
+      }
+    } else {
+      for (const auto &job : p_jobs) {
+        m_jobs.enqueue(job);
+      }
+    }
+    m_jobAvailable.wakeOne();
+  }
+
+  startIfNeeded();
+}
+
+void SpellCheckWorker::clear() {
+  QMutexLocker locker(&m_mutex);
+  m_jobs.clear();
+}
+
+void SpellCheckWorker::startIfNeeded() {
+  if (!isRunning()) {
+    start(QThread::LowPriority);
+  }
+}
+
+void SpellCheckWorker::run() {
+  QScopedPointer<Sonnet::LanguageFilter> filter;
+  {
+    // Sonnet objects set up their speller through the shared loader.
+    QMutexLocker locker(SpellChecker::getInst().mutex());
+    filter.reset(new Sonnet::LanguageFilter(new Sonnet::SentenceTokenizer()));
+  }
+  Sonnet::WordTokenizer tokenizer;
+
+  QVector<SpellCheckResult> results;
+  while (true) {
+    SpellCheckJob job;
+    {
+      QMutexLocker locker(&m_mutex);
+      if (!results.isEmpty() && (m_jobs.isEmpty() || results.size() >= c_maxResultBatchSize)) {
+        // Flush before going to sleep, so a short burst of jobs is not held
+        // back until the next one comes.
+        //
+        // The highlighter deletes this worker, and waits for it, before it
+        // goes away, so it outlives the post. A result obsolete meanwhile is
+        // ignored there.
+        auto highlighter = m_highlighter;
+        QMetaObject::invokeMethod(
+            m_highlighter,
+            [highlighter, results]() { highlighter->handleSpellCheckResults(results); },
+            Qt::QueuedConnection);
+        results.clear();
+      }
+
+      while (m_jobs.isEmpty() && !m_stop) {
+        m_jobAvailable.wait(&m_mutex);
+      }
+
+      if (m_stop) {
+        break;
+      }
+
+      job = m_jobs.dequeue();
+    }
+
+    SpellCheckResult res;
+    res.m_misspellings = SpellCheckHighlightHelper::checkText(
+        job.m_text, job.m_language, job.m_autoDetectEnabled, filter.data(), &tokenizer);
+    res.m_job = job;
+    results.push_back(res);
+  }
+
+  QMutexLocker locker(SpellChecker::getInst().mutex());
+  filter.reset();
+}
@@ -0,0 +1,80 @@
+#ifndef SPELLCHECKWORKER_H
+#define SPELLCHECKWORKER_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QTextBlock>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <vtextedit/blocksegment.h>
+
+namespace vte {
+class VSyntaxHighlighter;
+
+struct SpellCheckJob {
+  // Never touched by the worker; handed back with the result so the
+  // highlighter can tell whether the block still holds m_text.
+  QTextBlock m_block;
+
+  int m_revision = -1;
+
+  QString m_text;
+
+  QString m_language;
+
+  bool m_autoDetectEnabled = false;
+
+  // VSyntaxHighlighter's spell check generation the job belongs to.
+  int m_generation = 0;
+
+  // Queued by the idle time backfill rather than for the viewport.
+  bool m_backfill = false;
+};
+
+struct SpellCheckResult {
+  SpellCheckJob m_job;
+
+  QVector<BlockSegment> m_misspellings;
+};
+
+// Spell check blocks off the GUI thread. Results are posted back to the
+// highlighter in batches, in the order the jobs were handled.
+class SpellCheckWorker : public QThread {
+  Q_OBJECT
+public:
+  explicit SpellCheckWorker(VSyntaxHighlighter *p_highlighter);
+
+  ~SpellCheckWorker();
+
+  // @p_urgent jobs are handled before the ones already queued.
+  void enqueue(const SpellCheckJob &p_job, bool p_urgent);
+
+  void enqueue(const QVector<SpellCheckJob> &p_jobs, bool p_urgent);
+
+  // Drop the jobs not started yet.
+  void clear();
+
+  // Max number of results posted at once.
+  static const int c_maxResultBatchSize;
+
+protected:
+  void run() Q_DECL_OVERRIDE;
+
+private:
+  void startIfNeeded();
+
+  VSyntaxHighlighter *m_highlighter = nullptr;
+
+  QMutex m_mutex;
+
+  QWaitCondition m_jobAvailable;
+
+  QQueue<SpellCheckJob> m_jobs;
+
+  bool m_stop = false;
+};
+} // namespace vte
+
+#endif // SPELLCHECKWORKER_H
@@ -97,6 +97,11 @@ VTextEdit::VTextEdit(QWidget *p_parent) : QTextEdit(p_parent) {
 }
 
 void VTextEdit::handleCursorPositionChange() {
+  if (m_updateBatchCount > 0) {
+    // Done once by endUpdateBatch().
+    return;
+  }
+
   // Qt BUG: In the case of exist of invislbe blocks, when a user click at the
   // top of the document, the hit test of underlying document layout may treat
   // the cursor at wrong blocks (such as those invisible blocks or the next
@@ -972,3 +977,17 @@ void VTextEdit::setLeaderKeyToSkip(int p_key, Qt::KeyboardModifiers p_modifiers)
   m_leaderKeyToSkip.m_key = p_key;
   m_leaderKeyToSkip.m_modifiers = p_modifiers;
 }
+
+void VTextEdit::beginUpdateBatch() { ++m_updateBatchCount; }
+
+void VTextEdit::endUpdateBatch() {
+  Q_ASSERT(m_updateBatchCount > 0);
+  if (--m_updateBatchCount > 0) {
+    return;
+  }
+
+  handleCursorPositionChange();
+  emit updateBatchEnded();
+}
+
+bool VTextEdit::isUpdateBatched() const { return m_updateBatchCount > 0; }
@@ -1,28 +1,71 @@
 #ifndef BLOCKSPELLCHECKDATA_H
 #define BLOCKSPELLCHECKDATA_H
 
+#include <QSharedPointer>
 #include <QVector>
 
 #include <vtextedit/blocksegment.h>
 
 namespace vte {
+// Number of misspellings held by the BlockSpellCheckData of one highlighter.
+// Each data keeps it up to date as its misspellings change or go away with
+// their block, so the highlighter does not have to walk the document.
+struct MisspellingTally {
+  int m_count = 0;
+};
+
 struct BlockSpellCheckData {
+  explicit BlockSpellCheckData(const QSharedPointer<MisspellingTally> &p_tally)
+      : m_tally(p_tally) {}
+
+  ~BlockSpellCheckData() { setMisspellings(QVector<BlockSegment>()); }
+
   bool isValid(int p_revision) const { return m_revision > -1 && m_revision == p_revision; }
 
   bool isEmpty() const { return m_misspellings.isEmpty(); }
 
   void clear() {
     m_revision = -1;
-    m_misspellings.clear();
+    m_pendingRevision = -1;
+    setMisspellings(QVector<BlockSegment>());
+  }
+
+  void setMisspellings(const QVector<BlockSegment> &p_misspellings) {
+    if (m_tally) {
+      m_tally->m_count += p_misspellings.size() - m_misspellings.size();
+    }
+    m_misspellings = p_misspellings;
   }
 
-  void addMisspell(int p_offset, int p_length) {
-    m_misspellings.push_back(BlockSegment(p_offset, p_length));
+  // Count from now on in @p_tally instead, as another highlighter took the
+  // block over.
+  void setTally(const QSharedPointer<MisspellingTally> &p_tally) {
+    if (m_tally) {
+      m_tally->m_count -= m_misspellings.size();
+    }
+    m_tally = p_tally;
+    if (m_tally) {
+      m_tally->m_count += m_misspellings.size();
+    }
   }
 
+  const QSharedPointer<MisspellingTally> &tally() const { return m_tally; }
+
+  // Block revision m_misspellings were computed for.
   int m_revision = -1;
 
+  // Block revision a spell check has been requested for and not answered yet.
+  int m_pendingRevision = -1;
+
+  // The misspellings currently underlined. Kept when the data is only marked
+  // invalid, so an identical result does not cost a rehighlight. Changed
+  // through setMisspellings() only, which keeps the tally.
   QVector<BlockSegment> m_misspellings;
+
+private:
+  Q_DISABLE_COPY(BlockSpellCheckData)
+
+  QSharedPointer<MisspellingTally> m_tally;
 };
 } // namespace vte
 
@@ -1,5 +1,10 @@
 #include "completer.h"
 
+#include "completioncorpus.h"
+#include "completionindex.h"
+
+#include <algorithm>
+
 #include <QAbstractItemView>
 #include <QDebug>
 #include <QKeyEvent>
@@ -56,38 +61,27 @@ QPair<int, int> Completer::findCompletionPrefix(CompleterInterface *p_interface)
 QStringList Completer::generateCompletionCandidates(CompleterInterface *p_interface,
                                                     int p_wordStart, int p_wordEnd,
                                                     bool p_reversed) {
-  const QString contents = p_interface->contents();
-  QRegularExpression reg("\\W+");
-  QStringList above = contents.left(p_wordStart).split(reg, Qt::SkipEmptyParts);
-  QStringList below = contents.mid(p_wordEnd).split(reg, Qt::SkipEmptyParts);
+  // QCompleter filters the candidates by the whole prefix. Only its first
+  // letter is used here, since backspaces may shorten the prefix down to it.
+  const auto prefix = p_interface->getText(p_wordStart, qMin(p_wordStart + 1, p_wordEnd));
+  auto index = CompletionIndex::get(p_interface->document());
+  auto candidates = index->candidates(p_wordStart, p_wordEnd, prefix, p_reversed);
+
+  auto corpus = index->corpus();
+  if (!corpus) {
+    return candidates;
+  }
 
-  // It differs in order regarding duplicates.
+  // Words only found in other documents follow the ones of this document.
+  auto others = corpus->candidates(prefix, index);
   if (p_reversed) {
-    QStringList rev;
-    rev.reserve(above.size() + below.size());
-    for (auto it = above.rbegin(); it != above.rend(); ++it) {
-      rev.append(*it);
-    }
-
-    for (auto it = below.rbegin(); it != below.rend(); ++it) {
-      rev.append(*it);
-    }
-
-    rev.removeDuplicates();
-
-    QStringList res;
-    res.reserve(rev.size());
-    for (auto it = rev.rbegin(); it != rev.rend(); ++it) {
-      res.append(*it);
-    }
-
-    return res;
-  } else {
-    // below + above.
-    below.append(above);
-    below.removeDuplicates();
-    return below;
+    std::reverse(others.begin(), others.end());
+    others.append(candidates);
+    return others;
   }
+
+  candidates.append(others);
+  return candidates;
 }
 
 static Qt::CaseSensitivity completionCaseSensitivity(const QString &p_prefix) {
@@ -303,6 +297,12 @@ void Completer::execute() {
   auto interface = m_interface;
   finishCompletion();
 
+  const auto completion = currentCompletion();
+  auto corpus = CompletionIndex::get(interface->document())->corpus();
+  if (corpus) {
+    corpus->markUsed(completion);
+  }
+
   // Make m_interface nullptr before changing content.
-  interface->insertCompletion(m_prefixRange.first, m_prefixRange.second, currentCompletion());
+  interface->insertCompletion(m_prefixRange.first, m_prefixRange.second, completion);
 }
@@ -17,8 +17,6 @@ public:
 
   virtual QTextCursor textCursor() const = 0;
 
-  virtual QString contents() const = 0;
-
   virtual QWidget *widget() const = 0;
 
   virtual QString getText(int p_start, int p_end) const = 0;
@@ -52,7 +50,8 @@ public:
   static QPair<int, int> findCompletionPrefix(CompleterInterface *p_interface);
 
   // Helper function to generate completion candidates excluding the word
-  // specified by [p_wordStart, p_wordEnd).
+  // specified by [p_wordStart, p_wordEnd). Served by the CompletionIndex of the
+  // document.
   static QStringList generateCompletionCandidates(CompleterInterface *p_interface, int p_wordStart,
                                                   int p_wordEnd, bool p_reversed);
 
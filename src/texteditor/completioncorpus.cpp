@@ -0,0 +1,140 @@
+#include "completioncorpus.h"
+
+#include <algorithm>
+
+#include "completionindex.h"
+
+using namespace vte;
+
+CompletionCorpus::CompletionCorpus() {}
+
+CompletionCorpus::~CompletionCorpus() {
+  // Indexes outliving the corpus go on alone.
+  const auto indexes = m_indexes;
+  for (auto index : indexes) {
+    index->setCorpus(nullptr);
+  }
+}
+
+CompletionCorpus &CompletionCorpus::getInst() {
+  static CompletionCorpus inst;
+  return inst;
+}
+
+void CompletionCorpus::addIndex(CompletionIndex *p_index) {
+  Q_ASSERT(!m_indexes.contains(p_index));
+  m_indexes.push_back(p_index);
+}
+
+void CompletionCorpus::removeIndex(CompletionIndex *p_index) {
+  m_indexes.removeOne(p_index);
+}
+
+int CompletionCorpus::acquireWord(const QString &p_word) {
+  auto it = m_ids.constFind(p_word);
+  if (it != m_ids.constEnd()) {
+    ++m_entries[it.value()].m_documents;
+    return it.value();
+  }
+
+  int id = -1;
+  if (m_freeIds.isEmpty()) {
+    id = m_entries.size();
+    m_entries.resize(id + 1);
+  } else {
+    id = m_freeIds.takeLast();
+  }
+
+  auto &entry = m_entries[id];
+  entry.m_word = p_word;
+  entry.m_folded = p_word.toCaseFolded();
+  entry.m_documents = 1;
+  entry.m_frequency = 0;
+  entry.m_lastUsed = 0;
+  m_ids.insert(entry.m_word, id);
+  m_prefixIndex.insert(entry.m_folded, id);
+  return id;
+}
+
+void CompletionCorpus::releaseWord(int p_id) {
+  auto &entry = m_entries[p_id];
+  Q_ASSERT(entry.m_documents > 0);
+  if (--entry.m_documents > 0) {
+    return;
+  }
+
+  Q_ASSERT(entry.m_frequency == 0);
+  m_ids.remove(entry.m_word);
+  m_prefixIndex.remove(entry.m_folded, p_id);
+  entry.m_word.clear();
+  entry.m_folded.clear();
+  m_freeIds.push_back(p_id);
+}
+
+void CompletionCorpus::addFrequency(int p_id, int p_delta) {
+  m_entries[p_id].m_frequency += p_delta;
+  Q_ASSERT(m_entries[p_id].m_frequency >= 0);
+}
+
+const CompletionCorpus::Entry &CompletionCorpus::entry(int p_id) const { return m_entries[p_id]; }
+
+void CompletionCorpus::refresh() {
+  for (auto index : m_indexes) {
+    index->refresh();
+  }
+}
+
+QStringList CompletionCorpus::candidates(const QString &p_prefix,
+                                         const CompletionIndex *p_exclude) {
+  refresh();
+
+  QVector<int> ids;
+  const auto folded = p_prefix.toCaseFolded();
+  for (auto it = m_prefixIndex.lowerBound(folded);
+       it != m_prefixIndex.end() && it.key().startsWith(folded); ++it) {
+    // The excluded document gives its own words, in its own order.
+    if (p_exclude && p_exclude->contains(m_entries[it.value()].m_word)) {
+      continue;
+    }
+    ids.push_back(it.value());
+  }
+
+  std::sort(ids.begin(), ids.end(), [this](int p_a, int p_b) {
+    const auto &a = m_entries[p_a];
+    const auto &b = m_entries[p_b];
+    if (a.m_lastUsed != b.m_lastUsed) {
+      return a.m_lastUsed > b.m_lastUsed;
+    }
+    if (a.m_frequency != b.m_frequency) {
+      return a.m_frequency > b.m_frequency;
+    }
+    return a.m_word < b.m_word;
+  });
+
+  QStringList res;
+  res.reserve(ids.size());
+  for (int id : ids) {
+    res.append(m_entries[id].m_word);
+  }
+  return res;
+}
+
+void CompletionCorpus::markUsed(const QString &p_word) {
+  auto it = m_ids.constFind(p_word);
+  if (it != m_ids.constEnd()) {
+    m_entries[it.value()].m_lastUsed = ++m_clock;
+  }
+}
+
+int CompletionCorpus::frequency(const QString &p_word) {
+  refresh();
+  auto it = m_ids.constFind(p_word);
+  return it != m_ids.constEnd() ? m_entries[it.value()].m_frequency : 0;
+}
+
+int CompletionCorpus::wordCount() {
+  refresh();
+  return m_ids.size();
+}
+
+int CompletionCorpus::documentCount() const { return m_indexes.size(); }
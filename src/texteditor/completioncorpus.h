@@ -0,0 +1,89 @@
+#ifndef COMPLETIONCORPUS_H
+#define COMPLETIONCORPUS_H
+
+#include <QHash>
+#include <QMultiMap>
+#include <QStringList>
+#include <QVector>
+
+namespace vte {
+class CompletionIndex;
+
+// Words of every document whose CompletionIndex is attached, for completing
+// with words of the other open documents.
+// Each word is stored once for the whole process and the attached indexes
+// share its string. The corpus follows the indexes as they change and drops
+// a word once no attached document holds it.
+class CompletionCorpus {
+public:
+  static CompletionCorpus &getInst();
+
+  ~CompletionCorpus();
+
+  // Words starting with @p_prefix, compared case-insensitively, and not found
+  // in @p_exclude. The most recently completed words come first, then the
+  // most frequent ones across the attached documents.
+  QStringList candidates(const QString &p_prefix, const CompletionIndex *p_exclude);
+
+  // @p_word has just been picked from a completion.
+  void markUsed(const QString &p_word);
+
+  // Number of occurrences of @p_word in all the attached documents.
+  int frequency(const QString &p_word);
+
+  int wordCount();
+
+  int documentCount() const;
+
+private:
+  friend class CompletionIndex;
+
+  struct Entry {
+    QString m_word;
+
+    QString m_folded;
+
+    // Number of attached documents holding it.
+    int m_documents = 0;
+
+    int m_frequency = 0;
+
+    // Clock of the last markUsed(), 0 if never.
+    int m_lastUsed = 0;
+  };
+
+  CompletionCorpus();
+
+  // Bring every attached index up to date.
+  void refresh();
+
+  void addIndex(CompletionIndex *p_index);
+
+  void removeIndex(CompletionIndex *p_index);
+
+  // One more document holds @p_word. Return its ID.
+  int acquireWord(const QString &p_word);
+
+  void releaseWord(int p_id);
+
+  void addFrequency(int p_id, int p_delta);
+
+  const Entry &entry(int p_id) const;
+
+  QVector<CompletionIndex *> m_indexes;
+
+  // Index by ID. Entries held by no document are free and listed in m_freeIds.
+  QVector<Entry> m_entries;
+
+  QVector<int> m_freeIds;
+
+  QHash<QString, int> m_ids;
+
+  // Case folded word -> ID, sorted for prefix lookups.
+  QMultiMap<QString, int> m_prefixIndex;
+
+  int m_clock = 0;
+};
+} // namespace vte
+
+#endif // COMPLETIONCORPUS_H
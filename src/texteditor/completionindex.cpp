@@ -0,0 +1,397 @@
+#include "completionindex.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+#include "completioncorpus.h"
+
+using namespace vte;
+
+static bool isWordChar(const QChar &p_ch) {
+  return p_ch.isLetterOrNumber() || p_ch == QLatin1Char('_');
+}
+
+CompletionIndex::CompletionIndex(QTextDocument *p_doc) : QObject(p_doc), m_document(p_doc) {
+  connect(m_document, &QTextDocument::contentsChange, this,
+          &CompletionIndex::handleContentsChange);
+  rebuild();
+}
+
+CompletionIndex::~CompletionIndex() { setCorpus(nullptr); }
+
+CompletionIndex *CompletionIndex::get(QTextDocument *p_doc) {
+  Q_ASSERT(p_doc);
+  auto index = p_doc->findChild<CompletionIndex *>(QString(), Qt::FindDirectChildrenOnly);
+  if (!index) {
+    index = new CompletionIndex(p_doc);
+  }
+  return index;
+}
+
+void CompletionIndex::setCorpus(CompletionCorpus *p_corpus) {
+  if (m_corpus == p_corpus) {
+    return;
+  }
+
+  if (m_corpus) {
+    releaseCorpusWords();
+    m_corpus->removeIndex(this);
+  }
+
+  m_corpus = p_corpus;
+  if (!m_corpus) {
+    return;
+  }
+
+  m_corpus->addIndex(this);
+
+  // Take the strings of the corpus so each word is stored once.
+  m_wordIds.clear();
+  m_prefixIndex.clear();
+  for (int id = 0; id < m_words.size(); ++id) {
+    auto &word = m_words[id];
+    if (word.m_count == 0) {
+      continue;
+    }
+
+    word.m_corpusId = m_corpus->acquireWord(word.m_word);
+    const auto &entry = m_corpus->entry(word.m_corpusId);
+    word.m_word = entry.m_word;
+    word.m_folded = entry.m_folded;
+    m_corpus->addFrequency(word.m_corpusId, word.m_count);
+    m_wordIds.insert(word.m_word, id);
+    m_prefixIndex.insert(word.m_folded, id);
+  }
+}
+
+CompletionCorpus *CompletionIndex::corpus() const { return m_corpus; }
+
+void CompletionIndex::releaseCorpusWords() {
+  for (auto &word : m_words) {
+    if (word.m_count > 0) {
+      m_corpus->addFrequency(word.m_corpusId, -word.m_count);
+      m_corpus->releaseWord(word.m_corpusId);
+      word.m_corpusId = -1;
+    }
+  }
+}
+
+void CompletionIndex::rebuild() {
+  if (m_corpus) {
+    releaseCorpusWords();
+  }
+
+  m_words.clear();
+  m_freeIds.clear();
+  m_wordIds.clear();
+  m_prefixIndex.clear();
+  m_matchStamps.clear();
+  m_seenStamps.clear();
+
+  m_blocks = QVector<BlockWords>(m_document->blockCount());
+  m_dirtyBlocks = m_blocks.size();
+  m_firstDirtyBlock = 0;
+}
+
+void CompletionIndex::handleContentsChange(int p_position, int p_charsRemoved,
+                                           int p_charsAdded) {
+  Q_UNUSED(p_charsRemoved);
+  const int blockCount = m_document->blockCount();
+  auto firstBlock = m_document->findBlock(p_position);
+  auto lastBlock = m_document->findBlock(p_position + p_charsAdded);
+  if (!lastBlock.isValid()) {
+    lastBlock = m_document->lastBlock();
+  }
+  if (!firstBlock.isValid()) {
+    rebuild();
+    return;
+  }
+
+  // Blocks out of [first, newLast] are untouched and only shifted by the
+  // change of block count.
+  const int first = firstBlock.blockNumber();
+  const int newLast = lastBlock.blockNumber();
+  const int oldLast = newLast - (blockCount - m_blocks.size());
+  if (oldLast < first || oldLast >= m_blocks.size()) {
+    rebuild();
+    return;
+  }
+
+  // Keep as many entries as possible: their occurrences are compared with the
+  // new text once collected again.
+  const int oldSize = oldLast - first + 1;
+  const int newSize = newLast - first + 1;
+  const int kept = qMin(oldSize, newSize);
+  m_firstDirtyBlock = qMin(m_firstDirtyBlock, first);
+  for (int i = first; i < first + kept; ++i) {
+    auto &words = m_blocks[i];
+    if (!words.m_dirty) {
+      words.m_dirty = true;
+      ++m_dirtyBlocks;
+    }
+  }
+
+  if (oldSize > newSize) {
+    const int removedStart = first + kept;
+    const int removedCount = oldSize - newSize;
+    for (int i = removedStart; i < removedStart + removedCount; ++i) {
+      const auto &words = m_blocks[i];
+      for (const auto &occ : words.m_occurrences) {
+        releaseWord(occ.m_wordId);
+      }
+      if (words.m_dirty) {
+        --m_dirtyBlocks;
+      }
+    }
+    m_blocks.remove(removedStart, removedCount);
+  } else if (newSize > oldSize) {
+    m_blocks.insert(first + kept, newSize - oldSize, BlockWords());
+    m_dirtyBlocks += newSize - oldSize;
+  }
+
+  Q_ASSERT(m_blocks.size() == blockCount);
+}
+
+void CompletionIndex::refresh() {
+  if (m_blocks.size() != m_document->blockCount()) {
+    rebuild();
+  }
+
+  if (m_dirtyBlocks == 0) {
+    return;
+  }
+
+  int idx = m_firstDirtyBlock;
+  for (auto block = m_document->findBlockByNumber(idx); block.isValid();
+       block = block.next(), ++idx) {
+    auto &words = m_blocks[idx];
+    if (!words.m_dirty) {
+      continue;
+    }
+
+    collectWords(block, words);
+    if (--m_dirtyBlocks == 0) {
+      break;
+    }
+  }
+
+  Q_ASSERT(m_dirtyBlocks == 0);
+  m_firstDirtyBlock = m_blocks.size();
+}
+
+void CompletionIndex::collectWords(const QTextBlock &p_block, BlockWords &p_words) {
+  p_words.m_dirty = false;
+
+  const auto text = p_block.text();
+  const int revision = p_block.revision();
+  const uint textHash = qHash(text);
+  if (!p_words.m_occurrences.isEmpty() && p_words.m_revision == revision &&
+      p_words.m_textLength == text.size() && p_words.m_textHash == textHash) {
+    return;
+  }
+
+  QVector<Occurrence> occurrences;
+  const int size = text.size();
+  int i = 0;
+  while (i < size) {
+    if (!isWordChar(text[i])) {
+      ++i;
+      continue;
+    }
+
+    const int start = i;
+    while (i < size && isWordChar(text[i])) {
+      ++i;
+    }
+
+    Occurrence occ;
+    occ.m_wordId = acquireWord(text.mid(start, i - start));
+    occ.m_offset = start;
+    occurrences.push_back(occ);
+  }
+
+  // Release after acquiring, so words staying in the block keep their IDs.
+  for (const auto &occ : p_words.m_occurrences) {
+    releaseWord(occ.m_wordId);
+  }
+
+  p_words.m_occurrences = occurrences;
+  p_words.m_revision = revision;
+  p_words.m_textHash = textHash;
+  p_words.m_textLength = text.size();
+}
+
+int CompletionIndex::acquireWord(const QString &p_word) {
+  auto it = m_wordIds.constFind(p_word);
+  if (it != m_wordIds.constEnd()) {
+    auto &word = m_words[it.value()];
+    ++word.m_count;
+    if (m_corpus) {
+      m_corpus->addFrequency(word.m_corpusId, 1);
+    }
+    return it.value();
+  }
+
+  int id = -1;
+  if (m_freeIds.isEmpty()) {
+    id = m_words.size();
+    m_words.resize(id + 1);
+    m_matchStamps.resize(id + 1);
+    m_seenStamps.resize(id + 1);
+  } else {
+    id = m_freeIds.takeLast();
+  }
+
+  auto &word = m_words[id];
+  word.m_count = 1;
+  if (m_corpus) {
+    word.m_corpusId = m_corpus->acquireWord(p_word);
+    const auto &entry = m_corpus->entry(word.m_corpusId);
+    word.m_word = entry.m_word;
+    word.m_folded = entry.m_folded;
+    m_corpus->addFrequency(word.m_corpusId, 1);
+  } else {
+    word.m_word = p_word;
+    word.m_folded = foldWord(p_word);
+  }
+  m_wordIds.insert(word.m_word, id);
+  m_prefixIndex.insert(word.m_folded, id);
+  return id;
+}
+
+void CompletionIndex::releaseWord(int p_wordId) {
+  auto &word = m_words[p_wordId];
+  Q_ASSERT(word.m_count > 0);
+  if (m_corpus) {
+    m_corpus->addFrequency(word.m_corpusId, -1);
+  }
+  if (--word.m_count > 0) {
+    return;
+  }
+
+  if (m_corpus) {
+    m_corpus->releaseWord(word.m_corpusId);
+    word.m_corpusId = -1;
+  }
+
+  m_wordIds.remove(word.m_word);
+  m_prefixIndex.remove(word.m_folded, p_wordId);
+  word.m_word.clear();
+  word.m_folded.clear();
+  m_freeIds.push_back(p_wordId);
+}
+
+QString CompletionIndex::foldWord(const QString &p_word) { return p_word.toCaseFolded(); }
+
+QStringList CompletionIndex::candidates(int p_wordStart, int p_wordEnd, const QString &p_prefix,
+                                        bool p_reversed) {
+  refresh();
+
+  auto cursorBlock = m_document->findBlock(p_wordStart);
+  if (!cursorBlock.isValid()) {
+    return QStringList();
+  }
+
+  ++m_stamp;
+
+  int remaining = 0;
+  const auto folded = foldWord(p_prefix);
+  for (auto it = m_prefixIndex.lowerBound(folded);
+       it != m_prefixIndex.end() && it.key().startsWith(folded); ++it) {
+    m_matchStamps[it.value()] = m_stamp;
+    ++remaining;
+  }
+
+  const int cursorIdx = cursorBlock.blockNumber();
+  const int startOffset = p_wordStart - cursorBlock.position();
+  const int endOffset = p_wordEnd - cursorBlock.position();
+
+  // The word itself is skipped. Do not wait for it if it has no other
+  // occurrence.
+  for (const auto &occ : m_blocks[cursorIdx].m_occurrences) {
+    if (occ.m_offset == startOffset) {
+      const int id = occ.m_wordId;
+      if (m_matchStamps[id] == m_stamp && m_words[id].m_count == 1) {
+        m_seenStamps[id] = m_stamp;
+        --remaining;
+      }
+      break;
+    }
+  }
+
+  QStringList res;
+  if (remaining <= 0) {
+    return res;
+  }
+
+  // Visit occurrences of block @p_idx at offsets in [p_from, p_to). Return
+  // false once every match is found.
+  auto scan = [&](int p_idx, int p_from, int p_to) {
+    const auto &occurrences = m_blocks[p_idx].m_occurrences;
+    const int size = occurrences.size();
+    for (int i = 0; i < size; ++i) {
+      const auto &occ = occurrences[p_reversed ? size - 1 - i : i];
+      if (occ.m_offset < p_from || occ.m_offset >= p_to) {
+        continue;
+      }
+
+      const int id = occ.m_wordId;
+      if (m_matchStamps[id] != m_stamp || m_seenStamps[id] == m_stamp) {
+        continue;
+      }
+
+      m_seenStamps[id] = m_stamp;
+      res.append(m_words[id].m_word);
+      if (--remaining == 0) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  const int blockCount = m_blocks.size();
+  const int maxOffset = std::numeric_limits<int>::max();
+  if (p_reversed) {
+    bool more = scan(cursorIdx, 0, startOffset);
+    for (int i = cursorIdx - 1; more && i >= 0; --i) {
+      more = scan(i, 0, maxOffset);
+    }
+    for (int i = blockCount - 1; more && i > cursorIdx; --i) {
+      more = scan(i, 0, maxOffset);
+    }
+    if (more) {
+      scan(cursorIdx, endOffset, maxOffset);
+    }
+
+    std::reverse(res.begin(), res.end());
+  } else {
+    bool more = scan(cursorIdx, endOffset, maxOffset);
+    for (int i = cursorIdx + 1; more && i < blockCount; ++i) {
+      more = scan(i, 0, maxOffset);
+    }
+    for (int i = 0; more && i < cursorIdx; ++i) {
+      more = scan(i, 0, maxOffset);
+    }
+    if (more) {
+      scan(cursorIdx, 0, startOffset);
+    }
+  }
+
+  return res;
+}
+
+int CompletionIndex::count(const QString &p_word) {
+  refresh();
+  auto it = m_wordIds.constFind(p_word);
+  return it != m_wordIds.constEnd() ? m_words[it.value()].m_count : 0;
+}
+
+int CompletionIndex::wordCount() {
+  refresh();
+  return m_wordIds.size();
+}
+
+bool CompletionIndex::contains(const QString &p_word) const { return m_wordIds.contains(p_word); }
@@ -0,0 +1,144 @@
+#ifndef COMPLETIONINDEX_H
+#define COMPLETIONINDEX_H
+
+#include <QHash>
+#include <QMultiMap>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+class QTextBlock;
+class QTextDocument;
+
+namespace vte {
+class CompletionCorpus;
+
+// Words of one document for completion, kept up to date from
+// QTextDocument::contentsChange instead of splitting the whole text on each
+// request.
+// A word is a maximal run of letters, digits and '_', like the completion
+// prefix found by Completer::findCompletionPrefix().
+class CompletionIndex : public QObject {
+  Q_OBJECT
+public:
+  // Word occurrence inside a block.
+  struct Occurrence {
+    int m_wordId = -1;
+
+    // Offset in the block.
+    int m_offset = 0;
+  };
+
+  struct BlockWords {
+    // Revision of the block and qHash() and length of its text when the
+    // occurrences were collected. The text is taken as unchanged only if all
+    // three still match, without keeping a copy of it.
+    int m_revision = -1;
+
+    uint m_textHash = 0;
+
+    int m_textLength = -1;
+
+    // The block changed since its occurrences were collected.
+    bool m_dirty = true;
+
+    QVector<Occurrence> m_occurrences;
+  };
+
+  // The index of @p_doc, created and filled on first use. It is a child of
+  // @p_doc and goes away with it.
+  static CompletionIndex *get(QTextDocument *p_doc);
+
+  ~CompletionIndex();
+
+  // Share the words with @p_corpus, or with no corpus if nullptr.
+  void setCorpus(CompletionCorpus *p_corpus);
+
+  CompletionCorpus *corpus() const;
+
+  // Collect the occurrences of blocks changed since the last query.
+  void refresh();
+
+  // Candidates for a completion at the word [@p_wordStart, @p_wordEnd), which
+  // itself is excluded. Only words starting with @p_prefix, compared
+  // case-insensitively, are returned.
+  // Words after the word come first in document order, wrapping to the
+  // document start. When @p_reversed, words before the word come last, the
+  // nearest one at the end, wrapping to the document end.
+  // Each word appears once, at its nearest occurrence in that order.
+  QStringList candidates(int p_wordStart, int p_wordEnd, const QString &p_prefix,
+                         bool p_reversed);
+
+  // Number of occurrences of @p_word in the document.
+  int count(const QString &p_word);
+
+  int wordCount();
+
+  // Whether @p_word was in the document at the last refresh().
+  bool contains(const QString &p_word) const;
+
+private:
+  struct Word {
+    QString m_word;
+
+    // Key in m_prefixIndex.
+    QString m_folded;
+
+    int m_count = 0;
+
+    // ID in m_corpus.
+    int m_corpusId = -1;
+  };
+
+  explicit CompletionIndex(QTextDocument *p_doc);
+
+  void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+  void rebuild();
+
+  // Give back every word to m_corpus.
+  void releaseCorpusWords();
+
+  void collectWords(const QTextBlock &p_block, BlockWords &p_words);
+
+  int acquireWord(const QString &p_word);
+
+  void releaseWord(int p_wordId);
+
+  static QString foldWord(const QString &p_word);
+
+  QTextDocument *m_document = nullptr;
+
+  CompletionCorpus *m_corpus = nullptr;
+
+  // One entry per block, in block order.
+  QVector<BlockWords> m_blocks;
+
+  int m_dirtyBlocks = 0;
+
+  // No block before it is dirty.
+  int m_firstDirtyBlock = 0;
+
+  // Index by ID. Entries with zero count are free and listed in m_freeIds.
+  QVector<Word> m_words;
+
+  QVector<int> m_freeIds;
+
+  QHash<QString, int> m_wordIds;
+
+  // Case folded word -> word ID, sorted for prefix lookups.
+  QMultiMap<QString, int> m_prefixIndex;
+
+  // Per word ID, the query stamp it last matched or was collected in.
+  QVector<int> m_matchStamps;
+
+  QVector<int> m_seenStamps;
+
+  int m_stamp = 0;
+};
+} // namespace vte
+
+Q_DECLARE_TYPEINFO(vte::CompletionIndex::Occurrence, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(vte::CompletionIndex::BlockWords, Q_MOVABLE_TYPE);
+
+#endif // COMPLETIONINDEX_H
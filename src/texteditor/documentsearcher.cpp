@@ -0,0 +1,128 @@
+#include "documentsearcher.h"
+
+#include <QTextBlock>
+#include <QTextDocument>
+
+using namespace vte;
+
+bool DocumentSearcher::setPattern(const QString &p_pattern, bool p_regExp, bool p_caseSensitive,
+                                  bool p_wholeWords) {
+  if (p_regExp) {
+    // Whole words only matter to a literal pattern.
+    p_wholeWords = false;
+  }
+
+  if (m_compileCount > 0 && m_pattern == p_pattern && m_regExp == p_regExp &&
+      m_caseSensitive == p_caseSensitive && m_wholeWords == p_wholeWords) {
+    return m_compiled.isValid();
+  }
+
+  m_pattern = p_pattern;
+  m_regExp = p_regExp;
+  m_caseSensitive = p_caseSensitive;
+  m_wholeWords = p_wholeWords;
+
+  QString text;
+  if (m_regExp) {
+    text = fromViPattern(m_pattern);
+  } else {
+    text = QRegularExpression::escape(m_pattern);
+    if (m_wholeWords) {
+      text = QStringLiteral("\\b%1\\b").arg(text);
+    }
+  }
+
+  m_compiled = QRegularExpression(text, m_caseSensitive
+                                            ? QRegularExpression::NoPatternOption
+                                            : QRegularExpression::CaseInsensitiveOption);
+  ++m_compileCount;
+  if (!m_compiled.isValid()) {
+    return false;
+  }
+
+  // JIT compile once here instead of on the first match.
+  m_compiled.optimize();
+  return true;
+}
+
+DocumentSearcher::Match DocumentSearcher::find(const QTextDocument *p_doc, int p_startBlock,
+                                               int p_startColumn, int p_endBlock,
+                                               int p_endColumn, bool p_backward) const {
+  if (!m_compiled.isValid() || m_pattern.isEmpty() || p_startBlock > p_endBlock) {
+    return Match();
+  }
+
+  auto block = p_doc->findBlockByNumber(p_backward ? p_endBlock : p_startBlock);
+  while (block.isValid()) {
+    const int number = block.blockNumber();
+    if (p_backward ? number < p_startBlock : number > p_endBlock) {
+      break;
+    }
+
+    const auto text = block.text();
+    const int start = number == p_startBlock ? qMin(p_startColumn, text.size()) : 0;
+    const int end = number == p_endBlock ? qMin(p_endColumn, text.size()) : text.size();
+    if (start <= end) {
+      auto match = findInText(text, start, end, p_backward);
+      if (match.isValid()) {
+        match.m_block = number;
+        return match;
+      }
+    }
+
+    block = p_backward ? block.previous() : block.next();
+  }
+
+  return Match();
+}
+
+DocumentSearcher::Match DocumentSearcher::findInText(const QString &p_text, int p_start, int p_end,
+                                                     bool p_backward) const {
+  Match found;
+  auto it = m_compiled.globalMatch(p_text, p_start);
+  while (it.hasNext()) {
+    const auto match = it.next();
+    const int start = match.capturedStart();
+    const int end = match.capturedEnd();
+    if (start > p_end) {
+      break;
+    }
+
+    // An empty match at the end of the range is left to the next search
+    // backward, which would otherwise find it again and again.
+    if (end <= p_end && (start < p_end || !p_backward)) {
+      found.m_block = 0;
+      found.m_start = start;
+      found.m_end = end;
+      if (!p_backward) {
+        break;
+      }
+    }
+  }
+
+  return found;
+}
+
+int DocumentSearcher::compileCount() const { return m_compileCount; }
+
+QString DocumentSearcher::fromViPattern(const QString &p_pattern) {
+  QString pattern;
+  pattern.reserve(p_pattern.size());
+  for (int i = 0; i < p_pattern.size(); ++i) {
+    const QChar ch = p_pattern[i];
+    if (ch == QLatin1Char('\\') && i + 1 < p_pattern.size()) {
+      // Keep escapes in pairs so that an escaped backslash is not read as the
+      // start of another escape.
+      const QChar next = p_pattern[++i];
+      if (next == QLatin1Char('<') || next == QLatin1Char('>')) {
+        pattern += QStringLiteral("\\b");
+      } else {
+        pattern += ch;
+        pattern += next;
+      }
+    } else {
+      pattern += ch;
+    }
+  }
+  return pattern;
+}
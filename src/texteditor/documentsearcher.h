@@ -0,0 +1,68 @@
+#ifndef DOCUMENTSEARCHER_H
+#define DOCUMENTSEARCHER_H
+
+#include <QRegularExpression>
+#include <QString>
+
+class QTextDocument;
+
+namespace vte {
+// Finds the nearest match of one pattern in a range of a document, for the
+// vi searches which move to one match at a time.
+// Blocks are scanned one at a time from the end searched from and the scan
+// stops at the first block holding a match, so no list of all matches is
+// built. As with SearchIndex, a match never spans blocks.
+// The compiled pattern is kept until another one is asked for, so repeating a
+// search does not compile it again.
+class DocumentSearcher {
+public:
+  // Columns in the block, [m_start, m_end).
+  struct Match {
+    bool isValid() const { return m_block >= 0; }
+
+    int m_block = -1;
+
+    int m_start = 0;
+
+    int m_end = 0;
+  };
+
+  // Search @p_pattern from now on. A literal pattern is escaped, and
+  // @p_wholeWords applies to literal patterns only. Returns false if the
+  // pattern is not valid.
+  bool setPattern(const QString &p_pattern, bool p_regExp, bool p_caseSensitive,
+                  bool p_wholeWords);
+
+  // The first match lying in [(@p_startBlock, @p_startColumn),
+  // (@p_endBlock, @p_endColumn)] of @p_doc, or the last one if @p_backward.
+  // The text around the range is still seen by anchors and lookarounds.
+  Match find(const QTextDocument *p_doc, int p_startBlock, int p_startColumn, int p_endBlock,
+             int p_endColumn, bool p_backward) const;
+
+  // Times a pattern was compiled.
+  int compileCount() const;
+
+  // Translate the vi word boundaries \< and \>, which QRegularExpression
+  // takes as plain characters, to \b.
+  static QString fromViPattern(const QString &p_pattern);
+
+private:
+  // The match within [@p_start, @p_end) of @p_text nearest to the end
+  // searched from.
+  Match findInText(const QString &p_text, int p_start, int p_end, bool p_backward) const;
+
+  QString m_pattern;
+
+  bool m_regExp = false;
+
+  bool m_caseSensitive = true;
+
+  bool m_wholeWords = false;
+
+  QRegularExpression m_compiled;
+
+  int m_compileCount = 0;
+};
+} // namespace vte
+
+#endif // DOCUMENTSEARCHER_H
@@ -11,8 +11,6 @@ EditorCompleter::EditorCompleter(VTextEditor *p_editor)
 
 QTextCursor EditorCompleter::textCursor() const { return m_editor->m_textEdit->textCursor(); }
 
-QString EditorCompleter::contents() const { return m_editor->m_textEdit->toPlainText(); }
-
 QWidget *EditorCompleter::widget() const { return m_editor->m_textEdit; }
 
 QString EditorCompleter::getText(int p_start, int p_end) const {
@@ -12,8 +12,6 @@ public:
 
   QTextCursor textCursor() const Q_DECL_OVERRIDE;
 
-  QString contents() const Q_DECL_OVERRIDE;
-
   QWidget *widget() const Q_DECL_OVERRIDE;
 
   QString getText(int p_start, int p_end) const Q_DECL_OVERRIDE;
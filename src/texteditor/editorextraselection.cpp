@@ -1,11 +1,16 @@
 #include "editorextraselection.h"
 
+#include "selectionoverlay.h"
+
+#include <vtextedit/texteditutils.h>
 #include <vtextedit/vtextedit.h>
 #include <vtextedit/vtexteditor.h>
 
 #include <QHash>
 #include <QRect>
+#include <QAbstractTextDocumentLayout>
 #include <QRegion>
+#include <QTextBlock>
 #include <QVector>
 
 using namespace vte;
@@ -104,6 +109,46 @@ QRegion changedFullWidthRegion(VTextEdit *p_textEdit,
 
   return region;
 }
+
+// Add the rows of the visible ones of @p_selections to @p_region, in full
+// width and expanded vertically by the invalidation margin.
+void addVisibleSelectionRegion(VTextEdit *p_textEdit, const QPair<int, int> &p_visibleBlocks,
+                               const QList<QTextEdit::ExtraSelection> &p_selections,
+                               QRegion &p_region) {
+  auto doc = p_textEdit->document();
+  const auto firstBlock = doc->findBlockByNumber(p_visibleBlocks.first);
+  const auto lastBlock = doc->findBlockByNumber(p_visibleBlocks.second);
+  if (!firstBlock.isValid() || !lastBlock.isValid()) {
+    return;
+  }
+
+  const int visibleStart = firstBlock.position();
+  const int visibleEnd = lastBlock.position() + lastBlock.length();
+  const QRect viewportRect = p_textEdit->viewport()->rect();
+  QTextCursor cursor(doc);
+  for (const auto &selection : p_selections) {
+    if (selection.cursor.isNull() || selection.cursor.document() != doc) {
+      continue;
+    }
+
+    const int start = selection.cursor.selectionStart();
+    const int end = selection.cursor.selectionEnd();
+    if (end < visibleStart || start >= visibleEnd) {
+      continue;
+    }
+
+    cursor.setPosition(qMax(start, visibleStart));
+    const int top = p_textEdit->cursorRect(cursor).top();
+    cursor.setPosition(qMin(end, visibleEnd - 1));
+    const int bottom = p_textEdit->cursorRect(cursor).bottom();
+    QRect rect(viewportRect.left(), top, viewportRect.width(), bottom - top + 1);
+    rect.adjust(0, -c_selectionInvalidationMargin, 0, c_selectionInvalidationMargin);
+    rect &= viewportRect;
+    if (!rect.isEmpty()) {
+      p_region += rect;
+    }
+  }
+}
 } // namespace
 
 EditorExtraSelection::EditorExtraSelection(VTextEditor *p_editor)
@@ -138,15 +183,37 @@ void EditorExtraSelection::setExtraSelections(
   }
 }
 
-QList<QTextCursor> EditorExtraSelection::findAllText(const QString &p_text,
-                                                     bool p_isRegularExpression,
-                                                     bool p_caseSensitive) {
-  FindFlags flags = None;
-  if (p_isRegularExpression) {
-    flags |= FindFlag::RegularExpression;
+QTextDocument *EditorExtraSelection::document() const { return m_editor->m_textEdit->document(); }
+
+QPair<int, int> EditorExtraSelection::visibleBlockRange() const {
+  return TextEditUtils::visibleBlockRange(m_editor->m_textEdit);
+}
+
+SelectionOverlay *EditorExtraSelection::overlay() const {
+  auto layout = document()->documentLayout();
+  return layout ? layout->findChild<SelectionOverlay *>(QString(), Qt::FindDirectChildrenOnly)
+                : nullptr;
+}
+
+bool EditorExtraSelection::hasExtraSelectionLayers() const { return overlay() != nullptr; }
+
+void EditorExtraSelection::setExtraSelectionLayer(
+    int p_layer, const QList<QTextEdit::ExtraSelection> &p_selections) {
+  auto overlay = this->overlay();
+  Q_ASSERT(overlay);
+  if (!overlay) {
+    return;
   }
-  if (p_caseSensitive) {
-    flags |= FindFlag::CaseSensitive;
+
+  // The layout does not track the overlay, so invalidate the visible rows of
+  // the old and new selections of the layer. The other layers stay untouched.
+  auto textEdit = m_editor->m_textEdit;
+  const auto visibleBlocks = visibleBlockRange();
+  QRegion region;
+  addVisibleSelectionRegion(textEdit, visibleBlocks, overlay->layer(p_layer), region);
+  overlay->setLayer(p_layer, p_selections);
+  addVisibleSelectionRegion(textEdit, visibleBlocks, p_selections, region);
+  if (!region.isEmpty()) {
+    textEdit->viewport()->update(region);
   }
-  return m_editor->m_textEdit->findAllText(p_text, flags);
 }
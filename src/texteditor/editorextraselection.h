@@ -5,6 +5,7 @@
 
 namespace vte {
 class VTextEditor;
+class SelectionOverlay;
 
 class EditorExtraSelection : public ExtraSelectionInterface {
 public:
@@ -16,10 +17,19 @@ public:
 
   void setExtraSelections(const QList<QTextEdit::ExtraSelection> &p_selections) Q_DECL_OVERRIDE;
 
-  QList<QTextCursor> findAllText(const QString &p_text, bool p_isRegularExpression,
-                                 bool p_caseSensitive) Q_DECL_OVERRIDE;
+  QTextDocument *document() const Q_DECL_OVERRIDE;
+
+  QPair<int, int> visibleBlockRange() const Q_DECL_OVERRIDE;
+
+  bool hasExtraSelectionLayers() const Q_DECL_OVERRIDE;
+
+  void setExtraSelectionLayer(int p_layer,
+                              const QList<QTextEdit::ExtraSelection> &p_selections) Q_DECL_OVERRIDE;
 
 private:
+  // The overlay of the document layout, if it paints one.
+  SelectionOverlay *overlay() const;
+
   VTextEditor *m_editor = nullptr;
 
   // The full-width selections of the last applied extra selections, used to
@@ -1,8 +1,11 @@
 #include "extraselectionmgr.h"
 
 #include <QTextBlock>
+#include <QTextDocument>
 #include <QTimer>
 
+#include "searchindex.h"
+
 using namespace vte;
 
 ExtraSelectionMgr::ExtraSelectionMgr(ExtraSelectionInterface *p_interface, QObject *p_parent)
@@ -80,6 +83,7 @@ void ExtraSelectionMgr::setExtraSelectionFormat(int p_type, const QColor &p_fore
 }
 
 void ExtraSelectionMgr::updateOnExtraSelectionChange(int p_type) {
+  m_extraSelections[p_type].m_dirty = true;
   switch (p_type) {
   case SelectionType::CursorLine:
     highlightCursorLine();
@@ -144,6 +148,7 @@ void ExtraSelectionMgr::handleCursorPositionChange() {
           if (blockNumber == block.blockNumber()) {
             // Remove it.
             selections.erase(it);
+            extraSelection.m_dirty = true;
             needUpdate = true;
             break;
           } else if (blockNumber > block.blockNumber()) {
@@ -180,6 +185,32 @@ void ExtraSelectionMgr::handleCursorPositionChange() {
 void ExtraSelectionMgr::applyExtraSelections() {
   m_extraSelectionTimer->stop();
 
+  const bool layered = m_interface->hasExtraSelectionLayers();
+  if (layered != m_layered) {
+    // Apply everything the other way.
+    m_layered = layered;
+    for (auto &extraSelection : m_extraSelections) {
+      extraSelection.m_dirty = true;
+    }
+    if (m_layered) {
+      m_interface->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+    }
+  }
+
+  if (m_layered) {
+    // Leave the unchanged layers alone.
+    for (int i = 0; i < m_extraSelections.size(); ++i) {
+      auto &extraSelection = m_extraSelections[i];
+      if (extraSelection.m_dirty) {
+        extraSelection.m_dirty = false;
+        m_interface->setExtraSelectionLayer(i, extraSelection.m_enabled
+                                                   ? extraSelection.m_selections
+                                                   : QList<QTextEdit::ExtraSelection>());
+      }
+    }
+    return;
+  }
+
   QList<QTextEdit::ExtraSelection> selections;
   const int nrExtra = m_extraSelections.size();
   for (int i = 0; i < SelectionType::MaxBuiltInSelection; ++i) {
@@ -207,6 +238,7 @@ bool ExtraSelectionMgr::isExtraSelectionEnabled(SelectionType p_type) const {
 void ExtraSelectionMgr::highlightCursorLine(bool p_applyNow) {
   auto &extraSelection = m_extraSelections[SelectionType::CursorLine];
   auto &selections = extraSelection.m_selections;
+  extraSelection.m_dirty = true;
   if (extraSelection.m_enabled) {
     selections.clear();
 
@@ -311,6 +343,7 @@ bool ExtraSelectionMgr::highlightWhitespaceInternal(
       needUpdate = true;
     }
   }
+  extraSelection.m_dirty = extraSelection.m_dirty || needUpdate;
   return needUpdate;
 }
 
@@ -326,6 +359,7 @@ void ExtraSelectionMgr::highlightSelectedText(bool p_applyNow) {
         return;
       }
       selections.clear();
+      extraSelection.m_dirty = true;
     } else {
       findAllTextAsExtraSelection(selectedText, false, true, SelectionType::SelectedText,
                                   extraSelection.format());
@@ -336,6 +370,7 @@ void ExtraSelectionMgr::highlightSelectedText(bool p_applyNow) {
       return;
     }
     selections.clear();
+    extraSelection.m_dirty = true;
   }
 
   if (p_applyNow) {
@@ -347,6 +382,55 @@ void ExtraSelectionMgr::handleContentsChange() { m_whitespaceHighlightTimer->sta
 
 void ExtraSelectionMgr::handleSelectionChange() { m_selectedTextHighlightTimer->start(); }
 
+void ExtraSelectionMgr::handleViewportChange() {
+  const auto visibleRange = m_interface->visibleBlockRange();
+  if (visibleRange.first >= m_highlightBlockRange.first &&
+      visibleRange.second <= m_highlightBlockRange.second) {
+    // Still within the margin of the last highlight.
+    return;
+  }
+
+  highlightWhitespace(false);
+  highlightSelectedText(false);
+  applyExtraSelections();
+}
+
+void ExtraSelectionMgr::updateHighlightBlockRange() {
+  auto doc = m_interface->document();
+  if (!doc) {
+    m_highlightBlockRange = qMakePair(0, -1);
+    return;
+  }
+
+  const auto visibleRange = m_interface->visibleBlockRange();
+  const int screenBlocks = qMax(visibleRange.second - visibleRange.first + 1, 1);
+  m_highlightBlockRange.first = qMax(visibleRange.first - screenBlocks, 0);
+  m_highlightBlockRange.second = qMin(visibleRange.second + screenBlocks, doc->blockCount() - 1);
+}
+
+SearchIndex *ExtraSelectionMgr::searchIndex(SelectionType p_type) {
+  auto doc = m_interface->document();
+  if (m_document != doc) {
+    qDeleteAll(m_searchIndexes);
+    m_searchIndexes.clear();
+    m_document = doc;
+  }
+
+  if (!doc) {
+    return nullptr;
+  }
+
+  if (m_searchIndexes.isEmpty()) {
+    m_searchIndexes.resize(SelectionType::MaxBuiltInSelection);
+  }
+
+  auto &index = m_searchIndexes[p_type];
+  if (!index) {
+    index = new SearchIndex(doc, this);
+  }
+  return index;
+}
+
 void ExtraSelectionMgr::findAllTextAsExtraSelection(
     const QString &p_text, bool p_isRegularExpression, bool p_caseSensitive, SelectionType p_type,
     const QTextCharFormat &p_format, const std::function<bool(const QTextCursor &)> &p_filter) {
@@ -354,11 +438,35 @@ void ExtraSelectionMgr::findAllTextAsExtraSelection(
   Q_ASSERT(extraSelection.m_enabled);
   auto &selections = extraSelection.m_selections;
   selections.clear();
-  auto cursors = m_interface->findAllText(p_text, p_isRegularExpression, p_caseSensitive);
-  selections.reserve(cursors.size());
+  extraSelection.m_dirty = true;
+
+  auto index = searchIndex(p_type);
+  updateHighlightBlockRange();
+  if (!index || m_highlightBlockRange.first > m_highlightBlockRange.second) {
+    return;
+  }
+
+  FindFlags flags = FindFlag::None;
+  if (p_isRegularExpression) {
+    flags |= FindFlag::RegularExpression;
+  }
+  if (p_caseSensitive) {
+    flags |= FindFlag::CaseSensitive;
+  }
+
+  // Blocks out of the range are left to handleViewportChange().
+  auto doc = m_interface->document();
+  const auto firstBlock = doc->findBlockByNumber(m_highlightBlockRange.first);
+  const auto lastBlock = doc->findBlockByNumber(m_highlightBlockRange.second);
+  const auto &matches = index->findAll(QStringList(p_text), flags, firstBlock.position(),
+                                       lastBlock.position() + lastBlock.length() - 1);
+  selections.reserve(matches.size());
   QTextEdit::ExtraSelection select;
   select.format = p_format;
-  for (const auto &cursor : cursors) {
+  QTextCursor cursor(doc);
+  for (const auto &match : matches) {
+    cursor.setPosition(match.m_start);
+    cursor.setPosition(match.m_end, QTextCursor::KeepAnchor);
     if (p_filter && !p_filter(cursor)) {
       continue;
     }
@@ -377,6 +485,7 @@ void ExtraSelectionMgr::setSelections(int p_type, const QList<QTextCursor> &p_se
   Q_ASSERT(p_type < m_extraSelections.size());
   auto &extraSelection = m_extraSelections[p_type];
   auto &selections = extraSelection.m_selections;
+  extraSelection.m_dirty = true;
   if (extraSelection.m_enabled) {
     selections.clear();
     QTextEdit::ExtraSelection select;
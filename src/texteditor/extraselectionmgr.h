@@ -3,12 +3,19 @@
 
 #include <QBrush>
 #include <QObject>
+#include <QPair>
+#include <QPointer>
 #include <QTextCharFormat>
 #include <QTextEdit>
 
+#include <vtextedit/global.h>
+
 class QTimer;
+class QTextDocument;
 
 namespace vte {
+class SearchIndex;
+
 class ExtraSelectionInterface {
 public:
   virtual ~ExtraSelectionInterface() {}
@@ -19,8 +26,22 @@ public:
 
   virtual void setExtraSelections(const QList<QTextEdit::ExtraSelection> &p_selections) = 0;
 
-  virtual QList<QTextCursor> findAllText(const QString &p_text, bool p_isRegularExpression,
-                                         bool p_caseSensitive) = 0;
+  virtual QTextDocument *document() const = 0;
+
+  // Block numbers of the first and last visible blocks.
+  virtual QPair<int, int> visibleBlockRange() const = 0;
+
+  // Whether setExtraSelectionLayer() could be used instead of
+  // setExtraSelections().
+  virtual bool hasExtraSelectionLayers() const { return false; }
+
+  // Replace the selections of @p_layer only. Layers are painted in ascending
+  // order.
+  virtual void setExtraSelectionLayer(int p_layer,
+                                      const QList<QTextEdit::ExtraSelection> &p_selections) {
+    Q_UNUSED(p_layer);
+    Q_UNUSED(p_selections);
+  }
 };
 
 class ExtraSelectionMgr : public QObject {
@@ -53,10 +74,14 @@ public slots:
 
   void handleSelectionChange();
 
+  // Highlight the whitespace and selected text of the blocks scrolled in.
+  void handleViewportChange();
+
   void updateAllExtraSelections();
 
   // Apply the already-built selections to the interface immediately, cancelling
-  // the pending coalescing timer.
+  // the pending coalescing timer. With layers, only the changed types are
+  // applied.
   void applyExtraSelections();
 
 private:
@@ -84,6 +109,7 @@ private:
 
   void updateOnExtraSelectionChange(int p_type);
 
+  // Find @p_text in the blocks of m_highlightBlockRange only.
   // @p_filter: used to check every selection. Should return false if it
   // is not wanted.
   void
@@ -92,6 +118,12 @@ private:
                               const QTextCharFormat &p_format,
                               const std::function<bool(const QTextCursor &)> &p_filter = nullptr);
 
+  // Update m_highlightBlockRange to the visible blocks plus a screen on each side.
+  void updateHighlightBlockRange();
+
+  // The search index of @p_type for the current document.
+  SearchIndex *searchIndex(SelectionType p_type);
+
   struct ExtraSelection {
     bool m_enabled = false;
     QColor m_foreground;
@@ -99,6 +131,9 @@ private:
     bool m_isFullWidth = false;
     QList<QTextEdit::ExtraSelection> m_selections;
 
+    // Changed since last applied as a layer.
+    bool m_dirty = true;
+
     QTextCharFormat format() const {
       QTextCharFormat fmt;
       if (m_foreground.isValid()) {
@@ -146,6 +181,19 @@ private:
 
   // Whether cursor is right behind trailing space.
   bool m_cursorBehindTrailingSpace = false;
+
+  // Whether the selections were last applied as layers.
+  bool m_layered = false;
+
+  // Blocks whose whitespace and selected text are highlighted.
+  QPair<int, int> m_highlightBlockRange = qMakePair(0, -1);
+
+  // Document of m_searchIndexes.
+  QPointer<QTextDocument> m_document;
+
+  // Per-block matches of the whitespace and selected text highlights, indexed
+  // by SelectionType. Managed by QObject.
+  QVector<SearchIndex *> m_searchIndexes;
 };
 } // namespace vte
 
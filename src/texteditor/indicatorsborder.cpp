@@ -70,6 +70,23 @@ void IndicatorsBorder::setFont(const QFont &p_font) {
 
   m_foldingMarkerWith = fm.height();
 
+  m_foldingMarkerFont = m_font;
+  m_foldingMarkerFont.setBold(true);
+  const qreal ps = m_foldingMarkerFont.pointSizeF();
+  if (ps > 0) {
+    m_foldingMarkerFont.setPointSizeF(ps * 1.5);
+  }
+
+  const QString markerTexts[2] = {QStringLiteral("-"), QStringLiteral("+")};
+  for (int i = 0; i < 2; ++i) {
+    m_foldingMarkerTexts[i].setText(markerTexts[i]);
+    m_foldingMarkerTexts[i].setTextFormat(Qt::PlainText);
+    m_foldingMarkerTexts[i].prepare(QTransform(), m_foldingMarkerFont);
+  }
+
+  // Laid out with the old font.
+  m_lineNumberTexts.clear();
+
   m_needUpdateIndicatorsPosition = true;
 
   // Force to update line number area width.
@@ -138,10 +155,19 @@ void IndicatorsBorder::paintBorder(const QRect &p_rect) {
   const int currentBlockNumber = m_interface->cursorBlockNumber();
   auto block = m_interface->firstVisibleBlock();
   auto rect = m_interface->blockBoundingRect(block);
-  // When drawing block i, this indicates how many invisible blocks from block i
-  // to cursor block.
-  int numOfInvisibleBlocksToCursorBlock = -1;
-  int previousVisibleBlockNumber = block.blockNumber() - 1;
+
+  // Visible lines of the block to paint and of the cursor block. The painted
+  // blocks are consecutive visible lines, so only the first one is looked up.
+  int visibleLine = block.blockNumber();
+  int currentVisibleLine = currentBlockNumber;
+  if (m_lineNumberType == LineNumberType::Relative && m_interface->hasInvisibleBlocks()) {
+    const auto &folding = m_interface->textFolding();
+    visibleLine = folding.lineToVisibleLine(visibleLine);
+    currentVisibleLine = folding.lineToVisibleLine(currentVisibleLine);
+  }
+
+  // Line numbers laid out by the last paint are reused and the others dropped.
+  QHash<int, QStaticText> lineNumberTexts;
 
   // Paint the borader in chunks line by line.
   while (block.isValid() && rect.y() <= bottom) {
@@ -176,53 +202,23 @@ void IndicatorsBorder::paintBorder(const QRect &p_rect) {
       painter.setBrush(fg);
 
       int number = blockNumber + 1;
-      if (m_lineNumberType == LineNumberType::Relative) {
-        // Relative number.
-        if (distanceToCurrent == 0) {
-          // Reset since we need to change the direction.
-          numOfInvisibleBlocksToCursorBlock = -1;
-        } else {
-          if (m_interface->hasInvisibleBlocks()) {
-            // Take care of invisible blocks.
-            if (numOfInvisibleBlocksToCursorBlock == -1) {
-              numOfInvisibleBlocksToCursorBlock = 0;
-              // Go through all the blocks.
-              if (distanceToCurrent > 0) {
-                auto tb = m_interface->cursorBlock().next();
-                while (tb.blockNumber() < blockNumber) {
-                  if (!tb.isVisible()) {
-                    ++numOfInvisibleBlocksToCursorBlock;
-                  }
-                  tb = tb.next();
-                }
-              } else {
-                auto tb = block.next();
-                while (tb.blockNumber() < currentBlockNumber) {
-                  if (!tb.isVisible()) {
-                    ++numOfInvisibleBlocksToCursorBlock;
-                  }
-                  tb = tb.next();
-                }
-              }
-            } else if (blockNumber - 1 > previousVisibleBlockNumber) {
-              if (distanceToCurrent > 0) {
-                numOfInvisibleBlocksToCursorBlock += (blockNumber - previousVisibleBlockNumber - 1);
-              } else {
-                Q_ASSERT(numOfInvisibleBlocksToCursorBlock > 0);
-                numOfInvisibleBlocksToCursorBlock -= (blockNumber - previousVisibleBlockNumber - 1);
-              }
-            }
+      if (m_lineNumberType == LineNumberType::Relative && distanceToCurrent != 0) {
+        number = abs(visibleLine - currentVisibleLine);
+      }
 
-            Q_ASSERT(numOfInvisibleBlocksToCursorBlock >= 0);
-            number = abs(distanceToCurrent) - numOfInvisibleBlocksToCursorBlock;
-          } else {
-            number = abs(distanceToCurrent);
-          }
+      auto it = lineNumberTexts.find(number);
+      if (it == lineNumberTexts.end()) {
+        it = lineNumberTexts.insert(number, m_lineNumberTexts.take(number));
+        if (it->text().isEmpty()) {
+          it->setText(QString::number(number));
+          it->setTextFormat(Qt::PlainText);
+          it->prepare(QTransform(), m_font);
         }
       }
 
-      painter.drawText(x + m_maxCharWidth / 2, y, newLineNumberWidth - m_maxCharWidth, h,
-                       Qt::TextDontClip | Qt::AlignRight | Qt::AlignTop, QString::number(number));
+      // Right-aligned within the line number area.
+      const qreal textX = x + newLineNumberWidth - m_maxCharWidth / 2 - it->size().width();
+      painter.drawStaticText(QPointF(textX, y), *it);
 
       x += newLineNumberWidth + c_separatorWidth;
       if (m_needUpdateIndicatorsPosition) {
@@ -258,6 +254,7 @@ void IndicatorsBorder::paintBorder(const QRect &p_rect) {
 
     if (m_needUpdateIndicatorsPosition) {
       m_needUpdateIndicatorsPosition = false;
+      m_lineNumberTexts.swap(lineNumberTexts);
 
       // Add an extra separator.
       x += c_separatorWidth;
@@ -269,13 +266,15 @@ void IndicatorsBorder::paintBorder(const QRect &p_rect) {
       return;
     }
 
-    previousVisibleBlockNumber = blockNumber;
+    ++visibleLine;
 
     do {
       block = block.next();
     } while (block.isValid() && !block.isVisible());
     rect = m_interface->blockBoundingRect(block);
   }
+
+  m_lineNumberTexts.swap(lineNumberTexts);
 }
 
 void IndicatorsBorder::updateBorder() { update(); }
@@ -293,19 +292,13 @@ void IndicatorsBorder::paintFoldingMarker(QPainter &p_painter, int p_xOffset, in
   QColor color = p_folded ? m_foldedFoldingColor : m_foldingColor;
   p_painter.setPen(color);
   p_painter.setBrush(color);
+  p_painter.setFont(m_foldingMarkerFont);
 
-  auto font = p_painter.font();
-  font.setBold(true);
-  qreal ps = font.pointSizeF();
-  if (ps > 0) {
-    font.setPointSizeF(ps * 1.5);
-  }
-  p_painter.setFont(font);
-
-  const QString markerText(p_folded ? "+" : "-");
-
-  p_painter.drawText(p_xOffset, p_yOffset, p_width, p_height,
-                     Qt::TextDontClip | Qt::AlignCenter | Qt::AlignVCenter, markerText);
+  const auto &markerText = m_foldingMarkerTexts[p_folded ? 1 : 0];
+  const auto size = markerText.size();
+  p_painter.drawStaticText(QPointF(p_xOffset + (p_width - size.width()) / 2,
+                                   p_yOffset + (p_height - size.height()) / 2),
+                           markerText);
 
   p_painter.restore();
 }
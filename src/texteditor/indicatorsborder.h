@@ -3,8 +3,10 @@
 
 #include <QColor>
 #include <QFont>
+#include <QHash>
 #include <QPair>
 #include <QSharedPointer>
+#include <QStaticText>
 #include <QTextBlock>
 #include <QTimer>
 #include <QVector>
@@ -145,6 +147,15 @@ private:
 
   QFont m_font;
 
+  // Laid out line numbers of the last paint, by number. Scrolling mostly paints
+  // the same numbers again.
+  QHash<int, QStaticText> m_lineNumberTexts;
+
+  QFont m_foldingMarkerFont;
+
+  // Laid out unfolded and folded markers.
+  QStaticText m_foldingMarkerTexts[2];
+
   qreal m_maxCharWidth = 0.0;
 
   int m_lineNumberWidth = 0;
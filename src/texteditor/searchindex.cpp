@@ -0,0 +1,403 @@
+#include "searchindex.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QThreadPool>
+
+using namespace vte;
+
+const int SearchIndex::c_parallelScanSize = 512 * 1024;
+
+const int SearchIndex::c_scanChunkSize = 256 * 1024;
+
+namespace {
+class FunctionRunnable : public QRunnable {
+public:
+  explicit FunctionRunnable(const std::function<void()> &p_func) : m_func(p_func) {}
+
+  void run() Q_DECL_OVERRIDE { m_func(); }
+
+private:
+  std::function<void()> m_func;
+};
+} // namespace
+
+SearchIndex::SearchIndex(QTextDocument *p_doc, QObject *p_parent)
+    : QObject(p_parent), m_document(p_doc) {
+  connect(m_document, &QTextDocument::contentsChange, this, &SearchIndex::handleContentsChange);
+}
+
+void SearchIndex::clear() {
+  m_texts.clear();
+  m_flags = FindFlag::None;
+  m_patterns.clear();
+  m_blocks.clear();
+  m_dirtyBlocks = 0;
+  m_firstDirtyBlock = 0;
+  m_result.clear();
+  m_resultValid = false;
+}
+
+void SearchIndex::setSearch(const QStringList &p_texts, FindFlags p_flags) {
+  const auto flags = p_flags & ~FindFlag::FindBackward;
+  if (m_texts == p_texts && m_flags == flags) {
+    return;
+  }
+
+  clear();
+  m_texts = p_texts;
+  m_flags = flags;
+
+  const auto options = (m_flags & FindFlag::CaseSensitive)
+                           ? QRegularExpression::NoPatternOption
+                           : QRegularExpression::CaseInsensitiveOption;
+  for (const auto &text : m_texts) {
+    if (text.isEmpty()) {
+      continue;
+    }
+
+    Pattern pattern;
+    pattern.m_text = text;
+    if (m_flags & FindFlag::RegularExpression) {
+      pattern.m_regExp = QRegularExpression(text, options);
+      if (!pattern.m_regExp.isValid()) {
+        continue;
+      }
+
+      // Compile once here instead of in the first match of each thread.
+      pattern.m_regExp.optimize();
+    } else {
+      pattern.m_matcher.setPattern(text);
+      pattern.m_matcher.setCaseSensitivity((m_flags & FindFlag::CaseSensitive)
+                                               ? Qt::CaseSensitive
+                                               : Qt::CaseInsensitive);
+    }
+    m_patterns.push_back(pattern);
+  }
+
+  markAllDirty();
+}
+
+void SearchIndex::markAllDirty() {
+  m_blocks = QVector<BlockMatches>(m_document->blockCount());
+  m_dirtyBlocks = m_blocks.size();
+  m_firstDirtyBlock = 0;
+  m_resultValid = false;
+}
+
+void SearchIndex::handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded) {
+  Q_UNUSED(p_charsRemoved);
+  m_resultValid = false;
+  if (m_patterns.isEmpty()) {
+    return;
+  }
+
+  const int blockCount = m_document->blockCount();
+  auto firstBlock = m_document->findBlock(p_position);
+  auto lastBlock = m_document->findBlock(p_position + p_charsAdded);
+  if (!lastBlock.isValid()) {
+    lastBlock = m_document->lastBlock();
+  }
+  if (!firstBlock.isValid()) {
+    markAllDirty();
+    return;
+  }
+
+  // Blocks out of [first, newLast] are untouched and only shifted by the
+  // change of block count.
+  const int first = firstBlock.blockNumber();
+  const int newLast = lastBlock.blockNumber();
+  const int oldLast = newLast - (blockCount - m_blocks.size());
+  if (oldLast < first || oldLast >= m_blocks.size()) {
+    markAllDirty();
+    return;
+  }
+
+  const int oldSize = oldLast - first + 1;
+  const int newSize = newLast - first + 1;
+  const int kept = qMin(oldSize, newSize);
+  m_firstDirtyBlock = qMin(m_firstDirtyBlock, first);
+  for (int i = first; i < first + kept; ++i) {
+    auto &matches = m_blocks[i];
+    if (!matches.m_dirty) {
+      matches.m_dirty = true;
+      ++m_dirtyBlocks;
+    }
+  }
+
+  if (oldSize > newSize) {
+    const int removedStart = first + kept;
+    const int removedCount = oldSize - newSize;
+    for (int i = removedStart; i < removedStart + removedCount; ++i) {
+      if (m_blocks[i].m_dirty) {
+        --m_dirtyBlocks;
+      }
+    }
+    m_blocks.remove(removedStart, removedCount);
+  } else if (newSize > oldSize) {
+    m_blocks.insert(first + kept, newSize - oldSize, BlockMatches());
+    m_dirtyBlocks += newSize - oldSize;
+  }
+
+  Q_ASSERT(m_blocks.size() == blockCount);
+}
+
+static QString blockSearchText(const QTextBlock &p_block) {
+  // As QTextDocument::find() does.
+  auto text = p_block.text();
+  text.replace(QChar::Nbsp, QLatin1Char(' '));
+  return text;
+}
+
+void SearchIndex::refresh(int p_firstBlock, int p_lastBlock) {
+  if (m_blocks.size() != m_document->blockCount()) {
+    markAllDirty();
+  }
+
+  const int firstBlock = qMax(p_firstBlock, m_firstDirtyBlock);
+  if (m_dirtyBlocks == 0 || firstBlock > p_lastBlock) {
+    return;
+  }
+
+  // Snapshot the dirty blocks, which may then be scanned off the document.
+  QVector<int> blockNumbers;
+  QVector<QString> texts;
+  blockNumbers.reserve(m_dirtyBlocks);
+  texts.reserve(m_dirtyBlocks);
+  qint64 textSize = 0;
+  int idx = firstBlock;
+  for (auto block = m_document->findBlockByNumber(idx); block.isValid() && idx <= p_lastBlock;
+       block = block.next(), ++idx) {
+    if (!m_blocks[idx].m_dirty) {
+      continue;
+    }
+
+    blockNumbers.push_back(idx);
+    texts.push_back(blockSearchText(block));
+    textSize += texts.last().size();
+    if (blockNumbers.size() == m_dirtyBlocks) {
+      break;
+    }
+  }
+  // Every dirty block of the range is scanned.
+  Q_ASSERT(blockNumbers.size() == m_dirtyBlocks ||
+           idx > qMin(p_lastBlock, int(m_blocks.size()) - 1));
+
+  QVector<QVector<Match>> matches(texts.size());
+  if (textSize < c_parallelScanSize) {
+    for (int i = 0; i < texts.size(); ++i) {
+      matches[i] = findInBlockText(texts[i], 0);
+    }
+  } else {
+    findInBlockTextsInParallel(texts, matches);
+  }
+
+  for (int i = 0; i < blockNumbers.size(); ++i) {
+    auto &blockMatches = m_blocks[blockNumbers[i]];
+    blockMatches.m_matches = matches[i];
+    blockMatches.m_dirty = false;
+  }
+
+  m_dirtyBlocks -= blockNumbers.size();
+  if (m_dirtyBlocks == 0) {
+    m_firstDirtyBlock = m_blocks.size();
+  } else if (p_firstBlock <= m_firstDirtyBlock) {
+    // Every block up to @p_lastBlock is clean now.
+    m_firstDirtyBlock = p_lastBlock + 1;
+  }
+}
+
+void SearchIndex::findInBlockTextsInParallel(const QVector<QString> &p_texts,
+                                             QVector<QVector<Match>> &p_matches) const {
+  Q_ASSERT(p_matches.size() == p_texts.size());
+
+  // Chunks of whole blocks, since a match never spans blocks.
+  QVector<int> chunkEnds;
+  int chunkSize = 0;
+  for (int i = 0; i < p_texts.size(); ++i) {
+    chunkSize += p_texts[i].size() + 1;
+    if (chunkSize >= c_scanChunkSize) {
+      chunkEnds.push_back(i + 1);
+      chunkSize = 0;
+    }
+  }
+  if (chunkEnds.isEmpty() || chunkEnds.last() != p_texts.size()) {
+    chunkEnds.push_back(p_texts.size());
+  }
+
+  // Threads take the next chunk until none is left, and each writes the
+  // matches of its own blocks only.
+  auto results = p_matches.data();
+  QAtomicInt nextChunk(0);
+  auto scanChunks = [this, &p_texts, &chunkEnds, results, &nextChunk]() {
+    int chunk = 0;
+    while ((chunk = nextChunk.fetchAndAddRelaxed(1)) < chunkEnds.size()) {
+      const int first = chunk == 0 ? 0 : chunkEnds[chunk - 1];
+      for (int i = first; i < chunkEnds[chunk]; ++i) {
+        results[i] = findInBlockText(p_texts[i], 0);
+      }
+    }
+  };
+
+  // The calling thread scans too, so a busy pool only means fewer helpers.
+  auto pool = QThreadPool::globalInstance();
+  QSemaphore finished;
+  const int maxHelpers = qMin(pool->maxThreadCount(), chunkEnds.size()) - 1;
+  int helpers = 0;
+  for (; helpers < maxHelpers; ++helpers) {
+    auto runnable = new FunctionRunnable([&scanChunks, &finished]() {
+      scanChunks();
+      finished.release();
+    });
+    if (!pool->tryStart(runnable)) {
+      delete runnable;
+      break;
+    }
+  }
+
+  scanChunks();
+  finished.acquire(helpers);
+}
+
+QVector<SearchIndex::Match> SearchIndex::findInBlockText(const QString &p_text,
+                                                         int p_offset) const {
+  QVector<Match> matches;
+  for (int i = 0; i < m_patterns.size(); ++i) {
+    const int first = matches.size();
+    findInText(p_text, m_patterns[i], m_flags, p_offset, matches);
+    for (int j = first; j < matches.size(); ++j) {
+      matches[j].m_pattern = i;
+    }
+  }
+
+  if (m_patterns.size() > 1) {
+    sortMatches(matches);
+  }
+  return matches;
+}
+
+void SearchIndex::findInText(const QString &p_text, const Pattern &p_pattern, FindFlags p_flags,
+                             int p_offset, QVector<Match> &p_matches) {
+  const bool isRegExp = p_flags.testFlag(FindFlag::RegularExpression);
+  const int size = p_text.size();
+  int offset = p_offset;
+  while (offset <= size) {
+    int idx = -1;
+    int length = 0;
+    if (isRegExp) {
+      QRegularExpressionMatch match;
+      idx = p_text.indexOf(p_pattern.m_regExp, offset, &match);
+      if (idx > -1) {
+        length = match.capturedLength();
+      }
+    } else {
+      idx = p_pattern.m_matcher.indexIn(p_text, offset);
+      length = p_pattern.m_text.size();
+    }
+
+    if (idx == -1) {
+      break;
+    }
+
+    const int end = idx + length;
+    if (p_flags & FindFlag::WholeWordOnly) {
+      // QTextDocument::find() goes on one character after the rejected match.
+      if ((idx != 0 && p_text.at(idx - 1).isLetterOrNumber()) ||
+          (end != size && p_text.at(end).isLetterOrNumber())) {
+        offset = end + 1;
+        continue;
+      }
+    }
+
+    Match m;
+    m.m_start = idx;
+    m.m_end = end;
+    p_matches.push_back(m);
+
+    // Step over a zero-length match, such as ^ and $.
+    offset = length == 0 ? end + 1 : end;
+  }
+}
+
+void SearchIndex::sortMatches(QVector<Match> &p_matches) {
+  std::sort(p_matches.begin(), p_matches.end(), [](const Match &p_a, const Match &p_b) {
+    return p_a.m_end < p_b.m_end || (p_a.m_end == p_b.m_end && p_a.m_start < p_b.m_start);
+  });
+}
+
+const QVector<SearchIndex::Match> &SearchIndex::findAll(const QStringList &p_texts,
+                                                        FindFlags p_flags, int p_start,
+                                                        int p_end) {
+  setSearch(p_texts, p_flags);
+  if (m_resultValid && m_resultStart == p_start && m_resultEnd == p_end) {
+    return m_result;
+  }
+
+  m_result.clear();
+  m_resultValid = true;
+  m_resultStart = p_start;
+  m_resultEnd = p_end;
+  if (m_patterns.isEmpty() || (p_start >= p_end && p_end >= 0)) {
+    return m_result;
+  }
+
+  auto block = m_document->findBlock(p_start);
+  auto lastBlock = m_document->findBlock(p_end);
+  if (p_end == -1 || !lastBlock.isValid()) {
+    lastBlock = m_document->lastBlock();
+  }
+  refresh(block.blockNumber(), lastBlock.blockNumber());
+
+  // Follow the loop of VTextEdit::findAllTextInDocument() for each pattern: it
+  // stops once the search start reaches @end, and a match ending beyond @end is
+  // dropped.
+  const int end = p_end == -1 ? m_document->characterCount() + 1 : p_end;
+  QVector<int> searchStarts(m_patterns.size(), p_start);
+  int remaining = m_patterns.size();
+  auto append = [this, end, &searchStarts, &remaining](int p_position, const Match &p_match) {
+    int &searchStart = searchStarts[p_match.m_pattern];
+    if (searchStart == std::numeric_limits<int>::max()) {
+      return;
+    }
+
+    if (searchStart >= end || p_position + p_match.m_end > end) {
+      searchStart = std::numeric_limits<int>::max();
+      --remaining;
+      return;
+    }
+
+    Match m = p_match;
+    m.m_start += p_position;
+    m.m_end += p_position;
+    m_result.push_back(m);
+    searchStart = m.m_end + (m.m_start == m.m_end ? 1 : 0);
+  };
+
+  int idx = block.blockNumber();
+  for (; remaining > 0 && block.isValid() && block.position() <= end;
+       block = block.next(), ++idx) {
+    const int position = block.position();
+    if (position < p_start) {
+      // The matches from @p_start on may differ from the ones from the block start.
+      const auto matches = findInBlockText(blockSearchText(block), p_start - position);
+      for (const auto &m : matches) {
+        append(position, m);
+      }
+      continue;
+    }
+
+    Q_ASSERT(!m_blocks[idx].m_dirty);
+    for (const auto &m : m_blocks[idx].m_matches) {
+      append(position, m);
+    }
+  }
+
+  return m_result;
+}
@@ -0,0 +1,127 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QObject>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QStringMatcher>
+#include <QVector>
+
+#include <vtextedit/global.h>
+
+class QTextDocument;
+
+namespace vte {
+// Matches of one search in a document, kept per block and refreshed only for
+// the blocks changed since the last query.
+// Like QTextDocument::find(), a match never spans blocks, so the matches of a
+// block depend on its text only. This holds for regular expressions too:
+// there is no block separator in the text they are matched against.
+// Large scans run over a snapshot of the block texts, split at block
+// boundaries across the global thread pool.
+class SearchIndex : public QObject {
+  Q_OBJECT
+public:
+  // Document positions, [m_start, m_end).
+  struct Match {
+    int m_start = 0;
+
+    int m_end = 0;
+
+    // Index of the pattern matched, among the non-empty and valid texts searched.
+    int m_pattern = 0;
+  };
+
+  struct Pattern {
+    QString m_text;
+
+    // Used if searching literally.
+    QStringMatcher m_matcher;
+
+    // Valid if searching by regular expression.
+    QRegularExpression m_regExp;
+  };
+
+  explicit SearchIndex(QTextDocument *p_doc, QObject *p_parent = nullptr);
+
+  // Matches of @p_texts in [@p_start, @p_end), sorted by their end. @p_end is
+  // -1 for the document end. The same matches as calling QTextDocument::find()
+  // from @p_start on, one text after another. Valid until the next call.
+  // Only the blocks of the range are scanned, so a small range stays cheap on a
+  // large document.
+  const QVector<Match> &findAll(const QStringList &p_texts, FindFlags p_flags, int p_start,
+                                int p_end);
+
+  // Forget the search and its matches.
+  void clear();
+
+  // Append the matches of @p_pattern in @p_text from @p_offset on, as
+  // QTextDocument::find() gives them within one block. Offsets are in
+  // @p_text. Safe to call from several threads with the same @p_pattern.
+  static void findInText(const QString &p_text, const Pattern &p_pattern, FindFlags p_flags,
+                         int p_offset, QVector<Match> &p_matches);
+
+  // Sort by end, then by start, as sorting QTextCursor does.
+  static void sortMatches(QVector<Match> &p_matches);
+
+private:
+  struct BlockMatches {
+    bool m_dirty = true;
+
+    // Offsets in the block.
+    QVector<Match> m_matches;
+  };
+
+  void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+  void setSearch(const QStringList &p_texts, FindFlags p_flags);
+
+  void markAllDirty();
+
+  // Scan the blocks in [@p_firstBlock, @p_lastBlock] changed since they were
+  // last scanned.
+  void refresh(int p_firstBlock, int p_lastBlock);
+
+  // Matches of the current search in @p_text from @p_offset on.
+  QVector<Match> findInBlockText(const QString &p_text, int p_offset) const;
+
+  // Fill @p_matches with the matches of each of @p_texts, using the thread pool.
+  void findInBlockTextsInParallel(const QVector<QString> &p_texts,
+                                  QVector<QVector<Match>> &p_matches) const;
+
+  // Dirty text size in characters from which refresh() scans in parallel.
+  static const int c_parallelScanSize;
+
+  // Size in characters of the chunks of blocks a thread scans at a time.
+  static const int c_scanChunkSize;
+
+  QTextDocument *m_document = nullptr;
+
+  QStringList m_texts;
+
+  FindFlags m_flags = FindFlag::None;
+
+  QVector<Pattern> m_patterns;
+
+  // One entry per block, in block order.
+  QVector<BlockMatches> m_blocks;
+
+  int m_dirtyBlocks = 0;
+
+  // No block before it is dirty.
+  int m_firstDirtyBlock = 0;
+
+  // Result of the last findAll() for [m_resultStart, m_resultEnd).
+  QVector<Match> m_result;
+
+  bool m_resultValid = false;
+
+  int m_resultStart = -1;
+
+  int m_resultEnd = -1;
+};
+} // namespace vte
+
+Q_DECLARE_TYPEINFO(vte::SearchIndex::Match, Q_PRIMITIVE_TYPE);
+
+#endif // SEARCHINDEX_H
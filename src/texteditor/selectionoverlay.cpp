@@ -0,0 +1,119 @@
+#include "selectionoverlay.h"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QTextBlock>
+
+using namespace vte;
+
+SelectionOverlay::SelectionOverlay(QObject *p_parent) : QObject(p_parent) {}
+
+void SelectionOverlay::setLayer(int p_layer, const QList<QTextEdit::ExtraSelection> &p_selections) {
+  if (p_selections.isEmpty()) {
+    m_layers.remove(p_layer);
+    return;
+  }
+
+  auto &layer = m_layers[p_layer];
+  layer.m_selections.clear();
+  layer.m_selections.reserve(p_selections.size());
+  for (const auto &selection : p_selections) {
+    layer.m_selections.append(selection);
+  }
+  updateMaxLength(layer);
+
+  // Mostly sorted already. Keep the order of equal ones, which decides the
+  // painting order within the layer.
+  std::stable_sort(layer.m_selections.begin(), layer.m_selections.end(),
+                   [](const QTextEdit::ExtraSelection &p_a, const QTextEdit::ExtraSelection &p_b) {
+                     return p_a.cursor.selectionStart() < p_b.cursor.selectionStart();
+                   });
+}
+
+QList<QTextEdit::ExtraSelection> SelectionOverlay::layer(int p_layer) const {
+  QList<QTextEdit::ExtraSelection> selections;
+  auto it = m_layers.constFind(p_layer);
+  if (it != m_layers.constEnd()) {
+    selections.reserve(it->m_selections.size());
+    for (const auto &selection : it->m_selections) {
+      selections.append(selection);
+    }
+  }
+  return selections;
+}
+
+void SelectionOverlay::clear() { m_layers.clear(); }
+
+void SelectionOverlay::invalidateMaxLength() {
+  for (auto &layer : m_layers) {
+    layer.m_maxLengthDirty = true;
+  }
+}
+
+void SelectionOverlay::updateMaxLength(const Layer &p_layer) {
+  p_layer.m_maxLength = 0;
+  for (const auto &selection : p_layer.m_selections) {
+    p_layer.m_maxLength = qMax(p_layer.m_maxLength, selection.cursor.selectionEnd() -
+                                                        selection.cursor.selectionStart());
+  }
+  p_layer.m_maxLengthDirty = false;
+}
+
+QVector<QTextLayout::FormatRange> SelectionOverlay::formatRanges(const QTextBlock &p_block) const {
+  QVector<QTextLayout::FormatRange> ranges;
+  const int blockStart = p_block.position();
+  const int blockEnd = blockStart + p_block.length();
+  for (const auto &layer : m_layers) {
+    if (layer.m_maxLengthDirty) {
+      updateMaxLength(layer);
+    }
+
+    const auto &selections = layer.m_selections;
+    auto it = std::lower_bound(selections.begin(), selections.end(),
+                               blockStart - layer.m_maxLength,
+                               [](const QTextEdit::ExtraSelection &p_selection, int p_pos) {
+                                 return p_selection.cursor.selectionStart() < p_pos;
+                               });
+    for (; it != selections.end() && it->cursor.selectionStart() < blockEnd; ++it) {
+      appendFormatRange(p_block, it->cursor, it->format, ranges);
+    }
+  }
+  return ranges;
+}
+
+void SelectionOverlay::appendFormatRange(const QTextBlock &p_block, const QTextCursor &p_cursor,
+                                         const QTextCharFormat &p_format,
+                                         QVector<QTextLayout::FormatRange> &p_ranges) {
+  const int blpos = p_block.position();
+  const int bllen = p_block.length();
+  const int selStart = p_cursor.selectionStart() - blpos;
+  const int selEnd = p_cursor.selectionEnd() - blpos;
+  if (selStart < bllen && selEnd > 0 && selEnd > selStart) {
+    QTextLayout::FormatRange o;
+    o.start = selStart;
+    o.length = selEnd - selStart;
+    o.format = p_format;
+    p_ranges.append(o);
+  } else if (!p_cursor.hasSelection() && p_format.hasProperty(QTextFormat::FullWidthSelection) &&
+             p_block.contains(p_cursor.position())) {
+    // For full width selections we don't require an actual selection, just
+    // a position to specify the line. that's more convenience in usage.
+    QTextLayout::FormatRange o;
+    QTextLine l = p_block.layout()->lineForTextPosition(p_cursor.position() - blpos);
+    if (!l.isValid()) {
+      qWarning() << "invalid layout lineForTextPosition" << p_block.blockNumber()
+                 << p_cursor.position() << blpos;
+      Q_ASSERT(false);
+      return;
+    }
+    o.start = l.textStart();
+    o.length = l.textLength();
+    if (o.start + o.length == bllen - 1) {
+      ++o.length; // include newline
+    }
+
+    o.format = p_format;
+    p_ranges.append(o);
+  }
+}
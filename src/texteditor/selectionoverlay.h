@@ -0,0 +1,63 @@
+#ifndef SELECTIONOVERLAY_H
+#define SELECTIONOVERLAY_H
+
+#include <QMap>
+#include <QObject>
+#include <QTextEdit>
+#include <QTextLayout>
+#include <QVector>
+
+class QTextBlock;
+
+namespace vte {
+// Extra selections kept as separate layers, such as the cursor line, the search
+// matches and the trailing spaces, for a document layout to paint by itself.
+// Setting one layer leaves the others untouched, and the selections of a block
+// are looked up instead of split out of one list of all selections.
+// A layout supporting it owns one as a direct child.
+class SelectionOverlay : public QObject {
+  Q_OBJECT
+public:
+  explicit SelectionOverlay(QObject *p_parent = nullptr);
+
+  // Replace the selections of @p_layer. Layers are painted in ascending order.
+  void setLayer(int p_layer, const QList<QTextEdit::ExtraSelection> &p_selections);
+
+  QList<QTextEdit::ExtraSelection> layer(int p_layer) const;
+
+  void clear();
+
+  // Called on an insertion into the document, which may lengthen selections.
+  void invalidateMaxLength();
+
+  // Format ranges of the selections in @p_block, lower layers first.
+  QVector<QTextLayout::FormatRange> formatRanges(const QTextBlock &p_block) const;
+
+  // Append the part of selection @p_cursor in @p_block to @p_ranges, as
+  // QTextEdit does. A full-width selection without selected text marks the
+  // visual line of its position.
+  static void appendFormatRange(const QTextBlock &p_block, const QTextCursor &p_cursor,
+                                const QTextCharFormat &p_format,
+                                QVector<QTextLayout::FormatRange> &p_ranges);
+
+private:
+  struct Layer {
+    // Sorted by selection start. Cursors follow the edits, which keeps the
+    // order.
+    QVector<QTextEdit::ExtraSelection> m_selections;
+
+    // Max length of the selections, so that a selection starting before a
+    // block but reaching into it is not missed. Recomputed on the next lookup
+    // once an edit may have lengthened a selection.
+    mutable int m_maxLength = 0;
+
+    mutable bool m_maxLengthDirty = false;
+  };
+
+  static void updateMaxLength(const Layer &p_layer);
+
+  QMap<int, Layer> m_layers;
+};
+} // namespace vte
+
+#endif // SELECTIONOVERLAY_H
@@ -11,8 +11,6 @@
 #include "ksyntaxhighlighterwrapper.h"
 #include <vtextedit/textblockdata.h>
 
-#include "blockspellcheckdata.h"
-#include <spellcheck/spellcheckhighlighthelper.h>
 
 #include <utils/utils.h>
 
@@ -75,14 +73,7 @@ void SyntaxHighlighter::highlightBlock(const QString &p_text) {
 
   // Do spell check.
   if (!p_text.isEmpty() && m_spellCheckEnabled) {
-    bool ret = SpellCheckHighlightHelper::checkBlock(block, p_text, m_autoDetectLanguageEnabled);
-    if (ret) {
-      // Further check and highlight.
-      auto spellData = data->getBlockSpellCheckData();
-      if (spellData && spellData->isValid(block.revision()) && !spellData->isEmpty()) {
-        VSyntaxHighlighter::highlightMisspell(spellData);
-      }
-    }
+    spellCheckCurrentBlock(p_text);
   }
 
   // Store the state.
@@ -1,6 +1,7 @@
 #include "textfolding.h"
 
 #include <QDebug>
+#include <QMetaMethod>
 #include <QTextDocument>
 
 #include "extraselectionmgr.h"
@@ -42,10 +43,24 @@ QString TextFolding::FoldingRange::toString() const {
   return QStringLiteral("range [%1, %2]").arg(first()).arg(last());
 }
 
-TextFolding::TextFolding(QTextDocument *p_document) : QObject(p_document), m_document(p_document) {
+int TextFolding::EditedBlocks::map(int p_blockNumber) const {
+  if (p_blockNumber < m_first) {
+    return p_blockNumber;
+  } else if (p_blockNumber > m_lastBeforeEdit) {
+    return p_blockNumber + m_blockDelta;
+  }
+
+  return qMin(p_blockNumber, m_last);
+}
+
+TextFolding::TextFolding(QTextDocument *p_document)
+    : QObject(p_document), m_document(p_document), m_blockCount(p_document->blockCount()) {
   connect(m_document, &QTextDocument::contentsChange, this,
           [this](int p_position, int p_charsRemoved, int p_charsAdded) {
             if (p_charsRemoved > 0 || p_charsAdded > 0) {
+              const int blockDelta = m_document->blockCount() - m_blockCount;
+              m_blockCount = m_document->blockCount();
+
               // Detect full document replacement (e.g., setPlainText / clear).
               // All previously stored QTextBlock references are stale and must
               // not be accessed.  Hard-clear instead of checkAndUpdateFoldings.
@@ -53,10 +68,14 @@ TextFolding::TextFolding(QTextDocument *p_document) : QObject(p_document), m_doc
                   && p_charsAdded + 1 >= m_document->characterCount()) {
                 hardClear();
               } else {
-                checkAndUpdateFoldings();
+                checkAndUpdateFoldingsForEdit(p_position, p_charsAdded, blockDelta);
+                invalidateFoldedLineIndexForEdit(p_position, p_charsAdded);
               }
             }
           });
+
+  connect(this, &TextFolding::foldingRangesChanged, this,
+          [this]() { invalidateFoldedLineIndex(); });
 }
 
 TextFolding::~TextFolding() { qDeleteAll(m_foldingRanges); }
@@ -78,6 +97,7 @@ void TextFolding::clear() {
   m_idToFoldingRange.clear();
   qDeleteAll(m_foldingRanges);
   m_foldingRanges.clear();
+  invalidateFoldedLineIndex();
 
   markDocumentContentsDirty();
   emit foldingRangesChanged();
@@ -134,6 +154,7 @@ void TextFolding::hardClear() {
   m_foldedFoldingRanges.clear();
   qDeleteAll(m_foldingRanges);
   m_foldingRanges.clear();
+  invalidateFoldedLineIndex();
 
   // Restore the visibility of every block, without going through the ranges.
   //
@@ -169,6 +190,13 @@ qint64 TextFolding::newFoldingRange(const TextBlockRange &p_range, FoldingRangeF
     return InvalidRangeId;
   }
 
+  if (m_document->blockCount() != m_blockCount) {
+    // Added in reaction to an edit the contentsChange handler has not seen yet.
+    // The handler would take the post-edit block numbers of the new range for
+    // pre-edit ones.
+    m_fullCheckPending = true;
+  }
+
   auto newRange = new FoldingRange(p_range, p_flags);
   if (!insertNewFoldingRange(nullptr, m_foldingRanges, newRange)) {
     delete newRange;
@@ -186,7 +214,7 @@ qint64 TextFolding::newFoldingRange(const TextBlockRange &p_range, FoldingRangeF
 
   if (newRange->isFolded()) {
     updateFoldedRangesForNewRange(newRange);
-    markDocumentContentsDirty(newRange->m_range);
+    notifyBlocksVisibilityChanged(newRange->m_range);
   }
 
   emit foldingRangesChanged();
@@ -336,6 +364,7 @@ void TextFolding::updateFoldedRangesForNewRange(TextFolding::FoldingRange *p_new
   }
 
   m_foldedFoldingRanges = foldedFoldingRanges;
+  invalidateFoldedLineIndex();
 
   setRangeFolded(p_newRange->m_range, true);
 }
@@ -368,6 +397,7 @@ void TextFolding::updateFoldedRangesForRemovedRange(TextFolding::FoldingRange *p
   }
 
   m_foldedFoldingRanges = foldedFoldingRanges;
+  invalidateFoldedLineIndex();
 }
 
 QVector<QPair<qint64, TextFolding::FoldingRangeFlags>>
@@ -410,17 +440,18 @@ void TextFolding::setRangeFolded(const TextBlockRange &p_range, bool p_folded) c
     return;
   }
 
+  // One pass over the span. The end is detected by block identity since
+  // QTextBlock::blockNumber() walks the block tree on every call.
   auto blockIt = p_range.first();
+  const auto lastBlock = p_range.last();
   blockIt.setVisible(true);
-
-  int lastBlockNumber = p_range.last().blockNumber();
-  if (blockIt.blockNumber() == lastBlockNumber) {
+  if (blockIt == lastBlock) {
     return;
   }
 
   blockIt = blockIt.next();
   while (blockIt.isValid()) {
-    if (blockIt.blockNumber() == lastBlockNumber) {
+    if (blockIt == lastBlock) {
       blockIt.setVisible(true);
       break;
     }
@@ -566,7 +597,7 @@ void TextFolding::foldRange(FoldingRange *p_range) {
 
   p_range->m_flags |= TextFolding::FoldingRangeFlag::Folded;
   updateFoldedRangesForNewRange(p_range);
-  markDocumentContentsDirty(p_range->m_range);
+  notifyBlocksVisibilityChanged(p_range->m_range);
   emit foldingRangesChanged();
 }
 
@@ -603,9 +634,9 @@ bool TextFolding::unfoldRange(FoldingRange *p_range, bool p_remove) {
   if (p_range->isFolded()) {
     p_range->m_flags &= ~TextFolding::FoldingRangeFlag::Folded;
     updateFoldedRangesForRemovedRange(p_range);
+    notifyBlocksVisibilityChanged(p_range->m_range);
   }
 
-  markDocumentContentsDirty(p_range->m_range);
   emit foldingRangesChanged();
 
   if (needToRemove) {
@@ -632,6 +663,18 @@ void TextFolding::markDocumentContentsDirty(const TextBlockRange &p_range) {
   markDocumentContentsDirty(pos, len);
 }
 
+void TextFolding::notifyBlocksVisibilityChanged(const TextBlockRange &p_range) {
+  static const auto visibilitySignal =
+      QMetaMethod::fromSignal(&TextFolding::blocksVisibilityChanged);
+  if (!p_range.isValid() || !isSignalConnected(visibilitySignal)) {
+    // A layout which does not know about the bulk path relays the range out.
+    markDocumentContentsDirty(p_range);
+    return;
+  }
+
+  emit blocksVisibilityChanged(p_range.first().blockNumber(), p_range.last().blockNumber());
+}
+
 TextFolding::FoldingRange::Vector
 TextFolding::retrieveFoldedRanges(const TextFolding::FoldingRange::Vector &p_ranges) const {
   FoldingRange::Vector foldedRanges;
@@ -657,21 +700,35 @@ void TextFolding::unfoldRangeWithNestedFoldedRanges(
   auto blockIt = p_range.first();
   auto lastBlockNumber = p_range.last().blockNumber();
   int idx = 0;
+  // Block numbers are counted along and the extent of the current child is
+  // read once, since QTextBlock::blockNumber() walks the block tree.
+  int childFirst = -1;
+  int childLast = -1;
+  auto fetchChild = [&]() {
+    if (idx < p_foldedChildren.size()) {
+      childFirst = p_foldedChildren[idx]->first();
+      childLast = p_foldedChildren[idx]->last();
+    }
+  };
+  fetchChild();
+
+  int blockNumber = blockIt.blockNumber() - 1;
   while (blockIt.isValid()) {
-    int blockNumber = blockIt.blockNumber();
+    ++blockNumber;
     bool isHit = false;
     if (idx < p_foldedChildren.size()) {
-      const auto &range = p_foldedChildren[idx];
-      if (range->first() <= blockNumber && range->last() >= blockNumber) {
+      if (childFirst <= blockNumber && childLast >= blockNumber) {
         isHit = true;
-        if (range->first() == blockNumber) {
+        if (childFirst == blockNumber) {
           blockIt.setVisible(true);
-          if (range->last() == blockNumber) {
+          if (childLast == blockNumber) {
             ++idx;
+            fetchChild();
           }
-        } else if (range->last() == blockNumber) {
+        } else if (childLast == blockNumber) {
           blockIt.setVisible(true);
           ++idx;
+          fetchChild();
         } else {
           blockIt.setVisible(false);
         }
@@ -691,16 +748,27 @@ void TextFolding::unfoldRangeWithNestedFoldedRanges(
 
 void TextFolding::checkAndUpdateFoldings() {
   if (!m_enabled) {
+    m_fullCheckPending = true;
     return;
   }
 
+  m_fullCheckPending = false;
+  m_blockCount = m_document->blockCount();
+
   bool needUpdate = checkAndUpdateFoldings(m_foldingRanges);
   if (needUpdate) {
+    invalidateFoldedLineIndex();
     markDocumentContentsDirty();
     emit foldingRangesChanged();
   }
 }
 
+void TextFolding::checkAndUpdatePendingFoldings() {
+  if (m_fullCheckPending || m_document->blockCount() != m_blockCount) {
+    checkAndUpdateFoldings();
+  }
+}
+
 bool TextFolding::checkAndUpdateFoldings(TextFolding::FoldingRange::Vector &p_ranges) {
   if (p_ranges.isEmpty()) {
     return false;
@@ -724,24 +792,9 @@ bool TextFolding::checkAndUpdateFoldings(TextFolding::FoldingRange::Vector &p_ra
       // Remove this range and expose its children.
       needUpdate = true;
 
-      // Remove the range from id mapping.
-      m_idToFoldingRange.remove(range->m_id);
-
-      // Reparent our nested folding ranges.
-      for (auto nestedRange : qAsConst(range->m_nestedRanges)) {
-        nestedRange->m_parent = range->m_parent;
-        newRanges.push_back(nestedRange);
-      }
-
-      if (range->isFolded()) {
-        range->m_flags &= ~TextFolding::FoldingRangeFlag::Folded;
-        updateFoldedRangesForRemovedRange(range);
-
+      if (removeInvalidFoldingRange(range, newRanges)) {
         needUnfold = true;
       }
-
-      range->m_nestedRanges.clear();
-      delete range;
     }
   }
 
@@ -756,6 +809,164 @@ bool TextFolding::checkAndUpdateFoldings(TextFolding::FoldingRange::Vector &p_ra
   return needUpdate;
 }
 
+void TextFolding::checkAndUpdateFoldingsForEdit(int p_position, int p_charsAdded,
+                                                int p_blockDelta) {
+  if (!m_enabled || m_fullCheckPending) {
+    checkAndUpdateFoldings();
+    return;
+  }
+
+  if (m_foldingRanges.isEmpty()) {
+    return;
+  }
+
+  auto lastBlock = m_document->findBlock(p_position + p_charsAdded);
+  if (!lastBlock.isValid()) {
+    lastBlock = m_document->lastBlock();
+  }
+  auto firstBlock = m_document->findBlock(p_position);
+  if (!firstBlock.isValid()) {
+    firstBlock = lastBlock;
+  }
+
+  EditedBlocks edit;
+  edit.m_first = firstBlock.blockNumber();
+  edit.m_last = lastBlock.blockNumber();
+  edit.m_lastBeforeEdit = edit.m_last - p_blockDelta;
+  edit.m_blockDelta = p_blockDelta;
+
+  int dirtyFirst = -1;
+  int dirtyLast = -1;
+  bool needUpdate = checkAndUpdateFoldings(m_foldingRanges, edit, dirtyFirst, dirtyLast);
+
+  if (dirtyFirst > -1) {
+    // Only the blocks of the dropped folded ranges change their visibility.
+    auto first = m_document->findBlockByNumber(dirtyFirst);
+    auto last = m_document->findBlockByNumber(dirtyLast);
+    if (!last.isValid()) {
+      last = m_document->lastBlock();
+    }
+    TextBlockRange dirtyRange(first, last);
+
+    auto it = std::lower_bound(m_foldedFoldingRanges.begin(), m_foldedFoldingRanges.end(),
+                               dirtyFirst, [](const FoldingRange *p_range, int p_val) {
+                                 return p_range->last() < p_val;
+                               });
+    FoldingRange::Vector foldedRanges;
+    for (; it != m_foldedFoldingRanges.end() && (*it)->first() <= dirtyLast; ++it) {
+      foldedRanges.push_back(*it);
+    }
+
+    unfoldRangeWithNestedFoldedRanges(dirtyRange, foldedRanges);
+    markDocumentContentsDirty(dirtyRange);
+  }
+
+  if (needUpdate) {
+    invalidateFoldedLineIndex();
+    emit foldingRangesChanged();
+  }
+}
+
+bool TextFolding::checkAndUpdateFoldings(TextFolding::FoldingRange::Vector &p_ranges,
+                                         const EditedBlocks &p_edit, int &p_dirtyFirst,
+                                         int &p_dirtyLast) {
+  const int size = p_ranges.size();
+  if (size == 0) {
+    return false;
+  }
+
+  // Ranges ending before the edit are neither changed nor shifted.
+  int i = std::lower_bound(p_ranges.begin(), p_ranges.end(), p_edit.m_first,
+                           [](const FoldingRange *p_range, int p_val) {
+                             return p_range->m_range.validLastBlockNumber() < p_val;
+                           }) -
+          p_ranges.begin();
+
+  bool needUpdate = false;
+
+  // Only built once a range is dropped.
+  FoldingRange::Vector newRanges;
+  bool removed = false;
+
+  for (; i < size; ++i) {
+    auto range = p_ranges[i];
+    if (range->m_range.validFirstBlockNumber() > p_edit.m_lastBeforeEdit) {
+      break;
+    }
+
+    bool ret = checkAndUpdateFoldings(range->m_nestedRanges, p_edit, p_dirtyFirst, p_dirtyLast);
+    needUpdate = needUpdate | ret;
+
+    if (range->isValid()) {
+      range->m_range.update();
+      if (removed) {
+        newRanges.push_back(range);
+      }
+      continue;
+    }
+
+    needUpdate = true;
+    if (!removed) {
+      removed = true;
+      newRanges = p_ranges.mid(0, i);
+      newRanges.reserve(size);
+    }
+
+    const int first = p_edit.map(range->m_range.validFirstBlockNumber());
+    const int last = p_edit.map(range->m_range.validLastBlockNumber());
+    if (removeInvalidFoldingRange(range, newRanges)) {
+      p_dirtyFirst = p_dirtyFirst > -1 ? qMin(p_dirtyFirst, first) : first;
+      p_dirtyLast = qMax(p_dirtyLast, last);
+    }
+  }
+
+  // Ranges starting after the edit.
+  for (int j = i; j < size; ++j) {
+    if (p_edit.m_blockDelta != 0) {
+      shiftFoldingRange(p_ranges[j], p_edit.m_blockDelta);
+    }
+    if (removed) {
+      newRanges.push_back(p_ranges[j]);
+    }
+  }
+
+  if (removed) {
+    p_ranges = newRanges;
+  }
+
+  return needUpdate;
+}
+
+bool TextFolding::removeInvalidFoldingRange(FoldingRange *p_range,
+                                            FoldingRange::Vector &p_newRanges) {
+  // Remove the range from id mapping.
+  m_idToFoldingRange.remove(p_range->m_id);
+
+  // Reparent our nested folding ranges.
+  for (auto nestedRange : qAsConst(p_range->m_nestedRanges)) {
+    nestedRange->m_parent = p_range->m_parent;
+    p_newRanges.push_back(nestedRange);
+  }
+
+  const bool wasFolded = p_range->isFolded();
+  if (wasFolded) {
+    p_range->m_flags &= ~TextFolding::FoldingRangeFlag::Folded;
+    updateFoldedRangesForRemovedRange(p_range);
+  }
+
+  p_range->m_nestedRanges.clear();
+  delete p_range;
+
+  return wasFolded;
+}
+
+void TextFolding::shiftFoldingRange(FoldingRange *p_range, int p_delta) {
+  p_range->m_range.shift(p_delta);
+  for (auto range : qAsConst(p_range->m_nestedRanges)) {
+    shiftFoldingRange(range, p_delta);
+  }
+}
+
 QString TextFolding::debugDump() const {
   return QStringLiteral("tree %1 - folded %2")
       .arg(debugDump(m_foldingRanges, true), debugDump(m_foldedFoldingRanges, false));
@@ -813,6 +1024,61 @@ void TextFolding::setExtraSelectionMgr(ExtraSelectionMgr *p_mgr) {
   });
 }
 
+void TextFolding::invalidateFoldedLineIndex() { m_foldedLineIndex.m_dirty = true; }
+
+void TextFolding::invalidateFoldedLineIndexForEdit(int p_position, int p_charsAdded) {
+  auto &index = m_foldedLineIndex;
+  if (index.m_dirty) {
+    return;
+  }
+
+  // Block numbers after the edit only shift when it added or removed blocks.
+  if (m_document->blockCount() != index.m_blockCount) {
+    invalidateFoldedLineIndex();
+    return;
+  }
+
+  // A grouped edit may add as many blocks as it removes, which keeps the
+  // block count but moves the folded ranges within its span.
+  auto firstBlock = m_document->findBlock(p_position);
+  auto lastBlock = m_document->findBlock(p_position + p_charsAdded);
+  const int first = firstBlock.isValid() ? firstBlock.blockNumber() : 0;
+  const int last = lastBlock.isValid() ? lastBlock.blockNumber() : index.m_blockCount - 1;
+  auto it = std::lower_bound(index.m_entries.constBegin(), index.m_entries.constEnd(), first,
+                             [](const FoldedLineIndex::Entry &p_entry, int p_val) {
+                               return p_entry.m_last < p_val;
+                             });
+  if (it != index.m_entries.constEnd() && it->m_first <= last) {
+    invalidateFoldedLineIndex();
+  }
+}
+
+const TextFolding::FoldedLineIndex &TextFolding::foldedLineIndex() const {
+  auto &index = m_foldedLineIndex;
+  const int blockCount = m_document->blockCount();
+  if (!index.m_dirty && index.m_blockCount == blockCount) {
+    return index;
+  }
+
+  index.m_entries.resize(m_foldedFoldingRanges.size());
+  int hidden = 0;
+  for (int i = 0; i < m_foldedFoldingRanges.size(); ++i) {
+    const auto range = m_foldedFoldingRanges[i];
+    Q_ASSERT(range->isValid());
+    auto &entry = index.m_entries[i];
+    entry.m_first = range->first();
+    entry.m_last = range->last();
+    entry.m_visibleFirst = entry.m_first - hidden;
+    entry.m_hiddenBefore = hidden;
+    hidden += qMax(entry.m_last - entry.m_first - 1, 0);
+  }
+
+  index.m_totalHidden = hidden;
+  index.m_blockCount = blockCount;
+  index.m_dirty = false;
+  return index;
+}
+
 int TextFolding::lineToVisibleLine(int p_line) const {
   if (m_foldedFoldingRanges.isEmpty()) {
     return p_line;
@@ -821,23 +1087,24 @@ int TextFolding::lineToVisibleLine(int p_line) const {
     return 0;
   }
 
-  // visible line - line.
-  int delta = 0;
-  for (const auto &range : m_foldedFoldingRanges) {
-    Q_ASSERT(range->isValid());
-    if (p_line <= range->first()) {
-      return p_line + delta;
-    } else if (p_line < range->last()) {
-      // Locate within the folded range.
-      delta += (range->first() - p_line);
-      return p_line + delta;
-    } else {
-      delta -= qMax(range->last() - range->first() - 1, 0);
-    }
+  const auto &index = foldedLineIndex();
+
+  // First folded range not ending at or before @p_line.
+  auto it = std::upper_bound(index.m_entries.begin(), index.m_entries.end(), p_line,
+                             [](int p_val, const FoldedLineIndex::Entry &p_entry) {
+                               return p_val < p_entry.m_last;
+                             });
+  if (it == index.m_entries.end()) {
+    // @p_line goes through all the folded folding ranges.
+    return qMin(p_line, index.m_blockCount - 1) - index.m_totalHidden;
+  }
+
+  if (p_line <= it->m_first) {
+    return p_line - it->m_hiddenBefore;
   }
 
-  // @p_line goes through all the folded folding ranges.
-  return qMin(p_line, m_document->blockCount() - 1) + delta;
+  // Locate within the folded range.
+  return it->m_visibleFirst;
 }
 
 int TextFolding::visibleLineToLine(int p_line) const {
@@ -848,21 +1115,19 @@ int TextFolding::visibleLineToLine(int p_line) const {
     return 0;
   }
 
-  // line - visual line.
-  int delta = 0;
-  for (const auto &range : m_foldedFoldingRanges) {
-    Q_ASSERT(range->isValid());
-    // Visual line for this range.
-    int visualLine = range->first() - delta;
-    if (visualLine >= p_line) {
-      return p_line + delta;
-    } else {
-      delta += qMax(range->last() - range->first() - 1, 0);
-    }
+  const auto &index = foldedLineIndex();
+
+  // First folded range whose first line is visible at or after @p_line.
+  auto it = std::lower_bound(index.m_entries.begin(), index.m_entries.end(), p_line,
+                             [](const FoldedLineIndex::Entry &p_entry, int p_val) {
+                               return p_entry.m_visibleFirst < p_val;
+                             });
+  if (it == index.m_entries.end()) {
+    // @p_line goes through all the folded folding ranges.
+    return qMin(p_line + index.m_totalHidden, index.m_blockCount - 1);
   }
 
-  // @p_line goes through all the folded folding ranges.
-  return qMin(p_line + delta, m_document->blockCount() - 1);
+  return p_line + it->m_hiddenBefore;
 }
 
 void TextFolding::setEnabled(bool p_enable) {
@@ -94,14 +94,29 @@ public:
 
   void setFoldedFoldingRangeLineBackgroundColor(const QColor &p_color);
 
+  // Validate what the edits so far may have broken and the contentsChange
+  // handler could not validate as they happened, i.e. edits made while folding
+  // was disabled or ranges added before the handler saw the edit. Cheap when
+  // there is nothing pending.
+  void checkAndUpdatePendingFoldings();
+
 public slots:
   void clear();
 
+  // Validate every range. Edits are validated incrementally as they happen, so
+  // this is rarely needed.
   void checkAndUpdateFoldings();
 
 signals:
   void foldingRangesChanged();
 
+  // Folding or unfolding a range flipped the visibility of the blocks within
+  // [@p_firstBlock, @p_lastBlock] and nothing else. When connected, the
+  // receiver updates the geometry of these blocks itself and the document
+  // contents are not marked dirty, so neither a relayout of the whole span nor
+  // a rehighlight is triggered. Emitted before foldingRangesChanged().
+  void blocksVisibilityChanged(int p_firstBlock, int p_lastBlock);
+
 private:
   class FoldingRange {
   public:
@@ -144,6 +159,43 @@ private:
     qint64 m_id = InvalidRangeId;
   };
 
+  // Flat index of m_foldedFoldingRanges for the line mappings.
+  //
+  // Entry i holds the block extent of the i-th folded range and the number of
+  // lines hidden by the ranges before it, so both mappings are one binary
+  // search. Rebuilt lazily, in one pass, after the folding ranges change or an
+  // edit shifts block numbers or touches a folded range; other edits keep it.
+  struct FoldedLineIndex {
+    struct Entry {
+      int m_first = 0;
+
+      int m_last = 0;
+
+      // Visible line of m_first.
+      int m_visibleFirst = 0;
+
+      // Number of lines hidden by the folded ranges before this one.
+      int m_hiddenBefore = 0;
+    };
+
+    QVector<Entry> m_entries;
+
+    int m_totalHidden = 0;
+
+    // Block count of the document when built.
+    int m_blockCount = -1;
+
+    bool m_dirty = true;
+  };
+
+  const FoldedLineIndex &foldedLineIndex() const;
+
+  void invalidateFoldedLineIndex();
+
+  // Invalidate the folded line index if the edit of the contentsChange handler
+  // added or removed blocks, or touched a folded range.
+  void invalidateFoldedLineIndexForEdit(int p_position, int p_charsAdded);
+
   bool insertNewFoldingRange(FoldingRange *p_parent, FoldingRange::Vector &p_ranges,
                              FoldingRange *p_newRange);
 
@@ -176,6 +228,10 @@ private:
 
   void markDocumentContentsDirty(const TextBlockRange &p_range);
 
+  // Emit blocksVisibilityChanged() for @p_range, or mark it dirty when nobody
+  // listens.
+  void notifyBlocksVisibilityChanged(const TextBlockRange &p_range);
+
   FoldingRange::Vector
   retrieveFoldedRanges(const TextFolding::FoldingRange::Vector &p_ranges) const;
 
@@ -183,8 +239,43 @@ private:
       const TextBlockRange &p_range,
       const TextFolding::FoldingRange::Vector &p_foldedChildren) const;
 
+  // Blocks touched by one edit.
+  struct EditedBlocks {
+    // Post-edit number of @p_blockNumber, a block number before the edit.
+    // Blocks within the edit are clamped into it.
+    int map(int p_blockNumber) const;
+
+    // First block touched, both before and after the edit.
+    int m_first = 0;
+
+    // Last block touched after the edit.
+    int m_last = 0;
+
+    // Last block touched before the edit.
+    int m_lastBeforeEdit = 0;
+
+    // Number of blocks added by the edit; negative if removed.
+    int m_blockDelta = 0;
+  };
+
   bool checkAndUpdateFoldings(TextFolding::FoldingRange::Vector &p_ranges);
 
+  // Validate only the ranges intersecting @p_edit, located by the block numbers
+  // cached in their TextBlockRange, which are the pre-edit ones. The ranges
+  // after the edit are shifted and the ones before it are left untouched.
+  // [@p_dirtyFirst, @p_dirtyLast] is extended by the blocks of every dropped
+  // folded range.
+  bool checkAndUpdateFoldings(TextFolding::FoldingRange::Vector &p_ranges,
+                              const EditedBlocks &p_edit, int &p_dirtyFirst, int &p_dirtyLast);
+
+  void checkAndUpdateFoldingsForEdit(int p_position, int p_charsAdded, int p_blockDelta);
+
+  // Drop @p_range, which is no longer valid, and append its nested ranges to
+  // @p_newRanges. Return true if it was folded.
+  bool removeInvalidFoldingRange(FoldingRange *p_range, FoldingRange::Vector &p_newRanges);
+
+  static void shiftFoldingRange(FoldingRange *p_range, int p_delta);
+
   void hardClear();
 
   QString debugDump(const TextFolding::FoldingRange::Vector &p_ranges, bool p_recursive) const;
@@ -219,6 +310,15 @@ private:
   // this.
   FoldingRange::Vector m_foldedFoldingRanges;
 
+  mutable FoldedLineIndex m_foldedLineIndex;
+
+  // Block count as of the last edit the contentsChange handler saw.
+  int m_blockCount = 0;
+
+  // Whether the block numbers cached in the ranges may be stale, in which case
+  // the next validation has to walk the whole tree.
+  bool m_fullCheckPending = false;
+
   qint64 m_nextId = 0;
 
   QHash<qint64, FoldingRange *> m_idToFoldingRange;
@@ -1,13 +1,45 @@
 #include <vtextedit/vsyntaxhighlighter.h>
 
 #include <QTextDocument>
+#include <QTimer>
 
 #include "blockspellcheckdata.h"
+#include <spellcheck/spellcheckworker.h>
+#include <vtextedit/spellchecker.h>
 #include <vtextedit/textblockdata.h>
 
 using namespace vte;
 
-VSyntaxHighlighter::VSyntaxHighlighter(QTextDocument *p_doc) : QSyntaxHighlighter(p_doc) {}
+const int VSyntaxHighlighter::c_spellCheckViewportMargin = 50;
+
+const int VSyntaxHighlighter::c_spellCheckBackfillBatchSize = 32;
+
+const int VSyntaxHighlighter::c_spellCheckBackfillScanSize = 2000;
+
+const int VSyntaxHighlighter::c_spellCheckBackfillInterval = 300;
+
+VSyntaxHighlighter::VSyntaxHighlighter(QTextDocument *p_doc)
+    : QSyntaxHighlighter(p_doc), m_misspellingTally(new MisspellingTally()),
+      m_visibleBlockRange(-1, -1) {
+  m_spellCheckBackfillTimer = new QTimer(this);
+  m_spellCheckBackfillTimer->setSingleShot(true);
+  m_spellCheckBackfillTimer->setInterval(c_spellCheckBackfillInterval);
+  connect(m_spellCheckBackfillTimer, &QTimer::timeout, this,
+          &VSyntaxHighlighter::backfillSpellCheck);
+
+  if (p_doc) {
+    m_contentsRevision = p_doc->revision();
+    m_contentsBlockCount = p_doc->blockCount();
+    connect(p_doc, &QTextDocument::contentsChange, this,
+            &VSyntaxHighlighter::handleSpellCheckContentsChange);
+  }
+}
+
+VSyntaxHighlighter::~VSyntaxHighlighter() {
+  // Join the worker before the blocks it posts results for go away.
+  delete m_spellCheckWorker;
+  m_spellCheckWorker = nullptr;
+}
 
 void VSyntaxHighlighter::highlightMisspell(const QSharedPointer<BlockSpellCheckData> &p_data) {
   for (const auto &seg : p_data->m_misspellings) {
@@ -35,25 +67,220 @@ void VSyntaxHighlighter::setAutoDetectLanguageEnabled(bool p_enabled) {
   refreshSpellCheck();
 }
 
+void VSyntaxHighlighter::spellCheckCurrentBlock(const QString &p_text) {
+  auto block = currentBlock();
+  auto spellData = blockSpellCheckData(block, true);
+
+  const int revision = block.revision();
+  if (spellData->isValid(revision)) {
+    if (!spellData->isEmpty()) {
+      highlightMisspell(spellData);
+    }
+    return;
+  }
+
+  if (p_text.length() < 2) {
+    spellData->setMisspellings(QVector<BlockSegment>());
+    spellData->m_revision = revision;
+    return;
+  }
+
+  // Keep the underlines of the previous text until the worker answers, so they
+  // do not flicker off on each keystroke. Those past the new end are dropped.
+  auto misspellings = spellData->m_misspellings;
+  for (int i = misspellings.size() - 1; i >= 0; --i) {
+    if (misspellings[i].m_offset + misspellings[i].m_length > p_text.length()) {
+      misspellings.remove(i);
+    }
+  }
+  if (misspellings.size() != spellData->m_misspellings.size()) {
+    spellData->setMisspellings(misspellings);
+  }
+  if (!misspellings.isEmpty()) {
+    highlightMisspell(spellData);
+  }
+
+  const int blockNumber = block.blockNumber();
+  if (!isInSpellCheckViewport(blockNumber)) {
+    scheduleSpellCheckBackfill(blockNumber);
+    return;
+  }
+
+  // Most likely the block being edited.
+  requestSpellCheck(block, p_text, spellData, true);
+}
+
+bool VSyntaxHighlighter::prepareSpellCheck(const QTextBlock &p_block, bool p_backfill,
+                                           SpellCheckJob &p_job) {
+  auto spellData = blockSpellCheckData(p_block, true);
+
+  const int revision = p_block.revision();
+  if (spellData->isValid(revision) || spellData->m_pendingRevision == revision) {
+    return false;
+  }
+
+  // QTextBlock::length() counts the block separator.
+  if (p_block.length() < 3 || !isSpellCheckNeeded(p_block)) {
+    if (!spellData->isEmpty()) {
+      spellData->setMisspellings(QVector<BlockSegment>());
+      rehighlightBlock(p_block);
+    }
+    spellData->m_revision = revision;
+    return false;
+  }
+
+  spellData->m_pendingRevision = revision;
+
+  p_job.m_block = p_block;
+  p_job.m_revision = revision;
+  p_job.m_text = p_block.text();
+  p_job.m_language = m_spellCheckLanguage;
+  p_job.m_autoDetectEnabled = m_autoDetectLanguageEnabled;
+  p_job.m_generation = m_spellCheckGeneration;
+  p_job.m_backfill = p_backfill;
+  return true;
+}
+
+void VSyntaxHighlighter::requestSpellCheck(const QTextBlock &p_block, const QString &p_text,
+                                           const QSharedPointer<BlockSpellCheckData> &p_data,
+                                           bool p_urgent) {
+  const int revision = p_block.revision();
+  if (p_data->m_pendingRevision == revision) {
+    return;
+  }
+
+  // Called for each block highlighted, so the speller state read with the
+  // last batch is used rather than taking the speller lock the worker may hold.
+  if (!m_spellCheckerStateRead) {
+    readSpellCheckerState();
+  }
+  if (!m_spellCheckerValid) {
+    return;
+  }
+
+  p_data->m_pendingRevision = revision;
+
+  SpellCheckJob job;
+  job.m_block = p_block;
+  job.m_revision = revision;
+  job.m_text = p_text;
+  job.m_language = m_spellCheckLanguage;
+  job.m_autoDetectEnabled = m_autoDetectLanguageEnabled;
+  job.m_generation = m_spellCheckGeneration;
+  ++m_spellCheckJobsInFlight;
+  spellCheckWorker()->enqueue(job, p_urgent);
+}
+
+void VSyntaxHighlighter::handleSpellCheckResults(const QVector<SpellCheckResult> &p_results) {
+  for (const auto &res : p_results) {
+    const auto &job = res.m_job;
+    if (job.m_generation != m_spellCheckGeneration || !m_spellCheckEnabled) {
+      continue;
+    }
+
+    Q_ASSERT(m_spellCheckJobsInFlight > 0);
+    --m_spellCheckJobsInFlight;
+
+    if (job.m_backfill) {
+      Q_ASSERT(m_backfillJobsInFlight > 0);
+      if (--m_backfillJobsInFlight == 0) {
+        m_spellCheckBackfillTimer->start();
+      }
+    }
+
+    // The block changed meanwhile: the highlight of its new text asked again,
+    // or left it to the backfill.
+    auto block = job.m_block;
+    if (!block.isValid() || block.document() != document() ||
+        block.revision() != job.m_revision || block.text() != job.m_text) {
+      continue;
+    }
+
+    auto spellData = blockSpellCheckData(block, false);
+    if (!spellData || spellData->isValid(job.m_revision)) {
+      continue;
+    }
+
+    if (spellData->m_pendingRevision == job.m_revision) {
+      spellData->m_pendingRevision = -1;
+    }
+
+    const bool changed = spellData->m_misspellings != res.m_misspellings;
+    spellData->m_revision = job.m_revision;
+    spellData->setMisspellings(res.m_misspellings);
+    if (changed) {
+      rehighlightBlock(block);
+    }
+  }
+}
+
+void VSyntaxHighlighter::readSpellCheckerState() {
+  auto &speller = SpellChecker::getInst();
+  m_spellCheckerValid = speller.isValid();
+  m_spellCheckLanguage = speller.currentLanguage();
+  m_spellCheckerStateRead = true;
+}
+
+SpellCheckWorker *VSyntaxHighlighter::spellCheckWorker() {
+  if (!m_spellCheckWorker) {
+    m_spellCheckWorker = new SpellCheckWorker(this);
+  }
+  return m_spellCheckWorker;
+}
+
 void VSyntaxHighlighter::refreshSpellCheck() {
-  // Clear all the spell check cache data.
-  auto block = document()->firstBlock();
-  while (block.isValid()) {
-    auto data = TextBlockData::get(block);
-    auto spellData = data->getBlockSpellCheckData();
-    if (spellData) {
+  ++m_spellCheckGeneration;
+  if (m_spellCheckWorker) {
+    m_spellCheckWorker->clear();
+  }
+  m_spellCheckJobsInFlight = 0;
+  m_backfillJobsInFlight = 0;
+  m_backfillDone = true;
+  m_spellCheckBackfillTimer->stop();
+
+  auto doc = document();
+  if (!doc) {
+    return;
+  }
+
+  if (!m_spellCheckEnabled) {
+    // Only the blocks with underlines need a rehighlight.
+    for (auto block = doc->firstBlock(); block.isValid(); block = block.next()) {
+      auto spellData = blockSpellCheckData(block, false);
+      if (!spellData) {
+        continue;
+      }
+
+      const bool hasUnderlines = !spellData->isEmpty();
       spellData->clear();
+      if (hasUnderlines) {
+        rehighlightBlock(block);
+      }
     }
+    return;
+  }
 
-    block = block.next();
+  readSpellCheckerState();
+  if (!m_spellCheckerValid) {
+    return;
+  }
+
+  // Mark every block stale but keep what is underlined until its new result
+  // comes. Only the viewport is checked right away.
+  for (auto block = doc->firstBlock(); block.isValid(); block = block.next()) {
+    auto spellData = blockSpellCheckData(block, false);
+    if (spellData) {
+      spellData->m_revision = -1;
+      spellData->m_pendingRevision = -1;
+    }
   }
 
-  rehighlight();
+  spellCheckViewport();
+  scheduleSpellCheckBackfill(0);
 }
 
 void VSyntaxHighlighter::refreshBlockSpellCheck(const QTextBlock &p_block) {
-  auto data = TextBlockData::get(p_block);
-  auto spellData = data->getBlockSpellCheckData();
+  auto spellData = blockSpellCheckData(p_block, false);
   if (spellData) {
     spellData->clear();
   }
@@ -61,4 +288,169 @@ void VSyntaxHighlighter::refreshBlockSpellCheck(const QTextBlock &p_block) {
   rehighlightBlock(p_block);
 }
 
+void VSyntaxHighlighter::setVisibleBlockRange(int p_first, int p_last) {
+  if (m_visibleBlockRange.first == p_first && m_visibleBlockRange.second == p_last) {
+    return;
+  }
+
+  m_visibleBlockRange = qMakePair(p_first, p_last);
+  if (m_spellCheckEnabled) {
+    spellCheckViewport();
+  }
+}
+
+bool VSyntaxHighlighter::isInSpellCheckViewport(int p_blockNumber) const {
+  if (m_visibleBlockRange.first < 0) {
+    return false;
+  }
+
+  return p_blockNumber >= m_visibleBlockRange.first - c_spellCheckViewportMargin &&
+         p_blockNumber <= m_visibleBlockRange.second + c_spellCheckViewportMargin;
+}
+
+void VSyntaxHighlighter::spellCheckViewport() {
+  auto doc = document();
+  if (!doc || m_visibleBlockRange.first < 0) {
+    return;
+  }
+
+  readSpellCheckerState();
+  if (!m_spellCheckerValid) {
+    return;
+  }
+
+  const int first = qMax(0, m_visibleBlockRange.first - c_spellCheckViewportMargin);
+  const int last = m_visibleBlockRange.second + c_spellCheckViewportMargin;
+  QVector<SpellCheckJob> jobs;
+  int blockNumber = first;
+  for (auto block = doc->findBlockByNumber(first); block.isValid() && blockNumber <= last;
+       block = block.next(), ++blockNumber) {
+    SpellCheckJob job;
+    if (prepareSpellCheck(block, false, job)) {
+      jobs.push_back(job);
+    }
+  }
+
+  m_spellCheckJobsInFlight += jobs.size();
+  spellCheckWorker()->enqueue(jobs, true);
+}
+
+void VSyntaxHighlighter::scheduleSpellCheckBackfill(int p_blockNumber) {
+  if (m_backfillDone) {
+    m_backfillDone = false;
+    m_backfillNextBlock = p_blockNumber;
+  } else {
+    m_backfillNextBlock = qMin(m_backfillNextBlock, p_blockNumber);
+  }
+
+  if (m_backfillJobsInFlight == 0 && !m_spellCheckBackfillTimer->isActive()) {
+    m_spellCheckBackfillTimer->start();
+  }
+}
+
+void VSyntaxHighlighter::backfillSpellCheck() {
+  auto doc = document();
+  if (!doc || !m_spellCheckEnabled || m_backfillDone || m_backfillJobsInFlight > 0) {
+    return;
+  }
+
+  readSpellCheckerState();
+  if (!m_spellCheckerValid) {
+    return;
+  }
+
+  QVector<SpellCheckJob> jobs;
+  int scanned = 0;
+  auto block = doc->findBlockByNumber(m_backfillNextBlock);
+  while (block.isValid() && jobs.size() < c_spellCheckBackfillBatchSize &&
+         scanned < c_spellCheckBackfillScanSize) {
+    SpellCheckJob job;
+    if (prepareSpellCheck(block, true, job)) {
+      jobs.push_back(job);
+    }
+
+    block = block.next();
+    ++scanned;
+  }
+
+  m_backfillNextBlock += scanned;
+  if (!block.isValid()) {
+    m_backfillDone = true;
+  }
+
+  if (jobs.isEmpty()) {
+    if (!m_backfillDone) {
+      m_spellCheckBackfillTimer->start();
+    }
+    return;
+  }
+
+  // The next batch is scheduled once this one is answered.
+  m_backfillJobsInFlight = jobs.size();
+  m_spellCheckJobsInFlight += jobs.size();
+  spellCheckWorker()->enqueue(jobs, false);
+}
+
+void VSyntaxHighlighter::handleSpellCheckContentsChange(int p_position, int p_charsRemoved,
+                                                        int p_charsAdded) {
+  Q_UNUSED(p_charsRemoved);
+  Q_UNUSED(p_charsAdded);
+  auto doc = document();
+  const int revision = doc->revision();
+  const int blockCount = doc->blockCount();
+
+  // Each format change is reported through contentsChange too, such as the
+  // rehighlight of every spell check result. Those change neither the
+  // revision nor the block count, and taking them as edits would send the
+  // backfill back over blocks it has checked.
+  if (revision == m_contentsRevision && blockCount == m_contentsBlockCount &&
+      doc->isUndoRedoEnabled()) {
+    return;
+  }
+  m_contentsRevision = revision;
+  m_contentsBlockCount = blockCount;
+
+  if (!m_spellCheckEnabled) {
+    return;
+  }
+
+  // Blocks changed out of the viewport are left to the backfill, which waits
+  // for the editing to pause.
+  const int blockNumber = doc->findBlock(p_position).blockNumber();
+  scheduleSpellCheckBackfill(qMax(0, blockNumber));
+  if (m_backfillJobsInFlight == 0) {
+    m_spellCheckBackfillTimer->start();
+  }
+}
+
+int VSyntaxHighlighter::misspellingCount(bool *p_complete) const {
+  if (p_complete) {
+    // The backfill reached the end after the last edit and every job has
+    // been answered.
+    *p_complete = m_spellCheckEnabled && m_spellCheckerValid && m_backfillDone &&
+                  m_spellCheckJobsInFlight == 0;
+  }
+  return m_misspellingTally->m_count;
+}
+
+QSharedPointer<BlockSpellCheckData>
+VSyntaxHighlighter::blockSpellCheckData(const QTextBlock &p_block, bool p_create) {
+  auto data = TextBlockData::get(p_block);
+  auto spellData = data->getBlockSpellCheckData();
+  if (!spellData) {
+    if (p_create) {
+      spellData.reset(new BlockSpellCheckData(m_misspellingTally));
+      data->setBlockSpellCheckData(spellData);
+    }
+  } else if (spellData->tally() != m_misspellingTally) {
+    spellData->setTally(m_misspellingTally);
+  }
+  return spellData;
+}
+
+bool VSyntaxHighlighter::isSpellCheckNeeded(const QTextBlock &p_block) const {
+  Q_UNUSED(p_block);
+  return true;
+}
+
 bool VSyntaxHighlighter::isSyntaxFoldingEnabled() const { return false; }
@@ -11,6 +11,8 @@
 #include <vtextedit/viconfig.h>
 #include <vtextedit/vtextedit.h>
 
+#include "completioncorpus.h"
+#include "completionindex.h"
 #include "editorcompleter.h"
 #include "editorextraselection.h"
 #include "editorindicatorsborder.h"
@@ -19,6 +21,7 @@
 #include "inputmodestatuswidget.h"
 #include "ksyntaxhighlighterwrapper.h"
 #include "plaintexthighlighter.h"
+#include "searchindex.h"
 #include "statusindicator.h"
 #include "syntaxhighlighter.h"
 #include "textfolding.h"
@@ -50,29 +53,75 @@ int VTextEditor::s_instanceCount = 0;
 
 Completer *VTextEditor::s_completer = nullptr;
 
-void VTextEditor::FindResultCache::clear() {
-  m_start = -1;
-  m_end = -1;
+// @p_matches is in ascending order.
+// If @p_forward is true, find the smallest match whose start is greater than
+// @p_pos or the first match if wrapped. Otherwise, find the largest match whose
+// start is smaller than @p_pos or the last match if wrapped.
+static int selectMatch(const QVector<SearchIndex::Match> &p_matches, int p_pos,
+                       bool p_skipCurrent, bool p_forward, bool &p_isWrapped) {
+  Q_ASSERT(!p_matches.isEmpty());
 
-  m_texts.clear();
-  m_flags = FindFlag::None;
-  m_result.clear();
-}
+  p_isWrapped = false;
+  int first = 0, last = p_matches.size() - 1;
+  int lastMatch = -1;
+  while (first <= last) {
+    int mid = (first + last) / 2;
+    const int start = p_matches.at(mid).m_start;
+    if (p_forward) {
+      if (start < p_pos) {
+        first = mid + 1;
+      } else if (start == p_pos) {
+        if (!p_skipCurrent) {
+          // Found it.
+          lastMatch = mid;
+        } else if (mid < p_matches.size() - 1) {
+          // Next one is the right one.
+          lastMatch = mid + 1;
+        } else {
+          lastMatch = 0;
+          p_isWrapped = true;
+        }
+        break;
+      } else {
+        // It is a match.
+        if (lastMatch == -1 || mid < lastMatch) {
+          lastMatch = mid;
+        }
 
-bool VTextEditor::FindResultCache::matched(const QStringList &p_texts, FindFlags p_flags,
-                                           int p_start, int p_end) const {
-  return (m_flags & ~FindFlag::FindBackward) == (p_flags & ~FindFlag::FindBackward) &&
-         m_start == p_start && m_end == p_end && m_texts == p_texts;
-}
+        last = mid - 1;
+      }
+    } else {
+      if (start > p_pos) {
+        last = mid - 1;
+      } else if (start == p_pos) {
+        if (!p_skipCurrent) {
+          // Found it.
+          lastMatch = mid;
+        } else if (mid > 0) {
+          // Previous one is the right one.
+          lastMatch = mid - 1;
+        } else {
+          lastMatch = p_matches.size() - 1;
+          p_isWrapped = true;
+        }
+        break;
+      } else {
+        // It is a match.
+        if (lastMatch == -1 || mid > lastMatch) {
+          lastMatch = mid;
+        }
+
+        first = mid + 1;
+      }
+    }
+  }
 
-void VTextEditor::FindResultCache::update(const QStringList &p_texts, FindFlags p_flags,
-                                          int p_start, int p_end,
-                                          const QList<QTextCursor> &p_result) {
-  m_texts = p_texts;
-  m_flags = p_flags;
-  m_start = p_start;
-  m_end = p_end;
-  m_result = p_result;
+  if (lastMatch == -1) {
+    p_isWrapped = true;
+    lastMatch = p_forward ? 0 : (p_matches.size() - 1);
+  }
+
+  return lastMatch;
 }
 
 VTextEditor::VTextEditor(const QSharedPointer<TextEditorConfig> &p_config,
@@ -94,11 +143,12 @@ VTextEditor::VTextEditor(const QSharedPointer<TextEditorConfig> &p_config,
 
   setupCompleter();
 
-  connect(m_textEdit, &VTextEdit::contentsChanged, this, &VTextEditor::clearFindResultCache);
+  m_searchIndex = new SearchIndex(document(), this);
 
   // Status widget.
   connect(m_textEdit, &QTextEdit::cursorPositionChanged, this,
           &VTextEditor::updateCursorOfStatusWidget);
+  connect(m_textEdit, &VTextEdit::updateBatchEnded, this, &VTextEditor::handleUpdateBatchEnded);
   connect(this, &VTextEditor::syntaxChanged, this, &VTextEditor::updateSyntaxOfStatusWidget);
   connect(this, &VTextEditor::modeChanged, this, &VTextEditor::updateModeOfStatusWidget);
 
@@ -181,6 +231,19 @@ void VTextEditor::setupTextEdit() {
     connect(m_topLineChangedTimer, &QTimer::timeout, this, &VTextEditor::topLineChanged);
     connect(sb, &QScrollBar::valueChanged, m_topLineChangedTimer, QOverload<>::of(&QTimer::start));
   }
+
+  m_viewportChangedTimer = new QTimer(this);
+  m_viewportChangedTimer->setSingleShot(true);
+  m_viewportChangedTimer->setInterval(100);
+  connect(m_viewportChangedTimer, &QTimer::timeout, this, &VTextEditor::handleViewportChanged);
+  if (sb) {
+    connect(sb, &QScrollBar::valueChanged, m_viewportChangedTimer,
+            QOverload<>::of(&QTimer::start));
+  }
+  connect(m_textEdit, &VTextEdit::resized, m_viewportChangedTimer,
+          QOverload<>::of(&QTimer::start));
+  connect(m_textEdit, &VTextEdit::contentsChanged, m_viewportChangedTimer,
+          QOverload<>::of(&QTimer::start));
 }
 
 void VTextEditor::setText(const QString &p_text) {
@@ -235,8 +298,11 @@ void VTextEditor::setupTextFolding() {
 void VTextEditor::setupExtraSelection() {
   m_extraSelectionInterface.reset(new EditorExtraSelection(this));
   m_extraSelectionMgr = new ExtraSelectionMgr(m_extraSelectionInterface.data(), this);
-  connect(m_textEdit, &QTextEdit::cursorPositionChanged, m_extraSelectionMgr,
-          &ExtraSelectionMgr::handleCursorPositionChange);
+  connect(m_textEdit, &QTextEdit::cursorPositionChanged, m_extraSelectionMgr, [this]() {
+    if (!m_textEdit->isUpdateBatched()) {
+      m_extraSelectionMgr->handleCursorPositionChange();
+    }
+  });
   connect(m_textEdit, &VTextEdit::contentsChanged, m_extraSelectionMgr,
           &ExtraSelectionMgr::handleContentsChange);
   connect(m_textEdit, &VTextEdit::selectionChanged, m_extraSelectionMgr,
@@ -261,7 +327,12 @@ void VTextEditor::applyPendingExtraSelections() {
   }
 }
 
-void VTextEditor::setupCompleter() { m_completerInterface.reset(new EditorCompleter(this)); }
+void VTextEditor::setupCompleter() {
+  m_completerInterface.reset(new EditorCompleter(this));
+
+  // Completion offers words of all the open editors.
+  CompletionIndex::get(document())->setCorpus(&CompletionCorpus::getInst());
+}
 
 void VTextEditor::updateFromConfig() {
   Q_ASSERT(m_config);
@@ -840,13 +911,18 @@ StatusIndicator *VTextEditor::createStatusWidget() {
 }
 
 void VTextEditor::updateCursorOfStatusWidget() {
-  if (m_statusIndicator) {
+  if (m_statusIndicator && !m_textEdit->isUpdateBatched()) {
     auto pos = getCursorPosition();
     m_statusIndicator->updateCursor(m_textEdit->document()->blockCount(), pos.first + 1,
                                     pos.second);
   }
 }
 
+void VTextEditor::handleUpdateBatchEnded() {
+  m_extraSelectionMgr->handleCursorPositionChange();
+  updateCursorOfStatusWidget();
+}
+
 void VTextEditor::updateSyntaxOfStatusWidget() {
   if (m_statusIndicator) {
     m_statusIndicator->updateSyntax(getSyntax());
@@ -1113,21 +1189,27 @@ VTextEditor::FindResult VTextEditor::findTextHelper(const QStringList &p_texts,
     return result;
   }
 
-  const auto &allResults = findAllText(p_texts, p_flags, p_start, p_end);
+  const auto &allResults = m_searchIndex->findAll(p_texts, p_flags, p_start, p_end);
   if (!allResults.isEmpty()) {
     // Locate to the right match and update current cursor.
     bool wrapped = false;
-    int idx = selectCursor(allResults, p_cursor.position(), p_skipCurrent,
-                           !(p_flags & FindFlag::FindBackward), wrapped);
+    int idx = selectMatch(allResults, p_cursor.position(), p_skipCurrent,
+                          !(p_flags & FindFlag::FindBackward), wrapped);
     Q_ASSERT(idx != -1);
-    p_cursor = allResults[idx];
-
-    // Highlight.
-    highlightSearch(allResults, idx);
+    p_cursor.setPosition(allResults[idx].m_start);
+    p_cursor.setPosition(allResults[idx].m_end, QTextCursor::KeepAnchor);
 
     result.m_totalMatches = allResults.size();
     result.m_currentMatchIndex = idx;
     result.m_wrapped = wrapped;
+
+    // Highlight.
+    m_searchHighlight.m_enabled = true;
+    m_searchHighlight.m_texts = p_texts;
+    m_searchHighlight.m_flags = p_flags;
+    m_searchHighlight.m_start = p_start;
+    m_searchHighlight.m_end = p_end;
+    highlightSearch(p_cursor);
   } else {
     clearSearchHighlight();
     p_cursor = QTextCursor();
@@ -1168,27 +1250,58 @@ VTextEditor::FindResult VTextEditor::replaceAll(const QString &p_text, FindFlags
     return result;
   }
 
-  const auto &allResults = findAllText(QStringList(p_text), p_flags, p_start, p_end);
-  if (!allResults.isEmpty()) {
-    result.m_totalMatches = allResults.size();
+  // A copy, since editing invalidates the result of the index.
+  const auto allMatches = m_searchIndex->findAll(QStringList(p_text), p_flags, p_start, p_end);
+  if (!allMatches.isEmpty()) {
+    result.m_totalMatches = allMatches.size();
 
-    // Replace all matches one by one.
+    // Replace the matches of a block with one edit, from its first match to
+    // its last, whose new text is built in one pass. Each edit costs a layout
+    // and highlight pass of the block, which used to be paid per match. A
+    // match never spans blocks, so only the text between the matches of one
+    // block is rewritten along with them, and other blocks keep their data.
     auto cursor = m_textEdit->textCursor();
     cursor.beginEditBlock();
     bool hasBackRef =
         (p_flags & FindFlag::RegularExpression) ? hasBackReference(p_replaceText) : false;
     QRegularExpression regExp(hasBackRef ? p_text : QString());
-    for (const auto &result : allResults) {
-      cursor.setPosition(result.selectionStart());
-      cursor.setPosition(result.selectionEnd(), QTextCursor::KeepAnchor);
-
-      if (hasBackRef) {
-        auto newText = resolveBackReferenceInReplaceText(
-            p_replaceText, TextEditUtils::getSelectedText(cursor), regExp);
-        cursor.insertText(newText);
-      } else {
-        cursor.insertText(p_replaceText);
+    // Change of length by former edits.
+    int delta = 0;
+    int first = 0;
+    while (first < allMatches.size()) {
+      // Former edits are all before this block, so it is found by the shifted
+      // position and its end shifted back.
+      const auto block = document()->findBlock(allMatches[first].m_start + delta);
+      const int blockEnd = block.position() + block.length() - 1 - delta;
+      int last = first;
+      while (last + 1 < allMatches.size() && allMatches[last + 1].m_end <= blockEnd) {
+        ++last;
+      }
+
+      const int spanStart = allMatches[first].m_start;
+      const int spanEnd = allMatches[last].m_end;
+      cursor.setPosition(spanStart + delta);
+      cursor.setPosition(spanEnd + delta, QTextCursor::KeepAnchor);
+      const auto spanText = TextEditUtils::getSelectedText(cursor);
+
+      QString newText;
+      int pos = spanStart;
+      for (int i = first; i <= last; ++i) {
+        const auto &match = allMatches[i];
+        newText += spanText.mid(pos - spanStart, match.m_start - pos);
+        if (hasBackRef) {
+          newText += resolveBackReferenceInReplaceText(
+              p_replaceText, spanText.mid(match.m_start - spanStart, match.m_end - match.m_start),
+              regExp);
+        } else {
+          newText += p_replaceText;
+        }
+        pos = match.m_end;
       }
+
+      cursor.insertText(newText);
+      delta += newText.size() - (spanEnd - spanStart);
+      first = last + 1;
     }
     cursor.endEditBlock();
     m_textEdit->setTextCursor(cursor);
@@ -1202,128 +1315,67 @@ void VTextEditor::clearIncrementalSearchHighlight() {
   m_extraSelectionMgr->setSelections(m_incrementalSearchExtraSelection, QList<QTextCursor>());
 }
 
-void VTextEditor::clearFindResultCache() { m_findResultCache.clear(); }
-
 void VTextEditor::clearSearchHighlight() {
+  m_searchHighlight.m_enabled = false;
   m_extraSelectionMgr->setSelections(m_searchExtraSelection, QList<QTextCursor>());
   m_extraSelectionMgr->setSelections(m_searchUnderCursorExtraSelection, QList<QTextCursor>());
 }
 
-const QList<QTextCursor> &VTextEditor::findAllText(const QStringList &p_texts, FindFlags p_flags,
-                                                   int p_start, int p_end) {
-  if (p_texts.isEmpty() || (p_texts.size() == 1 && p_texts[0].isEmpty())) {
-    m_findResultCache.clear();
-    return m_findResultCache.m_result;
-  }
-
-  if (m_findResultCache.matched(p_texts, p_flags, p_start, p_end)) {
-    return m_findResultCache.m_result;
-  }
-
-  int cnt = 0;
-  QList<QTextCursor> results;
-  for (const auto &text : p_texts) {
-    if (text.isEmpty()) {
-      continue;
-    }
-
-    ++cnt;
-    results.append(m_textEdit->findAllText(text, p_flags, p_start, p_end));
-  }
+void VTextEditor::highlightSearch(const QTextCursor &p_current) {
+  QList<QTextCursor> searchUnderCursor;
+  searchUnderCursor << p_current;
+  m_extraSelectionMgr->setSelections(m_searchUnderCursorExtraSelection, searchUnderCursor);
 
-  if (cnt > 1) {
-    // Sort it.
-    std::sort(results.begin(), results.end());
+  if (p_current.selectionStart() == p_current.selectionEnd()) {
+    // Zero-length match.
+    const auto rect = m_textEdit->cursorRect(p_current);
+    QToolTip::hideText();
+    QToolTip::showText(m_textEdit->viewport()->mapToGlobal(rect.topLeft()), tr("Zero-length match"),
+                       m_textEdit);
   }
 
-  m_findResultCache.update(p_texts, p_flags, p_start, p_end, results);
-
-  return m_findResultCache.m_result;
+  updateSearchHighlight();
 }
 
-int VTextEditor::selectCursor(const QList<QTextCursor> &p_cursors, int p_pos, bool p_skipCurrent,
-                              bool p_forward, bool &p_isWrapped) {
-  Q_ASSERT(!p_cursors.isEmpty());
-
-  p_isWrapped = false;
-  int first = 0, last = p_cursors.size() - 1;
-  int lastMatch = -1;
-  while (first <= last) {
-    int mid = (first + last) / 2;
-    const QTextCursor &cur = p_cursors.at(mid);
-    if (p_forward) {
-      if (cur.selectionStart() < p_pos) {
-        first = mid + 1;
-      } else if (cur.selectionStart() == p_pos) {
-        if (!p_skipCurrent) {
-          // Found it.
-          lastMatch = mid;
-        } else if (mid < p_cursors.size() - 1) {
-          // Next one is the right one.
-          lastMatch = mid + 1;
-        } else {
-          lastMatch = 0;
-          p_isWrapped = true;
-        }
-        break;
-      } else {
-        // It is a match.
-        if (lastMatch == -1 || mid < lastMatch) {
-          lastMatch = mid;
-        }
+void VTextEditor::updateSearchHighlight() {
+  if (!m_searchHighlight.m_enabled) {
+    return;
+  }
 
-        last = mid - 1;
-      }
-    } else {
-      if (cur.selectionStart() > p_pos) {
-        last = mid - 1;
-      } else if (cur.selectionStart() == p_pos) {
-        if (!p_skipCurrent) {
-          // Found it.
-          lastMatch = mid;
-        } else if (mid > 0) {
-          // Previous one is the right one.
-          lastMatch = mid - 1;
-        } else {
-          lastMatch = p_cursors.size() - 1;
-          p_isWrapped = true;
-        }
-        break;
-      } else {
-        // It is a match.
-        if (lastMatch == -1 || mid > lastMatch) {
-          lastMatch = mid;
-        }
+  const auto &matches = m_searchIndex->findAll(m_searchHighlight.m_texts, m_searchHighlight.m_flags,
+                                               m_searchHighlight.m_start, m_searchHighlight.m_end);
 
-        first = mid + 1;
-      }
-    }
+  // One more screen above and below to cover small scrolls before the next
+  // update.
+  auto doc = document();
+  const auto range = TextEditUtils::visibleBlockRange(m_textEdit);
+  const int screenBlocks = range.second - range.first + 1;
+  const auto firstBlock = doc->findBlockByNumber(qMax(range.first - screenBlocks, 0));
+  auto lastBlock = doc->findBlockByNumber(range.second + screenBlocks);
+  if (!lastBlock.isValid()) {
+    lastBlock = doc->lastBlock();
   }
+  const int from = firstBlock.position();
+  const int to = lastBlock.position() + lastBlock.length();
 
-  if (lastMatch == -1) {
-    p_isWrapped = true;
-    lastMatch = p_forward ? 0 : (p_cursors.size() - 1);
+  // Matches are sorted by end.
+  auto it = std::lower_bound(
+      matches.begin(), matches.end(), from,
+      [](const SearchIndex::Match &p_match, int p_pos) { return p_match.m_end < p_pos; });
+  QList<QTextCursor> cursors;
+  QTextCursor cursor(doc);
+  for (; it != matches.end() && it->m_start < to; ++it) {
+    cursor.setPosition(it->m_start);
+    cursor.setPosition(it->m_end, QTextCursor::KeepAnchor);
+    cursors.append(cursor);
   }
-
-  return lastMatch;
+  m_extraSelectionMgr->setSelections(m_searchExtraSelection, cursors);
 }
 
-void VTextEditor::highlightSearch(const QList<QTextCursor> &p_results, int p_currentIdx) {
-  Q_ASSERT(!p_results.isEmpty() && p_currentIdx >= 0);
-  m_extraSelectionMgr->setSelections(m_searchExtraSelection, p_results);
-
-  QList<QTextCursor> searchUnderCursor;
-  searchUnderCursor << p_results[p_currentIdx];
-  m_extraSelectionMgr->setSelections(m_searchUnderCursorExtraSelection, searchUnderCursor);
-
-  const int selStart = p_results[p_currentIdx].selectionStart();
-  if (selStart == p_results[p_currentIdx].selectionEnd()) {
-    // Zero-length match.
-    const auto rect = m_textEdit->cursorRect(p_results[p_currentIdx]);
-    QToolTip::hideText();
-    QToolTip::showText(m_textEdit->viewport()->mapToGlobal(rect.topLeft()), tr("Zero-length match"),
-                       m_textEdit);
-  }
+void VTextEditor::handleViewportChanged() {
+  updateSpellCheckViewport();
+  updateSearchHighlight();
+  m_extraSelectionMgr->handleViewportChange();
 }
 
 bool VTextEditor::hasBackReference(const QString &p_regExpText) {
@@ -1356,11 +1408,23 @@ void VTextEditor::updateSpellCheck() {
     SpellChecker::getInst().setCurrentLanguage(m_parameters->m_defaultSpellCheckLanguage);
   }
   if (m_highlighter) {
+    if (m_parameters->m_spellCheckEnabled) {
+      updateSpellCheckViewport();
+    }
     m_highlighter->setSpellCheckEnabled(m_parameters->m_spellCheckEnabled);
     m_highlighter->setAutoDetectLanguageEnabled(m_parameters->m_autoDetectLanguageEnabled);
   }
 }
 
+void VTextEditor::updateSpellCheckViewport() {
+  if (!m_highlighter || !m_parameters->m_spellCheckEnabled) {
+    return;
+  }
+
+  const auto range = TextEditUtils::visibleBlockRange(m_textEdit);
+  m_highlighter->setVisibleBlockRange(range.first, range.second);
+}
+
 bool VTextEditor::isSpellCheckEnabled() const { return m_parameters->m_spellCheckEnabled; }
 
 bool VTextEditor::isAutoDetectLanguageEnabled() const {
@@ -1375,6 +1439,17 @@ QMap<QString, QString> VTextEditor::availableSpellCheckDictionaries() const {
   return SpellChecker::getInst().availableDictionaries();
 }
 
+int VTextEditor::misspellingCount(bool *p_complete) const {
+  if (!m_highlighter) {
+    if (p_complete) {
+      *p_complete = false;
+    }
+    return 0;
+  }
+
+  return m_highlighter->misspellingCount(p_complete);
+}
+
 void VTextEditor::setSpellCheckEnabled(bool p_enabled) {
   m_parameters->m_spellCheckEnabled = p_enabled;
   updateSpellCheck();
@@ -1388,8 +1463,12 @@ void VTextEditor::setAutoDetectLanguageEnabled(bool p_enabled) {
 }
 
 void VTextEditor::setSpellCheckLanguage(const QString &p_language) {
+  const bool changed = m_parameters->m_defaultSpellCheckLanguage != p_language;
   m_parameters->m_defaultSpellCheckLanguage = p_language;
   updateSpellCheck();
+  if (changed && m_highlighter && m_parameters->m_spellCheckEnabled) {
+    m_highlighter->refreshSpellCheck();
+  }
   emit spellCheckStateChanged();
 }
 
@@ -1428,16 +1507,17 @@ bool VTextEditor::appendSpellCheckMenu(QContextMenuEvent *p_event, QMenu *p_menu
   p_menu->addSeparator();
   auto subMenu = p_menu->addMenu(tr("Spelling \"%1\"").arg(selectedWord));
 
-  subMenu->addAction(tr("Ignore Word"), this, [this, selectedWord, mouseCursorPos]() {
+  // Other blocks may hold the word too. The recheck is served by the verdict
+  // cache, which has just dropped the word, and only rehighlights the blocks
+  // whose misspellings change.
+  subMenu->addAction(tr("Ignore Word"), this, [this, selectedWord]() {
     SpellChecker::getInst().ignoreWord(selectedWord);
-    auto block = document()->findBlock(mouseCursorPos);
-    m_highlighter->refreshBlockSpellCheck(block);
+    m_highlighter->refreshSpellCheck();
   });
 
-  subMenu->addAction(tr("Add To Dictionary"), this, [this, selectedWord, mouseCursorPos]() {
+  subMenu->addAction(tr("Add To Dictionary"), this, [this, selectedWord]() {
     SpellChecker::getInst().addToDictionary(selectedWord);
-    auto block = document()->findBlock(mouseCursorPos);
-    m_highlighter->refreshBlockSpellCheck(block);
+    m_highlighter->refreshSpellCheck();
   });
 
   subMenu->addSeparator();
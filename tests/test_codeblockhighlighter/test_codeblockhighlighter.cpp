@@ -0,0 +1,353 @@
+#include "test_codeblockhighlighter.h"
+
+#include <QSet>
+#include <QTimer>
+
+#include <webcodeblockhighlighter.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace {
+// Stands in for the host's Prism highlighter. Each line of code is answered as
+// one `keyword` token, each request @m_latency ms after the previous one.
+class StandInHighlighter : public QObject {
+public:
+  StandInHighlighter(WebCodeBlockHighlighter *p_highlighter, int p_latency)
+      : m_highlighter(p_highlighter), m_latency(p_latency) {
+    connect(p_highlighter, &WebCodeBlockHighlighter::externalCodeBlockHighlightBatchRequested, this,
+            [this](TimeStamp p_timeStamp,
+                   const QVector<ExternalCodeBlockHighlightRequest> &p_requests) {
+              Q_UNUSED(p_timeStamp);
+              m_batches.append(p_requests);
+              if (m_autoReply) {
+                reply(p_requests);
+              }
+            });
+  }
+
+  static QString toHtml(const QString &p_text) {
+    auto lines = p_text.split(QLatin1Char('\n'));
+    // Prism gets the code without the fences.
+    lines = lines.mid(1, lines.size() - 2);
+    for (auto &line : lines) {
+      if (!line.isEmpty()) {
+        line = QStringLiteral("<span class=\"token keyword\">%1</span>").arg(line.toHtmlEscaped());
+      }
+    }
+    return lines.join(QLatin1Char('\n'));
+  }
+
+  void reply(const QVector<ExternalCodeBlockHighlightRequest> &p_requests) {
+    int delay = 0;
+    for (const auto &req : p_requests) {
+      delay += m_latency;
+      ExternalCodeBlockHighlightData data;
+      data.m_id = req.m_id;
+      data.m_html = toHtml(req.m_text);
+      QTimer::singleShot(delay, this, [this, data]() {
+        m_highlighter->handleExternalCodeBlockHighlightBatchData({data});
+      });
+    }
+  }
+
+  int requestCount() const {
+    int cnt = 0;
+    for (const auto &batch : m_batches) {
+      cnt += batch.size();
+    }
+    return cnt;
+  }
+
+  WebCodeBlockHighlighter *m_highlighter = nullptr;
+
+  int m_latency = 0;
+
+  bool m_autoReply = true;
+
+  QVector<QVector<ExternalCodeBlockHighlightRequest>> m_batches;
+};
+
+md::FencedCodeBlock makeBlock(int p_startBlock, const QString &p_code,
+                              const QString &p_lang = QStringLiteral("cpp")) {
+  md::FencedCodeBlock block;
+  block.m_startBlock = p_startBlock;
+  block.m_endBlock = p_startBlock + p_code.count(QLatin1Char('\n')) + 2;
+  block.m_lang = p_lang;
+  block.m_text = QStringLiteral("```%1\n%2\n```").arg(p_lang, p_code);
+  return block;
+}
+
+QVector<CodeBlockHighlighter::HighlightResult> *collectResults(CodeBlockHighlighter *p_highlighter) {
+  auto results = new QVector<CodeBlockHighlighter::HighlightResult>();
+  QObject::connect(p_highlighter, &CodeBlockHighlighter::codeBlockHighlightCompleted,
+                   p_highlighter, [results](const CodeBlockHighlighter::HighlightResult &p_result) {
+                     results->append(p_result);
+                   });
+  QObject::connect(p_highlighter, &QObject::destroyed, [results]() { delete results; });
+  return results;
+}
+} // namespace
+
+void TestCodeBlockHighlighter::initTestCase() {
+  WebCodeBlockHighlighter::ExternalCodeBlockHighlightStyles styles;
+  QTextCharFormat fmt;
+  fmt.setFontWeight(QFont::Bold);
+  styles.insert(QStringLiteral("keyword"), fmt);
+  WebCodeBlockHighlighter::setExternalCodeBlockHighlihgtStyles(styles);
+}
+
+void TestCodeBlockHighlighter::testManyBlocksAreBatched() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 1);
+  auto results = collectResults(&highlighter);
+
+  const int cnt = 2 * WebCodeBlockHighlighter::c_maxBatchSize + 10;
+  QVector<md::FencedCodeBlock> blocks;
+  for (int i = 0; i < cnt; ++i) {
+    blocks.append(makeBlock(i * 4, QStringLiteral("int v%1 = %1;").arg(i)));
+  }
+
+  highlighter.highlight(1, blocks);
+
+  QCOMPARE(host.m_batches.size(), 3);
+  QCOMPARE(host.m_batches[0].size(), WebCodeBlockHighlighter::c_maxBatchSize);
+  QCOMPARE(host.requestCount(), cnt);
+
+  QSet<int> ids;
+  for (const auto &batch : host.m_batches) {
+    for (const auto &req : batch) {
+      ids.insert(req.m_id);
+    }
+  }
+  QCOMPARE(ids.size(), cnt);
+
+  QTRY_COMPARE_WITH_TIMEOUT(results->size(), cnt, 10000);
+
+  QSet<int> indexes;
+  for (const auto &res : *results) {
+    QCOMPARE(res.m_timeStamp, TimeStamp(1));
+    indexes.insert(res.m_index);
+
+    QCOMPARE(res.m_highlights.size(), 3);
+    QVERIFY(res.m_highlights[0].isEmpty());
+    QCOMPARE(res.m_highlights[1].size(), 1);
+    QCOMPARE(res.m_highlights[1][0].start, 0UL);
+    QCOMPARE(int(res.m_highlights[1][0].length),
+             blocks[res.m_index].m_text.split(QLatin1Char('\n'))[1].size());
+    QCOMPARE(res.m_highlights[1][0].format.fontWeight(), int(QFont::Bold));
+    QVERIFY(res.m_highlights[2].isEmpty());
+  }
+  QCOMPARE(indexes.size(), cnt);
+}
+
+void TestCodeBlockHighlighter::testResultsAreStreamed() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 0);
+  host.m_autoReply = false;
+  auto results = collectResults(&highlighter);
+
+  QVector<md::FencedCodeBlock> blocks;
+  for (int i = 0; i < 4; ++i) {
+    blocks.append(makeBlock(i * 4, QStringLiteral("return %1;").arg(i)));
+  }
+  highlighter.highlight(1, blocks);
+  QCOMPARE(host.m_batches.size(), 1);
+
+  // Answer the last request only. The HTML is parsed off the GUI thread, so
+  // nothing is delivered synchronously.
+  const auto &batch = host.m_batches[0];
+  ExternalCodeBlockHighlightData data;
+  data.m_id = batch.last().m_id;
+  data.m_html = StandInHighlighter::toHtml(batch.last().m_text);
+  highlighter.handleExternalCodeBlockHighlightBatchData({data});
+  QVERIFY(results->isEmpty());
+
+  QTRY_COMPARE(results->size(), 1);
+  QCOMPARE(results->at(0).m_index, 3);
+
+  // The rest in one batch.
+  QVector<ExternalCodeBlockHighlightData> rest;
+  for (int i = 0; i < 3; ++i) {
+    ExternalCodeBlockHighlightData d;
+    d.m_id = batch[i].m_id;
+    d.m_html = StandInHighlighter::toHtml(batch[i].m_text);
+    rest.append(d);
+  }
+  highlighter.handleExternalCodeBlockHighlightBatchData(rest);
+  QTRY_COMPARE(results->size(), 4);
+
+  // A repeated answer is ignored.
+  highlighter.handleExternalCodeBlockHighlightBatchData(rest);
+  QTest::qWait(50);
+  QCOMPARE(results->size(), 4);
+}
+
+void TestCodeBlockHighlighter::testDuplicateTextsShareOneRequest() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 5);
+  auto results = collectResults(&highlighter);
+
+  QVector<md::FencedCodeBlock> blocks;
+  for (int i = 0; i < 3; ++i) {
+    blocks.append(makeBlock(i * 4, QStringLiteral("int same;")));
+  }
+  highlighter.highlight(1, blocks);
+
+  QCOMPARE(host.requestCount(), 1);
+  QTRY_COMPARE(results->size(), 3);
+
+  QSet<int> indexes;
+  for (const auto &res : *results) {
+    indexes.insert(res.m_index);
+    QCOMPARE(res.m_highlights.size(), 3);
+  }
+  QCOMPARE(indexes, QSet<int>({0, 1, 2}));
+}
+
+void TestCodeBlockHighlighter::testInFlightRequestSurvivesReparse() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 0);
+  host.m_autoReply = false;
+  auto results = collectResults(&highlighter);
+
+  const auto block = makeBlock(0, QStringLiteral("int a;"));
+  highlighter.highlight(1, {block});
+  QCOMPARE(host.requestCount(), 1);
+
+  // Typing above the code block shifts it; its text is unchanged and still
+  // waiting, so it is not sent again.
+  auto shifted = block;
+  shifted.m_startBlock += 2;
+  shifted.m_endBlock += 2;
+  highlighter.highlight(2, {makeBlock(0, QStringLiteral("int b;")), shifted});
+  QCOMPARE(host.requestCount(), 2);
+  QCOMPARE(host.m_batches[1].size(), 1);
+  QVERIFY(host.m_batches[1][0].m_id != host.m_batches[0][0].m_id);
+
+  host.reply(host.m_batches[0]);
+  QTRY_COMPARE(results->size(), 1);
+  QCOMPARE(results->at(0).m_timeStamp, TimeStamp(2));
+  QCOMPARE(results->at(0).m_index, 1);
+}
+
+void TestCodeBlockHighlighter::testObsoleteRequestIsIgnored() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 0);
+  host.m_autoReply = false;
+  auto results = collectResults(&highlighter);
+
+  highlighter.highlight(1, {makeBlock(0, QStringLiteral("int a;"))});
+  highlighter.highlight(2, {makeBlock(0, QStringLiteral("int ab;"))});
+  QCOMPARE(host.m_batches.size(), 2);
+
+  host.reply(host.m_batches[0]);
+  QTest::qWait(50);
+  QVERIFY(results->isEmpty());
+
+  host.reply(host.m_batches[1]);
+  QTRY_COMPARE(results->size(), 1);
+  QCOMPARE(results->at(0).m_timeStamp, TimeStamp(2));
+}
+
+void TestCodeBlockHighlighter::testUnansweredRequestIsResent() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  highlighter.setRequestTimeout(20);
+  StandInHighlighter host(&highlighter, 0);
+  host.m_autoReply = false;
+  auto results = collectResults(&highlighter);
+
+  const QVector<md::FencedCodeBlock> blocks = {makeBlock(0, QStringLiteral("int a;"))};
+  highlighter.highlight(1, blocks);
+  highlighter.highlight(2, blocks);
+  QCOMPARE(host.requestCount(), 1);
+
+  // The host dropped the request; the next round past the timeout sends it again
+  // under the same ID.
+  QTest::qWait(50);
+  highlighter.highlight(3, blocks);
+  QCOMPARE(host.requestCount(), 2);
+  QCOMPARE(host.m_batches[1][0].m_id, host.m_batches[0][0].m_id);
+  QCOMPARE(host.m_batches[1][0].m_text, host.m_batches[0][0].m_text);
+
+  // Both answers arrive; only the first one is applied.
+  host.reply(host.m_batches[1]);
+  host.reply(host.m_batches[0]);
+  QTRY_COMPARE(results->size(), 1);
+  QCOMPARE(results->at(0).m_timeStamp, TimeStamp(3));
+  QTest::qWait(50);
+  QCOMPARE(results->size(), 1);
+}
+
+void TestCodeBlockHighlighter::testCacheHitSendsNoRequest() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 1);
+  auto results = collectResults(&highlighter);
+
+  const QVector<md::FencedCodeBlock> blocks = {makeBlock(0, QStringLiteral("int a;"))};
+  highlighter.highlight(1, blocks);
+  QTRY_COMPARE(results->size(), 1);
+
+  highlighter.highlight(2, blocks);
+  QCOMPARE(host.requestCount(), 1);
+  QCOMPARE(results->size(), 2);
+  QCOMPARE(results->at(1).m_timeStamp, TimeStamp(2));
+  QCOMPARE(results->at(1).m_highlights, results->at(0).m_highlights);
+}
+
+void TestCodeBlockHighlighter::testSingleBlockProtocol() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 0);
+  host.m_autoReply = false;
+  auto results = collectResults(&highlighter);
+
+  highlighter.highlight(1, {makeBlock(0, QStringLiteral("int a;"))});
+  const auto req = host.m_batches[0][0];
+  highlighter.handleExternalCodeBlockHighlightData(req.m_id, 1,
+                                                   StandInHighlighter::toHtml(req.m_text));
+  QTRY_COMPARE(results->size(), 1);
+  QCOMPARE(results->at(0).m_highlights[1].size(), 1);
+}
+
+void TestCodeBlockHighlighter::testEmptyLanguageIsNotSent() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  StandInHighlighter host(&highlighter, 0);
+  auto results = collectResults(&highlighter);
+
+  highlighter.highlight(1, {makeBlock(0, QStringLiteral("plain"), QString())});
+  QCOMPARE(host.requestCount(), 0);
+  QCOMPARE(results->size(), 1);
+  QVERIFY(results->at(0).isEmpty());
+}
+
+void TestCodeBlockHighlighter::testQueuedBatchProtocol() {
+  WebCodeBlockHighlighter highlighter(nullptr);
+  auto results = collectResults(&highlighter);
+
+  // A queued connection drops the call if its argument types are not registered.
+  QObject host;
+  connect(
+      &highlighter, &WebCodeBlockHighlighter::externalCodeBlockHighlightBatchRequested, &host,
+      [&highlighter](TimeStamp p_timeStamp,
+                     const QVector<ExternalCodeBlockHighlightRequest> &p_requests) {
+        Q_UNUSED(p_timeStamp);
+        QVector<ExternalCodeBlockHighlightData> answers;
+        for (const auto &req : p_requests) {
+          ExternalCodeBlockHighlightData data;
+          data.m_id = req.m_id;
+          data.m_html = StandInHighlighter::toHtml(req.m_text);
+          answers.append(data);
+        }
+        QMetaObject::invokeMethod(
+            &highlighter, "handleExternalCodeBlockHighlightBatchData", Qt::QueuedConnection,
+            Q_ARG(QVector<vte::ExternalCodeBlockHighlightData>, answers));
+      },
+      Qt::QueuedConnection);
+
+  highlighter.highlight(1, {makeBlock(0, QStringLiteral("int a;")),
+                            makeBlock(4, QStringLiteral("int b;"))});
+  QTRY_COMPARE(results->size(), 2);
+  QCOMPARE(results->at(0).m_highlights[1].size(), 1);
+}
+
+QTEST_MAIN(tests::TestCodeBlockHighlighter)
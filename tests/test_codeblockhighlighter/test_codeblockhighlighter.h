@@ -0,0 +1,36 @@
+#ifndef TESTS_TEST_CODEBLOCKHIGHLIGHTER_H
+#define TESTS_TEST_CODEBLOCKHIGHLIGHTER_H
+
+#include <QtTest>
+
+namespace tests {
+// Batched protocol of WebCodeBlockHighlighter, driven by an in-process stand-in
+// for the host's external highlighter which answers with a simulated latency.
+class TestCodeBlockHighlighter : public QObject {
+  Q_OBJECT
+private slots:
+  void initTestCase();
+
+  void testManyBlocksAreBatched();
+
+  void testResultsAreStreamed();
+
+  void testDuplicateTextsShareOneRequest();
+
+  void testInFlightRequestSurvivesReparse();
+
+  void testObsoleteRequestIsIgnored();
+
+  void testUnansweredRequestIsResent();
+
+  void testCacheHitSendsNoRequest();
+
+  void testSingleBlockProtocol();
+
+  void testEmptyLanguageIsNotSent();
+
+  void testQueuedBatchProtocol();
+};
+} // namespace tests
+
+#endif
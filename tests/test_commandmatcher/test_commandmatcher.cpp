@@ -0,0 +1,93 @@
+#include "test_commandmatcher.h"
+
+#include <vtextedit/texteditorconfig.h>
+#include <vtextedit/vtexteditor.h>
+
+#include <command.h>
+#include <commandmatcher.h>
+#include <inputmode/abstractinputmode.h>
+#include <katevi/inputmodemanager.h>
+#include <katevi/interface/kateviinputmode.h>
+#include <modes/normalvimode.h>
+#include <modes/visualvimode.h>
+#include <motion.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace {
+QSharedPointer<TextEditorConfig> viConfig() {
+  auto config = QSharedPointer<TextEditorConfig>::create();
+  config->m_inputMode = InputMode::ViMode;
+  return config;
+}
+
+KateVi::InputModeManager *viModeManager(const VTextEditor &p_editor) {
+  auto viMode = dynamic_cast<KateViI::KateViInputMode *>(p_editor.getInputMode().data());
+  return viMode ? viMode->viInputModeManager() : nullptr;
+}
+
+// Every prefix of every pattern, and keys the regex patterns accept past their
+// literal prefix or no pattern leads to.
+template <typename T> QStringList keysToTry(const QVector<T *> &p_commands) {
+  QStringList keys;
+  for (const auto cmd : p_commands) {
+    const auto pattern = cmd->pattern();
+    for (int i = 1; i <= pattern.size(); ++i) {
+      keys << pattern.left(i);
+    }
+  }
+
+  keys << QStringLiteral("fx") << QStringLiteral("Ta") << QStringLiteral("'a")
+       << QStringLiteral("`b") << QStringLiteral("\"ay") << QStringLiteral("\"_d")
+       << QStringLiteral("ma") << QStringLiteral("@q") << QStringLiteral("qa")
+       << QStringLiteral("rx") << QStringLiteral("gqq") << QStringLiteral("d3w")
+       << QStringLiteral("2dd") << QStringLiteral("ci(") << QStringLiteral("zz")
+       << QStringLiteral("Q") << QStringLiteral("ZZ") << QStringLiteral("\\")
+       << QStringLiteral("[[") << QStringLiteral(")") << QString(QChar(0xe4))
+       << QStringLiteral("xyz");
+  keys.removeDuplicates();
+  return keys;
+}
+
+template <typename T> void verifyMatcher(const QVector<T *> &p_commands) {
+  QVERIFY(!p_commands.isEmpty());
+  KateVi::CommandMatcher matcher;
+  matcher.build(p_commands);
+  for (const auto &keys : keysToTry(p_commands)) {
+    QVector<int> expected;
+    for (int i = 0; i < p_commands.size(); ++i) {
+      if (p_commands[i]->matches(keys)) {
+        expected.push_back(i);
+      }
+    }
+    QVERIFY2(matcher.matching(keys) == expected, qPrintable(keys));
+  }
+}
+} // namespace
+
+void TestCommandMatcher::testNormalMode() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  auto manager = viModeManager(editor);
+  QVERIFY(manager);
+
+  verifyMatcher(manager->getViNormalMode()->commands());
+  if (QTest::currentTestFailed()) {
+    return;
+  }
+  verifyMatcher(manager->getViNormalMode()->motions());
+}
+
+void TestCommandMatcher::testVisualMode() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  auto manager = viModeManager(editor);
+  QVERIFY(manager);
+
+  verifyMatcher(manager->getViVisualMode()->commands());
+  if (QTest::currentTestFailed()) {
+    return;
+  }
+  verifyMatcher(manager->getViVisualMode()->motions());
+}
+
+QTEST_MAIN(tests::TestCommandMatcher)
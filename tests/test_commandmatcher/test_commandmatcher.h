@@ -0,0 +1,18 @@
+#ifndef TESTS_TEST_COMMANDMATCHER_H
+#define TESTS_TEST_COMMANDMATCHER_H
+
+#include <QtTest>
+
+namespace tests {
+// CommandMatcher over the command and motion tables of the vi modes, against
+// a linear scan of Command::matches().
+class TestCommandMatcher : public QObject {
+  Q_OBJECT
+private slots:
+  void testNormalMode();
+
+  void testVisualMode();
+};
+} // namespace tests
+
+#endif // TESTS_TEST_COMMANDMATCHER_H
@@ -0,0 +1,369 @@
+#include "test_completionindex.h"
+
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <completioncorpus.h>
+#include <completionindex.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace {
+const char *c_vocabulary[] = {"alpha", "Alpha", "alphabet", "beta", "Beta_2", "gamma", "gamut",
+                              "delta", "DELTA", "epsilon", "eps", "zeta", "eta", "theta",
+                              "iota", "kappa", "lambda", "mu", "nu", "xi_1", "omicron", "pi"};
+
+const char *c_separators[] = {" ", " ", " ", ", ", ". ", "\n", "\n\n", " - ", "("};
+
+QString generateText(QRandomGenerator &p_rand, int p_size) {
+  QString text;
+  text.reserve(p_size + 16);
+  const int vocabularySize = sizeof(c_vocabulary) / sizeof(c_vocabulary[0]);
+  const int separatorSize = sizeof(c_separators) / sizeof(c_separators[0]);
+  while (text.size() < p_size) {
+    text += QLatin1String(c_vocabulary[p_rand.bounded(vocabularySize)]);
+    if (p_rand.bounded(8) == 0) {
+      text += QString::number(p_rand.bounded(100));
+    }
+    text += QLatin1String(c_separators[p_rand.bounded(separatorSize)]);
+  }
+  return text;
+}
+
+bool isWordChar(const QChar &p_ch) { return p_ch.isLetterOrNumber() || p_ch == QLatin1Char('_'); }
+
+// Same as Completer::findCompletionPrefix().
+QPair<int, int> wordRange(QTextDocument *p_doc, int p_position) {
+  auto block = p_doc->findBlock(p_position);
+  const auto text = block.text();
+  int pib = p_position - block.position();
+  int wordStart = pib;
+  if (pib >= text.size() || !isWordChar(text[pib])) {
+    --pib;
+  }
+  while (pib >= 0 && isWordChar(text[pib])) {
+    wordStart = pib;
+    --pib;
+  }
+
+  pib = p_position - block.position();
+  int wordEnd = pib - 1;
+  while (pib < text.size() && isWordChar(text[pib])) {
+    wordEnd = pib;
+    ++pib;
+  }
+
+  return qMakePair(block.position() + wordStart, block.position() + wordEnd + 1);
+}
+
+// What the completer computed before the index: split the whole text and
+// drop the duplicates.
+QStringList splitCandidates(const QString &p_contents, int p_wordStart, int p_wordEnd,
+                            const QString &p_prefix, bool p_reversed) {
+  QRegularExpression reg("\\W+");
+  QStringList above = p_contents.left(p_wordStart).split(reg, Qt::SkipEmptyParts);
+  QStringList below = p_contents.mid(p_wordEnd).split(reg, Qt::SkipEmptyParts);
+
+  QStringList all;
+  if (p_reversed) {
+    QStringList rev;
+    for (auto it = above.rbegin(); it != above.rend(); ++it) {
+      rev.append(*it);
+    }
+    for (auto it = below.rbegin(); it != below.rend(); ++it) {
+      rev.append(*it);
+    }
+    rev.removeDuplicates();
+    for (auto it = rev.rbegin(); it != rev.rend(); ++it) {
+      all.append(*it);
+    }
+  } else {
+    below.append(above);
+    below.removeDuplicates();
+    all = below;
+  }
+
+  QStringList res;
+  for (const auto &word : all) {
+    if (word.startsWith(p_prefix, Qt::CaseInsensitive)) {
+      res.append(word);
+    }
+  }
+  return res;
+}
+
+void verifyCandidates(QTextDocument *p_doc, QRandomGenerator &p_rand, int p_queries) {
+  auto index = CompletionIndex::get(p_doc);
+  const auto contents = p_doc->toPlainText();
+  for (int i = 0; i < p_queries; ++i) {
+    const int position = p_rand.bounded(p_doc->characterCount());
+    const auto range = wordRange(p_doc, position);
+    const auto prefix = contents.mid(range.first, qMin(1, range.second - range.first));
+    for (bool reversed : {false, true}) {
+      QCOMPARE(index->candidates(range.first, range.second, prefix, reversed),
+               splitCandidates(contents, range.first, range.second, prefix, reversed));
+    }
+  }
+}
+} // namespace
+
+void TestCompletionIndex::testCandidatesOrder_data() {
+  QTest::addColumn<QString>("text");
+  QTest::addColumn<int>("position");
+  QTest::addColumn<QString>("prefix");
+  QTest::addColumn<bool>("reversed");
+  QTest::addColumn<QStringList>("expected");
+
+  const QString text("ab ac\nad ab x\nae ac");
+  // Cursor at "x": words below first, then from the document start.
+  QTest::addRow("forward") << text << 12 << QString("a") << false
+                           << QStringList({"ae", "ac", "ab", "ad"});
+  // The nearest word above comes last.
+  QTest::addRow("reversed") << text << 12 << QString("a") << true
+                            << QStringList({"ae", "ac", "ad", "ab"});
+  QTest::addRow("empty prefix") << text << 12 << QString() << false
+                                << QStringList({"ae", "ac", "ab", "ad"});
+  QTest::addRow("no match") << text << 12 << QString("z") << false << QStringList();
+}
+
+void TestCompletionIndex::testCandidatesOrder() {
+  QFETCH(QString, text);
+  QFETCH(int, position);
+  QFETCH(QString, prefix);
+  QFETCH(bool, reversed);
+  QFETCH(QStringList, expected);
+
+  QTextDocument doc(text);
+  const auto range = wordRange(&doc, position);
+  QCOMPARE(CompletionIndex::get(&doc)->candidates(range.first, range.second, prefix, reversed),
+           expected);
+  QCOMPARE(splitCandidates(text, range.first, range.second, prefix, reversed), expected);
+
+  QRandomGenerator rand(7);
+  QTextDocument randomDoc(generateText(rand, 4000));
+  verifyCandidates(&randomDoc, rand, 200);
+}
+
+void TestCompletionIndex::testPrefixIsCaseInsensitive() {
+  QTextDocument doc("Alpha alphabet ALPS beta x");
+  auto index = CompletionIndex::get(&doc);
+  const int position = doc.characterCount() - 2;
+  QCOMPARE(index->candidates(position, position + 1, "al", false),
+           QStringList({"Alpha", "alphabet", "ALPS"}));
+  QCOMPARE(index->candidates(position, position + 1, "AL", false),
+           QStringList({"Alpha", "alphabet", "ALPS"}));
+  QCOMPARE(index->wordCount(), 5);
+}
+
+void TestCompletionIndex::testWordAtCursorIsExcluded() {
+  QTextDocument doc("foo fo\nfo");
+  auto index = CompletionIndex::get(&doc);
+
+  // The second "fo" occurs once more in the last block.
+  QCOMPARE(index->candidates(4, 6, "f", false), QStringList({"fo", "foo"}));
+
+  // Once the other one is removed, the word at the cursor is the only "fo".
+  QTextCursor cursor(&doc);
+  cursor.setPosition(3);
+  cursor.setPosition(6, QTextCursor::KeepAnchor);
+  cursor.removeSelectedText();
+  QCOMPARE(doc.toPlainText(), QString("foo\nfo"));
+  QCOMPARE(index->count("fo"), 1);
+  QCOMPARE(index->candidates(4, 6, "f", false), QStringList({"foo"}));
+}
+
+void TestCompletionIndex::testIncrementalEdits() {
+  QRandomGenerator rand(42);
+  QTextDocument doc(generateText(rand, 3000));
+  auto index = CompletionIndex::get(&doc);
+  verifyCandidates(&doc, rand, 10);
+
+  QTextCursor cursor(&doc);
+  for (int i = 0; i < 300; ++i) {
+    const int position = rand.bounded(doc.characterCount());
+    cursor.setPosition(position);
+    switch (rand.bounded(4)) {
+    case 0:
+      cursor.insertText(generateText(rand, rand.bounded(1, 40)));
+      break;
+
+    case 1:
+      cursor.insertText(QStringLiteral("\n"));
+      break;
+
+    case 2:
+      cursor.setPosition(qMin(position + rand.bounded(1, 60), doc.characterCount() - 1),
+                         QTextCursor::KeepAnchor);
+      cursor.removeSelectedText();
+      break;
+
+    default:
+      cursor.insertText(QString(QLatin1Char('a' + rand.bounded(26))));
+      break;
+    }
+
+    if (i % 10 == 0) {
+      verifyCandidates(&doc, rand, 5);
+    }
+  }
+
+  verifyCandidates(&doc, rand, 50);
+
+  // The same words as a fresh index of the same text.
+  QTextDocument fresh(doc.toPlainText());
+  QCOMPARE(index->wordCount(), CompletionIndex::get(&fresh)->wordCount());
+  for (const char *word : c_vocabulary) {
+    QCOMPARE(index->count(word), CompletionIndex::get(&fresh)->count(word));
+  }
+}
+
+void TestCompletionIndex::testUndoRedo() {
+  QRandomGenerator rand(3);
+  QTextDocument doc(generateText(rand, 2000));
+  auto index = CompletionIndex::get(&doc);
+  verifyCandidates(&doc, rand, 10);
+
+  QTextCursor cursor(&doc);
+  for (int i = 0; i < 20; ++i) {
+    cursor.setPosition(rand.bounded(doc.characterCount()));
+    cursor.insertText(generateText(rand, 100));
+  }
+
+  while (doc.isUndoAvailable()) {
+    doc.undo();
+    verifyCandidates(&doc, rand, 3);
+  }
+
+  cursor.select(QTextCursor::Document);
+  cursor.removeSelectedText();
+  QCOMPARE(index->wordCount(), 0);
+
+  doc.setPlainText(generateText(rand, 1000));
+  verifyCandidates(&doc, rand, 20);
+}
+
+void TestCompletionIndex::testCorpusRanking() {
+  auto &corpus = CompletionCorpus::getInst();
+  QTextDocument doc("alpha x");
+  QTextDocument other1("alps alpine alpine\nbeta");
+  QTextDocument other2("alpine alto alpha");
+  for (auto d : {&doc, &other1, &other2}) {
+    CompletionIndex::get(d)->setCorpus(&corpus);
+  }
+  QCOMPARE(corpus.documentCount(), 3);
+
+  // Words of @doc are left out. The most frequent come first.
+  auto index = CompletionIndex::get(&doc);
+  QCOMPARE(corpus.candidates("a", index), QStringList({"alpine", "alps", "alto"}));
+  QCOMPARE(corpus.frequency("alpine"), 3);
+  QCOMPARE(corpus.frequency("alpha"), 2);
+
+  // Then the most recently completed.
+  corpus.markUsed("alto");
+  corpus.markUsed("alps");
+  QCOMPARE(corpus.candidates("A", index), QStringList({"alps", "alto", "alpine"}));
+
+  // Words of @doc are given first by its own index.
+  QCOMPARE(index->candidates(6, 7, "a", false), QStringList({"alpha"}));
+
+  for (auto d : {&doc, &other1, &other2}) {
+    CompletionIndex::get(d)->setCorpus(nullptr);
+  }
+  QCOMPARE(corpus.documentCount(), 0);
+  QCOMPARE(corpus.wordCount(), 0);
+}
+
+void TestCompletionIndex::testCorpusFollowsDocuments() {
+  auto &corpus = CompletionCorpus::getInst();
+  QTextDocument doc("x");
+  CompletionIndex::get(&doc)->setCorpus(&corpus);
+  auto index = CompletionIndex::get(&doc);
+
+  {
+    QTextDocument other("gamma gamut");
+    CompletionIndex::get(&other)->setCorpus(&corpus);
+    QCOMPARE(corpus.candidates("g", index), QStringList({"gamma", "gamut"}));
+
+    QTextCursor cursor(&other);
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(" gamut\ngalaxy");
+    QCOMPARE(corpus.candidates("g", index), QStringList({"gamut", "galaxy", "gamma"}));
+
+    cursor.select(QTextCursor::Document);
+    cursor.insertText("gala");
+    QCOMPARE(corpus.candidates("g", index), QStringList({"gala"}));
+    QCOMPARE(corpus.frequency("gamut"), 0);
+
+    // The words of @other are released with it.
+  }
+  QCOMPARE(corpus.candidates("g", index), QStringList());
+  QCOMPARE(corpus.documentCount(), 1);
+  QCOMPARE(corpus.wordCount(), 1);
+
+  index->setCorpus(nullptr);
+  QCOMPARE(corpus.wordCount(), 0);
+}
+
+void TestCompletionIndex::benchmarkCandidates_data() {
+  QTest::addColumn<int>("size");
+
+  QTest::addRow("1 MB") << 1024 * 1024;
+  QTest::addRow("10 MB") << 10 * 1024 * 1024;
+}
+
+void TestCompletionIndex::benchmarkCandidates() {
+  QFETCH(int, size);
+
+  QRandomGenerator rand(1);
+  QTextDocument doc(generateText(rand, size));
+  auto index = CompletionIndex::get(&doc);
+  QTextCursor cursor(&doc);
+  cursor.setPosition(doc.characterCount() / 2);
+  cursor.insertText(QStringLiteral(" a"));
+
+  // Warm up: the first query collects every block.
+  auto range = wordRange(&doc, cursor.position());
+  QVERIFY(!index->candidates(range.first, range.second, "a", false).isEmpty());
+
+  // Type a letter and complete, like Ctrl+N while typing.
+  QBENCHMARK {
+    cursor.insertText(QStringLiteral("l"));
+    range = wordRange(&doc, cursor.position());
+    index->candidates(range.first, range.second, "a", false);
+  }
+}
+
+void TestCompletionIndex::benchmarkCorpusCandidates() {
+  // 100 documents of 20 KB, each with words of its own besides the shared ones.
+  QRandomGenerator rand(5);
+  QVector<QSharedPointer<QTextDocument>> docs;
+  for (int i = 0; i < 100; ++i) {
+    auto text = generateText(rand, 20 * 1024);
+    for (int j = 0; j < 500; ++j) {
+      text += QStringLiteral(" ") + QChar('a' + rand.bounded(26)) +
+              QString::number(rand.bounded(1000000), 36);
+    }
+    docs.push_back(QSharedPointer<QTextDocument>::create(text));
+    CompletionIndex::get(docs.last().data())->setCorpus(&CompletionCorpus::getInst());
+  }
+
+  auto &corpus = CompletionCorpus::getInst();
+  auto index = CompletionIndex::get(docs.first().data());
+  QVERIFY(corpus.wordCount() > 40000);
+
+  QTextCursor cursor(docs.last().data());
+  QBENCHMARK {
+    // Typing in another document leaves a block to collect again.
+    cursor.insertText(QStringLiteral("l"));
+    corpus.candidates("a", index);
+  }
+
+  docs.clear();
+  QCOMPARE(corpus.documentCount(), 0);
+}
+
+QTEST_MAIN(tests::TestCompletionIndex)
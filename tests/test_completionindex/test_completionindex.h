@@ -0,0 +1,32 @@
+#ifndef TESTS_TEST_COMPLETIONINDEX_H
+#define TESTS_TEST_COMPLETIONINDEX_H
+
+#include <QtTest>
+
+namespace tests {
+class TestCompletionIndex : public QObject {
+  Q_OBJECT
+private slots:
+  void testCandidatesOrder_data();
+  void testCandidatesOrder();
+
+  void testPrefixIsCaseInsensitive();
+
+  void testWordAtCursorIsExcluded();
+
+  void testIncrementalEdits();
+
+  void testUndoRedo();
+
+  void testCorpusRanking();
+
+  void testCorpusFollowsDocuments();
+
+  void benchmarkCandidates_data();
+  void benchmarkCandidates();
+
+  void benchmarkCorpusCandidates();
+};
+} // namespace tests
+
+#endif
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <limits>
 
+#include <QAbstractScrollArea>
 #include <QAbstractTextDocumentLayout>
 #include <QAction>
 #include <QApplication>
@@ -833,6 +834,39 @@ void TestInteractivePreview::testIdentityReuseOnUnrelatedEdit() {
   QCOMPARE(singlePreviewWidget(editor), static_cast<PreviewWidget *>(widget));
 }
 
+void TestInteractivePreview::testUnrelatedEditReusesTheSnapshotContent() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  auto factory = new RecordingPreviewFactory({PreviewElementType::Table});
+  QVERIFY(editor.registerPreviewWidgetFactory(factory, 5));
+
+  setTextAndSettle(editor, QStringLiteral("head\n\n") + QLatin1String(c_table));
+  QCOMPARE(factory->m_widgets.size(), 1);
+  auto widget = factory->m_widgets.first();
+  const auto before = widget->m_preview.staticCast<const TablePreview>();
+
+  // Text above the table moves it without changing it: the new snapshot is
+  // relocated from the old one, not converted again.
+  QTextCursor cursor(editor.document());
+  cursor.insertText(QStringLiteral("more "));
+  settle(editor);
+
+  const auto after = widget->m_preview.staticCast<const TablePreview>();
+  QVERIFY(after != before);
+  QVERIFY(after->revision() > before->revision());
+  QCOMPARE(after->startPos(), before->startPos() + 5);
+  QCOMPARE(after->cells().constData(), before->cells().constData());
+  QCOMPARE(after->cellFormats().constData(), before->cellFormats().constData());
+  QVERIFY(widget->previewContext()->preview() == after);
+
+  // Editing the table itself converts it again.
+  cursor.setPosition(after->startPos() + 2);
+  cursor.insertText(QStringLiteral("x"));
+  settle(editor);
+  const auto edited = widget->m_preview.staticCast<const TablePreview>();
+  QVERIFY(edited->cells().constData() != after->cells().constData());
+}
+
 // ---------------------------------------------------------------------------
 // Replacement
 // ---------------------------------------------------------------------------
@@ -1040,6 +1074,49 @@ void TestInteractivePreview::testTableEditCommitsCanonicalMarkdown() {
   QVERIFY2(after.contains(QStringLiteral("| h1 | h2 |")), qPrintable(after));
 }
 
+void TestInteractivePreview::testACellEditRewritesOnlyThatCell() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+  QString text = QStringLiteral("| h1 | h2 |\n| --- | --- |\n");
+  for (int i = 0; i < 20; ++i) {
+    text += QStringLiteral("| a%1 | b%1 |\n").arg(i);
+  }
+  setTextAndSettle(editor, text);
+
+  auto widget = singlePreviewWidget(editor);
+  QVERIFY(widget);
+  auto sheet = sheetView(widget);
+  QVERIFY(sheet);
+
+  auto doc = editor.document();
+  const int blockCount = doc->blockCount();
+  const QTextBlock first = doc->findBlockByNumber(2);
+  const QTextBlock last = doc->findBlockByNumber(21);
+
+  // Highlighting reports its format changes with as many characters added as
+  // removed; the edit is the one change which is not of that kind.
+  QVector<QList<QVariant>> edits;
+  QSignalSpy spy(doc, &QTextDocument::contentsChange);
+  editCell(sheet, 10, 1, QStringLiteral("changed"));
+  flushSheet(sheet);
+  for (const auto &args : spy) {
+    if (args.at(1).toInt() != args.at(2).toInt()) {
+      edits.append(args);
+    }
+  }
+
+  QCOMPARE(doc->toPlainText(), QString(text).replace(QStringLiteral("| b9 |"),
+                                                     QStringLiteral("| changed |")));
+  QCOMPARE(edits.size(), 1);
+  QCOMPARE(edits.first().at(0).toInt(), text.indexOf(QStringLiteral("b9 |")));
+  QCOMPARE(edits.first().at(1).toInt(), 2);
+  QCOMPARE(edits.first().at(2).toInt(), 7);
+
+  // The other rows are the same blocks as before.
+  QCOMPARE(doc->blockCount(), blockCount);
+  QCOMPARE(doc->findBlockByNumber(2), first);
+  QCOMPARE(doc->findBlockByNumber(21), last);
+}
+
 void TestInteractivePreview::testEnterInTheLastCellGrowsTheSource() {
   // The unit test's harness answers the replacement itself, so only this
   // target can prove that the *real* host accepts a table which grew: the
@@ -1714,12 +1791,12 @@ void TestInteractivePreview::testReplacementRejectsExoticLineSeparators() {
   }
 }
 
-void TestInteractivePreview::testOversizedTableFallsBackToSource() {
+void TestInteractivePreview::testLargeTableIsShownVirtualized() {
   VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
 
   // A QTextTable is not virtualized and relays the whole table out on every
-  // keystroke, so the cell bound is a latency bound. Past it the raw Markdown
-  // stays as the only rendering.
+  // keystroke, so past the sheet's cell bound the table gets the virtualized
+  // grid instead of the rich text sheet.
   QString text = QStringLiteral("| a | b | c | d | e |\n| --- | --- | --- | --- | --- |\n");
   for (int i = 0; i < 200; ++i) {
     text += QStringLiteral("| r | r | r | r | r |\n");
@@ -1727,8 +1804,22 @@ void TestInteractivePreview::testOversizedTableFallsBackToSource() {
 
   setTextAndSettle(editor, text);
 
-  // No sheet is materialized; the raw Markdown stays as the only rendering.
-  QVERIFY(previewWidgets(editor).isEmpty());
+  auto widget = singlePreviewWidget(editor);
+  QVERIFY(widget);
+  auto sheet = sheetView(widget);
+  QVERIFY(!sheet || !sheet->isVisibleTo(widget));
+
+  QAbstractScrollArea *grid = nullptr;
+  for (auto area : widget->findChildren<QAbstractScrollArea *>()) {
+    if (!qobject_cast<QTextEdit *>(area) && area->isVisibleTo(widget)) {
+      grid = area;
+    }
+  }
+  QVERIFY(grid);
+
+  // Its height is capped, so the editor does not reserve a band for all of
+  // the 201 rows.
+  QVERIFY(widget->heightForWidth(600) < 201 * widget->fontMetrics().height());
 }
 
 void TestInteractivePreview::testReadOnlyEditorDisablesCellEditing() {
@@ -5040,4 +5131,257 @@ void TestInteractivePreview::testOwedWorkDrainsOnceUnderANestedEventLoop() {
   QVERIFY2(delta <= 4, qPrintable(QStringLiteral("%1 drains ran for one unblock").arg(delta)));
 }
 
+void TestInteractivePreview::testOwedWorkIsPacedToTheFrame() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  auto factory = new RecordingPreviewFactory({PreviewElementType::Table});
+  QVERIFY(editor.registerPreviewWidgetFactory(factory, 5));
+
+  editor.resize(600, 300);
+  editor.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&editor));
+  setTextAndSettle(editor, QLatin1String(c_table));
+
+  auto host = previewHost(editor);
+  QVERIFY(host);
+  auto drains = [host]() { return host->property("vte_preview_owed_work_drains").toInt(); };
+  auto frames = [host]() { return host->property("vte_preview_owed_work_frames").toInt(); };
+
+  // Every keystroke owes a publish. While the editor is shown they are
+  // coalesced into at most one drain per frame: each drain has a frame of its
+  // own, however fast the keys come.
+  const int drainsBefore = drains();
+  const int framesBefore = frames();
+  QTextCursor cursor(editor.document());
+  for (int i = 0; i < 50; ++i) {
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(QStringLiteral("x"));
+    QCoreApplication::processEvents();
+  }
+  QTest::qWait(50);
+  QCoreApplication::processEvents();
+
+  const int delta = drains() - drainsBefore;
+  QVERIFY2(delta >= 1, "the owed work was never delivered");
+  QCOMPARE(frames() - framesBefore, delta);
+
+  // Each step reports how often it ran and what it cost.
+  const auto steps = host->property("vte_preview_owed_work_steps").toMap();
+  const auto publish = steps.value(QStringLiteral("publish")).toMap();
+  QVERIFY(publish.value(QStringLiteral("runs")).toInt() > 0);
+  QVERIFY(publish.value(QStringLiteral("nsecs")).toLongLong() > 0);
+}
+
+// ---------------------------------------------------------------------------
+// Virtualization
+// ---------------------------------------------------------------------------
+
+namespace {
+QString manyTables(int p_count) {
+  QString text;
+  for (int i = 0; i < p_count; ++i) {
+    text += QStringLiteral("section %1\n\n").arg(i);
+    text += QLatin1String(c_table);
+    text += QStringLiteral("\n");
+  }
+  return text;
+}
+} // namespace
+
+void TestInteractivePreview::testOffscreenWidgetsAreRecycled() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  auto factory = new RecordingPreviewFactory({PreviewElementType::Table});
+  QVERIFY(editor.registerPreviewWidgetFactory(factory, 5));
+
+  editor.resize(600, 300);
+  editor.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&editor));
+  setTextAndSettle(editor, manyTables(200));
+
+  // A few screens' worth of widgets, plus the pool.
+  const int live = previewWidgets(editor).size();
+  QVERIFY2(live > 0 && live < 100, qPrintable(QStringLiteral("live=%1").arg(live)));
+  QVERIFY2(factory->m_createCount < 100,
+           qPrintable(QStringLiteral("created=%1").arg(factory->m_createCount)));
+
+  // Scrolling through the whole document reuses the pooled widgets instead of
+  // creating one per table.
+  const int createdBefore = factory->m_createCount;
+  auto vbar = editor.getTextEdit()->verticalScrollBar();
+  QVERIFY(vbar->maximum() > 0);
+  for (int value = vbar->minimum(); value <= vbar->maximum(); value += vbar->pageStep()) {
+    vbar->setValue(value);
+    QCoreApplication::processEvents();
+  }
+  QTest::qWait(30);
+  QCoreApplication::processEvents();
+  QVERIFY2(factory->m_createCount - createdBefore < 100,
+           qPrintable(QStringLiteral("created=%1").arg(factory->m_createCount - createdBefore)));
+  QVERIFY(previewWidgets(editor).size() < 100);
+}
+
+void TestInteractivePreview::testScrolledToPreviewIsBoundAgain() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  auto factory = new RecordingPreviewFactory({PreviewElementType::Table});
+  QVERIFY(editor.registerPreviewWidgetFactory(factory, 5));
+
+  editor.resize(600, 300);
+  editor.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&editor));
+  const auto text = manyTables(100);
+  setTextAndSettle(editor, text);
+
+  auto vbar = editor.getTextEdit()->verticalScrollBar();
+  vbar->setValue(vbar->maximum());
+  QTest::qWait(30);
+  QCoreApplication::processEvents();
+
+  // The last table is bound to a visible widget carrying its own snapshot and
+  // a fresh identity.
+  const int lastStart = text.lastIndexOf(QLatin1String(c_table));
+  PreviewWidget *last = nullptr;
+  QSet<quint64> identities;
+  for (auto widget : previewWidgets(editor)) {
+    if (!widget->isVisible()) {
+      continue;
+    }
+    const auto context = widget->previewContext();
+    QVERIFY(context->identity() != 0);
+    QVERIFY(!identities.contains(context->identity()));
+    identities.insert(context->identity());
+    if (context->preview() && context->preview()->startPos() == lastStart) {
+      last = widget;
+    }
+  }
+  QVERIFY(last);
+  QCOMPARE(static_cast<RecordingPreviewWidget *>(last)->m_preview->startPos(), lastStart);
+  QVERIFY(editor.getTextEdit()->viewport()->rect().intersects(last->geometry()));
+}
+
+void TestInteractivePreview::testEqualPreviewsShareOneMeasurement() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  auto factory = new RecordingPreviewFactory({PreviewElementType::Table});
+  factory->m_wrapping = true;
+  factory->m_hint = QSize(400, 40);
+  QVERIFY(editor.registerPreviewWidgetFactory(factory, 5));
+
+  editor.resize(600, 300);
+  editor.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&editor));
+  setTextAndSettle(editor, manyTables(12));
+  QCOMPARE(factory->m_widgets.size(), 12);
+
+  auto host = previewHost(editor);
+  QVERIFY(host);
+  auto stats = [host]() { return host->property("vte_preview_measure_stats").toMap(); };
+  auto approximate = [&stats]() { return stats().value(QStringLiteral("approximate")).toInt(); };
+  auto hits = [&stats]() { return stats().value(QStringLiteral("hits")).toInt(); };
+  auto sizeHints = [factory]() {
+    int count = 0;
+    for (auto widget : factory->m_widgets) {
+      count += widget->m_sizeHintCount;
+    }
+    return count;
+  };
+
+  // The tables are equal, so one measurement serves them all.
+  QVERIFY2(hits() > 0, "no table reused the measurement of an equal one");
+
+  // A narrower window: the tables out of view keep their size until they are
+  // measured in the batches which follow.
+  editor.resize(400, 300);
+  QTRY_COMPARE(approximate(), 0);
+  settle(editor);
+
+  // Back to the first width, which every table was measured at already.
+  const int hitsBefore = hits();
+  const int sizeHintsBefore = sizeHints();
+  editor.resize(600, 300);
+  QTRY_COMPARE(approximate(), 0);
+  settle(editor);
+  QVERIFY(hits() - hitsBefore >= factory->m_widgets.size());
+  QCOMPARE(sizeHints(), sizeHintsBefore);
+
+  // Every reservation ends up being the exact measurement.
+  for (auto widget : factory->m_widgets) {
+    const QRectF assigned = widget->previewContext()->assignedPreviewRect();
+    QVERIFY(!assigned.isNull());
+    QCOMPARE(qRound(assigned.height()), widget->heightForWidth(qRound(assigned.width())));
+  }
+}
+
+void TestInteractivePreview::testOffscreenSizesAreRefinedInBatches() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  auto factory = new RecordingPreviewFactory({PreviewElementType::Table});
+  factory->m_wrapping = true;
+  factory->m_hint = QSize(400, 40);
+  QVERIFY(editor.registerPreviewWidgetFactory(factory, 5));
+
+  editor.resize(600, 300);
+  editor.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&editor));
+
+  // Distinct tables, so none can reuse the measurement of another.
+  QString text;
+  for (int i = 0; i < 20; ++i) {
+    text += QStringLiteral("| h%1 | h2 |\n| --- | --- |\n| a | b |\n\n").arg(i);
+  }
+  setTextAndSettle(editor, text);
+  QCOMPARE(factory->m_widgets.size(), 20);
+
+  auto host = previewHost(editor);
+  QVERIFY(host);
+  auto approximate = [host]() {
+    const auto stats = host->property("vte_preview_measure_stats").toMap();
+    return stats.value(QStringLiteral("approximate")).toInt();
+  };
+
+  // Only the tables in view are measured before the relayout. The others are
+  // refined by the drains which follow.
+  editor.resize(400, 300);
+  QTRY_COMPARE(approximate(), 0);
+  settle(editor);
+
+  const auto steps = host->property("vte_preview_owed_work_steps").toMap();
+  QVERIFY(steps.value(QStringLiteral("measure")).toMap().value(QStringLiteral("runs")).toInt() > 0);
+
+  for (auto widget : factory->m_widgets) {
+    const QRectF assigned = widget->previewContext()->assignedPreviewRect();
+    QVERIFY(!assigned.isNull());
+    QCOMPARE(qRound(assigned.height()), widget->heightForWidth(qRound(assigned.width())));
+  }
+}
+
+void TestInteractivePreview::benchmarkReconcileThousandPreviews() {
+  VMarkdownEditor editor(makeConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  auto factory = new RecordingPreviewFactory({PreviewElementType::Table});
+  QVERIFY(editor.registerPreviewWidgetFactory(factory, 5));
+
+  editor.resize(600, 400);
+  editor.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&editor));
+  setTextAndSettle(editor, manyTables(1000));
+
+  // Widget count stands in for the memory held by the previews.
+  qDebug() << "live widgets" << previewWidgets(editor).size() << "created"
+           << factory->m_createCount;
+
+  // An unrelated edit at the end, reparsed and reconciled against every item.
+  QTextCursor cursor(editor.document());
+  QBENCHMARK {
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(QStringLiteral("x"));
+    auto highlighter = editor.getHighlighter();
+    QSignalSpy completed(highlighter, &MarkdownHighlighter::highlightCompleted);
+    highlighter->updateHighlight();
+    QTRY_VERIFY(completed.count() > 0);
+    QCoreApplication::processEvents();
+  }
+}
+
 QTEST_MAIN(tests::TestInteractivePreview)
@@ -200,6 +200,7 @@ private slots:
   void testUnregisterDestroysFactory();
   void testEditorDestructionDestroysFactory();
   void testIdentityReuseOnUnrelatedEdit();
+  void testUnrelatedEditReusesTheSnapshotContent();
   void testReplacementAccepted();
   void testReplacementIsOneUndoStep();
   void testReplacementRejectedWhenReadOnly();
@@ -209,6 +210,7 @@ private slots:
   void testReplacementAcceptedAfterUnrelatedEdit();
   void testReplacementPreservesBlockquotePrefix();
   void testTableEditCommitsCanonicalMarkdown();
+  void testACellEditRewritesOnlyThatCell();
   void testEnterInTheLastCellGrowsTheSource();
   void testAColumnInsertGrowsTheSource();
   void testAnAlignmentChangeReachesTheDelimiterRow();
@@ -234,7 +236,7 @@ private slots:
   void testCommitKeepsTheSameWidget();
   void testConfigChangeKeepsLiveAnchors();
   void testReplacementRejectsExoticLineSeparators();
-  void testOversizedTableFallsBackToSource();
+  void testLargeTableIsShownVirtualized();
   void testReadOnlyEditorDisablesCellEditing();
   void testNoSnapshotWorkWithoutAClaimableFactory();
   void testTableSheetRefitsAfterFontChange();
@@ -332,6 +334,14 @@ private slots:
   void testConcurrentFlushTriggersSendOneRequest();
   void testReconcileDuringAReplacementCompletionIsPostponed();
   void testOwedWorkDrainsOnceUnderANestedEventLoop();
+  void testOwedWorkIsPacedToTheFrame();
+
+  // Only the previews around the viewport hold a widget.
+  void testOffscreenWidgetsAreRecycled();
+  void testScrolledToPreviewIsBoundAgain();
+  void testEqualPreviewsShareOneMeasurement();
+  void testOffscreenSizesAreRefinedInBatches();
+  void benchmarkReconcileThousandPreviews();
 };
 } // namespace tests
 
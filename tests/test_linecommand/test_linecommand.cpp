@@ -0,0 +1,253 @@
+#include "test_linecommand.h"
+
+#include <linecommand.h>
+
+using namespace tests;
+using namespace KateVi;
+
+namespace KateVi {
+bool operator==(const LineCommand::Change &p_a, const LineCommand::Change &p_b) {
+  return p_a.m_first == p_b.m_first && p_a.m_last == p_b.m_last &&
+         p_a.m_lineCount == p_b.m_lineCount && p_a.m_text == p_b.m_text;
+}
+} // namespace KateVi
+
+namespace {
+LineCommand::Change change(int p_first, int p_last, int p_lineCount, const QString &p_text) {
+  LineCommand::Change change;
+  change.m_first = p_first;
+  change.m_last = p_last;
+  change.m_lineCount = p_lineCount;
+  change.m_text = p_text;
+  return change;
+}
+
+// What LineCommand::apply() leaves in a document of @p_lines.
+QStringList applied(QStringList p_lines, const LineCommand::Plan &p_plan) {
+  for (int i = p_plan.m_changes.size() - 1; i >= 0; --i) {
+    const auto &change = p_plan.m_changes[i];
+    p_lines.erase(p_lines.begin() + change.m_first, p_lines.begin() + change.m_last + 1);
+    if (change.m_lineCount > 0) {
+      const auto lines = change.m_text.split(QLatin1Char('\n'));
+      for (int j = 0; j < lines.size(); ++j) {
+        p_lines.insert(change.m_first + j, lines[j]);
+      }
+    }
+  }
+  return p_lines;
+}
+
+QStringList generateLines(int p_count) {
+  const char *words[] = {"foo", "bar", "baz", "the", "other", "food", "x1"};
+  const int wordCount = sizeof(words) / sizeof(words[0]);
+  QStringList lines;
+  lines.reserve(p_count);
+  for (int i = 0; i < p_count; ++i) {
+    QString line;
+    for (int j = 0; j < 1 + i % 5; ++j) {
+      line += QLatin1String(words[(i * 7 + j * 3) % wordCount]);
+      line += QLatin1Char(' ');
+    }
+    line += QString::number(i);
+    lines.append(line);
+  }
+  return lines;
+}
+} // namespace
+
+void TestLineCommand::testKind_data() {
+  QTest::addColumn<QString>("cmd");
+  QTest::addColumn<int>("kind");
+
+  QTest::newRow("s") << "s/a/b/" << static_cast<int>(LineCommand::Kind::Substitute);
+  QTest::newRow("substitute") << "substitute/a/b/"
+                              << static_cast<int>(LineCommand::Kind::Substitute);
+  QTest::newRow("g") << "g/a/d" << static_cast<int>(LineCommand::Kind::Global);
+  QTest::newRow("g!") << "g!/a/d" << static_cast<int>(LineCommand::Kind::Global);
+  QTest::newRow("global") << "global/a/d" << static_cast<int>(LineCommand::Kind::Global);
+  QTest::newRow("v") << "v/a/d" << static_cast<int>(LineCommand::Kind::Global);
+  QTest::newRow("vglobal") << "vglobal/a/d" << static_cast<int>(LineCommand::Kind::Global);
+  QTest::newRow("set") << "set nu" << static_cast<int>(LineCommand::Kind::None);
+  QTest::newRow("sort") << "sort" << static_cast<int>(LineCommand::Kind::None);
+  QTest::newRow("range") << "%s/a/b/" << static_cast<int>(LineCommand::Kind::None);
+}
+
+void TestLineCommand::testKind() {
+  QFETCH(QString, cmd);
+  QFETCH(int, kind);
+
+  QCOMPARE(static_cast<int>(LineCommand::kind(cmd)), kind);
+}
+
+void TestLineCommand::testToQtPattern_data() {
+  QTest::addColumn<QString>("pattern");
+  QTest::addColumn<QString>("expected");
+  QTest::addColumn<bool>("caseInsensitive");
+
+  QTest::newRow("plain") << "a.b*" << "a.b*" << false;
+  QTest::newRow("groups") << "\\(a\\|b\\)\\+" << "(a|b)+" << false;
+  QTest::newRow("literal metacharacters") << "(a|b)+?" << "\\(a\\|b\\)\\+\\?" << false;
+  QTest::newRow("optional") << "ab\\=" << "ab?" << false;
+  QTest::newRow("word boundaries") << "\\<a\\>" << "\\ba\\b" << false;
+  QTest::newRow("count") << "a\\{2,3}" << "a{2,3}" << false;
+  QTest::newRow("escaped count end") << "a\\{2\\}" << "a{2}" << false;
+  QTest::newRow("lazy") << "a\\{-}" << "a*?" << false;
+  QTest::newRow("lazy count") << "a\\{-1,}" << "a{1,}?" << false;
+  QTest::newRow("other escapes") << "\\d\\s\\\\" << "\\d\\s\\\\" << false;
+  QTest::newRow("ignore case") << "\\cabc" << "abc" << true;
+}
+
+void TestLineCommand::testToQtPattern() {
+  QFETCH(QString, pattern);
+  QFETCH(QString, expected);
+  QFETCH(bool, caseInsensitive);
+
+  bool ci = false;
+  QCOMPARE(LineCommand::toQtPattern(pattern, &ci), expected);
+  QCOMPARE(ci, caseInsensitive);
+}
+
+void TestLineCommand::testSubstitute_data() {
+  QTest::addColumn<QString>("cmd");
+  QTest::addColumn<QString>("text");
+  QTest::addColumn<QString>("expected");
+
+  QTest::newRow("first") << "s/foo/bar/" << "foo foo\nxfoo" << "bar foo\nxbar";
+  QTest::newRow("all") << "s/foo/bar/g" << "foo foo\nxfoo" << "bar bar\nxbar";
+  QTest::newRow("groups") << "s/\\(a\\)\\(b\\)/\\2\\1/g" << "abab" << "baba";
+  QTest::newRow("whole match") << "s/o\\+/[&]/g" << "foo bo" << "f[oo] b[o]";
+  QTest::newRow("escaped ampersand") << "s/o/\\&/" << "foo" << "f&o";
+  QTest::newRow("ignore case flag") << "s/FOO/x/gi" << "foo Foo" << "x x";
+  QTest::newRow("ignore case marker") << "s/\\cFOO/x/g" << "foo Foo" << "x x";
+  QTest::newRow("case sensitive") << "s/Foo/x/g" << "foo Foo" << "foo x";
+  QTest::newRow("line breaks") << "s/, /\\r/g" << "a, b, c\nd" << "a\nb\nc\nd";
+  QTest::newRow("other delimiter") << "s#/#\\\\#g" << "a/b/c" << "a\\b\\c";
+  QTest::newRow("escaped delimiter") << "s/a\\/b/c/" << "a/b" << "c";
+  QTest::newRow("count") << "s/x\\{2}/y/g" << "xxxxx" << "yyx";
+  QTest::newRow("words") << "s/\\<the\\>/a/g" << "the then the" << "a then a";
+  QTest::newRow("line end") << "s/$/;/" << "a\n\nb" << "a;\n;\nb;";
+  QTest::newRow("no final delimiter") << "su/a/b" << "aa" << "ba";
+  QTest::newRow("literal parentheses") << "s/(x)/y/" << "(x) x" << "y x";
+  QTest::newRow("empty replacement") << "s/a//g" << "banana" << "bnn";
+}
+
+void TestLineCommand::testSubstitute() {
+  QFETCH(QString, cmd);
+  QFETCH(QString, text);
+  QFETCH(QString, expected);
+
+  const auto lines = text.split(QLatin1Char('\n'));
+  const auto plan = LineCommand::plan(cmd, lines, 0);
+  QVERIFY2(plan.m_error.isEmpty(), qPrintable(plan.m_error));
+  QCOMPARE(applied(lines, plan).join(QLatin1Char('\n')), expected);
+}
+
+void TestLineCommand::testGlobal_data() {
+  QTest::addColumn<QString>("cmd");
+  QTest::addColumn<QString>("text");
+  QTest::addColumn<QString>("expected");
+
+  QTest::newRow("delete") << "g/foo/d" << "foo\nbar\nfood\nbaz" << "bar\nbaz";
+  QTest::newRow("vglobal") << "v/foo/d" << "foo\nbar\nfood\nbaz" << "foo\nfood";
+  QTest::newRow("inverted") << "g!/foo/d" << "foo\nbar\nfood\nbaz" << "foo\nfood";
+  QTest::newRow("every line") << "global/^/delete" << "a\n\nb" << "";
+  QTest::newRow("substitute") << "g/^b/s/a/o/g" << "bar\nfoo\nbaa" << "bor\nfoo\nboo";
+  QTest::newRow("filter pattern") << "g/a/s//X/" << "bar\nfoo" << "bXr\nfoo";
+}
+
+void TestLineCommand::testGlobal() {
+  QFETCH(QString, cmd);
+  QFETCH(QString, text);
+  QFETCH(QString, expected);
+
+  const auto lines = text.split(QLatin1Char('\n'));
+  const auto plan = LineCommand::plan(cmd, lines, 0);
+  QVERIFY2(plan.m_error.isEmpty(), qPrintable(plan.m_error));
+  QCOMPARE(applied(lines, plan).join(QLatin1Char('\n')), expected);
+}
+
+void TestLineCommand::testErrors_data() {
+  QTest::addColumn<QString>("cmd");
+  QTest::addColumn<QString>("error");
+
+  QTest::newRow("not found") << "s/x/y/" << "Pattern not found: x";
+  QTest::newRow("not found quiet") << "s/x/y/e" << "";
+  QTest::newRow("global not found") << "g/x/d" << "Pattern not found: x";
+  QTest::newRow("no pattern") << "s" << "Expected a delimiter";
+  QTest::newRow("empty pattern") << "s//y/" << "No previous regular expression";
+  QTest::newRow("flag") << "s/a/b/q" << "Unsupported flag: q";
+  QTest::newRow("invalid pattern") << "s/\\(a/b/" << "Invalid pattern";
+  QTest::newRow("global without command") << "g/a/" << "Missing command for :global";
+  QTest::newRow("global command") << "g/a/normal x" << "Unsupported command for :global";
+  QTest::newRow("command") << "set nu" << "No such command";
+}
+
+void TestLineCommand::testErrors() {
+  QFETCH(QString, cmd);
+  QFETCH(QString, error);
+
+  const auto plan = LineCommand::plan(cmd, QStringList{"abc", "def"}, 0);
+  QVERIFY2(error.isEmpty() ? plan.m_error.isEmpty() : plan.m_error.startsWith(error),
+           qPrintable(plan.m_error));
+  QVERIFY(plan.m_changes.isEmpty());
+}
+
+void TestLineCommand::testChangeRuns() {
+  // Adjacent lines are merged into one change, numbered from the first line.
+  const auto deleted = LineCommand::plan(QStringLiteral("g/x/d"),
+                                         QStringList{"x", "a", "x", "x", "b", "x"}, 10);
+  QCOMPARE(deleted.m_changes,
+           QVector<LineCommand::Change>({change(10, 10, 0, QString()),
+                                         change(12, 13, 0, QString()),
+                                         change(15, 15, 0, QString())}));
+  QCOMPARE(deleted.m_removedLines, 4);
+
+  const auto substituted = LineCommand::plan(QStringLiteral("s/-/\\r/g"),
+                                             QStringList{"a-b", "c-d", "e", "f-"}, 0);
+  QCOMPARE(substituted.m_changes,
+           QVector<LineCommand::Change>({change(0, 1, 4, QStringLiteral("a\nb\nc\nd")),
+                                         change(3, 3, 2, QStringLiteral("f\n"))}));
+  QCOMPARE(substituted.m_substitutions, 3);
+  QCOMPARE(substituted.m_substitutedLines, 3);
+}
+
+void TestLineCommand::testParallelPlan() {
+  // Large enough to be planned in chunks across threads, compared with slices
+  // small enough to be planned on the calling thread.
+  const auto lines = generateLines(200000);
+  const int sliceSize = 1000;
+  const QStringList cmds{"s/\\<foo\\>/qux/g", "g/food/d", "v/bar/s/o\\+/0/"};
+  for (const auto &cmd : cmds) {
+    const auto plan = LineCommand::plan(cmd, lines, 0);
+    QVERIFY(plan.m_error.isEmpty());
+
+    QVector<LineCommand::Change> changes;
+    for (int i = 0; i < lines.size(); i += sliceSize) {
+      const auto slice = LineCommand::plan(cmd, lines.mid(i, sliceSize), i);
+      changes += slice.m_changes;
+    }
+
+    // Slices cut the runs at their ends, so compare the resulting lines.
+    LineCommand::Plan slicedPlan;
+    slicedPlan.m_changes = changes;
+    QCOMPARE(applied(lines, plan), applied(lines, slicedPlan));
+  }
+}
+
+void TestLineCommand::benchmarkSubstitute() {
+  const auto lines = generateLines(100000);
+  QBENCHMARK {
+    const auto plan = LineCommand::plan(QStringLiteral("s/\\<foo\\>/qux/g"), lines, 0);
+    QVERIFY(plan.m_substitutions > 0);
+  }
+}
+
+void TestLineCommand::benchmarkGlobalDelete() {
+  const auto lines = generateLines(100000);
+  QBENCHMARK {
+    const auto plan = LineCommand::plan(QStringLiteral("g/food/d"), lines, 0);
+    QVERIFY(plan.m_removedLines > 0);
+  }
+}
+
+QTEST_MAIN(tests::TestLineCommand)
@@ -0,0 +1,35 @@
+#ifndef TESTS_TEST_LINECOMMAND_H
+#define TESTS_TEST_LINECOMMAND_H
+
+#include <QtTest>
+
+namespace tests {
+class TestLineCommand : public QObject {
+  Q_OBJECT
+private slots:
+  void testKind_data();
+  void testKind();
+
+  void testToQtPattern_data();
+  void testToQtPattern();
+
+  void testSubstitute_data();
+  void testSubstitute();
+
+  void testGlobal_data();
+  void testGlobal();
+
+  void testErrors_data();
+  void testErrors();
+
+  void testChangeRuns();
+
+  void testParallelPlan();
+
+  void benchmarkSubstitute();
+
+  void benchmarkGlobalDelete();
+};
+} // namespace tests
+
+#endif
@@ -465,6 +465,129 @@ void TestMarkdownFolding::testFoldingBlockHeights() {
   QVERIFY(qFuzzyCompare(unfoldedHeight, preFoldHeight));
 }
 
+// Every block starts where the previous one ends.
+static bool offsetsAreChained(const QTextDocument &p_doc) {
+  qreal offset = 0;
+  for (auto block = p_doc.firstBlock(); block.isValid(); block = block.next()) {
+    auto info = BlockLayoutData::get(block);
+    if (!info->hasOffset() || !realNear(info->m_offset, offset)) {
+      return false;
+    }
+    offset = info->bottom();
+  }
+  return true;
+}
+
+void TestMarkdownFolding::testBatchedBlockVisibility() {
+  QTextDocument doc(generateLines(25));
+  DocumentResourceMgr resourceMgr;
+  auto *layout = new TextDocumentLayout(&doc, &resourceMgr);
+  doc.setDocumentLayout(layout);
+  TextFolding folding(&doc);
+  connect(&folding, &TextFolding::blocksVisibilityChanged, layout,
+          &TextDocumentLayout::updateBlocksVisibility);
+
+  // Reference going through markContentsDirty() and a relayout of the range.
+  QTextDocument refDoc(generateLines(25));
+  auto *refLayout = new TextDocumentLayout(&refDoc, &resourceMgr);
+  refDoc.setDocumentLayout(refLayout);
+  TextFolding refFolding(&refDoc);
+
+  const qreal unfoldedHeight = layout->documentSize().height();
+  QVERIFY(realNear(refLayout->documentSize().height(), unfoldedHeight));
+
+  QSignalSpy contentsSpy(&doc, &QTextDocument::contentsChange);
+  QSignalSpy visibilitySpy(&folding, &TextFolding::blocksVisibilityChanged);
+
+  auto newRange = [](QTextDocument &p_doc, TextFolding &p_folding, int p_first, int p_last) {
+    TextBlockRange range(p_doc.findBlockByNumber(p_first), p_doc.findBlockByNumber(p_last));
+    return p_folding.newFoldingRange(range, TextFolding::Persistent);
+  };
+  const auto inner = newRange(doc, folding, 12, 15);
+  const auto outer = newRange(doc, folding, 2, 20);
+  const auto refInner = newRange(refDoc, refFolding, 12, 15);
+  const auto refOuter = newRange(refDoc, refFolding, 2, 20);
+
+  folding.toggleRange(inner);
+  refFolding.toggleRange(refInner);
+  folding.toggleRange(outer);
+  refFolding.toggleRange(refOuter);
+
+  QCOMPARE(visibilitySpy.count(), 2);
+  QCOMPARE(visibilitySpy.last().at(0).toInt(), 2);
+  QCOMPARE(visibilitySpy.last().at(1).toInt(), 20);
+  QCOMPARE(contentsSpy.count(), 0);
+
+  for (int i = 3; i <= 19; ++i) {
+    auto block = doc.findBlockByNumber(i);
+    QCOMPARE(BlockLayoutData::get(block)->m_rect.height(), 0.0);
+    QCOMPARE(block.layout()->lineCount(), 0);
+  }
+  QVERIFY(offsetsAreChained(doc));
+  const qreal foldedHeight = layout->documentSize().height();
+  QVERIFY(foldedHeight < unfoldedHeight);
+  QVERIFY(realNear(foldedHeight, refLayout->documentSize().height()));
+
+  // The nested folded range stays folded and its blocks are not shaped again.
+  folding.toggleRange(outer);
+  refFolding.toggleRange(refOuter);
+  QCOMPARE(contentsSpy.count(), 0);
+  for (int i = 13; i <= 14; ++i) {
+    auto block = doc.findBlockByNumber(i);
+    QVERIFY(!block.isVisible());
+    QCOMPARE(block.layout()->lineCount(), 0);
+  }
+  for (int i : {3, 11, 12, 15, 16, 19}) {
+    QVERIFY(BlockLayoutData::get(doc.findBlockByNumber(i))->m_rect.height() > 0);
+  }
+  QVERIFY(offsetsAreChained(doc));
+  QVERIFY(realNear(layout->documentSize().height(), refLayout->documentSize().height()));
+
+  folding.toggleRange(inner);
+  QVERIFY(offsetsAreChained(doc));
+  QVERIFY(realNear(layout->documentSize().height(), unfoldedHeight));
+}
+
+void TestMarkdownFolding::benchmarkFoldLargeRange_data() {
+  QTest::addColumn<int>("lines");
+  QTest::addColumn<bool>("fold");
+
+  for (int lines : {1000, 10000, 100000}) {
+    QTest::addRow("fold %d", lines) << lines << true;
+    QTest::addRow("unfold %d", lines) << lines << false;
+  }
+}
+
+void TestMarkdownFolding::benchmarkFoldLargeRange() {
+  QFETCH(int, lines);
+  QFETCH(bool, fold);
+
+  // The range spans every line but the first and the last one.
+  QTextDocument doc(generateLines(lines + 2));
+  DocumentResourceMgr resourceMgr;
+  auto *layout = new TextDocumentLayout(&doc, &resourceMgr);
+  doc.setDocumentLayout(layout);
+  TextFolding folding(&doc);
+  connect(&folding, &TextFolding::blocksVisibilityChanged, layout,
+          &TextDocumentLayout::updateBlocksVisibility);
+
+  const qreal unfoldedHeight = layout->documentSize().height();
+  TextBlockRange range(doc.firstBlock(), doc.lastBlock());
+  const auto id = folding.newFoldingRange(range, TextFolding::Persistent);
+  QVERIFY(id != TextFolding::InvalidRangeId);
+
+  if (!fold) {
+    folding.toggleRange(id);
+  }
+
+  // Each row toggles once: a second round would unfold what the first folded.
+  QBENCHMARK_ONCE { folding.toggleRange(id); }
+
+  QCOMPARE(folding.isRangeFolded(id), fold);
+  const qreal height = layout->documentSize().height();
+  QVERIFY(fold ? height < unfoldedHeight : realNear(height, unfoldedHeight));
+}
+
 void TestMarkdownFolding::testFractionalBlockCoordinates() {
   QTextDocument doc(generateLines(10));
   doc.setTextWidth(600);
@@ -1828,6 +1951,138 @@ void TestMarkdownFolding::testRestoreFoldedRange() {
   QCOMPARE(folding.foldingRangesStartingOnBlock(15).size(), 0);
 }
 
+// ---------------------------------------------------------------------------
+// Diff against the previous parse
+// ---------------------------------------------------------------------------
+
+static QVector<qint64> rangeIdsStartingOn(const TextFolding &p_folding,
+                                          const QVector<int> &p_blocks) {
+  QVector<qint64> ids;
+  for (int block : p_blocks) {
+    const auto ranges = p_folding.foldingRangesStartingOnBlock(block);
+    ids.append(ranges.size() == 1 ? ranges.first().first : TextFolding::InvalidRangeId);
+  }
+  return ids;
+}
+
+// An edit between two regions moves the entries below it without a single call
+// into TextFolding, and the re-parse then finds nothing to add or remove.
+void TestMarkdownFolding::testDiffShiftsEntriesBelowAnEdit() {
+  QTextDocument doc(generateLines(100));
+  TextFolding folding(&doc);
+  MarkdownFoldingProvider provider(&folding, &doc);
+
+  QVector<md::FoldingRegion> regions;
+  regions.append({10, 19, md::FencedCode, 0});
+  regions.append({30, 39, md::Table, 0});
+  regions.append({50, 59, md::FencedCode, 0});
+  regions.append({70, 79, md::Math, 0});
+  provider.updateFoldingRegions(regions);
+  QCOMPARE(provider.lastDiff().m_added, 4);
+
+  const auto ids = rangeIdsStartingOn(folding, {10, 30, 50, 70});
+  QVERIFY(folding.foldRange(ids[2]));
+
+  QTextCursor cursor(doc.findBlockByNumber(45));
+  cursor.insertText(QStringLiteral("inserted\n"));
+
+  QSignalSpy spy(&folding, &TextFolding::foldingRangesChanged);
+  QVector<md::FoldingRegion> shifted;
+  shifted.append({10, 19, md::FencedCode, 0});
+  shifted.append({30, 39, md::Table, 0});
+  shifted.append({51, 60, md::FencedCode, 0});
+  shifted.append({71, 80, md::Math, 0});
+  provider.updateFoldingRegions(shifted);
+
+  QCOMPARE(spy.count(), 0);
+  QCOMPARE(provider.lastDiff().m_added, 0);
+  QCOMPARE(provider.lastDiff().m_removed, 0);
+  QCOMPARE(provider.lastDiff().m_moved, 2);
+  QCOMPARE(rangeIdsStartingOn(folding, {10, 30, 51, 71}), ids);
+  QVERIFY(folding.isRangeFolded(ids[2]));
+
+  // The next parse of an unchanged document has nothing to do at all.
+  provider.updateFoldingRegions(shifted);
+  QCOMPARE(provider.lastDiff().m_moved, 0);
+  QCOMPARE(spy.count(), 0);
+}
+
+// Several edits between two parses are merged into one span. Entries within it
+// resolve their live extent, the others are shifted by the net block delta.
+void TestMarkdownFolding::testDiffAcrossSeveralEdits() {
+  QTextDocument doc(generateLines(100));
+  TextFolding folding(&doc);
+  MarkdownFoldingProvider provider(&folding, &doc);
+
+  QVector<md::FoldingRegion> regions;
+  regions.append({10, 19, md::FencedCode, 0});
+  regions.append({30, 39, md::Table, 0});
+  regions.append({50, 59, md::FencedCode, 0});
+  regions.append({70, 79, md::Math, 0});
+  regions.append({90, 95, md::FencedCode, 0});
+  provider.updateFoldingRegions(regions);
+  const auto ids = rangeIdsStartingOn(folding, {10, 30, 50, 70, 90});
+
+  // One line added above everything, one removed between the second and the
+  // third region, and two added within the fourth one.
+  QTextCursor cursor(doc.findBlockByNumber(5));
+  cursor.insertText(QStringLiteral("x\n"));
+  cursor.setPosition(doc.findBlockByNumber(46).position());
+  cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
+  cursor.removeSelectedText();
+  cursor.setPosition(doc.findBlockByNumber(75).position());
+  cursor.insertText(QStringLiteral("y\nz\n"));
+
+  QVector<md::FoldingRegion> edited;
+  edited.append({11, 20, md::FencedCode, 0});
+  edited.append({31, 40, md::Table, 0});
+  edited.append({50, 59, md::FencedCode, 0});
+  edited.append({70, 81, md::Math, 0});
+  edited.append({92, 97, md::FencedCode, 0});
+  provider.updateFoldingRegions(edited);
+
+  QCOMPARE(provider.lastDiff().m_added, 0);
+  QCOMPARE(provider.lastDiff().m_removed, 0);
+  QCOMPARE(rangeIdsStartingOn(folding, {11, 31, 50, 70, 92}), ids);
+
+  bool folded = true;
+  QVERIFY(provider.tryRegionFolded(PreviewElementType::Math, 70, 81, &folded));
+  QVERIFY(!folded);
+}
+
+// A parse of a document with 20k heading sections, most of them unchanged.
+void TestMarkdownFolding::benchmarkReconcileManyHeadings() {
+  const int numOfHeadings = 20000;
+  QStringList lines;
+  lines.reserve(numOfHeadings * 3);
+  QVector<md::FoldingRegion> regions;
+  regions.reserve(numOfHeadings);
+  for (int i = 0; i < numOfHeadings; ++i) {
+    const int level = i % 3 + 1;
+    regions.append({lines.size(), lines.size(), md::Heading, level});
+    lines << QStringLiteral("%1 heading %2").arg(QString(level, QLatin1Char('#'))).arg(i)
+          << QStringLiteral("body") << QString();
+  }
+
+  QTextDocument doc(lines.join(QLatin1Char('\n')));
+  TextFolding folding(&doc);
+  MarkdownFoldingProvider provider(&folding, &doc);
+
+  md::computeHeadingSections(regions, doc.blockCount());
+  QCOMPARE(regions.size(), numOfHeadings);
+  provider.updateFoldingRegions(regions);
+  QCOMPARE(provider.lastDiff().m_added, numOfHeadings);
+
+  // Typing within a line of the middle section.
+  QTextCursor cursor(doc.findBlockByNumber(numOfHeadings / 2 * 3 + 1));
+  QBENCHMARK {
+    cursor.insertText(QStringLiteral("x"));
+    provider.updateFoldingRegions(regions);
+  }
+  QCOMPARE(provider.lastDiff().m_added, 0);
+  QCOMPARE(provider.lastDiff().m_removed, 0);
+}
+
 // ---------------------------------------------------------------------------
 // Preview driven auto-folding
 // ---------------------------------------------------------------------------
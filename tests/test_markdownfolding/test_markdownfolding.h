@@ -45,6 +45,12 @@ private slots:
 
   void testFoldingBlockHeights();
 
+  // Fold and unfold through TextDocumentLayout::updateBlocksVisibility().
+  void testBatchedBlockVisibility();
+
+  void benchmarkFoldLargeRange_data();
+  void benchmarkFoldLargeRange();
+
   void testFractionalBlockCoordinates();
 
   void testFractionalClipDraw();
@@ -125,6 +131,13 @@ private slots:
 
   void testRestoreFoldedRange();
 
+  // Diff against the previous parse.
+  void testDiffShiftsEntriesBelowAnEdit();
+
+  void testDiffAcrossSeveralEdits();
+
+  void benchmarkReconcileManyHeadings();
+
   // Preview driven auto-folding.
   void testAutoFoldWidgetPreview();
 
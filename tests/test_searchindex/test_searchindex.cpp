@@ -0,0 +1,463 @@
+#include "test_searchindex.h"
+
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <extraselectionmgr.h>
+#include <searchindex.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace vte {
+// Positions only, as the reference does not tell the pattern.
+bool operator==(const SearchIndex::Match &p_a, const SearchIndex::Match &p_b) {
+  return p_a.m_start == p_b.m_start && p_a.m_end == p_b.m_end;
+}
+} // namespace vte
+
+namespace {
+const char *c_vocabulary[] = {"foo", "Foo", "food", "bar", "BAR", "foobar", "baz", "a", "aa",
+                              "x1", "the", "The", "then", "other"};
+
+const char *c_separators[] = {" ", " ", " ", ", ", ". ", "\n", "\n\n", "-", "_"};
+
+QString generateText(QRandomGenerator &p_rand, int p_size) {
+  QString text;
+  text.reserve(p_size + 16);
+  const int vocabularySize = sizeof(c_vocabulary) / sizeof(c_vocabulary[0]);
+  const int separatorSize = sizeof(c_separators) / sizeof(c_separators[0]);
+  while (text.size() < p_size) {
+    text += QLatin1String(c_vocabulary[p_rand.bounded(vocabularySize)]);
+    text += QLatin1String(c_separators[p_rand.bounded(separatorSize)]);
+  }
+  return text;
+}
+
+// Same as VTextEdit::findAllText() with VTextEditor sorting the matches of
+// several texts.
+QVector<SearchIndex::Match> referenceFindAll(QTextDocument *p_doc, const QStringList &p_texts,
+                                             FindFlags p_flags, int p_start, int p_end) {
+  QTextDocument::FindFlags flags;
+  if (p_flags & FindFlag::CaseSensitive) {
+    flags |= QTextDocument::FindCaseSensitively;
+  }
+  if (p_flags & FindFlag::WholeWordOnly) {
+    flags |= QTextDocument::FindWholeWords;
+  }
+
+  QVector<SearchIndex::Match> matches;
+  int cnt = 0;
+  for (const auto &text : p_texts) {
+    if (text.isEmpty()) {
+      continue;
+    }
+
+    ++cnt;
+    const QRegularExpression regExp(text);
+    int start = p_start;
+    const int end = p_end == -1 ? p_doc->characterCount() + 1 : p_end;
+    while (start < end) {
+      const auto cursor = (p_flags & FindFlag::RegularExpression)
+                               ? p_doc->find(regExp, start, flags)
+                               : p_doc->find(text, start, flags);
+      if (cursor.isNull()) {
+        break;
+      }
+
+      start = cursor.selectionEnd();
+      if (start <= end) {
+        matches.push_back({cursor.selectionStart(), cursor.selectionEnd()});
+      }
+
+      if (cursor.selectionStart() == cursor.selectionEnd()) {
+        ++start;
+      }
+    }
+  }
+
+  if (cnt > 1) {
+    SearchIndex::sortMatches(matches);
+  }
+  return matches;
+}
+
+// Records what ExtraSelectionMgr applies, over a real document.
+class RecordingExtraSelectionInterface : public ExtraSelectionInterface {
+public:
+  explicit RecordingExtraSelectionInterface(QTextDocument *p_doc) : m_document(p_doc) {}
+
+  QTextCursor textCursor() const Q_DECL_OVERRIDE { return m_cursor; }
+
+  QString selectedText() const Q_DECL_OVERRIDE { return m_cursor.selectedText(); }
+
+  void setExtraSelections(const QList<QTextEdit::ExtraSelection> &p_selections) Q_DECL_OVERRIDE {
+    m_selections = p_selections;
+    ++m_applyCount;
+  }
+
+  QTextDocument *document() const Q_DECL_OVERRIDE { return m_document; }
+
+  QPair<int, int> visibleBlockRange() const Q_DECL_OVERRIDE { return m_visibleRange; }
+
+  // Block numbers of the selections applied, which must all be within
+  // [@p_first, @p_last].
+  bool selectionsWithin(int p_first, int p_last) const {
+    for (const auto &selection : m_selections) {
+      const int blockNumber = selection.cursor.blockNumber();
+      if (blockNumber < p_first || blockNumber > p_last) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  QTextDocument *m_document = nullptr;
+
+  QTextCursor m_cursor;
+
+  QPair<int, int> m_visibleRange = qMakePair(0, -1);
+
+  QList<QTextEdit::ExtraSelection> m_selections;
+
+  int m_applyCount = 0;
+};
+
+struct Search {
+  QStringList m_texts;
+
+  FindFlags m_flags;
+};
+
+QVector<Search> searches() {
+  return {{{"foo"}, FindFlag::None},
+          {{"foo"}, FindFlag::CaseSensitive},
+          {{"foo"}, FindFlag::WholeWordOnly},
+          {{"the", "a"}, FindFlag::WholeWordOnly},
+          {{"o+"}, FindFlag::RegularExpression},
+          {{"^", "$"}, FindFlag::RegularExpression},
+          {{"\\bba\\w*"}, FindFlags(FindFlag::RegularExpression | FindFlag::CaseSensitive)},
+          {{"a*"}, FindFlags(FindFlag::RegularExpression | FindFlag::WholeWordOnly)}};
+}
+
+void verifySearches(QTextDocument *p_doc, SearchIndex &p_index, QRandomGenerator &p_rand) {
+  for (const auto &search : searches()) {
+    const int size = p_doc->characterCount();
+    const int start = p_rand.bounded(size);
+    const int end = p_rand.bounded(2) ? -1 : start + p_rand.bounded(size - start + 1);
+    QCOMPARE(p_index.findAll(search.m_texts, search.m_flags, 0, -1),
+             referenceFindAll(p_doc, search.m_texts, search.m_flags, 0, -1));
+    QCOMPARE(p_index.findAll(search.m_texts, search.m_flags, start, end),
+             referenceFindAll(p_doc, search.m_texts, search.m_flags, start, end));
+  }
+}
+} // namespace
+
+void TestSearchIndex::testFindAll_data() {
+  QTest::addColumn<QStringList>("texts");
+  QTest::addColumn<int>("flags");
+  QTest::addColumn<int>("start");
+  QTest::addColumn<int>("end");
+
+  QTest::addRow("plain") << QStringList("foo") << int(FindFlag::None) << 0 << -1;
+  QTest::addRow("case sensitive") << QStringList("Foo") << int(FindFlag::CaseSensitive) << 0 << -1;
+  QTest::addRow("whole word") << QStringList("foo") << int(FindFlag::WholeWordOnly) << 0 << -1;
+  QTest::addRow("range") << QStringList("foo") << int(FindFlag::None) << 5 << 30;
+  QTest::addRow("range mid match") << QStringList("foo") << int(FindFlag::None) << 1 << 33;
+  QTest::addRow("multiple texts") << QStringList({"bar", "foo", ""}) << int(FindFlag::None) << 0
+                                  << -1;
+  QTest::addRow("regexp") << QStringList("f\\w+") << int(FindFlag::RegularExpression) << 0 << -1;
+  QTest::addRow("zero length") << QStringList("$") << int(FindFlag::RegularExpression) << 0 << -1;
+  QTest::addRow("zero length range") << QStringList("^") << int(FindFlag::RegularExpression) << 4
+                                     << 24;
+  QTest::addRow("invalid regexp") << QStringList("(") << int(FindFlag::RegularExpression) << 0
+                                  << -1;
+  QTest::addRow("empty range") << QStringList("foo") << int(FindFlag::None) << 8 << 8;
+}
+
+void TestSearchIndex::testFindAll() {
+  QFETCH(QStringList, texts);
+  QFETCH(int, flags);
+  QFETCH(int, start);
+  QFETCH(int, end);
+
+  QTextDocument doc(QStringLiteral("foo Foo food\nbar foobar\n\nFOO-foo_bar foo\nlast foo"));
+  SearchIndex index(&doc);
+  const auto findFlags = FindFlags(flags);
+  QCOMPARE(index.findAll(texts, findFlags, start, end),
+           referenceFindAll(&doc, texts, findFlags, start, end));
+}
+
+void TestSearchIndex::testIncrementalEdits() {
+  QRandomGenerator rand(11);
+  QTextDocument doc(generateText(rand, 3000));
+  SearchIndex index(&doc);
+  verifySearches(&doc, index, rand);
+
+  QTextCursor cursor(&doc);
+  for (int i = 0; i < 300; ++i) {
+    const int position = rand.bounded(doc.characterCount());
+    cursor.setPosition(position);
+    switch (rand.bounded(4)) {
+    case 0:
+      cursor.insertText(generateText(rand, rand.bounded(1, 40)));
+      break;
+
+    case 1:
+      cursor.insertText(QStringLiteral("\n"));
+      break;
+
+    case 2:
+      cursor.setPosition(qMin(position + rand.bounded(1, 60), doc.characterCount() - 1),
+                         QTextCursor::KeepAnchor);
+      cursor.removeSelectedText();
+      break;
+
+    default:
+      cursor.insertText(QString(QLatin1Char('a' + rand.bounded(26))));
+      break;
+    }
+
+    if (i % 5 == 0) {
+      verifySearches(&doc, index, rand);
+    }
+  }
+
+  verifySearches(&doc, index, rand);
+}
+
+void TestSearchIndex::testUndoRedo() {
+  QRandomGenerator rand(5);
+  QTextDocument doc(generateText(rand, 2000));
+  SearchIndex index(&doc);
+  verifySearches(&doc, index, rand);
+
+  QTextCursor cursor(&doc);
+  for (int i = 0; i < 20; ++i) {
+    cursor.setPosition(rand.bounded(doc.characterCount()));
+    cursor.insertText(generateText(rand, 100));
+  }
+
+  while (doc.isUndoAvailable()) {
+    doc.undo();
+    verifySearches(&doc, index, rand);
+  }
+
+  while (doc.isRedoAvailable()) {
+    doc.redo();
+  }
+  verifySearches(&doc, index, rand);
+
+  doc.setPlainText(generateText(rand, 1000));
+  verifySearches(&doc, index, rand);
+}
+
+void TestSearchIndex::testSearchChange() {
+  QTextDocument doc(QStringLiteral("foo bar\nfoo"));
+  SearchIndex index(&doc);
+  QCOMPARE(index.findAll(QStringList("foo"), FindFlag::None, 0, -1).size(), 2);
+  QCOMPARE(index.findAll(QStringList("bar"), FindFlag::None, 0, -1).size(), 1);
+
+  // Direction does not change the matches.
+  QCOMPARE(index.findAll(QStringList("bar"), FindFlag::FindBackward, 0, -1).size(), 1);
+
+  QTextCursor cursor(&doc);
+  cursor.insertText(QStringLiteral("bar\n"));
+  QCOMPARE(index.findAll(QStringList("bar"), FindFlag::None, 0, -1).size(), 2);
+
+  index.clear();
+  QCOMPARE(index.findAll(QStringList("foo"), FindFlag::None, 0, -1).size(), 2);
+}
+
+void TestSearchIndex::testRangeThenWiderQuery() {
+  QString text;
+  for (int i = 0; i < 200; ++i) {
+    text += QStringLiteral("foo %1 bar foo\n").arg(i);
+  }
+  QTextDocument doc(text);
+  SearchIndex index(&doc);
+  const QStringList texts("foo");
+
+  // Only the blocks of the range are scanned.
+  const int rangeStart = doc.findBlockByNumber(80).position();
+  const int rangeEnd = doc.findBlockByNumber(120).position();
+  QCOMPARE(index.findAll(texts, FindFlag::None, rangeStart, rangeEnd),
+           referenceFindAll(&doc, texts, FindFlag::None, rangeStart, rangeEnd));
+
+  // Edits before and after the range, changing the block count on both sides.
+  QTextCursor cursor(&doc);
+  cursor.setPosition(doc.findBlockByNumber(150).position());
+  cursor.insertText(QStringLiteral("foo\nfoo foo\n"));
+  cursor.setPosition(doc.findBlockByNumber(30).position());
+  cursor.setPosition(doc.findBlockByNumber(33).position(), QTextCursor::KeepAnchor);
+  cursor.removeSelectedText();
+  cursor.setPosition(doc.findBlockByNumber(10).position());
+  cursor.insertText(QStringLiteral("xfoo"));
+
+  // Across the clean range and the edited blocks on both sides.
+  const int widerStart = doc.findBlockByNumber(5).position();
+  const int widerEnd = doc.findBlockByNumber(160).position();
+  QCOMPARE(index.findAll(texts, FindFlag::None, widerStart, widerEnd),
+           referenceFindAll(&doc, texts, FindFlag::None, widerStart, widerEnd));
+  QCOMPARE(index.findAll(texts, FindFlag::None, 0, -1),
+           referenceFindAll(&doc, texts, FindFlag::None, 0, -1));
+
+  // Random ranges, each followed by edits out of it.
+  QRandomGenerator rand(23);
+  for (int i = 0; i < 100; ++i) {
+    const int firstBlock = rand.bounded(doc.blockCount());
+    const int lastBlock = qMin(firstBlock + rand.bounded(20), doc.blockCount() - 1);
+    const int start = doc.findBlockByNumber(firstBlock).position();
+    const auto last = doc.findBlockByNumber(lastBlock);
+    const int end = last.position() + last.length() - 1;
+    QCOMPARE(index.findAll(texts, FindFlag::None, start, end),
+             referenceFindAll(&doc, texts, FindFlag::None, start, end));
+
+    const int before = start > 0 ? rand.bounded(start) : -1;
+    const int after = end + 1 < doc.characterCount() - 1
+                          ? end + 1 + rand.bounded(doc.characterCount() - 1 - (end + 1))
+                          : -1;
+    // The later position first, so the earlier one stays valid.
+    for (const int position : {after, before}) {
+      if (position < 0) {
+        continue;
+      }
+      cursor.setPosition(position);
+      cursor.insertText(rand.bounded(2) ? QStringLiteral("foo\n") : QStringLiteral("o f"));
+    }
+
+    if (i % 10 == 0) {
+      QCOMPARE(index.findAll(texts, FindFlag::None, 0, -1),
+               referenceFindAll(&doc, texts, FindFlag::None, 0, -1));
+    }
+  }
+  QCOMPARE(index.findAll(texts, FindFlag::None, 0, -1),
+           referenceFindAll(&doc, texts, FindFlag::None, 0, -1));
+}
+
+void TestSearchIndex::testParallelScan() {
+  // Large enough to be scanned in chunks across threads.
+  QRandomGenerator rand(17);
+  QTextDocument doc(generateText(rand, 1536 * 1024));
+  SearchIndex index(&doc);
+  for (const auto &search : searches()) {
+    QCOMPARE(index.findAll(search.m_texts, search.m_flags, 0, -1),
+             referenceFindAll(&doc, search.m_texts, search.m_flags, 0, -1));
+  }
+
+  // One long block, which a chunk never splits.
+  QTextDocument longBlock(generateText(rand, 1024 * 1024).replace(QLatin1Char('\n'), ' '));
+  SearchIndex longBlockIndex(&longBlock);
+  QCOMPARE(longBlockIndex.findAll(QStringList("foobar"), FindFlag::None, 0, -1),
+           referenceFindAll(&longBlock, QStringList("foobar"), FindFlag::None, 0, -1));
+}
+
+void TestSearchIndex::testExtraSelectionViewport() {
+  // A tab, a trailing space and the selected text on each line.
+  QString text;
+  for (int i = 0; i < 300; ++i) {
+    text += QStringLiteral("line %1 foo\tbar \n").arg(i);
+  }
+  text.chop(1);
+  QTextDocument doc(text);
+  RecordingExtraSelectionInterface interface(&doc);
+  interface.m_cursor = QTextCursor(&doc);
+  interface.m_cursor.setPosition(doc.firstBlock().text().indexOf(QStringLiteral("foo")));
+  interface.m_cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor, 3);
+  ExtraSelectionMgr mgr(&interface);
+  mgr.setExtraSelectionEnabled(ExtraSelectionMgr::CursorLine, false);
+
+  // A screen of 10 blocks, highlighted with a screen on each side.
+  interface.m_visibleRange = qMakePair(100, 109);
+  mgr.handleViewportChange();
+  QCOMPARE(interface.m_selections.size(), 30 * 3);
+  QVERIFY(interface.selectionsWithin(90, 119));
+
+  // Scrolls within the margin keep the highlights.
+  const int applyCount = interface.m_applyCount;
+  interface.m_visibleRange = qMakePair(95, 104);
+  mgr.handleViewportChange();
+  interface.m_visibleRange = qMakePair(110, 119);
+  mgr.handleViewportChange();
+  QCOMPARE(interface.m_applyCount, applyCount);
+
+  // Scrolled out of it.
+  interface.m_visibleRange = qMakePair(200, 209);
+  mgr.handleViewportChange();
+  QVERIFY(interface.m_applyCount > applyCount);
+  QCOMPARE(interface.m_selections.size(), 30 * 3);
+  QVERIFY(interface.selectionsWithin(190, 219));
+
+  // Edits within the range, highlighted again for the same viewport.
+  QTextCursor cursor(&doc);
+  const auto block = doc.findBlockByNumber(205);
+  cursor.setPosition(block.position());
+  cursor.setPosition(block.position() + block.length() - 1, QTextCursor::KeepAnchor);
+  cursor.insertText(QStringLiteral("plain"));
+  mgr.updateAllExtraSelections();
+  QCOMPARE(interface.m_selections.size(), 29 * 3);
+  QVERIFY(interface.selectionsWithin(190, 219));
+
+  // Clamped to the document end.
+  interface.m_visibleRange = qMakePair(295, 299);
+  mgr.handleViewportChange();
+  QCOMPARE(interface.m_selections.size(), 10 * 3);
+  QVERIFY(interface.selectionsWithin(290, 299));
+}
+
+void TestSearchIndex::benchmarkFindAllAfterEdit_data() {
+  QTest::addColumn<int>("size");
+
+  QTest::addRow("1 MB") << 1024 * 1024;
+  QTest::addRow("10 MB") << 10 * 1024 * 1024;
+}
+
+void TestSearchIndex::benchmarkFindAllAfterEdit() {
+  QFETCH(int, size);
+
+  QRandomGenerator rand(1);
+  QTextDocument doc(generateText(rand, size));
+  SearchIndex index(&doc);
+  QTextCursor cursor(&doc);
+  cursor.setPosition(doc.characterCount() / 2);
+
+  // Warm up: the first query scans every block.
+  const QStringList texts("foo");
+  QVERIFY(!index.findAll(texts, FindFlag::None, 0, -1).isEmpty());
+
+  // Type a letter with the search highlighted.
+  QBENCHMARK {
+    cursor.insertText(QStringLiteral("f"));
+    index.findAll(texts, FindFlag::None, 0, -1);
+  }
+}
+
+void TestSearchIndex::benchmarkFindAllFullScan_data() {
+  QTest::addColumn<int>("size");
+  QTest::addColumn<bool>("regExp");
+
+  QTest::addRow("10 MB literal") << 10 * 1024 * 1024 << false;
+  QTest::addRow("10 MB regexp") << 10 * 1024 * 1024 << true;
+  QTest::addRow("50 MB literal") << 50 * 1024 * 1024 << false;
+}
+
+void TestSearchIndex::benchmarkFindAllFullScan() {
+  QFETCH(int, size);
+  QFETCH(bool, regExp);
+
+  QRandomGenerator rand(1);
+  QTextDocument doc(generateText(rand, size));
+  SearchIndex index(&doc);
+  const QStringList texts(regExp ? QStringLiteral("fo+d?") : QStringLiteral("food"));
+  const FindFlags flags = regExp ? FindFlag::RegularExpression : FindFlag::None;
+
+  // A new search scans every block.
+  QBENCHMARK {
+    index.clear();
+    index.findAll(texts, flags, 0, -1);
+  }
+}
+
+QTEST_MAIN(tests::TestSearchIndex)
@@ -0,0 +1,34 @@
+#ifndef TESTS_TEST_SEARCHINDEX_H
+#define TESTS_TEST_SEARCHINDEX_H
+
+#include <QtTest>
+
+namespace tests {
+class TestSearchIndex : public QObject {
+  Q_OBJECT
+private slots:
+  void testFindAll_data();
+  void testFindAll();
+
+  void testIncrementalEdits();
+
+  void testUndoRedo();
+
+  void testSearchChange();
+
+  void testRangeThenWiderQuery();
+
+  void testParallelScan();
+
+  // Whitespace and selected text highlights of ExtraSelectionMgr.
+  void testExtraSelectionViewport();
+
+  void benchmarkFindAllAfterEdit_data();
+  void benchmarkFindAllAfterEdit();
+
+  void benchmarkFindAllFullScan_data();
+  void benchmarkFindAllFullScan();
+};
+} // namespace tests
+
+#endif
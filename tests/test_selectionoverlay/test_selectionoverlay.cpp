@@ -0,0 +1,145 @@
+#include "test_selectionoverlay.h"
+
+#include <algorithm>
+
+#include <QRandomGenerator>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <selectionoverlay.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace {
+QTextEdit::ExtraSelection makeSelection(QTextDocument *p_doc, int p_start, int p_end,
+                                        const QColor &p_color) {
+  QTextEdit::ExtraSelection selection;
+  selection.cursor = QTextCursor(p_doc);
+  selection.cursor.setPosition(p_start);
+  selection.cursor.setPosition(p_end, QTextCursor::KeepAnchor);
+  selection.format.setBackground(p_color);
+  return selection;
+}
+} // namespace
+
+void TestSelectionOverlay::testLayerOrder() {
+  QTextDocument doc(QStringLiteral("foo bar\nbaz"));
+  SelectionOverlay overlay;
+  overlay.setLayer(2, {makeSelection(&doc, 4, 7, Qt::red)});
+  overlay.setLayer(0, {makeSelection(&doc, 0, 3, Qt::green), makeSelection(&doc, 4, 6, Qt::blue)});
+
+  const auto ranges = overlay.formatRanges(doc.firstBlock());
+  QCOMPARE(ranges.size(), 3);
+  QCOMPARE(ranges[0].start, 0);
+  QCOMPARE(ranges[0].format.background().color(), QColor(Qt::green));
+  QCOMPARE(ranges[1].start, 4);
+  QCOMPARE(ranges[1].length, 2);
+  QCOMPARE(ranges[1].format.background().color(), QColor(Qt::blue));
+  QCOMPARE(ranges[2].start, 4);
+  QCOMPARE(ranges[2].length, 3);
+  QCOMPARE(ranges[2].format.background().color(), QColor(Qt::red));
+
+  QVERIFY(overlay.formatRanges(doc.lastBlock()).isEmpty());
+}
+
+void TestSelectionOverlay::testSpanningSelection() {
+  QTextDocument doc(QStringLiteral("aaa\nbbb\nccc\nddd"));
+  SelectionOverlay overlay;
+  overlay.setLayer(0, {makeSelection(&doc, 1, 9, Qt::red), makeSelection(&doc, 13, 14, Qt::blue)});
+
+  // The long selection starts in the first block but covers the second one.
+  const auto ranges = overlay.formatRanges(doc.findBlockByNumber(1));
+  QCOMPARE(ranges.size(), 1);
+  QCOMPARE(ranges[0].start, -3);
+  QCOMPARE(ranges[0].length, 8);
+
+  QCOMPARE(overlay.formatRanges(doc.findBlockByNumber(2)).size(), 1);
+  QCOMPARE(overlay.formatRanges(doc.lastBlock()).size(), 1);
+}
+
+void TestSelectionOverlay::testSetLayer() {
+  QTextDocument doc(QStringLiteral("foo bar"));
+  SelectionOverlay overlay;
+  overlay.setLayer(0, {makeSelection(&doc, 4, 7, Qt::red), makeSelection(&doc, 0, 3, Qt::red)});
+  overlay.setLayer(1, {makeSelection(&doc, 0, 1, Qt::blue)});
+
+  // Sorted by start.
+  const auto layer = overlay.layer(0);
+  QCOMPARE(layer.size(), 2);
+  QCOMPARE(layer[0].cursor.selectionStart(), 0);
+  QCOMPARE(layer[1].cursor.selectionStart(), 4);
+
+  // Replacing one layer leaves the others.
+  overlay.setLayer(0, {});
+  QVERIFY(overlay.layer(0).isEmpty());
+  QCOMPARE(overlay.formatRanges(doc.firstBlock()).size(), 1);
+
+  // Selections follow the edits.
+  QTextCursor cursor(&doc);
+  cursor.insertText(QStringLiteral("xx"));
+  const auto ranges = overlay.formatRanges(doc.firstBlock());
+  QCOMPARE(ranges.size(), 1);
+  QCOMPARE(ranges[0].start, 2);
+
+  overlay.clear();
+  QVERIFY(overlay.formatRanges(doc.firstBlock()).isEmpty());
+}
+
+void TestSelectionOverlay::testLengthenedSelection() {
+  QTextDocument doc(QStringLiteral("aaa\nbbb"));
+  SelectionOverlay overlay;
+  overlay.setLayer(0, {makeSelection(&doc, 1, 2, Qt::red)});
+
+  // Typing at its end makes the selection reach into a new block.
+  QTextCursor cursor(&doc);
+  cursor.setPosition(2);
+  cursor.insertText(QStringLiteral("xxxxxx\nyy"));
+  overlay.invalidateMaxLength();
+
+  const auto ranges = overlay.formatRanges(doc.findBlockByNumber(1));
+  QCOMPARE(ranges.size(), 1);
+  QCOMPARE(ranges[0].start, -8);
+  QCOMPARE(ranges[0].length, 10);
+}
+
+void TestSelectionOverlay::testRandomSelections() {
+  QRandomGenerator rand(3);
+  QString text;
+  for (int i = 0; i < 200; ++i) {
+    text += QString(rand.bounded(0, 30), QLatin1Char('a'));
+    text += QLatin1Char('\n');
+  }
+  QTextDocument doc(text);
+
+  SelectionOverlay overlay;
+  QVector<QList<QTextEdit::ExtraSelection>> layers(3);
+  for (int i = 0; i < layers.size(); ++i) {
+    for (int j = 0; j < 100; ++j) {
+      const int start = rand.bounded(doc.characterCount() - 1);
+      const int end = qMin(start + rand.bounded(i == 0 ? 200 : 10), doc.characterCount() - 1);
+      layers[i].append(makeSelection(&doc, start, end, QColor(i, j, 0)));
+    }
+    overlay.setLayer(i, layers[i]);
+  }
+
+  // Same as splitting out all the selections, layer by layer in start order.
+  for (auto block = doc.begin(); block.isValid(); block = block.next()) {
+    QVector<QTextLayout::FormatRange> expected;
+    for (const auto &layer : layers) {
+      auto selections = layer;
+      std::stable_sort(selections.begin(), selections.end(),
+                       [](const QTextEdit::ExtraSelection &p_a,
+                          const QTextEdit::ExtraSelection &p_b) {
+                         return p_a.cursor.selectionStart() < p_b.cursor.selectionStart();
+                       });
+      for (const auto &selection : selections) {
+        SelectionOverlay::appendFormatRange(block, selection.cursor, selection.format, expected);
+      }
+    }
+    QCOMPARE(overlay.formatRanges(block), expected);
+  }
+}
+
+QTEST_MAIN(tests::TestSelectionOverlay)
@@ -0,0 +1,22 @@
+#ifndef TESTS_TEST_SELECTIONOVERLAY_H
+#define TESTS_TEST_SELECTIONOVERLAY_H
+
+#include <QtTest>
+
+namespace tests {
+class TestSelectionOverlay : public QObject {
+  Q_OBJECT
+private slots:
+  void testLayerOrder();
+
+  void testSpanningSelection();
+
+  void testSetLayer();
+
+  void testLengthenedSelection();
+
+  void testRandomSelections();
+};
+} // namespace tests
+
+#endif
@@ -0,0 +1,256 @@
+#include "test_spellcheck.h"
+
+#include <QPointer>
+#include <QSet>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextLayout>
+
+#include <plaintexthighlighter.h>
+#include <vtextedit/spellchecker.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace {
+// One misspelling in xa per line.
+QString generateText(int p_lineCount) {
+  QString text;
+  for (int i = 0; i < p_lineCount; ++i) {
+    if (i > 0) {
+      text += QLatin1Char('\n');
+    }
+    text += QStringLiteral("hello wrold");
+  }
+  return text;
+}
+
+bool isComplete(const VSyntaxHighlighter &p_highlighter) {
+  bool complete = false;
+  p_highlighter.misspellingCount(&complete);
+  return complete;
+}
+
+// Underlined words of @p_block.
+QStringList underlinedWords(const QTextBlock &p_block) {
+  QStringList words;
+  for (const auto &range : p_block.layout()->formats()) {
+    if (range.format.underlineStyle() == QTextCharFormat::SpellCheckUnderline) {
+      words << p_block.text().mid(range.start, range.length);
+    }
+  }
+  return words;
+}
+
+bool isUnderlined(const QTextBlock &p_block) { return !underlinedWords(p_block).isEmpty(); }
+} // namespace
+
+void TestSpellCheck::initTestCase() {
+  // Before the first use, which loads the dictionaries.
+  SpellChecker::addDictionaryCustomSearchPaths(QStringList(QStringLiteral(DICTIONARIES_DIR)));
+  auto &speller = SpellChecker::getInst();
+  const auto languages = speller.availableDictionaries().values();
+  if (!languages.contains(QStringLiteral("xa")) || !languages.contains(QStringLiteral("xb"))) {
+    QSKIP("the test dictionaries are not loaded");
+  }
+  speller.setCurrentLanguage(QStringLiteral("xa"));
+}
+
+void TestSpellCheck::testVerdictCache() {
+  const auto &speller = SpellChecker::getInst();
+  const int misses = speller.verdictCacheMisses();
+  QVERIFY(!speller.isMisspelled(QStringLiteral("xa"), QStringLiteral("quick")));
+  QCOMPARE(speller.verdictCacheMisses(), misses + 1);
+
+  // A hit, through the current language too.
+  QVERIFY(!speller.isMisspelled(QStringLiteral("xa"), QStringLiteral("quick")));
+  QVERIFY(!speller.isMisspelled(QStringLiteral("quick")));
+  QCOMPARE(speller.verdictCacheMisses(), misses + 1);
+
+  // Each language has its own verdicts.
+  QVERIFY(speller.isMisspelled(QStringLiteral("xb"), QStringLiteral("quick")));
+  QCOMPARE(speller.verdictCacheMisses(), misses + 2);
+  QVERIFY(!speller.isMisspelled(QStringLiteral("xb"), QStringLiteral("zeile")));
+  QVERIFY(speller.isMisspelled(QStringLiteral("xa"), QStringLiteral("zeile")));
+  QCOMPARE(speller.verdictCacheMisses(), misses + 4);
+
+  // Ignoring a word drops its verdicts and bumps the generation.
+  QVERIFY(speller.isMisspelled(QStringLiteral("xa"), QStringLiteral("qwzx")));
+  const int generation = speller.dictionaryGeneration();
+  SpellChecker::getInst().ignoreWord(QStringLiteral("qwzx"));
+  QVERIFY(speller.dictionaryGeneration() > generation);
+  QVERIFY(!speller.isMisspelled(QStringLiteral("xa"), QStringLiteral("qwzx")));
+  QCOMPARE(speller.verdictCacheMisses(), misses + 6);
+}
+
+void TestSpellCheck::testViewportFirst() {
+  QTextDocument doc(generateText(400));
+  PlainTextHighlighter highlighter(&doc);
+  QCoreApplication::processEvents();
+
+  // Each block is rehighlighted once its misspellings arrive.
+  QVector<int> order;
+  connect(&doc, &QTextDocument::contentsChange, this,
+          [&doc, &order](int p_position, int p_charsRemoved, int p_charsAdded) {
+            Q_UNUSED(p_charsRemoved);
+            Q_UNUSED(p_charsAdded);
+            order.push_back(doc.findBlock(p_position).blockNumber());
+          });
+
+  highlighter.setVisibleBlockRange(200, 205);
+  highlighter.setSpellCheckEnabled(true);
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+
+  const int first = 200 - VSyntaxHighlighter::c_spellCheckViewportMargin;
+  const int last = 205 + VSyntaxHighlighter::c_spellCheckViewportMargin;
+  int lastInViewport = -1;
+  int firstOutside = order.size();
+  for (int i = 0; i < order.size(); ++i) {
+    if (order[i] >= first && order[i] <= last) {
+      lastInViewport = i;
+    } else {
+      firstOutside = qMin(firstOutside, i);
+    }
+  }
+  QVERIFY(lastInViewport >= 0);
+  QVERIFY(lastInViewport < firstOutside);
+
+  QCOMPARE(QSet<int>(order.begin(), order.end()).size(), doc.blockCount());
+  QVERIFY(isUnderlined(doc.firstBlock()));
+  QVERIFY(isUnderlined(doc.lastBlock()));
+}
+
+void TestSpellCheck::testBackfillCompletes() {
+  QTextDocument doc(generateText(300));
+  PlainTextHighlighter highlighter(&doc);
+  QCoreApplication::processEvents();
+
+  int changes = 0;
+  connect(&doc, &QTextDocument::contentsChange, this, [&changes]() { ++changes; });
+
+  // No viewport: the backfill checks every block.
+  highlighter.setSpellCheckEnabled(true);
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), doc.blockCount());
+
+  // The rehighlights of the results are no edits and do not start it over.
+  const int changesWhenComplete = changes;
+  QTest::qWait(VSyntaxHighlighter::c_spellCheckBackfillInterval * 3);
+  QVERIFY(isComplete(highlighter));
+  QCOMPARE(changes, changesWhenComplete);
+}
+
+void TestSpellCheck::testMisspellingTally() {
+  QTextDocument doc(generateText(100));
+  PlainTextHighlighter highlighter(&doc);
+  highlighter.setSpellCheckEnabled(true);
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), 100);
+
+  // Removed blocks take their misspellings with them right away.
+  QTextCursor cursor(&doc);
+  cursor.setPosition(doc.findBlockByNumber(10).position(), QTextCursor::KeepAnchor);
+  cursor.removeSelectedText();
+  QCOMPARE(highlighter.misspellingCount(), 90);
+  QVERIFY(!isComplete(highlighter));
+
+  cursor.movePosition(QTextCursor::Start);
+  cursor.insertText(QStringLiteral("wrold wrold\n"));
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), 92);
+
+  // Fixed.
+  cursor.movePosition(QTextCursor::Start);
+  cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+  cursor.insertText(QStringLiteral("hello world"));
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), 90);
+
+  highlighter.setSpellCheckEnabled(false);
+  QCOMPARE(highlighter.misspellingCount(), 0);
+}
+
+void TestSpellCheck::testLanguageChange() {
+  // Two misspellings per line in xa, one in xb.
+  QString text;
+  for (int i = 0; i < 50; ++i) {
+    text += QStringLiteral("hello hallo welt\n");
+  }
+  QTextDocument doc(text);
+  PlainTextHighlighter highlighter(&doc);
+  highlighter.setSpellCheckEnabled(true);
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), 100);
+  QCOMPARE(underlinedWords(doc.firstBlock()),
+           QStringList({QStringLiteral("hallo"), QStringLiteral("welt")}));
+
+  auto &speller = SpellChecker::getInst();
+  speller.setCurrentLanguage(QStringLiteral("xb"));
+  highlighter.refreshSpellCheck();
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), 50);
+  QCOMPARE(underlinedWords(doc.firstBlock()), QStringList(QStringLiteral("hello")));
+
+  // Back while the results of xb are still in flight, which are dropped.
+  speller.setCurrentLanguage(QStringLiteral("xa"));
+  highlighter.refreshSpellCheck();
+  speller.setCurrentLanguage(QStringLiteral("xb"));
+  highlighter.refreshSpellCheck();
+  speller.setCurrentLanguage(QStringLiteral("xa"));
+  highlighter.refreshSpellCheck();
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), 100);
+  for (auto block = doc.firstBlock(); block.isValid(); block = block.next()) {
+    if (!block.text().isEmpty()) {
+      QCOMPARE(underlinedWords(block),
+               QStringList({QStringLiteral("hallo"), QStringLiteral("welt")}));
+    }
+  }
+}
+
+void TestSpellCheck::testStaleResultsDropped() {
+  QTextDocument doc(generateText(200));
+  PlainTextHighlighter highlighter(&doc);
+  highlighter.setVisibleBlockRange(0, 5);
+  highlighter.setSpellCheckEnabled(true);
+
+  // The results of the viewport are posted to the event loop at the earliest,
+  // so they are all in flight for the texts before these edits.
+  QTextCursor cursor(&doc);
+  for (int i = 0; i < 10; ++i) {
+    cursor.setPosition(doc.findBlockByNumber(i).position());
+    cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+    cursor.insertText(QStringLiteral("wrold line wrodl"));
+  }
+
+  QTRY_VERIFY_WITH_TIMEOUT(isComplete(highlighter), 30000);
+  QCOMPARE(highlighter.misspellingCount(), 10 * 2 + 190);
+  for (int i = 0; i < 10; ++i) {
+    QCOMPARE(underlinedWords(doc.findBlockByNumber(i)),
+             QStringList({QStringLiteral("wrold"), QStringLiteral("wrodl")}));
+  }
+  QCOMPARE(underlinedWords(doc.findBlockByNumber(10)), QStringList(QStringLiteral("wrold")));
+}
+
+void TestSpellCheck::testShutdownWithJobsInFlight() {
+  QTextDocument doc(generateText(5000));
+  QPointer<PlainTextHighlighter> highlighter = new PlainTextHighlighter(&doc);
+  highlighter->setVisibleBlockRange(0, 5);
+  highlighter->setSpellCheckEnabled(true);
+  // Let the backfill queue a few batches.
+  QTest::qWait(VSyntaxHighlighter::c_spellCheckBackfillInterval);
+  QVERIFY(!isComplete(*highlighter));
+
+  // Joins the worker, and the results it posted are never delivered.
+  delete highlighter;
+  QVERIFY(highlighter.isNull());
+  QCoreApplication::processEvents();
+  QTest::qWait(VSyntaxHighlighter::c_spellCheckBackfillInterval);
+
+  QTextCursor cursor(&doc);
+  cursor.insertText(QStringLiteral("wrold "));
+  QCOMPARE(doc.firstBlock().text(), QStringLiteral("wrold hello wrold"));
+}
+
+QTEST_MAIN(tests::TestSpellCheck)
@@ -0,0 +1,32 @@
+#ifndef TESTS_TEST_SPELLCHECK_H
+#define TESTS_TEST_SPELLCHECK_H
+
+#include <QtTest>
+
+namespace tests {
+// Spell check of a highlighter on the test dictionaries xa and xb.
+class TestSpellCheck : public QObject {
+  Q_OBJECT
+private slots:
+  void initTestCase();
+
+  // Verdict cache of SpellChecker.
+  void testVerdictCache();
+
+  // Viewport and backfill of VSyntaxHighlighter.
+  void testViewportFirst();
+
+  void testBackfillCompletes();
+
+  void testMisspellingTally();
+
+  // Results of the worker thread.
+  void testLanguageChange();
+
+  void testStaleResultsDropped();
+
+  void testShutdownWithJobsInFlight();
+};
+} // namespace tests
+
+#endif
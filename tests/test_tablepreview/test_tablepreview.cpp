@@ -9,6 +9,7 @@
 #include <QFontDatabase>
 #include <QImage>
 #include <QInputMethodEvent>
+#include <QLineEdit>
 #include <QMenu>
 #include <QMimeData>
 #include <QPainter>
@@ -28,6 +29,8 @@
 
 #include "hlformatresolver.h"
 #include "previewbuilder.h"
+#include "previewfromast.h"
+#include "previewsnapshotcache.h"
 #include "tablepreviewwidget.h"
 
 using namespace tests;
@@ -1105,12 +1108,11 @@ void TestTablePreview::testWidgetRejectsNonTable() {
 }
 
 void TestTablePreview::testWidgetRejectsOversizedTable() {
-  // A QTextTable is not virtualized: every cell is a QTextBlock, the sheet
-  // renders at its full natural height and Qt relays the whole table out on
-  // every keystroke. The bound is the measured 16 ms frame budget, so a table
-  // past it is left to the static source rendering.
+  // Past the sheet's bound a table goes to the virtualized grid, and only a
+  // table past the grid's bound as well is left to the static source
+  // rendering.
   const int columns = 10;
-  const int rows = TablePreviewDocument::c_maxCells / columns + 1;
+  const int rows = TablePreviewGrid::c_maxCells / columns + 1;
 
   QVector<QString> row;
   QVector<PreviewTableAlignment> alignments;
@@ -1125,11 +1127,15 @@ void TestTablePreview::testWidgetRejectsOversizedTable() {
   }
 
   auto table = makeTable(cells, alignments);
-  QVERIFY(TablePreviewDocument::normalizedCellCount(*table) > TablePreviewDocument::c_maxCells);
+  QVERIFY(TablePreviewDocument::normalizedCellCount(*table) > TablePreviewGrid::c_maxCells);
 
   TablePreviewWidget widget(nullptr, nullptr);
   QVERIFY(!widget.setPreview(table));
 
+  // One past the sheet's bound is the grid's.
+  cells.resize(TablePreviewDocument::c_maxCells / columns + 1);
+  QVERIFY(widget.setPreview(makeTable(cells, alignments)));
+
   // A table within the budget is still accepted.
   QVector<QVector<QString>> small;
   small.append({QStringLiteral("a"), QStringLiteral("b")});
@@ -1142,15 +1148,15 @@ void TestTablePreview::testWidgetRejectsOversizedTable() {
 
 void TestTablePreview::testWidgetRejectsTooManyRowsOrColumns() {
   // There is no independent row bound: the cell bound already caps a
-  // single-column table at 300 rows, so a row bound could never decide
-  // anything. A very tall table is still refused - by the cell bound.
+  // single-column table, so a row bound could never decide anything. A very
+  // tall table is still refused - by the grid's cell bound.
   QVector<QVector<QString>> tall;
-  for (int i = 0; i < TablePreviewDocument::c_maxCells + 1; ++i) {
+  for (int i = 0; i < TablePreviewGrid::c_maxCells + 1; ++i) {
     tall.append({QStringLiteral("r")});
   }
 
   auto tallTable = makeTable(tall, {PreviewTableAlignment::None});
-  QVERIFY(!TablePreviewDocument::isWithinLimits(*tallTable));
+  QVERIFY(!TablePreviewGrid::isWithinLimits(*tallTable));
 
   TablePreviewWidget widget(nullptr, nullptr);
   QVERIFY(!widget.setPreview(tallTable));
@@ -1171,6 +1177,7 @@ void TestTablePreview::testWidgetRejectsTooManyRowsOrColumns() {
   QVERIFY(TablePreviewDocument::normalizedCellCount(*wideTable) <=
           TablePreviewDocument::c_maxCells);
   QVERIFY(!TablePreviewDocument::isWithinLimits(*wideTable));
+  QVERIFY(!TablePreviewGrid::isWithinLimits(*wideTable));
   QVERIFY(!widget.setPreview(wideTable));
 }
 
@@ -3774,4 +3781,337 @@ void TestTablePreview::testDarkPaletteReachesTheSheet() {
   QCOMPARE(table->format().toTableFormat().borderBrush().color(), QColor(200, 200, 200));
 }
 
+namespace {
+const char *c_cachedSource = "| a | **b** |\n| --- | --- |\n| c | d |";
+
+// Extracted anew for every generation, as the highlighter does.
+QString cachedSource() { return QString::fromLatin1(c_cachedSource); }
+
+// The parsed form of c_cachedSource at @p_startPos, with the bold run of its
+// second header cell.
+md::TableElement cachedTableElement(int p_startPos) {
+  md::TableElement element;
+  element.m_startPos = p_startPos;
+  element.m_endPos = p_startPos + cachedSource().size();
+  element.m_columns = 2;
+  element.m_alignments = {0, 0};
+
+  md::TableRowElement header;
+  header.m_type = md::TableRowType::Header;
+  header.m_cells = {QStringLiteral("a"), QStringLiteral("**b**")};
+  header.m_cellHighlights = {QVector<md::HLUnit>(), {{0, 5, 1}}};
+  element.m_rows.append(header);
+
+  md::TableRowElement delimiter;
+  delimiter.m_type = md::TableRowType::Delimiter;
+  delimiter.m_cells = {QStringLiteral("---"), QStringLiteral("---")};
+  element.m_rows.append(delimiter);
+
+  md::TableRowElement data;
+  data.m_cells = {QStringLiteral("c"), QStringLiteral("d")};
+  element.m_rows.append(data);
+  return element;
+}
+
+QVector<QTextCharFormat> cachedStyles(const QColor &p_bold) {
+  QVector<QTextCharFormat> styles(2);
+  styles[1].setForeground(p_bold);
+  return styles;
+}
+} // namespace
+
+void TestTablePreview::testSnapshotCacheRelocatesAnUnchangedTable() {
+  PreviewSnapshotCache cache;
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto first = cache.table(1, cachedTableElement(0), cachedSource());
+  cache.endGeneration();
+  QCOMPARE(cache.missCount(), 1);
+
+  // The text above the table grew: same source, new position.
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto second = cache.table(2, cachedTableElement(7), cachedSource());
+  cache.endGeneration();
+  QCOMPARE(cache.hitCount(), 1);
+  QCOMPARE(cache.missCount(), 0);
+
+  QVERIFY(second != first);
+  QCOMPARE(second->revision(), quint64(2));
+  QCOMPARE(second->startPos(), 7);
+  QCOMPARE(second->endPos(), 7 + cachedSource().size());
+  QVERIFY(PreviewBuilder::sharesContent(first, second));
+
+  const auto table = second.staticCast<const TablePreview>();
+  QCOMPARE(table->cells(), first.staticCast<const TablePreview>()->cells());
+  QCOMPARE(table->cellFormats().at(0).at(1).at(0).m_format.foreground().color(),
+           QColor(Qt::red));
+
+  // An equal table built on its own describes the same content, but the host
+  // cannot tell without comparing it.
+  const auto element = cachedTableElement(7);
+  const auto separate = createTablePreview(2, element.m_startPos, element.m_endPos, cachedSource(),
+                                           element, cachedStyles(Qt::red));
+  QVERIFY(!PreviewBuilder::sharesContent(first, separate));
+}
+
+void TestTablePreview::testSnapshotCacheRebuildsOnNewHighlights() {
+  PreviewSnapshotCache cache;
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto first = cache.table(1, cachedTableElement(0), cachedSource());
+  cache.endGeneration();
+
+  // Same source, but the parse no longer highlights the cell.
+  auto element = cachedTableElement(0);
+  element.m_rows[0].m_cellHighlights[1].clear();
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto second = cache.table(2, element, cachedSource());
+  cache.endGeneration();
+  QCOMPARE(cache.missCount(), 1);
+  QVERIFY(!PreviewBuilder::sharesContent(first, second));
+  QVERIFY(second.staticCast<const TablePreview>()->cellFormats().at(0).at(1).isEmpty());
+}
+
+void TestTablePreview::testSnapshotCacheRebuildsOnNewStyles() {
+  PreviewSnapshotCache cache;
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto first = cache.table(1, cachedTableElement(0), cachedSource());
+  cache.endGeneration();
+
+  // A theme change keeps every unit and changes the formats only.
+  cache.beginGeneration(cachedStyles(Qt::blue));
+  const auto second = cache.table(1, cachedTableElement(0), cachedSource());
+  cache.endGeneration();
+  QCOMPARE(cache.missCount(), 1);
+  QVERIFY(!PreviewBuilder::sharesContent(first, second));
+  const auto &formats = second.staticCast<const TablePreview>()->cellFormats();
+  QCOMPARE(formats.at(0).at(1).at(0).m_format.foreground().color(), QColor(Qt::blue));
+}
+
+void TestTablePreview::testSnapshotCacheForgetsUnusedElements() {
+  PreviewSnapshotCache cache;
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto first = cache.table(1, cachedTableElement(0), cachedSource());
+  cache.endGeneration();
+
+  // A generation without the table, then the table is back.
+  cache.beginGeneration(cachedStyles(Qt::red));
+  cache.endGeneration();
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto second = cache.table(3, cachedTableElement(0), cachedSource());
+  cache.endGeneration();
+  QCOMPARE(cache.missCount(), 1);
+  QVERIFY(!PreviewBuilder::sharesContent(first, second));
+
+  // Two equal tables in one generation share one snapshot.
+  cache.beginGeneration(cachedStyles(Qt::red));
+  const auto upper = cache.table(4, cachedTableElement(0), cachedSource());
+  const auto lower = cache.table(4, cachedTableElement(100), cachedSource());
+  cache.endGeneration();
+  QCOMPARE(cache.hitCount(), 2);
+  QVERIFY(PreviewBuilder::sharesContent(upper, lower));
+  QCOMPARE(lower->startPos(), 100);
+}
+
+// ---------------------------------------------------------------------------
+// Virtualized grid
+// ---------------------------------------------------------------------------
+
+namespace {
+// A table whose source is its canonical Markdown, with a distinct text in
+// every cell. @p_rows includes the header.
+QSharedPointer<const TablePreview> makeLargeTable(int p_rows, int p_columns) {
+  QVector<QVector<QString>> cells;
+  cells.reserve(p_rows);
+  for (int r = 0; r < p_rows; ++r) {
+    QVector<QString> row;
+    row.reserve(p_columns);
+    for (int c = 0; c < p_columns; ++c) {
+      row.append(QStringLiteral("r%1c%2").arg(r).arg(c));
+    }
+    cells.append(row);
+  }
+
+  return makeSnapshot(cells,
+                      QVector<PreviewTableAlignment>(p_columns, PreviewTableAlignment::None));
+}
+
+TablePreviewGrid *gridOf(TablePreviewWidget &p_widget) {
+  return p_widget.findChild<TablePreviewGrid *>();
+}
+
+void showOffScreen(TablePreviewGrid &p_grid, int p_width) {
+  p_grid.setAttribute(Qt::WA_DontShowOnScreen, true);
+  p_grid.resize(p_width, p_grid.heightForWidth(p_width));
+  p_grid.show();
+  QCoreApplication::processEvents();
+}
+} // namespace
+
+void TestTablePreview::testALargeTableGoesToTheGrid() {
+  const int columns = 10;
+  const int rows = TablePreviewDocument::c_maxCells / columns + 1;
+  SheetHarness harness(makeLargeTable(rows, columns));
+
+  auto grid = gridOf(*harness.widget());
+  QVERIFY(grid);
+  QVERIFY(grid->isVisibleTo(harness.widget()));
+  QVERIFY(!harness.sheet()->isVisibleTo(harness.widget()));
+  QCOMPARE(grid->rowCount(), rows);
+  QCOMPARE(grid->columnCount(), columns);
+  QVERIFY(!grid->isReadOnly());
+
+  // The grid holds what the source says, so nothing is owed.
+  QCOMPARE(grid->toMarkdown(), harness.boundSource());
+  QCOMPARE(harness.widget()->flushNow(), TablePreviewWidget::FlushOutcome::Settled);
+  QCOMPARE(harness.requestCount(), 0);
+
+  // Back under the sheet's bound, the sheet takes over again.
+  QVERIFY(harness.deliver(makeCommittableTable()));
+  QVERIFY(!grid->isVisibleTo(harness.widget()));
+  QVERIFY(harness.sheet()->isVisibleTo(harness.widget()));
+}
+
+void TestTablePreview::testTheGridMeasuresOnlyTheRowsInView() {
+  // 100000 cells.
+  const int rows = 25000;
+  TablePreviewGrid grid;
+  grid.setTable(makeLargeTable(rows, 4));
+  QCOMPARE(grid.rowCount() * grid.columnCount(), 100000);
+
+  // Up front, only what fits under the height cap.
+  QVERIFY(grid.measuredRowCount() <= TablePreviewGrid::c_maxVisibleLines + 1);
+
+  showOffScreen(grid, 600);
+  grid.grab();
+  const int shown = grid.measuredRowCount();
+  QVERIFY(shown <= TablePreviewGrid::c_maxVisibleLines + 1);
+
+  // Jumping to the end measures the rows around it, not the rows in between.
+  grid.setCurrentCell(rows - 1, 3);
+  grid.grab();
+  QVERIFY(grid.measuredRowCount() <= 2 * shown + 1);
+
+  const QRect last = grid.cellRect(rows - 1, 3);
+  QVERIFY(grid.viewport()->rect().contains(last.center()));
+
+  // The height is capped rather than all 25000 rows.
+  QVERIFY(grid.heightForWidth(600) < 2 * TablePreviewGrid::c_maxVisibleLines *
+                                         grid.cellRect(1, 0).height());
+}
+
+void TestTablePreview::testGridRowTopsFollowMeasuredHeights() {
+  QVector<QVector<QString>> cells;
+  for (int r = 0; r < 200; ++r) {
+    cells.append({QStringLiteral("r%1").arg(r), QStringLiteral("x")});
+  }
+  // Far below the cap, and longer than any column the sample rows measure.
+  const int wrapped = 150;
+  cells[wrapped][1] = QString(50, QLatin1Char('w')) + QLatin1Char(' ') +
+                      QString(50, QLatin1Char('w')) + QLatin1Char(' ') +
+                      QString(50, QLatin1Char('w'));
+
+  TablePreviewGrid grid;
+  grid.setTable(
+      makeSnapshot(cells, {PreviewTableAlignment::None, PreviewTableAlignment::None}));
+  showOffScreen(grid, 600);
+
+  // Not measured yet, so it counts as one line.
+  const int lineHeight = grid.cellRect(1, 0).height();
+  QCOMPARE(grid.cellRect(wrapped, 1).height(), lineHeight);
+
+  grid.setCurrentCell(wrapped, 1);
+  grid.grab();
+  const QRect tall = grid.cellRect(wrapped, 1);
+  QVERIFY(tall.height() > lineHeight);
+  QCOMPARE(grid.cellRect(wrapped + 1, 1).top(), tall.bottom() + 1);
+  QCOMPARE(grid.cellRect(wrapped, 0).height(), tall.height());
+}
+
+void TestTablePreview::testAGridEditIsWrittenBack() {
+  const int columns = 10;
+  const int rows = TablePreviewDocument::c_maxCells / columns + 1;
+  auto table = makeLargeTable(rows, columns);
+  SheetHarness harness(table);
+  auto grid = gridOf(*harness.widget());
+  QVERIFY(grid);
+
+  grid->setCurrentCell(5, 2);
+  QVERIFY(grid->editCurrentCell());
+  QVERIFY(grid->isEditing());
+  auto editor = grid->findChild<QLineEdit *>();
+  QVERIFY(editor);
+  QCOMPARE(editor->text(), QStringLiteral("r5c2"));
+
+  QTest::keyClicks(editor, QStringLiteral("|x"));
+  QCOMPARE(harness.requestCount(), 0);
+
+  // Enter closes the edit, and a finished cell does not wait for the idle
+  // window.
+  QTest::keyClick(editor, Qt::Key_Return);
+  QVERIFY(!grid->isEditing());
+  QCOMPARE(harness.requestCount(), 1);
+
+  QVector<QVector<QString>> expected = table->cells();
+  expected[5][2] = QStringLiteral("r5c2|x");
+  QCOMPARE(harness.lastRequest(),
+           TablePreviewSerializer::serialize(
+               expected, table->alignments(), QVector<QString>(rows, QString()), QString()));
+  QVERIFY(harness.lastRequest().contains(QStringLiteral("r5c2\\|x")));
+
+  // Its echo keeps the grid and the current cell.
+  QVERIFY(harness.deliver(harness.echo()));
+  QCOMPARE(grid->currentRow(), 5);
+  QCOMPARE(grid->cells().at(5).at(2), QStringLiteral("r5c2|x"));
+
+  // Escape drops what was typed.
+  QVERIFY(grid->editCurrentCell());
+  QTest::keyClicks(editor, QStringLiteral("y"));
+  QTest::keyClick(editor, Qt::Key_Escape);
+  QCOMPARE(grid->cells().at(5).at(2), QStringLiteral("r5c2|x"));
+  waitForCommit();
+  QCOMPARE(harness.requestCount(), 1);
+}
+
+void TestTablePreview::testGridCellsAreSanitized() {
+  TablePreviewGrid grid;
+  grid.setTable(makeLargeTable(3, 2));
+
+  QVERIFY(grid.setCell(1, 1, QStringLiteral("a\r\nb\n\nc")));
+  QCOMPARE(grid.cells().at(1).at(1), QStringLiteral("a b c"));
+  QVERIFY(!grid.setCell(1, 1, QStringLiteral("a b c")));
+  QVERIFY(!grid.setCell(3, 0, QStringLiteral("out of range")));
+
+  const QString markdown = grid.toMarkdown();
+  QVERIFY(!markdown.isEmpty());
+  QCOMPARE(markdown.split(QLatin1Char('\n')).size(), 4);
+}
+
+void TestTablePreview::testAReadOnlyGridRefusesEdits() {
+  const int columns = 10;
+  const int rows = TablePreviewDocument::c_maxCells / columns + 1;
+  SheetHarness harness(makeLargeTable(rows, columns));
+  auto grid = gridOf(*harness.widget());
+  QVERIFY(grid);
+
+  QVERIFY(grid->editCurrentCell());
+  harness.widget()->setReadOnly(true);
+  QVERIFY(grid->isReadOnly());
+  QVERIFY(!grid->isEditing());
+  QVERIFY(!grid->editCurrentCell());
+
+  harness.widget()->setReadOnly(false);
+  QVERIFY(grid->editCurrentCell());
+}
+
+void TestTablePreview::benchmarkGridWithAHundredThousandCells() {
+  auto table = makeLargeTable(25000, 4);
+  TablePreviewGrid grid;
+  grid.setTable(table);
+  showOffScreen(grid, 600);
+
+  QBENCHMARK {
+    grid.setTable(table);
+    grid.grab();
+  }
+}
+
 QTEST_MAIN(tests::TestTablePreview)
@@ -136,6 +136,21 @@ private slots:
 
   // Palette.
   void testDarkPaletteReachesTheSheet();
+
+  // Snapshots reused across parse generations.
+  void testSnapshotCacheRelocatesAnUnchangedTable();
+  void testSnapshotCacheRebuildsOnNewHighlights();
+  void testSnapshotCacheRebuildsOnNewStyles();
+  void testSnapshotCacheForgetsUnusedElements();
+
+  // Virtualized grid.
+  void testALargeTableGoesToTheGrid();
+  void testTheGridMeasuresOnlyTheRowsInView();
+  void testGridRowTopsFollowMeasuredHeights();
+  void testAGridEditIsWrittenBack();
+  void testGridCellsAreSanitized();
+  void testAReadOnlyGridRefusesEdits();
+  void benchmarkGridWithAHundredThousandCells();
 };
 } // namespace tests
 
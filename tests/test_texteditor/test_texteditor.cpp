@@ -0,0 +1,103 @@
+#include "test_texteditor.h"
+
+#include <QTextCursor>
+
+#include <vtextedit/texteditorconfig.h>
+#include <vtextedit/vtextedit.h>
+#include <vtextedit/vtexteditor.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace {
+QSharedPointer<TextEditorConfig> defaultConfig() {
+  return QSharedPointer<TextEditorConfig>::create();
+}
+
+int cursorPosition(VTextEditor &p_editor) {
+  return p_editor.getTextEdit()->textCursor().position();
+}
+} // namespace
+
+void TestTextEditor::testReplaceAllBackReference() {
+  VTextEditor editor(defaultConfig(), QSharedPointer<TextEditorParameters>::create());
+  const auto text = QStringLiteral("ab=1 cd=22\nx\nef=333 gh=4444 ij=5");
+  editor.setText(text);
+
+  // Several matches in a block, and blocks without any.
+  auto result = editor.replaceAll(QStringLiteral("(\\w+)=(\\d+)"), FindFlag::RegularExpression,
+                                  QStringLiteral("\\2:\\1!"));
+  QCOMPARE(result.m_totalMatches, 5);
+  const auto expected = QStringLiteral("1:ab! 22:cd!\nx\n333:ef! 4444:gh! 5:ij!");
+  QCOMPARE(editor.getText(), expected);
+
+  // After the last replacement.
+  QCOMPARE(cursorPosition(editor), expected.size());
+
+  // One undo step for all of them.
+  editor.getTextEdit()->undo();
+  QCOMPARE(editor.getText(), text);
+}
+
+void TestTextEditor::testReplaceAllChangingLength() {
+  VTextEditor editor(defaultConfig(), QSharedPointer<TextEditorParameters>::create());
+  const auto text = QStringLiteral("foo foo bar\nbar\nfoofoo\nfoo");
+  editor.setText(text);
+
+  // Growing, with line breaks which add blocks before the later matches.
+  auto result = editor.replaceAll(QStringLiteral("foo"), FindFlag::None, QStringLiteral("a\nbc"));
+  QCOMPARE(result.m_totalMatches, 5);
+  auto expected = QStringLiteral("a\nbc a\nbc bar\nbar\na\nbca\nbc\na\nbc");
+  QCOMPARE(editor.getText(), expected);
+  QCOMPARE(cursorPosition(editor), expected.size());
+
+  editor.getTextEdit()->undo();
+  QCOMPARE(editor.getText(), text);
+
+  // Shrinking to nothing.
+  result = editor.replaceAll(QStringLiteral("foo"), FindFlag::None, QString());
+  QCOMPARE(result.m_totalMatches, 5);
+  expected = QStringLiteral("  bar\nbar\n\n");
+  QCOMPARE(editor.getText(), expected);
+  QCOMPARE(cursorPosition(editor), expected.size());
+
+  editor.getTextEdit()->undo();
+  QCOMPARE(editor.getText(), text);
+}
+
+void TestTextEditor::testReplaceAllInRange() {
+  VTextEditor editor(defaultConfig(), QSharedPointer<TextEditorParameters>::create());
+  const auto text = QStringLiteral("foo foo\nfoo foo\nfoo foo");
+  editor.setText(text);
+
+  // From the second match of the first block to the first of the last.
+  auto result = editor.replaceAll(QStringLiteral("foo"), FindFlag::None, QStringLiteral("xy"), 4,
+                                  text.indexOf(QStringLiteral("foo"), 16) + 3);
+  QCOMPARE(result.m_totalMatches, 4);
+  const auto expected = QStringLiteral("foo xy\nxy xy\nxy foo");
+  QCOMPARE(editor.getText(), expected);
+  QCOMPARE(cursorPosition(editor), expected.lastIndexOf(QStringLiteral("xy")) + 2);
+
+  editor.getTextEdit()->undo();
+  QCOMPARE(editor.getText(), text);
+}
+
+void TestTextEditor::benchmarkReplaceAllManyMatches() {
+  VTextEditor editor(defaultConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  // 60000 matches, three per block.
+  QString text;
+  for (int i = 0; i < 20000; ++i) {
+    text += QStringLiteral("line %1 foo beta foo gamma foo\n").arg(i);
+  }
+
+  QBENCHMARK {
+    editor.setText(text);
+    const auto result = editor.replaceAll(QStringLiteral("foo"), FindFlag::None,
+                                          QStringLiteral("quux"));
+    QCOMPARE(result.m_totalMatches, 60000);
+  }
+  QVERIFY(editor.getText().startsWith(QStringLiteral("line 0 quux beta quux gamma quux\n")));
+}
+
+QTEST_MAIN(tests::TestTextEditor)
@@ -0,0 +1,18 @@
+#ifndef TESTS_TEST_TEXTEDITOR_H
+#define TESTS_TEST_TEXTEDITOR_H
+
+#include <QtTest>
+
+namespace tests {
+// Find and replace, driven through the public editor.
+class TestTextEditor : public QObject {
+  Q_OBJECT
+private slots:
+  void testReplaceAllBackReference();
+  void testReplaceAllChangingLength();
+  void testReplaceAllInRange();
+  void benchmarkReplaceAllManyMatches();
+};
+} // namespace tests
+
+#endif // TESTS_TEST_TEXTEDITOR_H
@@ -1,5 +1,7 @@
 #include "test_textfolding.h"
 
+#include <functional>
+
 #include <QDebug>
 #include <QTextBlock>
 #include <QTextCursor>
@@ -34,14 +36,14 @@ public:
         m_selections = p_selections;
     }
 
-    QList<QTextCursor> findAllText(const QString &p_text,
-                                   bool p_isRegularExpression,
-                                   bool p_caseSensitive) Q_DECL_OVERRIDE
+    QTextDocument *document() const Q_DECL_OVERRIDE
+    {
+        return nullptr;
+    }
+
+    QPair<int, int> visibleBlockRange() const Q_DECL_OVERRIDE
     {
-        Q_UNUSED(p_text);
-        Q_UNUSED(p_isRegularExpression);
-        Q_UNUSED(p_caseSensitive);
-        return QList<QTextCursor>();
+        return qMakePair(0, -1);
     }
 
     QList<QTextEdit::ExtraSelection> m_selections;
@@ -782,4 +784,296 @@ void TestTextFolding::testFoldQueriesWhenDisabled()
     m_textFolding->setEnabled(true);
 }
 
+// Line mappings computed from block visibility, which is the ground truth the
+// folded line index has to agree with. A hidden line maps to the visible line
+// of the block hiding it.
+static void collectVisibleLines(const QTextDocument *p_doc,
+                                QVector<int> &p_lineToVisible,
+                                QVector<int> &p_visibleToLine)
+{
+    p_lineToVisible.clear();
+    p_visibleToLine.clear();
+    int visible = -1;
+    for (auto block = p_doc->firstBlock(); block.isValid(); block = block.next()) {
+        if (block.isVisible()) {
+            ++visible;
+            p_visibleToLine.push_back(block.blockNumber());
+        }
+        p_lineToVisible.push_back(qMax(visible, 0));
+    }
+}
+
+static bool checkVisibleLineMapping(const QTextDocument *p_doc, const TextFolding *p_folding)
+{
+    QVector<int> lineToVisible;
+    QVector<int> visibleToLine;
+    collectVisibleLines(p_doc, lineToVisible, visibleToLine);
+
+    for (int line = 0; line < lineToVisible.size(); ++line) {
+        if (p_folding->lineToVisibleLine(line) != lineToVisible[line]) {
+            qWarning() << "lineToVisibleLine" << line << p_folding->lineToVisibleLine(line)
+                       << lineToVisible[line];
+            return false;
+        }
+    }
+
+    for (int vline = 0; vline < visibleToLine.size(); ++vline) {
+        if (p_folding->visibleLineToLine(vline) != visibleToLine[vline]) {
+            qWarning() << "visibleLineToLine" << vline << p_folding->visibleLineToLine(vline)
+                       << visibleToLine[vline];
+            return false;
+        }
+    }
+
+    // Past the end.
+    const int lastLine = p_doc->blockCount() - 1;
+    return p_folding->lineToVisibleLine(lastLine + 10) == lineToVisible.last()
+           && p_folding->visibleLineToLine(visibleToLine.size() + 10) == lastLine;
+}
+
+// A document of @p_numOfRanges sections of four lines, each section folded
+// over its first three lines.
+static QString sectionedText(int p_numOfRanges)
+{
+    QStringList lines;
+    lines.reserve(p_numOfRanges * 4);
+    for (int i = 0; i < p_numOfRanges; ++i) {
+        lines << QStringLiteral("# section %1").arg(i) << QStringLiteral("body")
+              << QStringLiteral("end") << QString();
+    }
+    return lines.join(QLatin1Char('\n'));
+}
+
+static void foldSections(QTextDocument *p_doc, TextFolding *p_folding, int p_numOfRanges)
+{
+    auto block = p_doc->firstBlock();
+    for (int i = 0; i < p_numOfRanges; ++i) {
+        const auto first = block;
+        const auto last = first.next().next();
+        p_folding->newFoldingRange(TextBlockRange(first, last),
+                                   TextFolding::Persistent | TextFolding::Folded);
+        block = last.next().next();
+    }
+}
+
+void TestTextFolding::testVisibleLineMapping()
+{
+    m_doc->setPlainText(utils::getCppText());
+
+    // Nothing folded.
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    auto outerId = insertNewFoldingRange(10, 30, TextFolding::Persistent);
+    auto innerId = insertNewFoldingRange(15, 25, TextFolding::Persistent | TextFolding::Folded);
+    insertNewFoldingRange(40, 41, TextFolding::Persistent | TextFolding::Folded);
+    insertNewFoldingRange(50, 60, TextFolding::Persistent | TextFolding::Folded);
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    // Folding the parent swallows the nested folded range.
+    QVERIFY(m_textFolding->foldRange(outerId));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    QVERIFY(m_textFolding->toggleRange(outerId));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    QVERIFY(m_textFolding->toggleRange(innerId));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    QVERIFY(m_textFolding->removeFoldingRange(outerId));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+}
+
+void TestTextFolding::testVisibleLineMappingFollowsEdits()
+{
+    m_doc->setPlainText(utils::getCppText());
+
+    insertNewFoldingRange(10, 20, TextFolding::Persistent | TextFolding::Folded);
+    insertNewFoldingRange(30, 40, TextFolding::Persistent | TextFolding::Folded);
+    insertNewFoldingRange(50, 60, TextFolding::Persistent | TextFolding::Folded);
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    // Lines added above the folded ranges shift them.
+    QTextCursor cursor(m_doc->findBlockByNumber(2));
+    cursor.insertText(QStringLiteral("a\nb\nc\n"));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    // A line added then one removed, with no query in between: the block count
+    // is back to what it was, but the ranges between the two edits moved.
+    cursor.setPosition(m_doc->findBlockByNumber(25).position());
+    cursor.insertText(QStringLiteral("d\n"));
+    cursor.setPosition(m_doc->findBlockByNumber(70).position());
+    cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    // The same in one grouped edit, which emits a single contentsChange
+    // keeping the block count.
+    cursor.beginEditBlock();
+    cursor.setPosition(m_doc->findBlockByNumber(25).position());
+    cursor.insertText(QStringLiteral("e\n"));
+    cursor.setPosition(m_doc->findBlockByNumber(70).position());
+    cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    cursor.endEditBlock();
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    // An edit within a line.
+    cursor.setPosition(m_doc->findBlockByNumber(5).position());
+    cursor.insertText(QStringLiteral("xyz"));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+}
+
+bool TestTextFolding::checkCachedBlockNumbers(const TextFolding *p_folding)
+{
+    std::function<bool(const TextFolding::FoldingRange::Vector &)> check =
+        [&check](const TextFolding::FoldingRange::Vector &p_ranges) {
+            for (auto range : p_ranges) {
+                if (range->m_range.validFirstBlockNumber() != range->first()
+                    || range->m_range.validLastBlockNumber() != range->last()) {
+                    qWarning() << "stale cached block numbers" << range->toString()
+                               << range->m_range.validFirstBlockNumber()
+                               << range->m_range.validLastBlockNumber();
+                    return false;
+                }
+                if (!check(range->m_nestedRanges)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+    return check(p_folding->m_foldingRanges);
+}
+
+void TestTextFolding::testIncrementalValidation()
+{
+    m_doc->setPlainText(utils::getCppText());
+
+    insertNewFoldingRange(10, 20, TextFolding::Persistent | TextFolding::Folded);
+    insertNewFoldingRange(30, 45, TextFolding::Persistent);
+    insertNewFoldingRange(32, 36, TextFolding::Persistent | TextFolding::Folded);
+    insertNewFoldingRange(50, 60, TextFolding::Persistent | TextFolding::Folded);
+
+    QSignalSpy spy(m_textFolding, &TextFolding::foldingRangesChanged);
+
+    // Lines added above every range shift all of them.
+    QTextCursor cursor(m_doc->findBlockByNumber(2));
+    cursor.insertText(QStringLiteral("a\nb\nc\n"));
+    QVERIFY(checkCachedBlockNumbers(m_textFolding));
+
+    // Lines added within a range resize it and shift the later ones.
+    cursor.setPosition(m_doc->findBlockByNumber(45).position());
+    cursor.insertText(QStringLiteral("d\ne\n"));
+    QVERIFY(checkCachedBlockNumbers(m_textFolding));
+
+    // A line removed between two ranges.
+    cursor.setPosition(m_doc->findBlockByNumber(52).position());
+    cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+    QVERIFY(checkCachedBlockNumbers(m_textFolding));
+
+    // An edit within a line.
+    cursor.setPosition(m_doc->findBlockByNumber(55).position());
+    cursor.insertText(QStringLiteral("xyz"));
+    QVERIFY(checkCachedBlockNumbers(m_textFolding));
+
+    // Nothing was dropped, and a full validation agrees.
+    QCOMPARE(spy.count(), 0);
+    m_textFolding->checkAndUpdateFoldings();
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(m_textFolding->debugDump(),
+             QStringLiteral("tree [13 pf 23] [33 p [35 pf 39] 50] [54 pf 64] - "
+                            "folded [13 pf 23] [35 pf 39] [54 pf 64]"));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+}
+
+void TestTextFolding::testIncrementalValidationDropsFoldedRange()
+{
+    m_doc->setPlainText(utils::getCppText());
+
+    auto id1 = insertNewFoldingRange(10, 20, TextFolding::Persistent | TextFolding::Folded);
+    auto id2 = insertNewFoldingRange(30, 45, TextFolding::Persistent | TextFolding::Folded);
+    auto id3 = insertNewFoldingRange(50, 60, TextFolding::Persistent | TextFolding::Folded);
+
+    QSignalSpy spy(m_textFolding, &TextFolding::foldingRangesChanged);
+
+    // Remove blocks [28, 47], which the second range lies within.
+    QTextCursor cursor(m_doc->findBlockByNumber(28));
+    cursor.setPosition(m_doc->findBlockByNumber(48).position(), QTextCursor::KeepAnchor);
+    cursor.removeSelectedText();
+
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(m_textFolding->isRangeFolded(id1));
+    QVERIFY(!m_textFolding->foldingRangeBlocks(id2, nullptr, nullptr));
+
+    int first = -1;
+    int last = -1;
+    QVERIFY(m_textFolding->foldingRangeBlocks(id3, &first, &last));
+    QCOMPARE(first, 30);
+    QCOMPARE(last, 40);
+    QVERIFY(checkCachedBlockNumbers(m_textFolding));
+
+    // The blocks the dropped range hid are visible again.
+    QVERIFY(checkTextBlocksInvisible(m_doc, 11, 19));
+    QVERIFY(checkTextBlocksVisible(m_doc, 20, 30));
+    QVERIFY(checkTextBlocksInvisible(m_doc, 31, 39));
+    QVERIFY(checkVisibleLineMapping(m_doc, m_textFolding));
+
+    // A full validation agrees.
+    m_textFolding->checkAndUpdateFoldings();
+    QCOMPARE(spy.count(), 1);
+}
+
+void TestTextFolding::benchmarkLineToVisibleLine()
+{
+    const int numOfRanges = 10000;
+    QTextDocument doc(sectionedText(numOfRanges));
+    TextFolding folding(&doc);
+    foldSections(&doc, &folding, numOfRanges);
+    QCOMPARE(folding.m_foldedFoldingRanges.size(), numOfRanges);
+    QVERIFY(checkVisibleLineMapping(&doc, &folding));
+
+    const int blockCount = doc.blockCount();
+    int sum = 0;
+    QBENCHMARK {
+        for (int line = 0; line < blockCount; line += 7) {
+            sum += folding.lineToVisibleLine(line);
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
+void TestTextFolding::benchmarkVisibleLineToLine()
+{
+    const int numOfRanges = 10000;
+    QTextDocument doc(sectionedText(numOfRanges));
+    TextFolding folding(&doc);
+    foldSections(&doc, &folding, numOfRanges);
+
+    const int visibleCount = folding.lineToVisibleLine(doc.blockCount() - 1) + 1;
+    int sum = 0;
+    QBENCHMARK {
+        for (int vline = 0; vline < visibleCount; vline += 3) {
+            sum += folding.visibleLineToLine(vline);
+        }
+    }
+    QVERIFY(sum > 0);
+}
+
+void TestTextFolding::benchmarkEditWithManyFoldedRanges()
+{
+    const int numOfRanges = 10000;
+    QTextDocument doc(sectionedText(numOfRanges));
+    TextFolding folding(&doc);
+    foldSections(&doc, &folding, numOfRanges);
+
+    // Type into a visible line in the middle of the document, the way a user
+    // does: only the range around the cursor has to be looked at.
+    QTextCursor cursor(doc.findBlockByNumber(numOfRanges * 2 + 3));
+    QBENCHMARK {
+        cursor.insertText(QStringLiteral("x"));
+    }
+    QCOMPARE(folding.m_foldedFoldingRanges.size(), numOfRanges);
+    QVERIFY(checkCachedBlockNumbers(&folding));
+}
+
 QTEST_MAIN(tests::TestTextFolding)
\ No newline at end of file
@@ -38,6 +38,20 @@ namespace tests
 
         void testFoldQueriesWhenDisabled();
 
+        void testVisibleLineMapping();
+
+        void testVisibleLineMappingFollowsEdits();
+
+        void testIncrementalValidation();
+
+        void testIncrementalValidationDropsFoldedRange();
+
+        void benchmarkLineToVisibleLine();
+
+        void benchmarkVisibleLineToLine();
+
+        void benchmarkEditWithManyFoldedRanges();
+
         void cleanupTestCase();
 
         // Will be executed before any test function.
@@ -48,6 +62,10 @@ namespace tests
                                      int p_last,
                                      vte::TextFolding::FoldingRangeFlags p_flags = vte::TextFolding::FoldingRangeFlags());
 
+        // Whether every range caches its current block numbers, which the
+        // incremental validation relies on.
+        static bool checkCachedBlockNumbers(const vte::TextFolding *p_folding);
+
         QTextDocument *m_doc = nullptr;
 
         vte::TextFolding *m_textFolding = nullptr;
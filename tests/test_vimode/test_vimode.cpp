@@ -0,0 +1,322 @@
+#include "test_vimode.h"
+
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include <vtextedit/texteditorconfig.h>
+#include <vtextedit/vtextedit.h>
+#include <vtextedit/vtexteditor.h>
+
+using namespace tests;
+using namespace vte;
+
+namespace {
+// Published on the VTextEdit after each macro or repeat replay.
+const char *c_replayStatsProperty = "vte_vi_replay_stats";
+
+QSharedPointer<TextEditorConfig> viConfig() {
+  auto config = QSharedPointer<TextEditorConfig>::create();
+  config->m_inputMode = InputMode::ViMode;
+  return config;
+}
+
+// Type @p_keys, in which '\x1b' stands for Escape and '\n' for Return.
+void typeKeys(QWidget *p_widget, const QString &p_keys) {
+  for (const QChar ch : p_keys) {
+    if (ch == QLatin1Char('\x1b')) {
+      QTest::keyClick(p_widget, Qt::Key_Escape);
+    } else if (ch == QLatin1Char('\n')) {
+      QTest::keyClick(p_widget, Qt::Key_Return);
+    } else {
+      QTest::keyClicks(p_widget, QString(ch));
+    }
+  }
+}
+
+int cursorBlock(VTextEditor &p_editor) {
+  return p_editor.getTextEdit()->textCursor().blockNumber();
+}
+
+int cursorColumn(VTextEditor &p_editor) {
+  return p_editor.getTextEdit()->textCursor().positionInBlock();
+}
+
+// A recorded editing session: word and character motions, operators with
+// motions and text objects, counts and insertions.
+const char *c_session = "j0wcwword\x1b"
+                        "fardX"
+                        "0f(ci(args\x1b"
+                        "2wdw"
+                        "2jk"
+                        "A tail\x1b"
+                        "0de"
+                        "u";
+} // namespace
+
+void TestViMode::testOperatorWithMotion() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("alpha beta gamma"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg0dw"));
+  QCOMPARE(editor.getText(), QStringLiteral("beta gamma"));
+}
+
+void TestViMode::testRegexMotionAndCommand() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("alpha beta gamma"));
+
+  // f waits for the character to find, and r for the one to replace with.
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg0fgrX"));
+  QCOMPARE(editor.getText(), QStringLiteral("alpha beta Xamma"));
+
+  // An operator followed by a motion which takes a character too.
+  typeKeys(editor.getTextEdit(), QStringLiteral("0dtb"));
+  QCOMPARE(editor.getText(), QStringLiteral("beta Xamma"));
+}
+
+void TestViMode::testTextObject() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("call(foo, bar)"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg0fbci(x\x1b"));
+  QCOMPARE(editor.getText(), QStringLiteral("call(x)"));
+}
+
+void TestViMode::testCount() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("one\ntwo\nthree\nfour"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg2jx"));
+  QCOMPARE(cursorBlock(editor), 2);
+  QCOMPARE(editor.getText(), QStringLiteral("one\ntwo\nhree\nfour"));
+
+  // The count applies to the operator as well.
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg2dd"));
+  QCOMPARE(editor.getText(), QStringLiteral("hree\nfour"));
+}
+
+void TestViMode::testSearchNextAndPrevious() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("foo bar\nbaz foo\nfoobar foo"));
+
+  // A word search skips foo as part of a longer word.
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg0*"));
+  QCOMPARE(cursorBlock(editor), 1);
+  QCOMPARE(cursorColumn(editor), 4);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("n"));
+  QCOMPARE(cursorBlock(editor), 2);
+  QCOMPARE(cursorColumn(editor), 7);
+
+  // Past the last match it wraps to the first one.
+  typeKeys(editor.getTextEdit(), QStringLiteral("n"));
+  QCOMPARE(cursorBlock(editor), 0);
+  QCOMPARE(cursorColumn(editor), 0);
+
+  // And backward from the first one to the last one.
+  typeKeys(editor.getTextEdit(), QStringLiteral("N"));
+  QCOMPARE(cursorBlock(editor), 2);
+  QCOMPARE(cursorColumn(editor), 7);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("2N"));
+  QCOMPARE(cursorBlock(editor), 0);
+  QCOMPARE(cursorColumn(editor), 0);
+}
+
+void TestViMode::testSearchWordBackward() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("foo bar foo\nbar\nbar foo"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("G$#"));
+  QCOMPARE(cursorBlock(editor), 0);
+  QCOMPARE(cursorColumn(editor), 8);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("n"));
+  QCOMPARE(cursorBlock(editor), 0);
+  QCOMPARE(cursorColumn(editor), 0);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("n"));
+  QCOMPARE(cursorBlock(editor), 2);
+  QCOMPARE(cursorColumn(editor), 4);
+}
+
+void TestViMode::benchmarkSearchLargeDocument() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  // 100 000 lines with a match every 10 000 of them, so each n scans far.
+  QString text;
+  for (int i = 0; i < 100000; ++i) {
+    text += (i % 10000 == 0) ? QStringLiteral("needle %1\n").arg(i)
+                             : QStringLiteral("line %1 alpha beta gamma\n").arg(i);
+  }
+  editor.setText(text);
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg0*"));
+  QCOMPARE(cursorBlock(editor), 10000);
+
+  QBENCHMARK { typeKeys(editor.getTextEdit(), QStringLiteral("n")); }
+  QCOMPARE(cursorBlock(editor) % 10000, 0);
+}
+
+void TestViMode::testVisualRangeCommand() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  // Sets up the command line.
+  editor.statusWidget();
+  editor.setText(QStringLiteral("a\nfoo\nfoo\nfoo"));
+
+  // : in visual mode runs the command on the selected lines.
+  typeKeys(editor.getTextEdit(), QStringLiteral("ggjVj:s/foo/bar/\n"));
+  QCOMPARE(editor.getText(), QStringLiteral("a\nbar\nbar\nfoo"));
+}
+
+void TestViMode::testSubstituteEmptyLine() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.statusWidget();
+  editor.setText(QStringLiteral("a\n\nb"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg:%s/^$/x/\n"));
+  QCOMPARE(editor.getText(), QStringLiteral("a\nx\nb"));
+  QCOMPARE(cursorBlock(editor), 1);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("u"));
+  QCOMPARE(editor.getText(), QStringLiteral("a\n\nb"));
+}
+
+void TestViMode::testSubstituteUndoneAtOnce() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.statusWidget();
+  editor.setText(QStringLiteral("foo\nx\n  foo foo\nx"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("G:%s/foo/bar/g\n"));
+  QCOMPARE(editor.getText(), QStringLiteral("bar\nx\n  bar bar\nx"));
+
+  // On the first non-space character of the last line changed.
+  QCOMPARE(cursorBlock(editor), 2);
+  QCOMPARE(cursorColumn(editor), 2);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("u"));
+  QCOMPARE(editor.getText(), QStringLiteral("foo\nx\n  foo foo\nx"));
+}
+
+void TestViMode::testGlobalDeleteLastLine() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.statusWidget();
+  editor.setText(QStringLiteral("a\nfoo\nb\nfoo"));
+
+  // The last line goes with the line break before it.
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg:g/foo/d\n"));
+  QCOMPARE(editor.getText(), QStringLiteral("a\nb"));
+  QCOMPARE(cursorBlock(editor), 1);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("u"));
+  QCOMPARE(editor.getText(), QStringLiteral("a\nfoo\nb\nfoo"));
+}
+
+void TestViMode::testGlobalDeleteAll() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.statusWidget();
+  editor.setText(QStringLiteral("foo\nfoo bar\nfoo"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("gg:g/foo/d\n"));
+  QCOMPARE(editor.getText(), QString());
+  QCOMPARE(cursorBlock(editor), 0);
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("u"));
+  QCOMPARE(editor.getText(), QStringLiteral("foo\nfoo bar\nfoo"));
+}
+
+void TestViMode::benchmarkSubstituteLargeDocument() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.statusWidget();
+
+  QString text;
+  for (int i = 0; i < 100000; ++i) {
+    text += QStringLiteral("line %1 foo beta food\n").arg(i);
+  }
+
+  QBENCHMARK {
+    editor.setText(text);
+    typeKeys(editor.getTextEdit(), QStringLiteral(":%s/\\<foo\\>/qux/g\n"));
+  }
+  QVERIFY(editor.getText().startsWith(QStringLiteral("line 0 qux beta food\n")));
+}
+
+void TestViMode::testMacroReplayRefreshesOnce() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("0\n1\n2\n3\n4\n5\n6\n7\n8\n9"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("ggqqA!\x1bjq"));
+  QCOMPARE(cursorBlock(editor), 1);
+
+  QSignalSpy spy(editor.getTextEdit(), &VTextEdit::cursorLineChanged);
+  typeKeys(editor.getTextEdit(), QStringLiteral("8@q"));
+  QCOMPARE(editor.getText(), QStringLiteral("0!\n1!\n2!\n3!\n4!\n5!\n6!\n7!\n8!\n9"));
+  QCOMPARE(cursorBlock(editor), 9);
+
+  // The cursor went through eight lines but the listeners saw the last one.
+  QCOMPARE(spy.count(), 1);
+
+  const auto stats = editor.getTextEdit()->property(c_replayStatsProperty).toMap();
+  QCOMPARE(stats.value(QStringLiteral("keys")).toInt(), 8 * 4);
+
+  // Undone as one edit.
+  typeKeys(editor.getTextEdit(), QStringLiteral("u"));
+  QCOMPARE(editor.getText(), QStringLiteral("0!\n1\n2\n3\n4\n5\n6\n7\n8\n9"));
+}
+
+void TestViMode::testRepeatLastChangeIsBatched() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+  editor.setText(QStringLiteral("a\nb"));
+
+  typeKeys(editor.getTextEdit(), QStringLiteral("ggA!\x1bj."));
+  QCOMPARE(editor.getText(), QStringLiteral("a!\nb!"));
+
+  const auto stats = editor.getTextEdit()->property(c_replayStatsProperty).toMap();
+  QVERIFY(stats.value(QStringLiteral("keys")).toInt() > 0);
+}
+
+void TestViMode::benchmarkMacroReplay() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  QString text;
+  for (int i = 0; i < 1000; ++i) {
+    text += QStringLiteral("line %1 alpha beta\n").arg(i);
+  }
+
+  qint64 keysPerSecond = 0;
+  QBENCHMARK {
+    editor.setText(text);
+    typeKeys(editor.getTextEdit(), QStringLiteral("ggqq0wcwword\x1bA;\x1bjq998@q"));
+    const auto stats = editor.getTextEdit()->property(c_replayStatsProperty).toMap();
+    keysPerSecond = stats.value(QStringLiteral("keysPerSecond")).toLongLong();
+  }
+  qDebug() << "replayed" << keysPerSecond << "keys per second";
+  QVERIFY(editor.getText().startsWith(QStringLiteral("line word alpha beta;\n")));
+}
+
+void TestViMode::benchmarkReplaySession() {
+  VTextEditor editor(viConfig(), QSharedPointer<TextEditorParameters>::create());
+
+  QString text;
+  for (int i = 0; i < 400; ++i) {
+    text += QStringLiteral("line %1 alpha beta call(foo, bar) delta\n").arg(i);
+  }
+
+  // Long enough for the per key cost to dominate the setup.
+  QString session;
+  for (int i = 0; i < 40; ++i) {
+    session += QLatin1String(c_session);
+  }
+
+  int keys = 0;
+  QBENCHMARK {
+    editor.setText(text);
+    typeKeys(editor.getTextEdit(), QStringLiteral("gg"));
+    typeKeys(editor.getTextEdit(), session);
+    keys += session.size() + 2;
+  }
+  qDebug() << "replayed" << keys << "keys";
+  QVERIFY(editor.getText() != text);
+}
+
+QTEST_MAIN(tests::TestViMode)
@@ -0,0 +1,39 @@
+#ifndef TESTS_TEST_VIMODE_H
+#define TESTS_TEST_VIMODE_H
+
+#include <QtTest>
+
+namespace tests {
+// Key handling of the vi input mode, driven through the public editor.
+class TestViMode : public QObject {
+  Q_OBJECT
+private slots:
+  // Command and motion matching.
+  void testOperatorWithMotion();
+  void testRegexMotionAndCommand();
+  void testTextObject();
+  void testCount();
+
+  // Searching through the editor interface.
+  void testSearchNextAndPrevious();
+  void testSearchWordBackward();
+  void benchmarkSearchLargeDocument();
+
+  // Line commands typed on the command line.
+  void testVisualRangeCommand();
+  void testSubstituteEmptyLine();
+  void testSubstituteUndoneAtOnce();
+  void testGlobalDeleteLastLine();
+  void testGlobalDeleteAll();
+  void benchmarkSubstituteLargeDocument();
+
+  // Macro and repeat replay.
+  void testMacroReplayRefreshesOnce();
+  void testRepeatLastChangeIsBatched();
+  void benchmarkMacroReplay();
+
+  void benchmarkReplaySession();
+};
+} // namespace tests
+
+#endif // TESTS_TEST_VIMODE_H